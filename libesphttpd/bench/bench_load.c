@@ -0,0 +1,792 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          bench_load.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Load generator for bench_server.c. Runs the scenarios one after the other, each for the given
+time, and writes a JSON report with the requests per second, the p50/p99 latency and the heap
+counters of the server:
+
+   static      keep-alive clients loading the assets of the pages: css, js and images
+   template    keep-alive clients loading the template pages
+   config      keep-alive clients posting the config form to /Config.cgi
+   websocket   clients connected to /status, each request of /bench/broadcast is sent to all
+               of them, the latency is the time until a client got the message
+   slow        clients loading the big image with a small receive buffer and slow reads, in
+               parallel to clients loading the static assets; the latency is the one of the
+               static requests
+
+The heap counters are taken from /bench/stats after each scenario, they are cleared before.
+*/
+
+#define _GNU_SOURCE        // strcasestr()
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+static int port = 8088;
+static int duration = 3;               // seconds per scenario
+static int clients = 16;
+static int slowClients = 4;
+static const char *label = "";
+
+static const char *staticAssets[] =
+{
+   "/css/style.css",
+   "/css/siimple.min.css",
+   "/js/common.js",
+   "/js/140medley.min.js",
+   "/js/smoothie_min.js",
+   "/img/favicon.png",
+   "/img/arrow_up.png",
+   "/img/arrow_down.png",
+   "/img/wifi_icons.png",
+   "/img/IoT-Wifi-Switch_320x240.jpg",
+   "/favicon.ico",
+   NULL
+};
+
+static const char *templatePages[] =
+{
+   "/index.tpl.html",
+   "/Timer.tpl.html",
+   "/WifiConfig.tpl.html",
+   "/MqttConfig.tpl.html",
+   "/History.tpl.html",
+   "/WifiSetup.tpl.html",
+   NULL
+};
+
+static const char configForm[] =
+   "hostname=iot-switch&wlan_net=HomeNet&wlan_password=very%20secret&sta_only=0"
+   "&sta_power_save=1&sta_static_ip=0&ap_ssid=IoT-Switch&ap_password=12345678"
+   "&ap_ssid_hidden=0&dhcp_enable=1&dhcp_address=192.168.4.1&dhcp_netmask=255.255.255.0"
+   "&dhcp_gateway=192.168.4.1&dhcp_server=192.168.4.1&mqtt_enable_ssl=0&mqtt_self_signed=0"
+   "&mqtt_server=broker.local&mqtt_port=1883&mqtt_client_id=switch-1&mqtt_user=iot"
+   "&mqtt_password=pw%26more&mqtt_keep_alive=120&wifi_server=update.local&wifi_port=80";
+
+#define SLOW_ASSET      "/img/IoT-Wifi-Switch_320x240.jpg"
+#define SLOW_RCVBUF     4096
+#define SLOW_CHUNK      512
+#define SLOW_DELAY_US   10000
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+static uint64_t nowUs( void )
+{
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ( uint64_t )ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+typedef struct
+{
+   uint32_t *v;
+   int n;
+   int size;
+} Samples;
+
+static void samplesAdd( Samples *s, uint32_t us )
+{
+   if( s->n == s->size )
+   {
+      s->size = s->size ? s->size * 2 : 4096;
+      s->v = realloc( s->v, s->size * sizeof( uint32_t ) );
+      if( s->v == NULL )
+      {
+         perror( "realloc" );
+         exit( 1 );
+      }
+   }
+   s->v[s->n++] = us;
+}
+
+static void samplesMerge( Samples *to, const Samples *from )
+{
+   for( int i = 0; i < from->n; i++ )
+      samplesAdd( to, from->v[i] );
+}
+
+static int cmpU32( const void *a, const void *b )
+{
+   uint32_t x = *( const uint32_t * )a, y = *( const uint32_t * )b;
+   return x < y ? -1 : x > y;
+}
+
+static double samplesPercentile( Samples *s, double q )
+{
+   if( s->n == 0 )
+      return 0;
+   return s->v[( int )( ( s->n - 1 ) * q + 0.5 )] / 1000.0;
+}
+
+// --------------------------------------------------------------------------
+// http client
+// --------------------------------------------------------------------------
+
+typedef struct
+{
+   int fd;
+   int rcvbuf;                         // SO_RCVBUF, 0 for the default
+   int chunk;                          // read at most chunk bytes at once, 0 for no limit
+   int delay;                          // us to wait before each read
+   int len, pos;                       // data in buf[pos..len)
+   char buf[16384];
+} Client;
+
+static int clientConnect( Client *c )
+{
+   struct sockaddr_in addr;
+   int one = 1;
+
+   c->fd = socket( AF_INET, SOCK_STREAM, 0 );
+   if( c->fd < 0 )
+      return -1;
+   if( c->rcvbuf )
+      setsockopt( c->fd, SOL_SOCKET, SO_RCVBUF, &c->rcvbuf, sizeof( c->rcvbuf ) );
+   setsockopt( c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof( one ) );
+
+   struct timeval tv = { 5, 0 };
+   setsockopt( c->fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+
+   memset( &addr, 0, sizeof( addr ) );
+   addr.sin_family = AF_INET;
+   addr.sin_port = htons( port );
+   addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+   if( connect( c->fd, ( struct sockaddr * )&addr, sizeof( addr ) ) < 0 )
+   {
+      close( c->fd );
+      c->fd = -1;
+      return -1;
+   }
+   c->len = c->pos = 0;
+   return 0;
+}
+
+static void clientClose( Client *c )
+{
+   if( c->fd >= 0 )
+      close( c->fd );
+   c->fd = -1;
+}
+
+static int clientFill( Client *c )
+{
+   int max, n;
+
+   if( c->pos == c->len )
+      c->pos = c->len = 0;
+   else if( c->len == sizeof( c->buf ) )
+   {
+      memmove( c->buf, c->buf + c->pos, c->len - c->pos );
+      c->len -= c->pos;
+      c->pos = 0;
+   }
+
+   max = sizeof( c->buf ) - c->len;
+   if( c->chunk && max > c->chunk )
+      max = c->chunk;
+   if( c->delay )
+      usleep( c->delay );
+
+   n = recv( c->fd, c->buf + c->len, max, 0 );
+   if( n <= 0 )
+      return -1;
+   c->len += n;
+   return n;
+}
+
+// next line without CRLF, NULL if the connection failed
+static char *clientLine( Client *c )
+{
+   for( ;; )
+   {
+      char *end = memchr( c->buf + c->pos, '\n', c->len - c->pos );
+      if( end != NULL )
+      {
+         char *line = c->buf + c->pos;
+         c->pos = end + 1 - c->buf;
+         if( end > line && end[-1] == '\r' )
+            end--;
+         *end = 0;
+         return line;
+      }
+      if( c->pos == 0 && c->len == sizeof( c->buf ) )
+         return NULL;
+      if( clientFill( c ) < 0 )
+         return NULL;
+   }
+}
+
+static int clientSkip( Client *c, long n )
+{
+   while( n > 0 )
+   {
+      if( c->pos == c->len && clientFill( c ) < 0 )
+         return -1;
+      long k = c->len - c->pos < n ? c->len - c->pos : n;
+      c->pos += k;
+      n -= k;
+   }
+   return 0;
+}
+
+// read the status line and the headers, returns the status code or -1
+static int clientHeaders( Client *c, long *contentLength, bool *chunked, bool *keepAlive )
+{
+   char *line = clientLine( c );
+   int status;
+
+   *contentLength = -1;
+   *chunked = false;
+   *keepAlive = true;
+   if( line == NULL || sscanf( line, "HTTP/1.%*d %d", &status ) != 1 )
+      return -1;
+   if( strncmp( line, "HTTP/1.0", 8 ) == 0 )
+      *keepAlive = false;
+
+   while( ( line = clientLine( c ) ) != NULL && *line != 0 )
+   {
+      if( strncasecmp( line, "Content-Length:", 15 ) == 0 )
+         *contentLength = atol( line + 15 );
+      else if( strncasecmp( line, "Transfer-Encoding:", 18 ) == 0 && strcasestr( line, "chunked" ) )
+         *chunked = true;
+      else if( strncasecmp( line, "Connection:", 11 ) == 0 )
+         *keepAlive = strcasestr( line, "close" ) == NULL;
+   }
+   return line == NULL ? -1 : status;
+}
+
+// send a request and read the response, returns the status code or -1
+static int httpRequest( Client *c, const char *method, const char *path, const char *body )
+{
+   char req[512];
+   long contentLength;
+   bool chunked, keepAlive;
+   int len, status;
+
+   if( c->fd < 0 && clientConnect( c ) < 0 )
+      return -1;
+
+   if( body != NULL )
+      len = snprintf( req, sizeof( req ), "%s %s HTTP/1.1\r\nHost: 127.0.0.1\r\n"
+                      "Content-Type: application/x-www-form-urlencoded\r\nContent-Length: %d\r\n\r\n",
+                      method, path, ( int )strlen( body ) );
+   else
+      len = snprintf( req, sizeof( req ), "%s %s HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n", method, path );
+
+   if( send( c->fd, req, len, MSG_NOSIGNAL ) != len
+    || ( body != NULL && send( c->fd, body, strlen( body ), MSG_NOSIGNAL ) != ( ssize_t )strlen( body ) ) )
+      goto fail;
+
+   status = clientHeaders( c, &contentLength, &chunked, &keepAlive );
+   if( status < 0 )
+      goto fail;
+
+   if( chunked )
+   {
+      for( ;; )
+      {
+         char *line = clientLine( c );
+         if( line == NULL )
+            goto fail;
+         long n = strtol( line, NULL, 16 );
+         if( clientSkip( c, n ) < 0 || ( line = clientLine( c ) ) == NULL )
+            goto fail;
+         if( n == 0 )
+            break;
+      }
+   }
+   else if( contentLength >= 0 )
+   {
+      if( clientSkip( c, contentLength ) < 0 )
+         goto fail;
+   }
+   else
+   {
+      // body ends with the connection
+      while( clientFill( c ) > 0 )
+         c->pos = c->len;
+      keepAlive = false;
+   }
+
+   if( !keepAlive )
+      clientClose( c );
+   return status;
+
+fail:
+   clientClose( c );
+   return -1;
+}
+
+// the body of a small response, e.g. of /bench/stats
+static int httpGet( const char *path, char *out, int size )
+{
+   Client *c = calloc( 1, sizeof( Client ) );
+   long contentLength;
+   bool chunked, keepAlive;
+   int status = -1;
+   char req[256];
+
+   out[0] = 0;
+   if( c == NULL || clientConnect( c ) < 0 )
+      goto done;
+
+   int len = snprintf( req, sizeof( req ), "GET %s HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n", path );
+   if( send( c->fd, req, len, MSG_NOSIGNAL ) != len )
+      goto done;
+   status = clientHeaders( c, &contentLength, &chunked, &keepAlive );
+
+   // small bodies only, they come in one piece or with the end of the connection
+   int n = 0;
+   while( n < size - 1 && ( c->pos < c->len || clientFill( c ) > 0 ) )
+   {
+      int k = c->len - c->pos < size - 1 - n ? c->len - c->pos : size - 1 - n;
+      memcpy( out + n, c->buf + c->pos, k );
+      c->pos += k;
+      n += k;
+      if( contentLength >= 0 && n >= contentLength )
+         break;
+   }
+   out[n] = 0;
+
+done:
+   if( c != NULL )
+      clientClose( c );
+   free( c );
+   return status;
+}
+
+// --------------------------------------------------------------------------
+// websocket client
+// --------------------------------------------------------------------------
+
+static int wsConnect( Client *c )
+{
+   static const char req[] =
+      "GET /status HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n";
+   long contentLength;
+   bool chunked, keepAlive;
+
+   if( clientConnect( c ) < 0 )
+      return -1;
+   if( send( c->fd, req, sizeof( req ) - 1, MSG_NOSIGNAL ) != sizeof( req ) - 1
+    || clientHeaders( c, &contentLength, &chunked, &keepAlive ) != 101 )
+   {
+      clientClose( c );
+      return -1;
+   }
+   return 0;
+}
+
+// take a complete frame out of the buffer, returns the payload length or -1
+static int wsFrame( Client *c )
+{
+   unsigned char *p = ( unsigned char * )c->buf + c->pos;
+   int avail = c->len - c->pos;
+   int head = 2;
+   long len;
+
+   if( avail < 2 )
+      return -1;
+   len = p[1] & 0x7f;
+   if( len == 126 )
+   {
+      head = 4;
+      if( avail < head )
+         return -1;
+      len = ( p[2] << 8 ) | p[3];
+   }
+   else if( len == 127 )
+      return -1;                       // never sent by the server for these messages
+   if( avail < head + len )
+      return -1;
+   c->pos += head + len;
+   return len;
+}
+
+// --------------------------------------------------------------------------
+// scenarios
+// --------------------------------------------------------------------------
+
+typedef struct
+{
+   int id;
+   uint64_t deadline;
+   Samples lat;
+   long requests;
+   long errors;
+   long extra;                         // requests of the slow clients, websocket receivers
+} Worker;
+
+typedef struct
+{
+   const char *name;
+   void *( *run )( void *arg );
+   int threads;
+} Scenario;
+
+static void *runPaths( Worker *w, const char **paths, const char *body, int rcvbuf, int chunk, int delay )
+{
+   Client *c = calloc( 1, sizeof( Client ) );
+   int n = 0, i;
+
+   // every client starts with another path
+   while( paths[n] != NULL )
+      n++;
+   i = w->id % n;
+
+   if( c == NULL )
+      return NULL;
+   c->fd = -1;
+   c->rcvbuf = rcvbuf;
+   c->chunk = chunk;
+   c->delay = delay;
+
+   while( nowUs() < w->deadline )
+   {
+      const char *path = paths[i];
+      i = ( i + 1 ) % n;
+
+      uint64_t t0 = nowUs();
+      int status = httpRequest( c, body ? "POST" : "GET", path, body );
+      if( status != 200 )
+      {
+         w->errors++;
+         usleep( 1000 );
+         continue;
+      }
+      samplesAdd( &w->lat, nowUs() - t0 );
+      w->requests++;
+   }
+   clientClose( c );
+   free( c );
+   return NULL;
+}
+
+static void *runStatic( void *arg )
+{
+   return runPaths( arg, staticAssets, NULL, 0, 0, 0 );
+}
+
+static void *runTemplate( void *arg )
+{
+   return runPaths( arg, templatePages, NULL, 0, 0, 0 );
+}
+
+static void *runConfig( void *arg )
+{
+   static const char *paths[] = { "/Config.cgi", NULL };
+   return runPaths( arg, paths, configForm, 0, 0, 0 );
+}
+
+// the first slowClients threads are slow readers, the others load the static assets
+static void *runSlow( void *arg )
+{
+   static const char *paths[] = { SLOW_ASSET, NULL };
+   Worker *w = arg;
+
+   if( w->id >= slowClients )
+      return runStatic( arg );
+
+   runPaths( w, paths, NULL, SLOW_RCVBUF, SLOW_CHUNK, SLOW_DELAY_US );
+
+   // not part of the latency of the normal clients
+   w->extra = w->requests;
+   w->requests = 0;
+   w->lat.n = 0;
+   return NULL;
+}
+
+// one thread: connect the websockets, then broadcast and wait until every client got it
+static void *runWebsocket( void *arg )
+{
+   Worker *w = arg;
+   Client *ws = calloc( clients, sizeof( Client ) );
+   Client *http = calloc( 1, sizeof( Client ) );
+   struct pollfd *pfd = calloc( clients, sizeof( struct pollfd ) );
+   int *slot = calloc( clients, sizeof( int ) );
+   int n = 0;
+   unsigned seq = 0;
+
+   if( ws == NULL || http == NULL || pfd == NULL || slot == NULL )
+      goto done;
+   http->fd = -1;
+
+   for( int i = 0; i < clients; i++ )
+   {
+      if( wsConnect( &ws[n] ) == 0 )
+         n++;
+      else
+         w->errors++;
+   }
+   w->extra = n;
+
+   while( n > 0 && nowUs() < w->deadline )
+   {
+      char path[64];
+      snprintf( path, sizeof( path ), "/bench/broadcast?%u", seq++ );
+
+      uint64_t t0 = nowUs();
+      if( httpRequest( http, "GET", path, NULL ) != 200 )
+      {
+         w->errors++;
+         usleep( 1000 );
+         continue;
+      }
+
+      int waiting = n;
+      for( int i = 0; i < n; i++ )
+         slot[i] = 1;
+
+      while( waiting > 0 )
+      {
+         int k = 0;
+         for( int i = 0; i < n; i++ )
+         {
+            if( slot[i] )
+            {
+               pfd[k].fd = ws[i].fd;
+               pfd[k].events = POLLIN;
+               slot[i] = k + 1;
+               k++;
+            }
+         }
+         if( poll( pfd, k, 2000 ) <= 0 )
+         {
+            w->errors += waiting;
+            goto done;
+         }
+         for( int i = 0; i < n; i++ )
+         {
+            if( slot[i] == 0 || !( pfd[slot[i] - 1].revents & ( POLLIN | POLLHUP | POLLERR ) ) )
+               continue;
+            if( clientFill( &ws[i] ) < 0 )
+            {
+               w->errors += waiting;
+               goto done;
+            }
+            if( wsFrame( &ws[i] ) >= 0 )
+            {
+               samplesAdd( &w->lat, nowUs() - t0 );
+               w->requests++;
+               slot[i] = 0;
+               waiting--;
+            }
+         }
+      }
+   }
+
+done:
+   if( ws != NULL )
+      for( int i = 0; i < n; i++ )
+         clientClose( &ws[i] );
+   if( http != NULL )
+      clientClose( http );
+   free( ws );
+   free( http );
+   free( pfd );
+   free( slot );
+   return NULL;
+}
+
+static const Scenario scenarios[] =
+{
+   { "static",    runStatic,     0 },
+   { "template",  runTemplate,   0 },
+   { "config",    runConfig,     0 },
+   { "websocket", runWebsocket,  1 },
+   { "slow",      runSlow,       -1 },        // clients + slowClients
+   { NULL, NULL, 0 }
+};
+
+// value of a number in the JSON object of /bench/stats
+static long statsValue( const char *json, const char *name )
+{
+   char key[32];
+   const char *p;
+
+   snprintf( key, sizeof( key ), "\"%s\"", name );
+   p = strstr( json, key );
+   if( p == NULL || ( p = strchr( p, ':' ) ) == NULL )
+      return -1;
+   return atol( p + 1 );
+}
+
+static void runScenario( FILE *out, const Scenario *sc, bool last )
+{
+   int threads = sc->threads > 0 ? sc->threads : sc->threads < 0 ? clients + slowClients : clients;
+   Worker *w = calloc( threads, sizeof( Worker ) );
+   pthread_t *tid = calloc( threads, sizeof( pthread_t ) );
+   Samples lat = { NULL, 0, 0 };
+   long requests = 0, errors = 0, extra = 0;
+   char stats[256];
+
+   if( w == NULL || tid == NULL )
+   {
+      perror( "calloc" );
+      exit( 1 );
+   }
+
+   httpGet( "/bench/reset", stats, sizeof( stats ) );
+
+   uint64_t start = nowUs();
+   for( int i = 0; i < threads; i++ )
+   {
+      w[i].id = i;
+      w[i].deadline = start + ( uint64_t )duration * 1000000;
+      pthread_create( &tid[i], NULL, sc->run, &w[i] );
+   }
+   for( int i = 0; i < threads; i++ )
+   {
+      pthread_join( tid[i], NULL );
+      samplesMerge( &lat, &w[i].lat );
+      requests += w[i].requests;
+      errors += w[i].errors;
+      extra += w[i].extra;
+      free( w[i].lat.v );
+   }
+   double secs = ( nowUs() - start ) / 1e6;
+
+   if( httpGet( "/bench/stats", stats, sizeof( stats ) ) != 200 )
+      stats[0] = 0;
+
+   qsort( lat.v, lat.n, sizeof( uint32_t ), cmpU32 );
+
+   fprintf( out, "    {\n" );
+   fprintf( out, "      \"name\" : \"%s\",\n", sc->name );
+   fprintf( out, "      \"clients\" : %d,\n", sc->run == runWebsocket ? clients : threads );
+   fprintf( out, "      \"requests\" : %ld,\n", requests );
+   fprintf( out, "      \"errors\" : %ld,\n", errors );
+   if( sc->run == runWebsocket )
+      fprintf( out, "      \"receivers\" : %ld,\n", extra );
+   if( sc->run == runSlow )
+      fprintf( out, "      \"slow_clients\" : %d,\n      \"slow_requests\" : %ld,\n", slowClients, extra );
+   fprintf( out, "      \"rps\" : %.1f,\n", requests / secs );
+   fprintf( out, "      \"p50_ms\" : %.3f,\n", samplesPercentile( &lat, 0.50 ) );
+   fprintf( out, "      \"p99_ms\" : %.3f,\n", samplesPercentile( &lat, 0.99 ) );
+   fprintf( out, "      \"heap_peak\" : %ld,\n", statsValue( stats, "heap_peak" ) );
+   fprintf( out, "      \"allocs\" : %ld,\n", statsValue( stats, "allocs" ) );
+   fprintf( out, "      \"frees\" : %ld\n", statsValue( stats, "frees" ) );
+   fprintf( out, "    }%s\n", last ? "" : "," );
+   fflush( out );
+
+   fprintf( stderr, "%-10s %8.1f req/s  p50 %7.3f ms  p99 %7.3f ms  errors %ld\n",
+            sc->name, requests / secs, samplesPercentile( &lat, 0.50 ), samplesPercentile( &lat, 0.99 ), errors );
+
+   free( lat.v );
+   free( tid );
+   free( w );
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+static void usage( const char *name )
+{
+   fprintf( stderr, "Usage: %s [-p port] [-t seconds] [-c clients] [-s slow-clients] [-l label]\n"
+                    "          [-o report.json] [scenario ...]\n", name );
+   exit( 1 );
+}
+
+int main( int argc, char **argv )
+{
+   const char *report = NULL;
+   FILE *out = stdout;
+   char stats[256];
+   char date[32];
+   int opt, i;
+
+   while( ( opt = getopt( argc, argv, "p:t:c:s:l:o:" ) ) != -1 )
+   {
+      switch( opt )
+      {
+         case 'p': port = atoi( optarg ); break;
+         case 't': duration = atoi( optarg ); break;
+         case 'c': clients = atoi( optarg ); break;
+         case 's': slowClients = atoi( optarg ); break;
+         case 'l': label = optarg; break;
+         case 'o': report = optarg; break;
+         default:  usage( argv[0] );
+      }
+   }
+   if( duration <= 0 || clients <= 0 || slowClients < 0 )
+      usage( argv[0] );
+
+   signal( SIGPIPE, SIG_IGN );
+
+   // wait for the server
+   for( i = 0; i < 50 && httpGet( "/bench/stats", stats, sizeof( stats ) ) != 200; i++ )
+      usleep( 100000 );
+   if( i == 50 )
+   {
+      fprintf( stderr, "no server on 127.0.0.1:%d\n", port );
+      return 1;
+   }
+
+   if( report != NULL && ( out = fopen( report, "w" ) ) == NULL )
+   {
+      perror( report );
+      return 1;
+   }
+
+   time_t t = time( NULL );
+   strftime( date, sizeof( date ), "%Y-%m-%dT%H:%M:%SZ", gmtime( &t ) );
+
+   fprintf( out, "{\n" );
+   fprintf( out, "  \"label\" : \"%s\",\n", label );
+   fprintf( out, "  \"date\" : \"%s\",\n", date );
+   fprintf( out, "  \"duration\" : %d,\n", duration );
+   fprintf( out, "  \"scenarios\" :\n  [\n" );
+
+   // all scenarios or the ones named on the command line, in the order of the table
+   const Scenario *run[sizeof( scenarios ) / sizeof( scenarios[0] )];
+   int n = 0;
+   for( const Scenario *sc = scenarios; sc->name != NULL; sc++ )
+   {
+      bool selected = optind == argc;
+      for( i = optind; i < argc; i++ )
+         selected |= strcmp( argv[i], sc->name ) == 0;
+      if( selected )
+         run[n++] = sc;
+   }
+   for( i = 0; i < n; i++ )
+      runScenario( out, run[i], i == n - 1 );
+
+   fprintf( out, "  ]\n}\n" );
+   if( out != stdout )
+      fclose( out );
+   return 0;
+}
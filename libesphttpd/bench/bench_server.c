@@ -0,0 +1,454 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          bench_server.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   /bench/wait, /bench/wake: a request waiting for an event like a wifi scan
+//    2026-10-19  AWe   /events, /bench/broadcast also publishes a status event
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Linux build of the web server for the load benchmark, see bench_load.c. It serves the espfs
+image of the html/ directory with the url table of the firmware on the loopback interface.
+
+The cgi functions of the firmware need the SDK and the switch hardware, they are replaced by
+stand-ins doing the same kind of work: the template pages get a value for every token, the
+config form is parsed with the post parser and counted, and the websocket on /status gets a
+broadcast on each request of /bench/broadcast. /bench/wait waits like the scan of cgiWiFiScan(),
+until the next request of /bench/wake or the timeout given in ms as query.
+
+malloc() and friends are wrapped ( -Wl,--wrap ) to count the allocations and the heap in use.
+/bench/stats returns the counters as JSON, /bench/reset clears them.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <signal.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+#include "libesphttpd/httpd.h"
+#include "libesphttpd/httpd-freertos.h"
+#include "libesphttpd/httpdespfs.h"
+#include "libesphttpd/cgiwebsocket.h"
+#include "libesphttpd/cgieventsource.h"
+#include "libesphttpd/postparser.h"
+#include "libesphttpd/espfs.h"
+#ifdef CONFIG_ESPHTTPD_METRICS
+   #include "libesphttpd/httpdmetrics.h"
+#endif
+
+// --------------------------------------------------------------------------
+// heap accounting
+// --------------------------------------------------------------------------
+
+void *__real_malloc( size_t size );
+void *__real_calloc( size_t n, size_t size );
+void *__real_realloc( void *p, size_t size );
+void __real_free( void *p );
+
+static struct
+{
+   long allocs;
+   long frees;
+   long heap;        // bytes in use
+   long heapPeak;
+} heapStats;
+
+static void heapAdd( long n )
+{
+   long now = __atomic_add_fetch( &heapStats.heap, n, __ATOMIC_RELAXED );
+   long peak = __atomic_load_n( &heapStats.heapPeak, __ATOMIC_RELAXED );
+
+   while( now > peak && !__atomic_compare_exchange_n( &heapStats.heapPeak, &peak, now, true,
+                                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+      ;
+}
+
+static void *heapCount( void *p )
+{
+   if( p != NULL )
+   {
+      __atomic_add_fetch( &heapStats.allocs, 1, __ATOMIC_RELAXED );
+      heapAdd( malloc_usable_size( p ) );
+   }
+   return p;
+}
+
+void *__wrap_malloc( size_t size )
+{
+   return heapCount( __real_malloc( size ) );
+}
+
+void *__wrap_calloc( size_t n, size_t size )
+{
+   return heapCount( __real_calloc( n, size ) );
+}
+
+void *__wrap_realloc( void *p, size_t size )
+{
+   long old = p ? ( long )malloc_usable_size( p ) : 0;
+   void *n = __real_realloc( p, size );
+
+   if( n != NULL || size == 0 )
+   {
+      __atomic_add_fetch( &heapStats.allocs, 1, __ATOMIC_RELAXED );
+      if( p != NULL )
+         __atomic_add_fetch( &heapStats.frees, 1, __ATOMIC_RELAXED );
+      heapAdd( ( n ? ( long )malloc_usable_size( n ) : 0 ) - old );
+   }
+   return n;
+}
+
+void __wrap_free( void *p )
+{
+   if( p != NULL )
+   {
+      __atomic_add_fetch( &heapStats.frees, 1, __ATOMIC_RELAXED );
+      __atomic_sub_fetch( &heapStats.heap, ( long )malloc_usable_size( p ), __ATOMIC_RELAXED );
+   }
+   __real_free( p );
+}
+
+// --------------------------------------------------------------------------
+// SDK functions used by the library
+// --------------------------------------------------------------------------
+
+static bool verbose;
+
+int os_printf( const char *format, ... )
+{
+   va_list ap;
+   int n = 0;
+
+   if( verbose )
+   {
+      va_start( ap, format );
+      n = vfprintf( stderr, format, ap );
+      va_end( ap );
+   }
+   return n;
+}
+
+uint32_t system_get_time( void )
+{
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ( uint32_t )ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+char *sys_time2str( uint32_t sys_time )
+{
+   static __thread char buf[16];
+   snprintf( buf, sizeof( buf ), "%u.%03u", sys_time / 1000, sys_time % 1000 );
+   return buf;
+}
+
+// --------------------------------------------------------------------------
+// stand-ins for the cgi functions of the firmware
+// --------------------------------------------------------------------------
+
+static HttpdFreertosInstance httpdInstance;
+static EventSource benchEvents;
+
+// value of a token: the name of the token, like the short settings of the real pages
+static CgiStatus ICACHE_FLASH_ATTR tplBench( HttpdConnData *connData, char *token, void **arg )
+{
+   if( token == NULL )
+      return HTTPD_CGI_DONE;
+
+   tplSend( connData, token, -1 );
+   return HTTPD_CGI_DONE;
+}
+
+typedef struct
+{
+   HttpdPostParser pp;
+   int count;
+} BenchPostData;
+
+static int ICACHE_FLASH_ATTR benchPostField( HttpdPostParser *pp, const char *data, int len, int flags )
+{
+   BenchPostData *bpd = ( BenchPostData * )pp->arg;
+
+   if( flags & HTTPD_POST_LAST )
+      bpd->count++;
+   return 0;
+}
+
+// the form of the config pages, answered like cgiConfig() of the firmware
+static CgiStatus ICACHE_FLASH_ATTR cgiBenchConfig( HttpdConnData *connData )
+{
+   BenchPostData *bpd = ( BenchPostData * )connData->cgiData;
+   char buf[48];
+   int rc;
+
+   if( connData->isConnectionClosed )
+   {
+      free( connData->cgiData );
+      connData->cgiData = NULL;
+      return HTTPD_CGI_DONE;
+   }
+
+   if( connData->requestType != HTTPD_METHOD_POST )
+   {
+      httpdStartResponse( connData, 406 );
+      httpdEndHeaders( connData );
+      return HTTPD_CGI_DONE;
+   }
+
+   if( bpd == NULL )
+   {
+      bpd = ( BenchPostData * )malloc( sizeof( BenchPostData ) );
+      if( bpd == NULL )
+         return HTTPD_CGI_NOTFOUND;
+      bpd->count = 0;
+      httpdPostParserInit( &bpd->pp, connData, benchPostField, bpd );
+      connData->cgiData = bpd;
+   }
+
+   rc = httpdPostParseChunk( &bpd->pp, connData );
+   if( connData->post.received < connData->post.len )
+      return HTTPD_CGI_MORE;
+
+   int len = sprintf( buf, "{ \"settings\" : %d }", bpd->count );
+   httpdStartResponse( connData, rc < 0 ? 400 : 200 );
+   httpdHeader( connData, "Content-Type", "text/json" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, buf, len );
+
+   free( bpd );
+   connData->cgiData = NULL;
+   return HTTPD_CGI_DONE;
+}
+
+static void ICACHE_FLASH_ATTR benchWebsocketConnect( Websock *ws )
+{
+}
+
+// send the query string to all websockets on /status, the reply is the number of receivers
+static CgiStatus ICACHE_FLASH_ATTR cgiBenchBroadcast( HttpdConnData *connData )
+{
+   char msg[64];
+   char buf[32];
+   int len;
+
+   if( connData->isConnectionClosed )
+      return HTTPD_CGI_DONE;
+
+   len = snprintf( msg, sizeof( msg ), "%s", connData->getArgs ? connData->getArgs : "" );
+   if( len >= ( int )sizeof( msg ) )
+      len = sizeof( msg ) - 1;
+   int n = cgiWebsockBroadcast( &httpdInstance.httpdInstance, "/status", msg, len, WEBSOCK_FLAG_NONE );
+   int e = eventSourcePublish( &httpdInstance.httpdInstance, &benchEvents, "status", msg, len, EVENTSOURCE_FLAG_STATE );
+   if( e > 0 ) n += e;
+
+   len = sprintf( buf, "%d", n );
+   httpdStartResponse( connData, 200 );
+   httpdHeader( connData, "Content-Type", "text/plain" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, buf, len );
+   return HTTPD_CGI_DONE;
+}
+
+static HttpdSuspendId benchWaiters[HTTPD_MAX_SUSPENDED];
+
+// wait for /bench/wake, answers "woken" or "timeout"
+static CgiStatus ICACHE_FLASH_ATTR cgiBenchWait( HttpdConnData *connData )
+{
+   int i;
+
+   if( connData->isConnectionClosed )
+   {
+      if( connData->cgiData != NULL )
+         *( HttpdSuspendId * )connData->cgiData = 0;
+      return HTTPD_CGI_DONE;
+   }
+
+   if( connData->cgiData == NULL )
+   {
+      int ms = connData->getArgs ? atoi( connData->getArgs ) : 0;
+      for( i = 0; i < HTTPD_MAX_SUSPENDED && benchWaiters[i] != 0; i++ )
+         ;
+      if( i < HTTPD_MAX_SUSPENDED && ( benchWaiters[i] = httpdSuspend( connData, ms > 0 ? ms : 2000 ) ) != 0 )
+      {
+         connData->cgiData = &benchWaiters[i];
+         return HTTPD_CGI_MORE;
+      }
+      httpdStartResponse( connData, 503 );
+      httpdEndHeaders( connData );
+      return HTTPD_CGI_DONE;
+   }
+
+   *( HttpdSuspendId * )connData->cgiData = 0;
+
+   const char *msg = httpdSuspendTimedOut( connData ) ? "timeout" : "woken";
+   httpdStartResponse( connData, 200 );
+   httpdHeader( connData, "Content-Type", "text/plain" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, msg, -1 );
+   return HTTPD_CGI_DONE;
+}
+
+// end the waits of /bench/wait, the reply is the number of them
+static CgiStatus ICACHE_FLASH_ATTR cgiBenchWake( HttpdConnData *connData )
+{
+   char buf[16];
+   int i, n = 0;
+
+   if( connData->isConnectionClosed )
+      return HTTPD_CGI_DONE;
+
+   for( i = 0; i < HTTPD_MAX_SUSPENDED; i++ )
+   {
+      if( benchWaiters[i] != 0 && httpdResume( benchWaiters[i] ) )
+         n++;
+   }
+
+   int len = sprintf( buf, "%d", n );
+   httpdStartResponse( connData, 200 );
+   httpdHeader( connData, "Content-Type", "text/plain" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, buf, len );
+   return HTTPD_CGI_DONE;
+}
+
+static CgiStatus ICACHE_FLASH_ATTR cgiBenchStats( HttpdConnData *connData )
+{
+   char buf[160];
+   int len;
+
+   if( connData->isConnectionClosed )
+      return HTTPD_CGI_DONE;
+
+   // don't count the bench requests themselves
+   if( connData->cgiArg != NULL )
+   {
+      __atomic_store_n( &heapStats.allocs, 0, __ATOMIC_RELAXED );
+      __atomic_store_n( &heapStats.frees, 0, __ATOMIC_RELAXED );
+      __atomic_store_n( &heapStats.heapPeak, __atomic_load_n( &heapStats.heap, __ATOMIC_RELAXED ), __ATOMIC_RELAXED );
+   }
+
+   len = sprintf( buf, "{ \"allocs\" : %ld, \"frees\" : %ld, \"heap\" : %ld, \"heap_peak\" : %ld }",
+                  heapStats.allocs, heapStats.frees, heapStats.heap, heapStats.heapPeak );
+   httpdStartResponse( connData, 200 );
+   httpdHeader( connData, "Content-Type", "text/json" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, buf, len );
+   return HTTPD_CGI_DONE;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// the url table of user_httpd.c with the stand-ins
+static const HttpdBuiltInUrl benchUrls[] =
+{
+   {"/index.tpl.html",          cgiEspFsTemplateCached,          tplBench, NULL, ROUTE_FLAG_DEFLATE },
+   {"/Timer.tpl.html",          cgiEspFsTemplate,                tplBench, NULL, ROUTE_FLAG_DEFLATE },
+   {"/WifiConfig.tpl.html",     cgiEspFsTemplate,                tplBench, NULL, ROUTE_FLAG_DEFLATE },
+   {"/MqttConfig.tpl.html",     cgiEspFsTemplate,                tplBench, NULL, ROUTE_FLAG_DEFLATE },
+   {"/Config.cgi",              cgiBenchConfig,                  NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/History.tpl.html",        cgiEspFsTemplate,                tplBench, NULL, ROUTE_FLAG_DEFLATE },
+   {"/status",                  cgiWebsocket,                    benchWebsocketConnect, NULL, ROUTE_FLAG_PRIORITY },
+   {"/WifiSetup.tpl.html",      cgiEspFsTemplate,                tplBench, NULL, ROUTE_FLAG_DEFLATE },
+#ifdef CONFIG_ESPHTTPD_METRICS
+   {"/metrics",                 cgiMetrics,                      NULL, NULL, ROUTE_FLAG_PRIORITY | ROUTE_FLAG_DEFLATE },
+#endif
+
+   {"/events",                  cgiEventSource,                  &benchEvents, NULL, ROUTE_FLAG_PRIORITY },
+   {"/bench/broadcast",         cgiBenchBroadcast,               NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/bench/wait",              cgiBenchWait,                    NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/bench/wake",              cgiBenchWake,                    NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/bench/stats",             cgiBenchStats,                   NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/bench/reset",             cgiBenchStats,                   "reset", NULL, ROUTE_FLAG_PRIORITY },
+
+   {"*",                        cgiEspFsHook,                    NULL, NULL, 0 },
+   {NULL, NULL, NULL, NULL, 0}
+};
+
+// espfs keeps flash addresses in 32 bit, the image has to be mapped below 0x40000000
+static void *loadImage( const char *fileName )
+{
+   struct stat st;
+   void *image;
+   int fd;
+
+   fd = open( fileName, O_RDONLY );
+   if( fd < 0 || fstat( fd, &st ) < 0 )
+   {
+      perror( fileName );
+      return NULL;
+   }
+
+   image = mmap( ( void * )0x10000000, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+   close( fd );
+   if( image == MAP_FAILED || ( uintptr_t )image + st.st_size > 0x40000000 )
+   {
+      fprintf( stderr, "%s: can't map the image below 0x40000000\n", fileName );
+      return NULL;
+   }
+   return image;
+}
+
+static void usage( const char *name )
+{
+   fprintf( stderr, "Usage: %s [-p port] [-v] espfs-image\n", name );
+   exit( 1 );
+}
+
+int main( int argc, char **argv )
+{
+   static RtosConnType connections[CONFIG_ESPHTTPD_MAX_CONNECTIONS];
+   int port = 8088;
+   int opt;
+
+   while( ( opt = getopt( argc, argv, "p:v" ) ) != -1 )
+   {
+      switch( opt )
+      {
+         case 'p': port = atoi( optarg ); break;
+         case 'v': verbose = true; break;
+         default:  usage( argv[0] );
+      }
+   }
+   if( optind != argc - 1 )
+      usage( argv[0] );
+
+   void *image = loadImage( argv[optind] );
+   if( image == NULL || espFsInit( image ) != ESPFS_INIT_RESULT_OK )
+   {
+      fprintf( stderr, "%s: no valid espfs image\n", argv[optind] );
+      return 1;
+   }
+
+   signal( SIGPIPE, SIG_IGN );
+
+   if( httpdFreertosInitEx( &httpdInstance, benchUrls, port, htonl( INADDR_LOOPBACK ),
+                            connections, CONFIG_ESPHTTPD_MAX_CONNECTIONS, HTTPD_FLAG_NONE ) != InitializationSuccess )
+   {
+      fprintf( stderr, "can't start the server on port %d\n", port );
+      return 1;
+   }
+
+   fprintf( stderr, "serving %s on 127.0.0.1:%d\n", argv[optind], port );
+   pause();
+   return 0;
+}
@@ -0,0 +1,47 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          c_types.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Host replacement of the c_types.h of the ESP8266 SDK, aweDBG.h includes it for the esp_log
+macros. Only what the linux build of libesphttpd needs.
+*/
+
+#ifndef _C_TYPES_H_
+#define _C_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef uint8_t   uint8;
+typedef int8_t    sint8;
+typedef int8_t    int8;
+typedef uint16_t  uint16;
+typedef int16_t   sint16;
+typedef int16_t   int16;
+typedef uint32_t  uint32;
+typedef int32_t   sint32;
+typedef int32_t   int32;
+
+#define LOCAL     static
+
+#define ICACHE_FLASH_ATTR
+#define ICACHE_RODATA_ATTR
+#define STORE_ATTR               __attribute__( ( aligned( 4 ) ) )
+
+int os_printf( const char *format, ... );
+uint32 system_get_time( void );
+
+#endif // _C_TYPES_H_
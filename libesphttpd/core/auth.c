@@ -9,6 +9,7 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   use httpdGetHeaderById(), no need for a copy of the Authorization header
 //    2018-05-04  AWe   add debug support
 //    2018-01-19  AWe   update to chmorgan/libesphttpd
 //                         https://github.com/chmorgan/libesphttpd/commits/cmo_minify
@@ -62,7 +63,6 @@ CgiStatus ICACHE_FLASH_ATTR authBasic( HttpdConnData *connData )
 
    int no = 0;
    int r;
-   char hdr[( AUTH_MAX_USER_LEN + AUTH_MAX_PASS_LEN + 2 ) * 10];
    char userpass[AUTH_MAX_USER_LEN + AUTH_MAX_PASS_LEN + 2];
    char user[AUTH_MAX_USER_LEN];
    char pass[AUTH_MAX_PASS_LEN];
@@ -73,10 +73,10 @@ CgiStatus ICACHE_FLASH_ATTR authBasic( HttpdConnData *connData )
       return HTTPD_CGI_DONE;
    }
 
-   r = httpdGetHeader( connData, "Authorization", hdr, sizeof( hdr ) );
+   const char *hdr = httpdGetHeaderById( connData, HTTPD_HDR_AUTHORIZATION );
    ESP_LOGD( TAG, "hdr: %s", S( hdr ) );
 
-   if( r && strncmp( hdr, "Basic", 5 ) == 0 )
+   if( hdr && strncmp( hdr, "Basic", 5 ) == 0 )
    {
       r = base64_decode( strlen( hdr ) - 6, hdr + 6, sizeof( userpass ), ( unsigned char * )userpass );
       if( r < 0 ) r = 0;      // just clean out string on decode error
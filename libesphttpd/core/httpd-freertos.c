@@ -9,6 +9,22 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   epoll: httpdPlatPostResume() wakes the worker which serves the connection,
+//                        not always the first one
+//    2026-10-19  AWe   TCP_NODELAY on the connection sockets, a response written in two parts
+//                        waited for the delayed ACK of the client
+//    2026-10-19  AWe   epoll: non-blocking connection sockets, what doesn't fit in the socket
+//                        buffer waits in the backlog, a slow client no longer stalls the workers
+//    2026-10-19  AWe   httpdPlatPostResume(): resumed cgis run in the server thread, woken by an
+//                        eventfd on linux
+//    2026-10-19  AWe   initialize the pool of request head buffers
+//    2026-10-19  AWe   the linux httpd lock is recursive like the FreeRTOS one, a cgi can
+//                        broadcast to websockets without a deadlock
+//    2026-10-19  AWe   count refused connections in the request metrics
+//    2026-10-19  AWe   CONFIG_ESPHTTPD_EPOLL: edge triggered epoll backend for linux with
+//                        HTTPD_EPOLL_WORKERS threads, each serving a share of the connections
+//    2026-10-19  AWe   serve the connections round robin, starting with the next one each pass
+//    2026-10-19  AWe   implement httpdPlatSetIdleTimeout(), idle keep-alive connections are closed
 //    2018-04-19  awe   httpdConnectCb changed, can now fail with out of memory
 //    2018-02-14  AWe   change "esphttpd" task priority from 4 to 5
 //    2018-01-18  AWe   update to chmorgan/libesphttpd
@@ -53,6 +69,8 @@ static const char *TAG = "httpd-freertos";
    #include <pthread.h>
    #include <unistd.h>
    #include <arpa/inet.h>
+   #include <time.h>
+   #include <sys/eventfd.h>
 #else
    #include <libesphttpd/esp.h>
 #endif
@@ -60,6 +78,7 @@ static const char *TAG = "httpd-freertos";
 #include "libesphttpd/httpd.h"
 #include "libesphttpd/platform.h"
 #include "httpd-platform.h"
+#include "libesphttpd/httpdmetrics.h"
 #include "libesphttpd/httpd-freertos.h"
 
 #ifdef FREERTOS
@@ -72,6 +91,15 @@ static const char *TAG = "httpd-freertos";
 #define fr_of_instance( instance ) esp_container_of( instance, HttpdFreertosInstance, httpdInstance )
 #define frconn_of_conn( conn ) esp_container_of( conn, RtosConnType, connData )
 
+#ifdef CONFIG_ESPHTTPD_EPOLL
+   #include <errno.h>
+   #include <fcntl.h>
+   #include <sys/epoll.h>
+   #include <sys/eventfd.h>
+
+static void ICACHE_FLASH_ATTR platEpollKick( RtosConnType *pRconn );
+#endif
+
 // --------------------------------------------------------------------------
 // heap tracing
 // --------------------------------------------------------------------------
@@ -106,6 +134,12 @@ int ICACHE_FLASH_ATTR httpdPlatSendData( HttpdInstance *pInstance, HttpdConnData
 #endif
       bytesWritten = write( pRconn->fd, buf, len );
 
+#ifdef CONFIG_ESPHTTPD_EPOLL
+   // the socket buffer is full, the rest waits in the backlog for EPOLLOUT
+   if( bytesWritten < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+      bytesWritten = 0;
+   platEpollKick( pRconn );
+#endif
    return bytesWritten;
 }
 
@@ -118,11 +152,32 @@ void ICACHE_FLASH_ATTR httpdPlatDisconnect( HttpdConnData *connData )
    RtosConnType *pRconn = frconn_of_conn( connData );
    pRconn->needsClose = 1;
    pRconn->needWriteDoneNotif = 1; // because the real close is done in the writable select code
+#ifdef CONFIG_ESPHTTPD_EPOLL
+   platEpollKick( pRconn );
+#endif
+}
+
+// seconds since start, used for the idle timeout of the connections
+static uint32_t ICACHE_FLASH_ATTR platSeconds( void )
+{
+#ifdef linux
+   return ( uint32_t )time( NULL );
+#else
+   return xTaskGetTickCount() * portTICK_PERIOD_MS / 1000;
+#endif
 }
 
 void httpdPlatDisableTimeout( HttpdConnData *connData )
 {
-   // Unimplemented for FreeRTOS
+   RtosConnType *pRconn = frconn_of_conn( connData );
+   pRconn->idleTimeout = 0;
+}
+
+void ICACHE_FLASH_ATTR httpdPlatSetIdleTimeout( HttpdConnData *connData, int seconds )
+{
+   RtosConnType *pRconn = frconn_of_conn( connData );
+   pRconn->idleTimeout = seconds;
+   pRconn->idleSince = platSeconds();
 }
 
 // --------------------------------------------------------------------------
@@ -130,6 +185,18 @@ void httpdPlatDisableTimeout( HttpdConnData *connData )
 // --------------------------------------------------------------------------
 
 #ifdef linux
+// The lock may be taken again by the same thread, e.g. by httpdConnSendStart() called from a
+// cgi, so it is recursive like the FreeRTOS one.
+static void ICACHE_FLASH_ATTR platInitLock( HttpdFreertosInstance *pInstance )
+{
+   pthread_mutexattr_t attr;
+
+   pthread_mutexattr_init( &attr );
+   pthread_mutexattr_settype( &attr, PTHREAD_MUTEX_RECURSIVE );
+   pthread_mutex_init( &pInstance->httpdMux, &attr );
+   pthread_mutexattr_destroy( &attr );
+}
+
 // Set/clear global httpd lock.
 void ICACHE_FLASH_ATTR httpdPlatLock( HttpdInstance *pInstance )
 {
@@ -157,6 +224,22 @@ void ICACHE_FLASH_ATTR httpdPlatUnlock( HttpdInstance *pInstance )
 }
 #endif  // linux
 
+// Resumed cgis run in the server thread, not in the one of the event, see httpdResume().
+// With epoll it is the worker which serves the connection.
+void ICACHE_FLASH_ATTR httpdPlatPostResume( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+#if defined( CONFIG_ESPHTTPD_EPOLL )
+   HttpdEpollWorker *pWorker = frconn_of_conn( connData )->pWorker;
+
+   if( pWorker == NULL ) pWorker = &fr_of_instance( pInstance )->worker[0];
+   eventfd_write( pWorker->wakefd, 1 );
+#elif defined( linux )
+   eventfd_write( fr_of_instance( pInstance )->resumefd, 1 );
+#else
+   httpdRunResumed( pInstance );
+#endif
+}
+
 // --------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------
@@ -273,6 +356,57 @@ failed1:
    #define PLAT_TASK_EXIT vTaskDelete( NULL )
 #endif
 
+// let the stack detect dead clients, send the responses without the Nagle delay
+static void ICACHE_FLASH_ATTR platSetKeepAlive( int fd )
+{
+   int keepAlive = 1; // enable keepalive
+   int keepIdle = 60; // 60s
+   int keepInterval = 5; // 5s
+   int keepCount = 3; // retry times
+   int noDelay = 1;   // the head and the body of a response are separate writes
+
+   setsockopt( fd, SOL_SOCKET, SO_KEEPALIVE, ( void * )&keepAlive, sizeof( keepAlive ) );
+   setsockopt( fd, IPPROTO_TCP, TCP_KEEPIDLE, ( void* )&keepIdle, sizeof( keepIdle ) );
+   setsockopt( fd, IPPROTO_TCP, TCP_KEEPINTVL, ( void * )&keepInterval, sizeof( keepInterval ) );
+   setsockopt( fd, IPPROTO_TCP, TCP_KEEPCNT, ( void * )&keepCount, sizeof( keepCount ) );
+   setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, ( void * )&noDelay, sizeof( noDelay ) );
+}
+
+#ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
+// Socket which receives the shutdown request of httpdPlatShutdown(), -1 on error
+static int ICACHE_FLASH_ATTR platShutdownSocket( HttpdFreertosInstance *pInstance )
+{
+   static int currentUdpShutdownPort = 8000;
+
+   struct sockaddr_in udp_addr;
+   memset( &udp_addr, 0, sizeof( udp_addr ) ); /* Zero out structure */
+   udp_addr.sin_family = AF_INET;        /* Internet address family */
+   udp_addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+  #ifndef linux
+   udp_addr.sin_len = sizeof( udp_addr );
+  #endif
+
+   // FIXME: use and increment of currentUdpShutdownPort is not thread-safe
+   // and should use a mutex
+   pInstance->udpShutdownPort = currentUdpShutdownPort;
+   currentUdpShutdownPort++;
+   udp_addr.sin_port = htons( pInstance->udpShutdownPort );
+
+   int udpListenfd = socket( AF_INET, SOCK_DGRAM, 0 );
+   ESP_LOGI( TAG, "udpListenfd %d", udpListenfd );
+   if( bind( udpListenfd, ( struct sockaddr * )&udp_addr, sizeof( udp_addr ) ) != 0 )
+   {
+      ESP_LOGE( TAG, "udp bind failure" );
+      close( udpListenfd );
+      return -1;
+   }
+   ESP_LOGI( TAG, "shutdown bound to udp port %d", pInstance->udpShutdownPort );
+   return udpListenfd;
+}
+#endif  // CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
+
+#ifndef CONFIG_ESPHTTPD_EPOLL
+
 static PLAT_RETURN platHttpServerTask( void *pvParameters )
 {
    int32_t listenfd;
@@ -282,6 +416,8 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
    int x;
    int maxfdp = 0;
    fd_set readset, writeset;
+   struct timeval idleCheck;
+   bool idleConnections;
    struct sockaddr name;
    struct sockaddr_in server_addr;
    struct sockaddr_in remote_addr;
@@ -291,7 +427,7 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
    int maxConnections = pInstance->httpdInstance.maxConnections;
 
 #ifdef linux
-   pthread_mutex_init( &pInstance->httpdMux, NULL );
+   platInitLock( pInstance );
 #else
    pInstance->httpdMux = xSemaphoreCreateRecursiveMutex();
 #endif
@@ -301,32 +437,21 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
       pInstance->rConnList[x].fd = -1;
    }
 
-#ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
-   static int currentUdpShutdownPort = 8000;
-
-   struct sockaddr_in udp_addr;
-   memset( &udp_addr, 0, sizeof( udp_addr ) ); /* Zero out structure */
-   udp_addr.sin_family = AF_INET;        /* Internet address family */
-   udp_addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
-  #ifndef linux
-   udp_addr.sin_len = sizeof( udp_addr );
-  #endif
-
-   // FIXME: use and increment of currentUdpShutdownPort is not thread-safe
-   // and should use a mutex
-   pInstance->udpShutdownPort = currentUdpShutdownPort;
-   currentUdpShutdownPort++;
-   udp_addr.sin_port = htons( pInstance->udpShutdownPort );
+#ifdef linux
+   pInstance->resumefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+   if( pInstance->resumefd < 0 )
+   {
+      ESP_LOGE( TAG, "eventfd" );
+      PLAT_TASK_EXIT;
+   }
+#endif
 
-   int udpListenfd = socket( AF_INET, SOCK_DGRAM, 0 );
-   ESP_LOGI( TAG, "udpListenfd %d", udpListenfd );
-   ret = bind( udpListenfd, ( struct sockaddr * )&udp_addr, sizeof( udp_addr ) );
-   if( ret != 0 )
+#ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
+   int udpListenfd = platShutdownSocket( pInstance );
+   if( udpListenfd < 0 )
    {
-      ESP_LOGE( TAG, "udp bind failure" );
       PLAT_TASK_EXIT;
    }
-   ESP_LOGI( TAG, "shutdown bound to udp port %d", pInstance->udpShutdownPort );
 #endif  // CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
 
    /* Construct local address structure */
@@ -406,6 +531,7 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
    ESP_LOGI( TAG, "esphttpd: active and listening to connections on %s", serverStr );
    bool shutdown = false;
    bool listeningForNewConnections = false;
+   int first = 0;    // connection served first in this pass
    while( !shutdown )
    {
 #ifdef TRACE_ON
@@ -414,6 +540,7 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
 #endif
       // clear fdset, and set the select function wait time
       int socketsFull = 1;
+      idleConnections = false;
       maxfdp = 0;
       FD_ZERO( &readset );
       FD_ZERO( &writeset );
@@ -426,6 +553,7 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
             FD_SET( pRconn->fd, &readset );
             if( pRconn->needWriteDoneNotif ) FD_SET( pRconn->fd, &writeset );
             if( pRconn->fd > maxfdp ) maxfdp = pRconn->fd;
+            if( pRconn->idleTimeout ) idleConnections = true;
          }
          else
          {
@@ -458,8 +586,16 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
       if( udpListenfd > maxfdp ) maxfdp = udpListenfd;
 #endif
 
+#ifdef linux
+      FD_SET( pInstance->resumefd, &readset );
+      if( pInstance->resumefd > maxfdp ) maxfdp = pInstance->resumefd;
+#endif
+
       // polling all exist client handle, wait until readable/writable
-      ret = select( maxfdp + 1, &readset, &writeset, NULL, NULL ); // &timeout
+      // wake up once a second to close idle connections
+      idleCheck.tv_sec = 1;
+      idleCheck.tv_usec = 0;
+      ret = select( maxfdp + 1, &readset, &writeset, NULL, idleConnections ? &idleCheck : NULL );
       // ESP_LOGD( TAG, "select ret" );
       if( ret > 0 )
       {
@@ -471,6 +607,16 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
          }
 #endif
 
+#ifdef linux
+         // cgis whose wait ended
+         if( FD_ISSET( pInstance->resumefd, &readset ) )
+         {
+            eventfd_t val;
+            eventfd_read( pInstance->resumefd, &val );
+            httpdRunResumed( &pInstance->httpdInstance );
+         }
+#endif
+
          // See if we need to accept a new connection
          if( FD_ISSET( listenfd, &readset ) )
          {
@@ -486,25 +632,19 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
             if( x == maxConnections )
             {
                ESP_LOGE( TAG, "all connections in use, closing fd" );
+               HTTPD_METRICS_INC( refused );
                close( remotefd );
                continue;
             }
 
             RtosConnType *pRconn = &( pInstance->rConnList[x] );
 
-            int keepAlive = 1; // enable keepalive
-            int keepIdle = 60; // 60s
-            int keepInterval = 5; // 5s
-            int keepCount = 3; // retry times
-
-            setsockopt( remotefd, SOL_SOCKET, SO_KEEPALIVE, ( void * )&keepAlive, sizeof( keepAlive ) );
-            setsockopt( remotefd, IPPROTO_TCP, TCP_KEEPIDLE, ( void* )&keepIdle, sizeof( keepIdle ) );
-            setsockopt( remotefd, IPPROTO_TCP, TCP_KEEPINTVL, ( void * )&keepInterval, sizeof( keepInterval ) );
-            setsockopt( remotefd, IPPROTO_TCP, TCP_KEEPCNT, ( void * )&keepCount, sizeof( keepCount ) );
+            platSetKeepAlive( remotefd );
 
             pRconn->fd = remotefd;
             pRconn->needWriteDoneNotif = 0;
             pRconn->needsClose = 0;
+            pRconn->idleTimeout = 0;
 
 #ifdef CONFIG_ESPHTTPD_SSL_SUPPORT
             if( pInstance->httpdFlags & HTTPD_FLAG_SSL )
@@ -548,10 +688,11 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
             httpdConnectCb( &pInstance->httpdInstance, &pRconn->connData );
          }
 
-         // See if anything happened on the existing connections.
-         for( x = 0; x < maxConnections; x++ )
+         // See if anything happened on the existing connections. Start with another one each
+         // pass, so no connection gets always served first.
+         for( int n = 0; n < maxConnections; n++ )
          {
-            RtosConnType *pRconn = &( pInstance->rConnList[x] );
+            RtosConnType *pRconn = &( pInstance->rConnList[( first + n ) % maxConnections] );
 
             // Skip empty slots
             if( pRconn->fd == -1 ) continue;
@@ -561,6 +702,7 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
             if( pRconn->needWriteDoneNotif && FD_ISSET( pRconn->fd, &writeset ) )
             {
                pRconn->needWriteDoneNotif = 0; // Do this first, httpdSentCb may write something making this 1 again.
+               pRconn->idleSince = platSeconds();
                if( pRconn->needsClose )
                {
                   // Do callback and close fd.
@@ -577,6 +719,7 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
 
             if( FD_ISSET( pRconn->fd, &readset ) )
             {
+               pRconn->idleSince = platSeconds();
 #ifdef CONFIG_ESPHTTPD_SSL_SUPPORT
                if( pInstance->httpdFlags & HTTPD_FLAG_SSL )
                {
@@ -639,6 +782,22 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
 #endif
             }
          }
+         first = ( first + 1 ) % maxConnections;
+      }
+
+      // Close persistent connections, which are waiting too long for the next request
+      if( idleConnections )
+      {
+         uint32_t now = platSeconds();
+         for( x = 0; x < maxConnections; x++ )
+         {
+            RtosConnType *pRconn = &( pInstance->rConnList[x] );
+            if( pRconn->fd != -1 && pRconn->idleTimeout && now - pRconn->idleSince >= ( uint32_t )pRconn->idleTimeout )
+            {
+               ESP_LOGD( TAG, "closing idle connection fd %d", pRconn->fd );
+               closeConnection( pInstance, pRconn );
+            }
+         }
       }
 #ifdef TRACE_ON
       ESP_LOGI( TAG, "Stop heap tracing" );
@@ -653,6 +812,9 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
 #ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
    close( listenfd );
    close( udpListenfd );
+  #ifdef linux
+   close( pInstance->resumefd );
+  #endif
 
    // close all open connections
    for( x = 0; x < maxConnections; x++ )
@@ -679,6 +841,416 @@ static PLAT_RETURN platHttpServerTask( void *pvParameters )
 
    PLAT_TASK_EXIT;
 }
+#endif  // CONFIG_ESPHTTPD_EPOLL
+
+#ifdef CONFIG_ESPHTTPD_EPOLL
+
+// --------------------------------------------------------------------------
+// epoll backend ( linux )
+// --------------------------------------------------------------------------
+
+// The fds are registered edge triggered: reads are repeated until EAGAIN, the interest in
+// EPOLLOUT is re-armed whenever the httpd core waits for a sent callback. Connection sockets are
+// non-blocking, a short write leaves the rest in the backlog of the core and never blocks a worker
+// while it holds the httpd lock.
+
+#ifndef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
+   #error "CONFIG_ESPHTTPD_EPOLL needs CONFIG_ESPHTTPD_BACKLOG_SUPPORT"
+#endif
+
+#define EPOLL_EVENTS_PER_WAIT    32
+
+static __thread RtosConnType *platServing;   // connection handled by the current thread
+
+// The core changed the state of a connection outside of its event handling, e.g. from another
+// connection or another thread. Let the owner have a look.
+static void ICACHE_FLASH_ATTR platEpollKick( RtosConnType *pRconn )
+{
+   if( pRconn == platServing || pRconn->pWorker == NULL )
+      return;
+
+   eventfd_write( pRconn->pWorker->wakefd, 1 );
+}
+
+// Register the connection for EPOLLOUT if the core waits for a sent callback. Registering again
+// reports a writable socket at once.
+static void ICACHE_FLASH_ATTR platEpollArm( HttpdEpollWorker *pWorker, RtosConnType *pRconn )
+{
+   struct epoll_event ev;
+   int wantOut;
+
+   httpdPlatLock( &pWorker->pInstance->httpdInstance );
+   wantOut = pRconn->needWriteDoneNotif;
+   httpdPlatUnlock( &pWorker->pInstance->httpdInstance );
+
+   if( !wantOut && !pRconn->armedOut )
+      return;
+
+   ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET | ( wantOut ? EPOLLOUT : 0 );
+   ev.data.ptr = pRconn;
+   epoll_ctl( pWorker->epfd, EPOLL_CTL_MOD, pRconn->fd, &ev );
+   pRconn->armedOut = wantOut;
+}
+
+static void ICACHE_FLASH_ATTR platEpollListen( HttpdEpollWorker *pWorker, bool enable )
+{
+   struct epoll_event ev;
+
+   if( pWorker->listening == enable )
+      return;
+
+   ev.events = EPOLLIN | EPOLLET;
+   ev.data.ptr = &pWorker->listenfd;
+   epoll_ctl( pWorker->epfd, enable ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, pWorker->listenfd, &ev );
+   pWorker->listening = enable;
+}
+
+static void ICACHE_FLASH_ATTR platEpollClose( HttpdEpollWorker *pWorker, RtosConnType *pRconn )
+{
+   epoll_ctl( pWorker->epfd, EPOLL_CTL_DEL, pRconn->fd, NULL );
+   closeConnection( pWorker->pInstance, pRconn );
+   pRconn->pWorker = NULL;
+
+   // accept again, connections waiting in the backlog are reported at once
+   platEpollListen( pWorker, true );
+}
+
+// Accept the pending connections, as long as the worker has free slots.
+static void ICACHE_FLASH_ATTR platEpollAccept( HttpdEpollWorker *pWorker )
+{
+   HttpdFreertosInstance *pInstance = pWorker->pInstance;
+   struct sockaddr_in remote_addr;
+   socklen_t len;
+   int remotefd;
+   int x;
+
+   while( 1 )
+   {
+      for( x = pWorker->first; x < pWorker->last; x++ )
+      {
+         if( pInstance->rConnList[x].fd == -1 )
+            break;
+      }
+      if( x == pWorker->last )
+      {
+         ESP_LOGI( TAG, "worker %d: all connections in use", pWorker->index );
+         platEpollListen( pWorker, false );
+         return;
+      }
+
+      len = sizeof( remote_addr );
+      remotefd = accept( pWorker->listenfd, ( struct sockaddr * )&remote_addr, &len );
+      if( remotefd < 0 )
+      {
+         if( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+            perror( "accept" );
+         return;
+      }
+
+      RtosConnType *pRconn = &( pInstance->rConnList[x] );
+
+      platSetKeepAlive( remotefd );
+      fcntl( remotefd, F_SETFL, fcntl( remotefd, F_GETFL, 0 ) | O_NONBLOCK );
+
+      pRconn->fd = remotefd;
+      pRconn->needWriteDoneNotif = 0;
+      pRconn->needsClose = 0;
+      pRconn->idleTimeout = 0;
+      pRconn->pWorker = pWorker;
+      pRconn->armedOut = 0;
+      pRconn->port = remote_addr.sin_port;
+      memcpy( &pRconn->ip, &remote_addr.sin_addr.s_addr, sizeof( pRconn->ip ) );
+
+      struct epoll_event ev;
+      ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+      ev.data.ptr = pRconn;
+      epoll_ctl( pWorker->epfd, EPOLL_CTL_ADD, remotefd, &ev );
+
+      platServing = pRconn;
+      // NOTE: httpdConnectCb can fail with out of memory
+      httpdConnectCb( &pInstance->httpdInstance, &pRconn->connData );
+      platServing = NULL;
+   }
+}
+
+// Handle the events of one connection.
+static void ICACHE_FLASH_ATTR platEpollServe( HttpdEpollWorker *pWorker, RtosConnType *pRconn, uint32_t events, char *recvBuf )
+{
+   HttpdFreertosInstance *pInstance = pWorker->pInstance;
+   int sentNotif = 0;
+   int needsClose = 0;
+   int ret;
+
+   platServing = pRconn;
+
+   if( events & EPOLLOUT )
+   {
+      // Do this first, httpdSentCb may write something making this 1 again.
+      httpdPlatLock( &pInstance->httpdInstance );
+      sentNotif = pRconn->needWriteDoneNotif;
+      needsClose = pRconn->needsClose;
+      pRconn->needWriteDoneNotif = 0;
+      httpdPlatUnlock( &pInstance->httpdInstance );
+   }
+
+   if( sentNotif )
+   {
+      pRconn->idleSince = platSeconds();
+      if( needsClose || httpdSentCb( &pInstance->httpdInstance, &pRconn->connData ) != CallbackSuccess )
+      {
+         platEpollClose( pWorker, pRconn );
+      }
+   }
+
+   if( pRconn->fd != -1 && ( events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) ) )
+   {
+      pRconn->idleSince = platSeconds();
+      while( pRconn->fd != -1 )
+      {
+         ret = recv( pRconn->fd, recvBuf, RECV_BUF_SIZE, MSG_DONTWAIT );
+         if( ret > 0 )
+         {
+            // Data received. Pass to httpd.
+            if( httpdRecvCb( &pInstance->httpdInstance, &pRconn->connData, recvBuf, ret ) != CallbackSuccess )
+            {
+               platEpollClose( pWorker, pRconn );
+            }
+         }
+         else if( ret < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+         {
+            break;
+         }
+         else if( ret < 0 && errno == EINTR )
+         {
+            continue;
+         }
+         else
+         {
+            // recv error, connection close
+            platEpollClose( pWorker, pRconn );
+         }
+      }
+   }
+
+   if( pRconn->fd != -1 )
+      platEpollArm( pWorker, pRconn );
+
+   platServing = NULL;
+}
+
+// Close persistent connections, which are waiting too long for the next request. Returns true
+// if connections with a timeout remain.
+static bool ICACHE_FLASH_ATTR platEpollIdle( HttpdEpollWorker *pWorker )
+{
+   uint32_t now = platSeconds();
+   bool idleConnections = false;
+   int x;
+
+   for( x = pWorker->first; x < pWorker->last; x++ )
+   {
+      RtosConnType *pRconn = &( pWorker->pInstance->rConnList[x] );
+      if( pRconn->fd == -1 || !pRconn->idleTimeout )
+         continue;
+
+      if( now - pRconn->idleSince >= ( uint32_t )pRconn->idleTimeout )
+      {
+         ESP_LOGD( TAG, "closing idle connection fd %d", pRconn->fd );
+         platServing = pRconn;
+         platEpollClose( pWorker, pRconn );
+         platServing = NULL;
+      }
+      else
+      {
+         idleConnections = true;
+      }
+   }
+   return idleConnections;
+}
+
+static int ICACHE_FLASH_ATTR platEpollSocket( HttpdFreertosInstance *pInstance )
+{
+   struct sockaddr_in server_addr;
+   int enable = 1;
+   int fd;
+
+   fd = socket( AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+   if( fd == -1 )
+   {
+      perror( "socket" );
+      return -1;
+   }
+
+   // every worker listens on its own socket, the kernel spreads the connections
+   if( setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof( int ) ) < 0 )
+      perror( "setsockopt( SO_REUSEADDR ) failed" );
+   if( setsockopt( fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof( int ) ) < 0 )
+      perror( "setsockopt( SO_REUSEPORT ) failed" );
+
+   memset( &server_addr, 0, sizeof( server_addr ) );
+   server_addr.sin_family = AF_INET;
+   server_addr.sin_addr.s_addr = pInstance->httpListenAddress.sin_addr.s_addr;
+   server_addr.sin_port = htons( pInstance->httpPort );
+
+   if( bind( fd, ( struct sockaddr * )&server_addr, sizeof( server_addr ) ) != 0 ||
+       listen( fd, pInstance->httpdInstance.maxConnections ) != 0 )
+   {
+      perror( "bind/listen" );
+      close( fd );
+      return -1;
+   }
+   return fd;
+}
+
+static PLAT_RETURN platEpollWorkerTask( void *pvParameters )
+{
+   HttpdEpollWorker *pWorker = ( HttpdEpollWorker* )pvParameters;
+   HttpdFreertosInstance *pInstance = pWorker->pInstance;
+   struct epoll_event events[EPOLL_EVENTS_PER_WAIT];
+   struct epoll_event ev;
+   char recvBuf[RECV_BUF_SIZE];
+   bool idleConnections = false;
+   int n, i, x;
+
+#ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
+   int udpListenfd = -1;
+   if( pWorker->index == 0 )
+   {
+      udpListenfd = platShutdownSocket( pInstance );
+      if( udpListenfd >= 0 )
+      {
+         ev.events = EPOLLIN;
+         ev.data.ptr = &udpListenfd;
+         epoll_ctl( pWorker->epfd, EPOLL_CTL_ADD, udpListenfd, &ev );
+      }
+   }
+#endif
+
+   ev.events = EPOLLIN;
+   ev.data.ptr = &pWorker->wakefd;
+   epoll_ctl( pWorker->epfd, EPOLL_CTL_ADD, pWorker->wakefd, &ev );
+   pWorker->listening = false;
+   platEpollListen( pWorker, true );
+
+   ESP_LOGI( TAG, "worker %d: connections %d..%d", pWorker->index, pWorker->first, pWorker->last - 1 );
+
+   while( !pInstance->shutdown )
+   {
+      // wake up once a second to close idle connections
+      n = epoll_wait( pWorker->epfd, events, EPOLL_EVENTS_PER_WAIT, idleConnections ? 1000 : -1 );
+      if( n < 0 && errno != EINTR )
+      {
+         perror( "epoll_wait" );
+         break;
+      }
+
+      for( i = 0; i < n; i++ )
+      {
+         void *ptr = events[i].data.ptr;
+
+         if( ptr == &pWorker->listenfd )
+         {
+            platEpollAccept( pWorker );
+         }
+         else if( ptr == &pWorker->wakefd )
+         {
+            eventfd_t val;
+            eventfd_read( pWorker->wakefd, &val );
+            // cgis whose wait ended, see httpdPlatPostResume()
+            httpdRunResumed( &pInstance->httpdInstance );
+            for( x = pWorker->first; x < pWorker->last; x++ )
+            {
+               if( pInstance->rConnList[x].fd != -1 )
+                  platEpollArm( pWorker, &pInstance->rConnList[x] );
+            }
+         }
+#ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
+         else if( ptr == &udpListenfd )
+         {
+            ESP_LOGI( TAG, "shutting down" );
+            pInstance->shutdown = true;
+            for( x = 0; x < HTTPD_EPOLL_WORKERS; x++ )
+               eventfd_write( pInstance->worker[x].wakefd, 1 );
+         }
+#endif
+         else
+         {
+            RtosConnType *pRconn = ( RtosConnType * )ptr;
+            // the connection may be closed by an earlier event of this round
+            if( pRconn->fd != -1 && pRconn->pWorker == pWorker )
+               platEpollServe( pWorker, pRconn, events[i].events, recvBuf );
+         }
+      }
+
+      idleConnections = platEpollIdle( pWorker );
+   }
+
+   // close all open connections
+   for( x = pWorker->first; x < pWorker->last; x++ )
+   {
+      if( pInstance->rConnList[x].fd != -1 )
+         closeConnection( pInstance, &pInstance->rConnList[x] );
+   }
+   close( pWorker->listenfd );
+   close( pWorker->wakefd );
+   close( pWorker->epfd );
+#ifdef CONFIG_ESPHTTPD_SHUTDOWN_SUPPORT
+   if( udpListenfd >= 0 )
+      close( udpListenfd );
+#endif
+
+   if( __sync_sub_and_fetch( &pInstance->runningWorkers, 1 ) == 0 )
+   {
+      ESP_LOGI( TAG, "httpd exiting" );
+      pInstance->isShutdown = true;
+   }
+   PLAT_TASK_EXIT;
+}
+
+// Split the connections between the workers and start them.
+static HttpdInitStatus ICACHE_FLASH_ATTR platEpollStart( HttpdFreertosInstance *pInstance )
+{
+   int maxConnections = pInstance->httpdInstance.maxConnections;
+   pthread_t thread;
+   int w, x;
+
+   platInitLock( pInstance );
+   pInstance->shutdown = false;
+   pInstance->runningWorkers = 0;
+
+   for( x = 0; x < maxConnections; x++ )
+   {
+      pInstance->rConnList[x].fd = -1;
+      pInstance->rConnList[x].pWorker = NULL;
+   }
+
+   for( w = 0; w < HTTPD_EPOLL_WORKERS; w++ )
+   {
+      HttpdEpollWorker *pWorker = &pInstance->worker[w];
+
+      pWorker->pInstance = pInstance;
+      pWorker->index = w;
+      pWorker->first = w * maxConnections / HTTPD_EPOLL_WORKERS;
+      pWorker->last = ( w + 1 ) * maxConnections / HTTPD_EPOLL_WORKERS;
+      pWorker->epfd = epoll_create1( EPOLL_CLOEXEC );
+      pWorker->wakefd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+      pWorker->listenfd = platEpollSocket( pInstance );
+      if( pWorker->epfd < 0 || pWorker->wakefd < 0 || pWorker->listenfd < 0 || pWorker->first == pWorker->last )
+      {
+         ESP_LOGE( TAG, "can't start worker %d", w );
+         return OutOfMemory;
+      }
+   }
+
+   for( w = 0; w < HTTPD_EPOLL_WORKERS; w++ )
+   {
+      __sync_add_and_fetch( &pInstance->runningWorkers, 1 );
+      pthread_create( &thread, NULL, platEpollWorkerTask, &pInstance->worker[w] );
+      pthread_detach( thread );
+   }
+   return InitializationSuccess;
+}
+
+#endif  // CONFIG_ESPHTTPD_EPOLL
 
 // --------------------------------------------------------------------------
 //
@@ -855,6 +1427,9 @@ HttpdInitStatus ICACHE_FLASH_ATTR httpdFreertosInitEx( HttpdFreertosInstance *pI
 
    pInstance->httpdInstance.builtInUrls = fixedUrls;
    pInstance->httpdInstance.maxConnections = maxConnections;
+   pInstance->httpdInstance.connList = NULL;
+   pInstance->httpdInstance.activity = 0;
+   pInstance->httpdInstance.headPoolCount = 0;
 
    status = InitializationSuccess;
    pInstance->httpPort = port;
@@ -864,7 +1439,9 @@ HttpdInitStatus ICACHE_FLASH_ATTR httpdFreertosInitEx( HttpdFreertosInstance *pI
 
    pInstance->rConnList = connectionBuffer;
 
-#ifdef linux
+#if defined( CONFIG_ESPHTTPD_EPOLL )
+   status = platEpollStart( pInstance );
+#elif defined( linux )
    pthread_t thread;
    pthread_create( &thread, NULL, platHttpServerTask, pInstance );
 #else   // linux
@@ -9,6 +9,12 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   httpdPlatPostResume(): resumed cgis run in an SDK task, HTTPD_TASK_PRIO
+//    2026-10-19  AWe   httpdPlatTimerCreate() allocated only the size of a pointer
+//    2026-10-19  AWe   initialize the pool of request head buffers
+//    2026-10-19  AWe   count refused connections in the request metrics
+//    2026-10-19  AWe   initialize the connection list of the admission control
+//    2026-10-19  AWe   add httpdPlatSetIdleTimeout() for persistent connections
 //    2018-04-19  AWe   for priv buffer and sendData buffer allocate memory from
 //                        heap when needed. Give up to have buffers in the memory space.
 //    2018-04-19  awe   httpdConnectCb changed, can now fail with out of memory
@@ -56,6 +62,7 @@ static const char *TAG = "httpd-nonos";
 #include <libesphttpd/esp.h>
 #include "libesphttpd/httpd.h"
 #include "httpd-platform.h"
+#include "libesphttpd/httpdmetrics.h"
 #include "libesphttpd/httpd-nonos.h"
 
 #ifndef FREERTOS
@@ -64,6 +71,16 @@ static const char *TAG = "httpd-nonos";
    #define HTTPD_CONN_TIMEOUT 2
 #endif
 
+// Priority of the task which calls the resumed cgis, see httpdResume(). The SDK has the
+// priorities 0 .. 2, mqtt uses 2.
+#ifndef HTTPD_TASK_PRIO
+   #define HTTPD_TASK_PRIO    1
+#endif
+
+#define HTTPD_TASK_QUEUE_LEN  4
+
+static os_event_t httpdTaskQueue[HTTPD_TASK_QUEUE_LEN];
+
 static HttpdNonosInstance *pHttpdNonosInstance = NULL;
 static HttpdInstance     *pHttpdInstance = NULL;
 
@@ -93,9 +110,11 @@ int  ICACHE_FLASH_ATTR httpdPlatSendData( HttpdInstance *pInstance, HttpdConnDat
 
 void ICACHE_FLASH_ATTR httpdPlatDisconnect( HttpdConnData *connData );
 void ICACHE_FLASH_ATTR httpdPlatDisableTimeout( HttpdConnData *connData );
+void ICACHE_FLASH_ATTR httpdPlatSetIdleTimeout( HttpdConnData *connData, int seconds );
 
 void ICACHE_FLASH_ATTR httpdPlatLock( HttpdInstance *pInstance );
 void ICACHE_FLASH_ATTR httpdPlatUnlock( HttpdInstance *pInstance );
+void ICACHE_FLASH_ATTR httpdPlatPostResume( HttpdInstance *pInstance, HttpdConnData *connData );
 
 HttpdPlatTimerHandle ICACHE_FLASH_ATTR httpdPlatTimerCreate( const char *name, int periodMs, int autoreload, void ( *callback )( void *arg ), void *ctx );
 void ICACHE_FLASH_ATTR httpdPlatTimerStart( HttpdPlatTimerHandle timer );
@@ -341,6 +360,7 @@ static void ICACHE_FLASH_ATTR platConnCb( void *arg )
    if( rc > 0 )
    {
       ESP_LOGW( TAG, "Aiee, connData pool overflow!" );
+      HTTPD_METRICS_INC( refused );
       espconn_disconnect( conn );
    }
 
@@ -362,6 +382,19 @@ void ICACHE_FLASH_ATTR httpdPlatUnlock( HttpdInstance *pInstance )
 {
 }
 
+static void ICACHE_FLASH_ATTR platResumeTask( os_event_t *e )
+{
+   httpdRunResumed( ( HttpdInstance * )e->par );
+}
+
+// The event which resumes a cgi may come from an SDK callback, e.g. the end of a wifi scan.
+// The cgi runs in the task, after the callback returned.
+void ICACHE_FLASH_ATTR httpdPlatPostResume( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   // a full queue already holds a post, httpdRunResumed() runs all ended waits
+   system_os_post( HTTPD_TASK_PRIO, 0, ( os_param_t )pInstance );
+}
+
 int ICACHE_FLASH_ATTR httpdPlatSendData( HttpdInstance *pInstance, HttpdConnData *connData, char *buf, int len )
 {
    ESP_LOGD( TAG, "httpdPlatSendData ..." );
@@ -391,6 +424,15 @@ void ICACHE_FLASH_ATTR httpdPlatDisableTimeout( HttpdConnData *connData )
    espconn_regist_time( pConn->conn, 7199, 1 );
 }
 
+void ICACHE_FLASH_ATTR httpdPlatSetIdleTimeout( HttpdConnData *connData, int seconds )
+{
+   ESP_LOGD( TAG, "httpdPlatSetIdleTimeout %d s", seconds );
+
+   ConnTypePtr pConn = frconn_of_conn( connData );
+   // the SDK closes the connection when there is no traffic for this time
+   espconn_regist_time( pConn->conn, seconds, 1 );
+}
+
 // --------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------
@@ -399,7 +441,12 @@ HttpdPlatTimerHandle ICACHE_FLASH_ATTR httpdPlatTimerCreate( const char *name, i
 {
    ESP_LOGD( TAG, "httpdPlatTimerCreate ..." );
 
-   HttpdPlatTimerHandle newTimer = malloc( sizeof( HttpdPlatTimerHandle ) );
+   HttpdPlatTimerHandle newTimer = malloc( sizeof( HttpdPlatTimer ) );
+   if( newTimer == NULL )
+   {
+      ESP_LOGE( TAG, "Cannot allocate timer %s", name );
+      return NULL;
+   }
    os_timer_setfn( &newTimer->timer, callback, ctx );
 
    // store the timer settings into the structure as we want to capture them here but
@@ -455,6 +502,9 @@ HttpdInitStatus ICACHE_FLASH_ATTR httpdNonosInitEx( HttpdNonosInstance *pInstanc
 
    pInstance->httpdInstance.builtInUrls = fixedUrls;
    pInstance->httpdInstance.maxConnections = maxConnections;
+   pInstance->httpdInstance.connList = NULL;
+   pInstance->httpdInstance.activity = 0;
+   pInstance->httpdInstance.headPoolCount = 0;
    pInstance->pConnList = NULL;
    pInstance->httpPort = port;
    pInstance->httpdFlags = flags;
@@ -486,6 +536,8 @@ HttpdInitStatus ICACHE_FLASH_ATTR httpdNonosInitEx( HttpdNonosInstance *pInstanc
    espHttpdTcp.local_port = port;
    espHttpdConn.proto.tcp = &espHttpdTcp;   // struct espconl global var
 
+   system_os_task( platResumeTask, HTTPD_TASK_PRIO, httpdTaskQueue, HTTPD_TASK_QUEUE_LEN );
+
    espconn_regist_connectcb( &espHttpdConn, platConnCb );
    espconn_accept( &espHttpdConn );
    espconn_regist_time( &espHttpdConn, HTTPD_CONN_TIMEOUT, 0 ); // Configure timeout
@@ -11,10 +11,17 @@ int ICACHE_FLASH_ATTR httpdPlatSendData( HttpdInstance *pInstance, HttpdConnData
 
 void ICACHE_FLASH_ATTR httpdPlatDisconnect( HttpdConnData *ponn );
 void ICACHE_FLASH_ATTR httpdPlatDisableTimeout( HttpdConnData *connData );
+void ICACHE_FLASH_ATTR httpdPlatSetIdleTimeout( HttpdConnData *connData, int seconds );
 
 void ICACHE_FLASH_ATTR httpdPlatLock( HttpdInstance *pInstance );
 void ICACHE_FLASH_ATTR httpdPlatUnlock( HttpdInstance *pInstance );
 
+/**
+ * Have httpdRunResumed() called in the context of the server which serves the connection of the
+ * ended wait, see httpdResume()
+ */
+void ICACHE_FLASH_ATTR httpdPlatPostResume( HttpdInstance *pInstance, HttpdConnData *connData );
+
 HttpdPlatTimerHandle ICACHE_FLASH_ATTR httpdPlatTimerCreate( const char *name, int periodMs, int autoreload, void ( *callback )( void *arg ), void *ctx );
 void ICACHE_FLASH_ATTR httpdPlatTimerStart( HttpdPlatTimerHandle timer );
 void ICACHE_FLASH_ATTR httpdPlatTimerStop( HttpdPlatTimerHandle timer );
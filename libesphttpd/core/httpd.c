@@ -9,6 +9,45 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   httpdPlatPostResume() gets the connection, epoll wakes the worker which
+//                        serves it
+//    2026-10-19  AWe   httpdSend_html(), httpdSend_js(): send as much as fits and return the number
+//                        of bytes sent, the caller continues with the rest
+//    2026-10-19  AWe   httpdFlushDeflate() assembles the output in a static buffer, no malloc per
+//                        flush
+//    2026-10-19  AWe   httpdRouteMatch(): an empty route doesn't read before its start
+//    2026-10-19  AWe   backlog: keep the unwritten rest of a short write, data goes out in order
+//    2026-10-19  AWe   keep a connection only if the body of the request was read, the rest of it
+//                        is dropped before the connection is closed
+//    2026-10-19  AWe   httpdSuspend(), httpdResume(): a cgi waits for an event or a timeout, the
+//                        platform calls it again in the context of the server after the event
+//    2026-10-19  AWe   request arena: httpdArenaAlloc() takes cgi scratch memory from chunks of
+//                        the connection, which are freed together when the request is done
+//    2026-10-19  AWe   the request head is received into a buffer of the pool of the instance and
+//                        moved into a block of its size when it is complete, when a cgi takes the
+//                        connection over ( websocket ) only the url is kept
+//    2026-10-19  AWe   gzip compression of the responses of routes with ROUTE_FLAG_DEFLATE when the
+//                        client accepts it, the body is compressed in httpdFlushSendBuffer()
+//    2026-10-19  AWe   httpdSend_html(), httpdSend_js(): table driven escaping, runs of plain bytes
+//                        are copied in one piece into the send buffer, nothing is sent on overflow
+//    2026-10-19  AWe   count requests, status codes, latency and overflows for httpdmetrics.c
+//    2026-10-19  AWe   admission control: HTTPD_RESERVED_CONNECTIONS are kept for priority routes,
+//                        other requests wait for a free connection or get a 503, idle persistent
+//                        connections and static file transfers are closed to make room
+//    2026-10-19  AWe   add httpdParseArgs(), httpdGetArg(), httpdGetNextArg()
+//    2026-10-19  AWe   record the response body for the render cache, httpdCaptureStart()
+//    2026-10-19  AWe   httpdSendReserve(), httpdSendSpan() to send without extra copies
+//    2026-10-19  AWe   add status 304, Cache-Control of static files from HTTPD_CACHE_CONTROL
+//    2026-10-19  AWe   HTTP/1.1 persistent connections: responses with a known length are sent with
+//                        Content-Length, small chunked responses which are still completely in the
+//                        send buffer are converted, pipelined requests are held back until the
+//                        current response is done, idle connections are closed after
+//                        HTTPD_KEEPALIVE_TIMEOUT
+//    2026-10-19  AWe   keep the position of the well known headers in priv->knownHeaders
+//                        while parsing, httpdGetHeaderById() is a plain table access
+//    2026-10-19  AWe   replace the byte-by-byte head collection and the strstr() scan for
+//                        the empty line with a resumable single pass parser, header lines
+//                        are split while they arrive and kept as offsets in priv->headers
 //    2018-06-12  AWe   change return value of httpdSend and related function
 //                      return value < 0 something goes wrong -1 out of memory
 //                      otherwise return value gives the number of remaining free bytes in the send buffer
@@ -94,6 +133,8 @@ static const char *TAG = "httpd";
 
 #include "libesphttpd/httpd.h"
 #include "libesphttpd/httpdespfs.h"   // serveStaticFile()
+#include "libesphttpd/httpdmetrics.h"
+#include "libesphttpd/httpddeflate.h"
 #include "httpd-platform.h"
 
 // --------------------------------------------------------------------------
@@ -110,6 +151,13 @@ static const char *serverName = HTTPD_SERVERNAME;
 #define HFL_DISCONAFTERSENT ( 1<<3 )
 #define HFL_NOCONNECTIONSTR ( 1<<4 )
 #define HFL_NOCORS          ( 1<<5 )
+#define HFL_KEEPALIVE       ( 1<<6 )    // client accepts a persistent connection
+#define HFL_CONTENTLEN      ( 1<<7 )    // response is sent with Content-Length
+#define HFL_GZIPOK          ( 1<<8 )    // route may compress and the client accepts gzip
+
+// States of the request head parser
+#define HPS_REQLINE         0     // waiting for the request line
+#define HPS_HEADERS         1     // receiving header lines
 
 // Struct to keep extension->mime data in
 typedef struct
@@ -181,11 +229,15 @@ const char* ICACHE_FLASH_ATTR code2str( int code )
    switch( code )
    {
       case 200:         return "OK";
+      case 206:         return "Partial Content";
       case 301:         return "Moved Permanently";
       case 302:         return "Found";
+      case 304:         return "Not Modified";
       case 403:         return "Forbidden";
       case 400:         return "Bad Request";
       case 404:         return "Not Found";
+      case 416:         return "Range Not Satisfiable";
+      case 503:         return "Service Unavailable";
       default:
          if( code >= 500 ) return "Server Error";
          if( code >= 400 ) return "Client Error";
@@ -206,7 +258,7 @@ void httpdAddCacheHeaders( HttpdConnData *connData, const char *mime )
    if( strcmp( mime, "text/csv" ) == 0 ) return;
    if( strcmp( mime, "application/json" ) == 0 ) return;
 
-   httpdHeader( connData, "Cache-Control", "max-age=7200, public, must-revalidate" );
+   httpdHeader( connData, "Cache-Control", HTTPD_CACHE_CONTROL );
 }
 
 const char* ICACHE_FLASH_ATTR httpdGetVersion( void )
@@ -218,9 +270,82 @@ const char* ICACHE_FLASH_ATTR httpdGetVersion( void )
 //
 // --------------------------------------------------------------------------
 
+static void ICACHE_FLASH_ATTR httpdResumeParked( HttpdInstance *pInstance );
+static void ICACHE_FLASH_ATTR httpdHeadFree( HttpdInstance *pInstance, HttpdPriv *priv );
+static void ICACHE_FLASH_ATTR httpdSuspendCancel( HttpdPriv *priv );
+static void ICACHE_FLASH_ATTR httpdSuspendCheck( HttpdInstance *pInstance, HttpdConnData *connData );
+
+// A chunk of the request arena. New allocations are taken from the first chunk of the list.
+typedef struct HttpdArenaChunk
+{
+   struct HttpdArenaChunk *next;
+   int size;
+   int used;
+   uint64_t data[];
+} HttpdArenaChunk;
+
+void* ICACHE_FLASH_ATTR httpdArenaAlloc( HttpdConnData *connData, int size )
+{
+   HttpdPriv *priv = connData->priv;
+   HttpdArenaChunk *chunk = priv->arena;
+
+   size = ( size + 7 ) & ~7;
+   if( chunk != NULL && chunk->used + size <= chunk->size )
+   {
+      void *p = ( char * )chunk->data + chunk->used;
+      chunk->used += size;
+      return p;
+   }
+
+   // larger chunks are a multiple of the chunk size, the rest takes the next small allocations
+   int chunkSize = ( size + HTTPD_ARENA_CHUNK_SIZE - 1 ) / HTTPD_ARENA_CHUNK_SIZE * HTTPD_ARENA_CHUNK_SIZE;
+   HttpdArenaChunk *c = ( HttpdArenaChunk * )malloc( sizeof( HttpdArenaChunk ) + chunkSize );
+   if( c == NULL )
+   {
+      ESP_LOGE( TAG, "malloc failed %d bytes", chunkSize );
+      return NULL;
+   }
+   c->size = chunkSize;
+   c->used = size;
+
+   // go on with the chunk which has more room left
+   if( chunk != NULL && chunk->size - chunk->used > chunkSize - size )
+   {
+      c->next = chunk->next;
+      chunk->next = c;
+   }
+   else
+   {
+      c->next = chunk;
+      priv->arena = c;
+   }
+   return c->data;
+}
+
+// Release all memory of the request arena
+static void ICACHE_FLASH_ATTR httpdArenaFree( HttpdPriv *priv )
+{
+   while( priv->arena != NULL )
+   {
+      HttpdArenaChunk *c = priv->arena;
+      priv->arena = c->next;
+      free( c );
+   }
+}
+
 // Retires a connection for re-use
 static void ICACHE_FLASH_ATTR httpdRetireConn( HttpdInstance *pInstance, HttpdConnData *connData )
 {
+   HttpdConnData **pp;
+   for( pp = &pInstance->connList; *pp != NULL; pp = &( *pp )->priv->nextConn )
+   {
+      if( *pp == connData )
+      {
+         *pp = connData->priv->nextConn;
+         break;
+      }
+   }
+
 #ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
    if( connData->priv->sendBacklog != NULL )
    {
@@ -242,11 +367,33 @@ static void ICACHE_FLASH_ATTR httpdRetireConn( HttpdInstance *pInstance, HttpdCo
       connData->post.buf = NULL;
    }
 
+   if( connData->priv != NULL )
+   {
+      httpdSuspendCancel( connData->priv );
+      httpdHeadFree( pInstance, connData->priv );
+      httpdArenaFree( connData->priv );
+      free( connData->priv->capBuf );
+      connData->priv->capBuf = NULL;
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+      httpdDeflateFree( connData->priv->deflate );
+      connData->priv->deflate = NULL;
+#endif
+   }
+
+   if( connData->priv != NULL && connData->priv->pipeBuf != NULL )
+   {
+      free( connData->priv->pipeBuf );
+      connData->priv->pipeBuf = NULL;
+   }
+
    if( connData->priv != NULL )
    {
       free( connData->priv );
       connData->priv = NULL;
    }
+
+   // a connection is free now
+   httpdResumeParked( pInstance );
 }
 
 // Stupid li'l helper function that returns the value of a hex char.
@@ -342,42 +489,221 @@ int ICACHE_FLASH_ATTR httpdFindArg( const char *line, const char *arg, char *buf
    return -1; // not found
 }
 
+static uint16_t ICACHE_FLASH_ATTR httpdArgHash( const char *name )
+{
+   uint16_t h = 0;
+   while( *name ) h = h * 31 + ( uint8_t )*name++;
+   return h;
+}
+
+// Length of the get- or post-data, like httpdFindArg() it ends at the end of the line
+static int ICACHE_FLASH_ATTR httpdArgsLen( const char *line )
+{
+   const char *end = line;
+   while( *end != 0 && *end != '\r' && *end != '\n' ) end++;
+   return end - line;
+}
+
+// Split the get- or post-data at '&' and '=' and decode names and values into one buffer.
+// The decoded string is never longer than the encoded one, the terminating zeros take the
+// place of '=' and '&', so the buffer needs the length of the line plus one byte.
+static int ICACHE_FLASH_ATTR httpdSplitArgs( HttpdArgs *args, const char *line, int len, char *buf )
+{
+   const char *end = line + len;
+   char *d = buf;
+   const char *p = line;
+   while( p < end && args->count < HTTPD_MAX_ARGS )
+   {
+      const char *e = p;
+      const char *eq = NULL;
+      while( e < end && *e != '&' )
+      {
+         if( *e == '=' && eq == NULL ) eq = e;
+         e++;
+      }
+
+      if( e != p )
+      {
+         HttpdArg *arg = &args->arg[ args->count++ ];
+         const char *ne = ( eq != NULL ) ? eq : e;
+         int n;
+
+         httpdUrlDecode( p, ne - p, d, ne - p + 1, &n );
+         arg->name = d;
+         arg->hash = httpdArgHash( d );
+         d += n;
+
+         if( eq != NULL )
+         {
+            httpdUrlDecode( eq + 1, e - eq - 1, d, e - eq, &n );
+            arg->value = d;
+            arg->valueLen = n - 1;
+            d += n;
+         }
+         else
+         {
+            arg->value = "";
+            arg->valueLen = 0;
+         }
+      }
+      p = e + 1;
+   }
+
+   // chain the buckets back to front, so repeated names are found in their order
+   for( int i = args->count - 1; i >= 0; i-- )
+   {
+      uint8_t *b = &args->bucket[ args->arg[ i ].hash & ( HTTPD_ARGS_HASH_SIZE - 1 ) ];
+      args->arg[ i ].next = *b;
+      *b = i;
+   }
+   return args->count;
+}
+
+int ICACHE_FLASH_ATTR httpdParseArgs( HttpdArgs *args, const char *line )
+{
+   args->buf = NULL;
+   args->count = 0;
+   memset( args->bucket, 0xff, sizeof( args->bucket ) );
+   if( line == NULL ) return 0;
+
+   int len = httpdArgsLen( line );
+   if( len == 0 ) return 0;
+
+   args->buf = ( char * ) malloc( len + 1 );
+   if( args->buf == NULL )
+   {
+      ESP_LOGE( TAG, "Failed to malloc args buffer" );
+      return -1;
+   }
+   return httpdSplitArgs( args, line, len, args->buf );
+}
+
+int ICACHE_FLASH_ATTR httpdParseArgsArena( HttpdConnData *connData, HttpdArgs *args, const char *line )
+{
+   args->buf = NULL;
+   args->count = 0;
+   memset( args->bucket, 0xff, sizeof( args->bucket ) );
+   if( line == NULL ) return 0;
+
+   int len = httpdArgsLen( line );
+   if( len == 0 ) return 0;
+
+   char *buf = ( char * )httpdArenaAlloc( connData, len + 1 );
+   if( buf == NULL ) return -1;
+   return httpdSplitArgs( args, line, len, buf );
+}
+
+void ICACHE_FLASH_ATTR httpdFreeArgs( HttpdArgs *args )
+{
+   free( args->buf );
+   args->buf = NULL;
+   args->count = 0;
+}
+
+static const HttpdArg* ICACHE_FLASH_ATTR httpdFindArgInChain( const HttpdArgs *args, int i, const char *name, uint16_t hash )
+{
+   while( i != 0xff )
+   {
+      const HttpdArg *arg = &args->arg[ i ];
+      if( arg->hash == hash && strcmp( arg->name, name ) == 0 ) return arg;
+      i = arg->next;
+   }
+   return NULL;
+}
+
+// Look up the first argument with this name, NULL if there is none
+
+const HttpdArg* ICACHE_FLASH_ATTR httpdGetArg( const HttpdArgs *args, const char *name )
+{
+   uint16_t hash = httpdArgHash( name );
+   return httpdFindArgInChain( args, args->bucket[ hash & ( HTTPD_ARGS_HASH_SIZE - 1 ) ], name, hash );
+}
+
+// The next argument with the same name as arg, NULL if there is none
+
+const HttpdArg* ICACHE_FLASH_ATTR httpdGetNextArg( const HttpdArgs *args, const HttpdArg *arg )
+{
+   return httpdFindArgInChain( args, arg->next, arg->name, arg->hash );
+}
+
+// Names of the headers in HttpdHeaderId, same order as the enum
+
+static const char * const knownHeaderNames[HTTPD_HDR_COUNT] =
+{
+   "Host",
+   "Connection",
+   "Content-Length",
+   "Content-Type",
+   "Accept-Encoding",
+   "Authorization",
+   "Upgrade",
+   "Sec-WebSocket-Key",
+   "If-None-Match",
+   "Range",
+   "Origin",
+   "Access-Control-Request-Headers",
+   "Last-Event-ID",
+};
+
+// Map a header name to its HttpdHeaderId, HTTPD_HDR_OTHER if it isn't a known one
+static HttpdHeaderId ICACHE_FLASH_ATTR httpdHeaderId( const char *name )
+{
+   int id;
+
+   for( id = 0; id < HTTPD_HDR_COUNT; id++ )
+   {
+      if( strcasecmp( knownHeaderNames[id], name ) == 0 ) break;
+   }
+   return ( HttpdHeaderId )id;
+}
+
+// Get the value of a well known header in the HTTP client head
+// Returns a pointer into the head, NULL when not found.
+
+const char * ICACHE_FLASH_ATTR httpdGetHeaderById( HttpdConnData *connData, HttpdHeaderId id )
+{
+   HttpdPriv *priv = connData->priv;
+
+   if( id >= HTTPD_HDR_COUNT || priv->knownHeaders[id] == 0 ) return NULL;
+   return priv->head + priv->knownHeaders[id];
+}
+
 // Get the value of a certain header in the HTTP client head
 // Returns true when found, false when not found.
 
 bool ICACHE_FLASH_ATTR httpdGetHeader( HttpdConnData *connData, const char *header, char *ret, int retLen )
 {
-   bool retval = false;
+   HttpdPriv *priv = connData->priv;
+   const char *p = NULL;
 
-   char *p = connData->priv->head;
-   p = p + strlen( p ) + 1; // skip GET/POST part
-   p = p + strlen( p ) + 1; // skip HTTP part
-   while( p < ( connData->priv->head + connData->priv->headPos ) )
+   HttpdHeaderId id = httpdHeaderId( header );
+   if( id != HTTPD_HDR_OTHER )
    {
-      while( *p <= 32 && *p != 0 ) p++; // skip crap at start
-      // See if this is the header
-      if( strncasecmp( p, header, strlen( header ) ) == 0 && p[strlen( header )] == ':' )
+      p = httpdGetHeaderById( connData, id );
+   }
+   else
+   {
+      for( int i = 0; i < priv->headerCount; i++ )
       {
-         // Skip 'key:' bit of header line
-         p = p + strlen( header ) + 1;
-         // Skip past spaces after the colon
-         while( *p == ' ' ) p++;
-         // Copy from p to end
-         // retLen check preserves one byte in ret so we can null terminate
-         while( *p != 0 && *p != '\r' && *p != '\n' && retLen > 1 )
+         if( strcasecmp( priv->head + priv->headers[i].name, header ) == 0 )
          {
-            *ret++ = *p++;
-            retLen--;
+            p = priv->head + priv->headers[i].value;
+            break;
          }
-         // Zero-terminate string
-         *ret = 0;
-         // All done : )
-         retval = true;
       }
-      p += strlen( p ) + 1; // Skip past end of string and \0 terminator
    }
 
-   return retval;
+   if( p == NULL ) return false;
+
+   // retLen check preserves one byte in ret so we can null terminate
+   while( *p != 0 && retLen > 1 )
+   {
+      *ret++ = *p++;
+      retLen--;
+   }
+   // Zero-terminate string
+   *ret = 0;
+   return true;
 }
 
 void ICACHE_FLASH_ATTR httpdSetTransferMode( HttpdConnData *connData, TransferModes mode )
@@ -399,33 +725,90 @@ void ICACHE_FLASH_ATTR httpdSetTransferMode( HttpdConnData *connData, TransferMo
    }
 }
 
+// Announce the length of the response body, call before httpdStartResponse()
+void ICACHE_FLASH_ATTR httpdSetContentLength( HttpdConnData *connData, int len )
+{
+   connData->priv->contentLen = len;
+   connData->priv->flags &= ~HFL_CHUNKED;
+   connData->priv->flags |= HFL_CONTENTLEN;
+}
+
 void ICACHE_FLASH_ATTR httdResponseOptions( HttpdConnData *connData, int cors )
 {
    if( cors == 0 )
       connData->priv->flags |= HFL_NOCORS;
 }
 
+static const char* CHUNK_SIZE_TEXT = "0000\r\n";
+static const int CHUNK_SIZE_TEXT_LEN = 6; // number of characters in CHUNK_SIZE_TEXT
+
+static const char* TE_CHUNKED_TEXT = "Transfer-Encoding: chunked\r\n";
+static const int TE_CHUNKED_TEXT_LEN = 28; // number of characters in TE_CHUNKED_TEXT
+
 // Start the response headers.
 void ICACHE_FLASH_ATTR httpdStartResponse( HttpdConnData *connData, int code )
 {
-   char buf[128];
+   char buf[160];
+   char lenStr[24] = "";
    int l;
    const char *connStr = "Connection: close\r\n";
 
-   if( connData->priv->flags & HFL_CHUNKED ) connStr = "Transfer-Encoding: chunked\r\n";
+#ifdef CONFIG_ESPHTTPD_METRICS
+   connData->priv->status = code;
+#endif
+
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   if( ( connData->priv->flags & HFL_GZIPOK ) && code == 200 && !( connData->priv->flags & HFL_NOCONNECTIONSTR ) &&
+         connData->priv->deflate == NULL )
+   {
+      // without enough memory the response is sent uncompressed
+      connData->priv->deflate = httpdDeflateNew();
+      if( connData->priv->deflate != NULL && ( connData->priv->flags & HFL_CONTENTLEN ) )
+      {
+         // the compressed length is not known yet, HTTP/1.0 clients get a closed connection
+         connData->priv->flags &= ~HFL_CONTENTLEN;
+         if( connData->priv->flags & HFL_HTTP11 )
+            connData->priv->flags |= HFL_CHUNKED;
+      }
+   }
+#endif
+
+   if( connData->priv->flags & HFL_CONTENTLEN )
+   {
+      snprintf( lenStr, sizeof( lenStr ), "Content-Length: %d\r\n", connData->priv->contentLen );
+      // HTTP/1.1 connections are persistent by default, HTTP/1.0 clients have to be told
+      if( connData->priv->flags & HFL_KEEPALIVE )
+         connStr = ( connData->priv->flags & HFL_HTTP11 ) ? "" : "Connection: keep-alive\r\n";
+   }
+   else if( connData->priv->flags & HFL_CHUNKED )
+   {
+      connStr = TE_CHUNKED_TEXT;
+   }
    if( connData->priv->flags & HFL_NOCONNECTIONSTR ) connStr = "";
-   l = snprintf( buf, sizeof( buf ), "HTTP/1.%d %d %s\r\nServer: %s\r\n%s",
+   l = snprintf( buf, sizeof( buf ), "HTTP/1.%d %d %s\r\nServer: %s\r\n%s%s",
                  ( connData->priv->flags & HFL_HTTP11 ) ? 1 : 0,
                  code,
                  code2str( code ),
                  serverName,
+                 lenStr,
                  connStr );
-   if( l >= sizeof( buf ) )
+   if( l >= ( int )sizeof( buf ) )
    {
       ESP_LOGE( TAG, "buf[%zu] too small", sizeof( buf ) );
    }
+
+   // remember where the transfer encoding is, see httpdUnchunkResponse()
+   connData->priv->teHdrPos = 0;
+   if( connStr == TE_CHUNKED_TEXT && l < ( int )sizeof( buf ) )
+      connData->priv->teHdrPos = connData->priv->sendBuffLen + l - TE_CHUNKED_TEXT_LEN;
+
    httpdSend( connData, buf, l );
 
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   if( connData->priv->deflate != NULL )
+      httpdSend( connData, "Content-Encoding: gzip\r\nVary: Accept-Encoding\r\n", -1 );
+#endif
+
 #ifdef CONFIG_ESPHTTPD_CORS_SUPPORT
    // CORS headers
    if( 0 == ( connData->priv->flags & HFL_NOCORS ) )
@@ -451,6 +834,9 @@ void ICACHE_FLASH_ATTR httpdEndHeaders( HttpdConnData *connData )
 {
    httpdSend( connData, "\r\n", -1 );
    connData->priv->flags |= HFL_SENDINGBODY;
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   connData->priv->bodyPos = connData->priv->sendBuffLen;
+#endif
 }
 
 // Redirect to the given URL.
@@ -489,8 +875,61 @@ static CgiStatus ICACHE_FLASH_ATTR cgiNotFound( HttpdConnData *connData )
    return HTTPD_CGI_DONE;
 }
 
-static const char* CHUNK_SIZE_TEXT = "0000\r\n";
-static const int CHUNK_SIZE_TEXT_LEN = 6; // number of characters in CHUNK_SIZE_TEXT
+// Record the body of the response from now on, at most maxLen bytes
+bool ICACHE_FLASH_ATTR httpdCaptureStart( HttpdConnData *connData, int maxLen )
+{
+   free( connData->priv->capBuf );
+   connData->priv->capLen = 0;
+   connData->priv->capMax = maxLen;
+   connData->priv->capSize = ( maxLen < 1024 ) ? maxLen : 1024;
+   connData->priv->capBuf = malloc( connData->priv->capSize );
+   return connData->priv->capBuf != NULL;
+}
+
+char* ICACHE_FLASH_ATTR httpdCaptureEnd( HttpdConnData *connData, int *len )
+{
+   char *buf = connData->priv->capBuf;
+   *len = connData->priv->capLen;
+   connData->priv->capBuf = NULL;
+   return buf;
+}
+
+// Append body data to the capture buffer, drop the capture when it gets too long
+static void ICACHE_FLASH_ATTR httpdCapture( HttpdConnData *connData, const char *data, int len )
+{
+   HttpdPriv *priv = connData->priv;
+
+   if( priv->capBuf == NULL || !( priv->flags & HFL_SENDINGBODY ) ) return;
+
+   if( priv->capLen + len > priv->capSize )
+   {
+      char *n = NULL;
+      // grow in steps of 1 kByte
+      int size = ( priv->capLen + len + 1023 ) & ~1023;
+      if( size > priv->capMax ) size = priv->capMax;
+      if( priv->capLen + len <= size ) n = realloc( priv->capBuf, size );
+      if( n == NULL )
+      {
+         free( priv->capBuf );
+         priv->capBuf = NULL;
+         return;
+      }
+      priv->capBuf = n;
+      priv->capSize = size;
+   }
+   memcpy( priv->capBuf + priv->capLen, data, len );
+   priv->capLen += len;
+}
+
+// Establish start of chunk
+// Use a chunk length placeholder of 4 characters
+static void ICACHE_FLASH_ATTR httpdStartChunk( HttpdConnData *connData )
+{
+   connData->priv->chunkHdr = &connData->priv->sendBuff[connData->priv->sendBuffLen];
+   memcpy( connData->priv->chunkHdr, CHUNK_SIZE_TEXT, CHUNK_SIZE_TEXT_LEN );
+   connData->priv->sendBuffLen += CHUNK_SIZE_TEXT_LEN;
+   ASSERT( "sendBuffLen > HTTPD_MAX_SENDBUFF_LEN", connData->priv->sendBuffLen <= HTTPD_MAX_SENDBUFF_LEN );
+}
 
 // Add data to the send buffer. len is the length of the data. If len is -1
 // the data is seen as a C-string. If len  is 0 return the number of remaining bytes
@@ -511,23 +950,20 @@ int ICACHE_FLASH_ATTR httpdSend( HttpdConnData *connData, const char *data, int
          if( connData->priv->sendBuffLen + len + CHUNK_SIZE_TEXT_LEN > HTTPD_MAX_SENDBUFF_LEN )
          {
             ESP_LOGE( TAG, "httpdSend ( chrunked ): sendbuffer will overflow, discard data" );
+            HTTPD_METRICS_INC( sendOverflows );
             return -1;
          }
-
-         // Establish start of chunk
-         // Use a chunk length placeholder of 4 characters
-         connData->priv->chunkHdr = &connData->priv->sendBuff[connData->priv->sendBuffLen];
-         strcpy( connData->priv->chunkHdr, CHUNK_SIZE_TEXT );
-         connData->priv->sendBuffLen += CHUNK_SIZE_TEXT_LEN;
-         ASSERT( "sendBuffLen > HTTPD_MAX_SENDBUFF_LEN", connData->priv->sendBuffLen <= HTTPD_MAX_SENDBUFF_LEN );
+         httpdStartChunk( connData );
       }
       if( connData->priv->sendBuffLen + len > HTTPD_MAX_SENDBUFF_LEN )
       {
          ESP_LOGE( TAG, "httpdSend: sendbuffer will overflow, discard data" );
+         HTTPD_METRICS_INC( sendOverflows );
          return -1;
       }
       memcpy( connData->priv->sendBuff + connData->priv->sendBuffLen, data, len );
       connData->priv->sendBuffLen += len;
+      httpdCapture( connData, data, len );
    }
 
    if( connData->priv->flags & HFL_CHUNKED && connData->priv->flags & HFL_SENDINGBODY && connData->priv->chunkHdr == NULL )
@@ -542,6 +978,51 @@ int ICACHE_FLASH_ATTR httpdSend( HttpdConnData *connData, const char *data, int
    }
 }
 
+char* ICACHE_FLASH_ATTR httpdSendReserve( HttpdConnData *connData, int *len )
+{
+   int hdr = 0;
+   int reserved = 0;
+
+   if( connData->priv->flags & HFL_CHUNKED && connData->priv->flags & HFL_SENDINGBODY )
+   {
+      // the chunk header is only written by httpdSendCommit(), an empty chunk would end the body
+      if( connData->priv->chunkHdr == NULL ) hdr = CHUNK_SIZE_TEXT_LEN;
+      // keep room for the end of the chunk and the terminating chunk of httpdFlushSendBuffer()
+      reserved = 2 + 5;
+   }
+
+   *len = HTTPD_MAX_SENDBUFF_LEN - connData->priv->sendBuffLen - hdr - reserved;
+   if( *len < 0 ) *len = 0;
+   return connData->priv->sendBuff + connData->priv->sendBuffLen + hdr;
+}
+
+void ICACHE_FLASH_ATTR httpdSendCommit( HttpdConnData *connData, int len )
+{
+   if( len <= 0 ) return;
+   if( connData->priv->flags & HFL_CHUNKED && connData->priv->flags & HFL_SENDINGBODY && connData->priv->chunkHdr == NULL )
+   {
+      httpdStartChunk( connData );
+   }
+   httpdCapture( connData, connData->priv->sendBuff + connData->priv->sendBuffLen, len );
+   connData->priv->sendBuffLen += len;
+   ASSERT( "sendBuffLen > HTTPD_MAX_SENDBUFF_LEN", connData->priv->sendBuffLen <= HTTPD_MAX_SENDBUFF_LEN );
+}
+
+bool ICACHE_FLASH_ATTR httpdSendSpan( HttpdConnData *connData, const char *data, int len )
+{
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   // the span is compressed into a buffer with its own chunk header
+   if( connData->priv->deflate == NULL )
+#endif
+   if( connData->priv->flags & HFL_CHUNKED && connData->priv->flags & HFL_SENDINGBODY ) return false;
+   if( connData->priv->sendSpanLen != 0 || len > HTTPD_MAX_SENDBUFF_LEN ) return false;
+
+   connData->priv->sendSpan = data;
+   connData->priv->sendSpanLen = len;
+   httpdCapture( connData, data, len );
+   return true;
+}
+
 static char ICACHE_FLASH_ATTR httpdHexNibble( int val )
 {
    val &= 0xf;
@@ -553,130 +1034,312 @@ static char ICACHE_FLASH_ATTR httpdHexNibble( int val )
 //
 // --------------------------------------------------------------------------
 
-// encode for HTML
-// return value < 0 something goes wrong: -1 sendbuffer will overflow, discard data
-// otherwise return value gives the number of remaining free bytes in the send buffer
+// Escaping of template tokens and JSON strings. A class table gives for every byte the escape
+// sequence for HTML in the low and for JS in the high nibble, 0 for bytes copied as they are.
+// Runs of such bytes are copied in one piece directly into the send buffer.
 
-int ICACHE_FLASH_ATTR httpdSend_html( HttpdConnData *connData, const char *data, int len )
+#define ESC_HTML( n )      ( n )
+#define ESC_JS( n )        ( ( n ) << 4 )
+#define ESC_JS_CTRL        9           // other control characters as \u00XX
+#define ESC_END            15          // the terminating zero of a string
+
+static const char * const htmlEscapes[] =
+{
+   NULL, "&#34;", "&#39;", "&lt;", "&gt;", "&amp;"
+};
+
+static const char * const jsEscapes[] =
+{
+   NULL, "\\\"", "\\u0027", "\\\\", "\\u003C", "\\u003E", "\\n", "\\r", "\\t"
+};
+
+// int instead of char, the table is in flash and read with aligned 32-bit accesses
+static const int escClass[256] ICACHE_RODATA_ATTR STORE_ATTR =
+{
+   [ 0 ]                = ESC_HTML( ESC_END ) | ESC_JS( ESC_END ),
+   [ 1 ... 0x08 ]       = ESC_JS( ESC_JS_CTRL ),
+   [ '\t' ]             = ESC_JS( 8 ),
+   [ '\n' ]             = ESC_JS( 6 ),
+   [ 0x0b ... 0x0c ]    = ESC_JS( ESC_JS_CTRL ),
+   [ '\r' ]             = ESC_JS( 7 ),
+   [ 0x0e ... 0x1f ]    = ESC_JS( ESC_JS_CTRL ),
+   [ '"' ]              = ESC_HTML( 1 ) | ESC_JS( 1 ),
+   [ '\'' ]             = ESC_HTML( 2 ) | ESC_JS( 2 ),
+   [ '\\' ]             = ESC_JS( 3 ),
+   [ '<' ]              = ESC_HTML( 3 ) | ESC_JS( 4 ),
+   [ '>' ]              = ESC_HTML( 4 ) | ESC_JS( 5 ),
+   [ '&' ]              = ESC_HTML( 5 ),
+   [ 0x7f ]             = ESC_JS( ESC_JS_CTRL ),
+};
+
+// shift selects the nibble of escClass: 0 for HTML, 4 for JS. As much as fits in the send buffer
+// is sent, an escape sequence is never split. Returns the number of bytes of data which were
+// sent, less than len if the rest has to be sent after the next flush.
+
+static int ICACHE_FLASH_ATTR httpdSendEscaped( HttpdConnData *connData, const char *data, int len, int shift )
 {
-   int start = 0, end = 0;
-   char c;
-   int rc = 0;
+   const char * const *escapes = shift ? jsEscapes : htmlEscapes;
+   char seq[7];
+   const char *esc;
+   int avail, out = 0, i = 0;
+   char *buf;
+
    if( len < 0 )
-      len = ( int ) strlen( data );
+      len = ( int )strlen( data );
 
-   if( len > 0 )
+   buf = httpdSendReserve( connData, &avail );
+
+   while( i < len )
    {
-      for( end = 0; end < len; end++ )
+      // run of bytes which need no escaping
+      int run = i;
+      int cls = 0;
+      while( i < len && ( cls = ( escClass[( uint8_t )data[i]] >> shift ) & 0xf ) == 0 )
+         i++;
+
+      if( out + i - run > avail )
       {
-         c = data[end];
-         if( c == 0 )
-         {
-            // we found EOS
-            break;
-         }
+         // the send buffer is full
+         i = run + avail - out;
+         memcpy( buf + out, data + run, i - run );
+         out = avail;
+         break;
+      }
+      memcpy( buf + out, data + run, i - run );
+      out += i - run;
+      if( i == len )
+         break;
+      if( cls == ESC_END )
+      {
+         i = len;
+         break;
+      }
 
-         if( c == '"' || c == '\'' || c == '<' || c == '>' )
-         {
-            if( start < end )
-               rc = httpdSend( connData, data + start, end - start );
-            start = end + 1;
-
-            if( rc <= 0 ) ;
-            else if( c == '"' )  rc = httpdSend( connData, "&#34;", 5 );
-            else if( c == '\'' ) rc = httpdSend( connData, "&#39;", 5 );
-            else if( c == '<' )  rc = httpdSend( connData, "&lt;", 4 );
-            else if( c == '>' )  rc = httpdSend( connData, "&gt;", 4 );
-
-            if( rc <= 0 )
-               break; // no more space in send buffer
-         }
+      if( cls == ESC_JS_CTRL )
+      {
+         memcpy( seq, "\\u00", 4 );
+         seq[4] = httpdHexNibble( data[i] >> 4 );
+         seq[5] = httpdHexNibble( data[i] );
+         seq[6] = 0;
+         esc = seq;
+      }
+      else
+      {
+         esc = escapes[cls];
       }
-   }
 
-   if( ( rc > 0 && start <= end ) || len == 0 )
-   {
-      // if len or end - start is zero get only the remaining bytes in the send buffer
-      rc = httpdSend( connData, data + start, end - start );
+      // escape sequences are never split
+      int n = strlen( esc );
+      if( out + n > avail )
+         break;
+      memcpy( buf + out, esc, n );
+      out += n;
+      i++;
    }
-   return rc;
-}
 
-// --------------------------------------------------------------------------
-//
-// --------------------------------------------------------------------------
+   httpdSendCommit( connData, out );
+   if( i < len )
+      ESP_LOGD( TAG, "httpdSend_%s: sendbuffer full, %d of %d bytes sent", shift ? "js" : "html", i, len );
+   return i;
+}
 
-// encode for HTML.
-// return value < 0 something goes wrong: -1 sendbuffer will overflow, discard data
-// otherwise return value gives the number of remaining free bytes in the send buffer
+// encode for HTML
+// returns the number of bytes of data sent, the rest didn't fit in the send buffer
 
-int ICACHE_FLASH_ATTR httpdSend_js( HttpdConnData *connData, const char *data, int len )
+int ICACHE_FLASH_ATTR httpdSend_html( HttpdConnData *connData, const char *data, int len )
 {
-   int start = 0, end = 0;
-   char c;
-   int rc = 0;
-   if( len < 0 )
-      len = ( int ) strlen( data );
-
-   if( len > 0 )
-   {
-      for( end = 0; end < len; end++ )
-      {
-         c = data[end];
-         if( c == 0 )
-         {
-            // we found EOS
-            break;
-         }
+   return httpdSendEscaped( connData, data, len, 0 );
+}
 
-         if( c == '"' || c == '\\' || c == '\'' || c == '<' || c == '>' || c == '\n' || c == '\r' )
-         {
-            if( start < end )
-               rc = httpdSend( connData, data + start, end - start );
-            start = end + 1;
-
-            if( rc <= 0 ) ;
-            else if( c == '"' )  rc = httpdSend( connData, "\\\"", 2 );
-            else if( c == '\'' ) rc = httpdSend( connData, "\\'", 2 );
-            else if( c == '\\' ) rc = httpdSend( connData, "\\\\", 2 );
-            else if( c == '<' )  rc = httpdSend( connData, "\\u003C", 6 );
-            else if( c == '>' )  rc = httpdSend( connData, "\\u003E", 6 );
-            else if( c == '\n' ) rc = httpdSend( connData, "\\n", 2 );
-            else if( c == '\r' ) rc = httpdSend( connData, "\\r", 2 );
-
-            if( rc <= 0 )
-               break; // no more space in send buffer
-         }
-      }
-   }
+// encode for JS, the data can be put into a string literal or a JSON string
+// returns the number of bytes of data sent, the rest didn't fit in the send buffer
 
-   if( ( rc > 0 && start <= end ) || len == 0 )
-   {
-      // if len or end - start is zero get only the remaining bytes in the send buffer
-      rc = httpdSend( connData, data + start, end - start );
-   }
-   return rc;
+int ICACHE_FLASH_ATTR httpdSend_js( HttpdConnData *connData, const char *data, int len )
+{
+   return httpdSendEscaped( connData, data, len, 4 );
 }
 
 // --------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------
 
-// Function to send any data in connData->priv->sendBuff. Do not use in CGIs unless you know what you
-// are doing! Also, if you do set connData->cgi to NULL to indicate the connection is closed, do it BEFORE
-// calling this.
-
-bool ICACHE_FLASH_ATTR httpdFlushSendBuffer( HttpdInstance *pInstance, HttpdConnData *connData )
+// Hand data to the platform, whatever can't be sent now goes to the backlog
+static bool ICACHE_FLASH_ATTR httpdSendOrQueue( HttpdInstance *pInstance, HttpdConnData *connData, const char *buf, int len )
 {
-   int r, len;
-   // if( connData->isConnectionClosed ) return false;
-   if( connData->priv->chunkHdr != NULL )
-   {
-      // We're sending chunked data, and the chunk needs fixing up.
-      // Finish chunk with cr/lf
-      httpdSend( connData, "\r\n", 2 );
-      // Calculate length of chunk
-      // +2 is to remove the two characters written above via httpdSend(), those
+   int r;
+#ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
+   // Data waiting in the backlog goes out first
+   if( connData->priv->sendBacklog != NULL )
+      r = 0;
+   else
+#endif
+      r = httpdPlatSendData( pInstance, connData, ( char * )buf, len );
+#ifdef CONFIG_ESPHTTPD_METRICS
+   connData->priv->txBytes += len;
+#endif
+   if( r != len )
+   {
+#ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
+      // Can't send this for some reason, e.g. the socket buffer is full. Dump the rest in the
+      // backlog, we can send it later.
+      if( r > 0 )
+      {
+         buf += r;
+         len -= r;
+      }
+      if( connData->priv->sendBacklogSize + len > HTTPD_MAX_BACKLOG_SIZE )
+      {
+         ESP_LOGE( TAG, "Backlog: Exceeded max backlog size, dropped %d bytes", len );
+         HTTPD_METRICS_INC( backlogOverflows );
+         return false;
+      }
+      HttpSendBacklogItem *i = malloc( sizeof( HttpSendBacklogItem ) + len );
+      if( i == NULL )
+      {
+         ESP_LOGE( TAG, "Backlog: malloc failed" );
+         HTTPD_METRICS_INC( backlogOverflows );
+         return false;
+      }
+      memcpy( i->data, buf, len );
+      i->len = len;
+      i->next = NULL;
+      if( connData->priv->sendBacklog == NULL )
+      {
+         connData->priv->sendBacklog = i;
+      }
+      else
+      {
+         HttpSendBacklogItem *e = connData->priv->sendBacklog;
+         while( e->next != NULL ) e = e->next;
+         e->next = i;
+      }
+      connData->priv->sendBacklogSize += len;
+#else
+      ESP_LOGE( TAG, "send buf tried to write %d bytes, wrote %d", len, r );
+      HEAP_INFO( "" );
+      HTTPD_METRICS_INC( backlogOverflows );
+#endif
+   }
+   return true;
+}
+
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+// Output of httpdFlushDeflate(), the flushes run under the httpd lock and the platform copies
+// the data or keeps it in the backlog
+static char deflateOut[HTTPD_DEFLATE_OUT_LEN];
+
+// Send the body in sendBuff and the span compressed. The output is assembled in deflateOut,
+// with the headers and the chunk header in front. When the whole response is there, it is
+// sent with Content-Length instead of the transfer encoding.
+static bool ICACHE_FLASH_ATTR httpdFlushDeflate( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   HttpdPriv *priv = connData->priv;
+   bool last = ( connData->cgi == NULL );
+   bool chunked = ( priv->flags & HFL_CHUNKED ) != 0;
+   int hdrLen = priv->bodyPos;
+   char *body = ( priv->chunkHdr != NULL ) ? priv->chunkHdr + CHUNK_SIZE_TEXT_LEN : priv->sendBuff + hdrLen;
+   int bodyLen = priv->sendBuff + priv->sendBuffLen - body;
+   bool r = true;
+
+   // headers, chunk header, data, end of the chunk and the last chunk
+   int bufLen = hdrLen + CHUNK_SIZE_TEXT_LEN + HTTPD_DEFLATE_BOUND( bodyLen ) +
+                HTTPD_DEFLATE_BOUND( priv->sendSpanLen ) + HTTPD_DEFLATE_BOUND( 0 ) + 2 + 5;
+   if( bufLen > ( int )sizeof( deflateOut ) )
+   {
+      ESP_LOGE( TAG, "deflate output of %d bytes too large", bufLen );
+      r = false;
+   }
+   else
+   {
+      char *data = deflateOut + hdrLen + CHUNK_SIZE_TEXT_LEN;
+      char *start = data;
+      int len = httpdDeflate( priv->deflate, body, bodyLen, data );
+      if( priv->sendSpanLen != 0 )
+         len += httpdDeflate( priv->deflate, priv->sendSpan, priv->sendSpanLen, data + len );
+      if( last )
+         len += httpdDeflateFinish( priv->deflate, data + len );
+
+      if( last && chunked && priv->teHdrPos != 0 )
+      {
+         // the length line is shorter than the transfer encoding line
+         char lenStr[24];
+         int l = snprintf( lenStr, sizeof( lenStr ), "Content-Length: %d\r\n", len );
+         int hdrRest = hdrLen - priv->teHdrPos - TE_CHUNKED_TEXT_LEN;
+         start -= hdrRest;
+         memcpy( start, priv->sendBuff + priv->teHdrPos + TE_CHUNKED_TEXT_LEN, hdrRest );
+         start -= l;
+         memcpy( start, lenStr, l );
+         start -= priv->teHdrPos;
+         memcpy( start, priv->sendBuff, priv->teHdrPos );
+         priv->flags &= ~HFL_CHUNKED;
+         priv->flags |= HFL_CONTENTLEN;
+      }
+      else
+      {
+         if( chunked && len > 0 )
+         {
+            char chunkStr[CHUNK_SIZE_TEXT_LEN + 1];
+            int l = snprintf( chunkStr, sizeof( chunkStr ), "%x\r\n", len );
+            start -= l;
+            memcpy( start, chunkStr, l );
+            memcpy( data + len, "\r\n", 2 );
+            len += 2;
+         }
+         if( chunked && last )
+         {
+            memcpy( data + len, "0\r\n\r\n", 5 );
+            len += 5;
+         }
+         start -= hdrLen;
+         memcpy( start, priv->sendBuff, hdrLen );
+      }
+
+      if( data + len != start )
+         r = httpdSendOrQueue( pInstance, connData, start, data + len - start );
+   }
+
+   priv->sendBuffLen = 0;
+   priv->chunkHdr = NULL;
+   priv->teHdrPos = 0;
+   priv->bodyPos = 0;
+   priv->sendSpanLen = 0;
+   if( last )
+   {
+      httpdDeflateFree( priv->deflate );
+      priv->deflate = NULL;
+   }
+   return r;
+}
+#endif
+
+// Function to send any data in connData->priv->sendBuff. Do not use in CGIs unless you know what you
+// are doing! Also, if you do set connData->cgi to NULL to indicate the connection is closed, do it BEFORE
+// calling this.
+
+bool ICACHE_FLASH_ATTR httpdFlushSendBuffer( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   int r, len;
+   // if( connData->isConnectionClosed ) return false;
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   if( connData->priv->deflate != NULL && ( connData->priv->flags & HFL_SENDINGBODY ) )
+      return httpdFlushDeflate( pInstance, connData );
+#endif
+
+   if( connData->priv->chunkHdr != NULL )
+   {
+      // We're sending chunked data, and the chunk needs fixing up.
+      // Finish chunk with cr/lf, not with httpdSend(), it's not part of the body
+      if( connData->priv->sendBuffLen + 2 <= HTTPD_MAX_SENDBUFF_LEN )
+      {
+         memcpy( &connData->priv->sendBuff[connData->priv->sendBuffLen], "\r\n", 2 );
+         connData->priv->sendBuffLen += 2;
+      }
+      else
+      {
+         ESP_LOGE( TAG, "sendBuff full" );
+      }
+      // Calculate length of chunk
+      // +2 is to remove the two characters written above, those
       // bytes aren't counted in the chunk length
       len = ( ( &connData->priv->sendBuff[connData->priv->sendBuffLen] ) - connData->priv->chunkHdr ) - ( CHUNK_SIZE_TEXT_LEN + 2 );
       // Fix up chunk header to correct value
@@ -705,71 +1368,210 @@ bool ICACHE_FLASH_ATTR httpdFlushSendBuffer( HttpdInstance *pInstance, HttpdConn
 
    if( connData->priv->sendBuffLen != 0 )
    {
-      r = httpdPlatSendData( pInstance, connData, connData->priv->sendBuff, connData->priv->sendBuffLen );
-      if( r != connData->priv->sendBuffLen )
-      {
-#ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
-         // Can't send this for some reason. Dump packet in backlog, we can send it later.
-         if( connData->priv->sendBacklogSize + connData->priv->sendBuffLen > HTTPD_MAX_BACKLOG_SIZE )
-         {
-            ESP_LOGE( TAG, "Backlog: Exceeded max backlog size, dropped %d bytes", connData->priv->sendBuffLen );
-            connData->priv->sendBuffLen = 0;
-            return false;
-         }
-         HttpSendBacklogItem *i = malloc( sizeof( HttpSendBacklogItem ) + connData->priv->sendBuffLen );
-         if( i == NULL )
-         {
-            ESP_LOGE( TAG, "Backlog: malloc failed" );
-            return false;
-         }
-         memcpy( i->data, connData->priv->sendBuff, connData->priv->sendBuffLen );
-         i->len = connData->priv->sendBuffLen;
-         i->next = NULL;
-         if( connData->priv->sendBacklog == NULL )
-         {
-            connData->priv->sendBacklog = i;
-         }
-         else
-         {
-            HttpSendBacklogItem *e = connData->priv->sendBacklog;
-            while( e->next != NULL ) e = e->next;
-            e->next = i;
-         }
-         connData->priv->sendBacklogSize += connData->priv->sendBuffLen;
-#else
-         ESP_LOGE( TAG, "send buf tried to write %d bytes, wrote %d", connData->priv->sendBuffLen, r );
-         HEAP_INFO( "" );
-#endif
-      }
+      r = httpdSendOrQueue( pInstance, connData, connData->priv->sendBuff, connData->priv->sendBuffLen );
       connData->priv->sendBuffLen = 0;
+      connData->priv->teHdrPos = 0;   // headers are gone
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+      connData->priv->bodyPos = 0;
+#endif
+      if( !r ) return false;
+   }
+   if( connData->priv->sendSpanLen != 0 )
+   {
+      r = httpdSendOrQueue( pInstance, connData, connData->priv->sendSpan, connData->priv->sendSpanLen );
+      connData->priv->sendSpanLen = 0;
+      if( !r ) return false;
    }
    return true;
 }
 
+// Take a buffer of HTTPD_MAX_HEAD_LEN bytes for a request head, from the pool if there is one
+static char* ICACHE_FLASH_ATTR httpdHeadAlloc( HttpdInstance *pInstance )
+{
+   if( pInstance->headPoolCount > 0 )
+      return pInstance->headPool[--pInstance->headPoolCount];
+   return ( char * )malloc( HTTPD_MAX_HEAD_LEN );
+}
+
+// Free the request head of the connection, buffers of the full size go back into the pool
+static void ICACHE_FLASH_ATTR httpdHeadFree( HttpdInstance *pInstance, HttpdPriv *priv )
+{
+   if( priv->head == NULL ) return;
+
+   if( priv->headSize == HTTPD_MAX_HEAD_LEN && pInstance->headPoolCount < HTTPD_HEAD_POOL_SIZE )
+      pInstance->headPool[pInstance->headPoolCount++] = priv->head;
+   else
+      free( priv->head );
+   priv->head = NULL;
+   priv->headSize = 0;
+}
+
+// Move a pointer into the head from the old to the new place of the head
+static char* ICACHE_FLASH_ATTR httpdHeadMove( char *p, const char *from, char *to )
+{
+   return ( p != NULL ) ? to + ( p - from ) : NULL;
+}
+
+// The head is complete: move it out of the pool buffer into a block of its actual size. The
+// header offsets stay valid, the pointers into the head are moved along. If there is no memory
+// for the copy, the request keeps the pool buffer.
+static void ICACHE_FLASH_ATTR httpdCompactHead( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   HttpdPriv *priv = connData->priv;
+   char *old = priv->head;
+
+   if( old == NULL || priv->headPos >= priv->headSize ) return;
+
+   char *head = ( char * )malloc( priv->headPos );
+   if( head == NULL ) return;
+   memcpy( head, old, priv->headPos );
+
+   connData->url = httpdHeadMove( connData->url, old, head );
+   connData->getArgs = httpdHeadMove( connData->getArgs, old, head );
+   connData->hostName = httpdHeadMove( connData->hostName, old, head );
+   connData->post.multipartBoundary = httpdHeadMove( connData->post.multipartBoundary, old, head );
+
+   httpdHeadFree( pInstance, priv );
+   priv->head = head;
+   priv->headSize = priv->headPos;
+}
+
+// A cgi which installed a receive handler took the connection over, there are no further
+// requests on it. The headers are released, only the url is kept, cgiWebsocketBroadcast()
+// looks for the connections by their url.
+static void ICACHE_FLASH_ATTR httpdReleaseHead( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   HttpdPriv *priv = connData->priv;
+   char *url = NULL;
+   int len = 0;
+
+   if( priv->head == NULL ) return;
+
+   if( connData->url != NULL )
+   {
+      len = strlen( connData->url ) + 1;
+      url = ( char * )malloc( len );
+      if( url == NULL ) return;  // keep the head
+      memcpy( url, connData->url, len );
+   }
+
+   httpdHeadFree( pInstance, priv );
+   priv->head = url;
+   priv->headSize = len;
+   priv->headPos = len;
+   priv->headerCount = 0;
+   memset( priv->knownHeaders, 0, sizeof( priv->knownHeaders ) );
+
+   connData->url = url;
+   connData->getArgs = NULL;
+   connData->hostName = NULL;
+   connData->post.multipartBoundary = NULL;
+}
+
+// Prepare the head parser for the next request on this connection
+static void ICACHE_FLASH_ATTR httpdResetHead( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   HttpdPriv *priv = connData->priv;
+
+   httpdHeadFree( pInstance, priv );
+   connData->url = NULL;
+   connData->getArgs = NULL;
+   connData->hostName = NULL;
+   connData->post.multipartBoundary = NULL;
+
+   priv->headPos = 0;
+   priv->lineStart = 0;
+   priv->postLen = 0;
+   priv->parseState = HPS_REQLINE;
+   priv->lineDropped = 0;
+   priv->headerCount = 0;
+   memset( priv->knownHeaders, 0, sizeof( priv->knownHeaders ) );
+}
+
+// If a chunked response is still completely in the send buffer, send it with Content-Length
+// instead. This saves the chunk framing for the many small cgi responses.
+static void ICACHE_FLASH_ATTR httpdUnchunkResponse( HttpdConnData *connData )
+{
+   HttpdPriv *priv = connData->priv;
+
+   if( priv->teHdrPos == 0 || !( priv->flags & HFL_SENDINGBODY ) ) return;
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   // done by httpdFlushDeflate() with the compressed length
+   if( priv->deflate != NULL ) return;
+#endif
+
+   char *te = priv->sendBuff + priv->teHdrPos;
+   char *hdrEnd = ( priv->chunkHdr != NULL ) ? priv->chunkHdr : priv->sendBuff + priv->sendBuffLen;
+   char *body = ( priv->chunkHdr != NULL ) ? priv->chunkHdr + CHUNK_SIZE_TEXT_LEN : hdrEnd;
+   int bodyLen = priv->sendBuff + priv->sendBuffLen - body;
+   int hdrRest = hdrEnd - ( te + TE_CHUNKED_TEXT_LEN ); // header lines behind the transfer encoding
+   char lenStr[24];
+
+   // the length line is always shorter than the transfer encoding line, because the body fits
+   // into the send buffer, so everything moves towards the start of the buffer
+   int l = snprintf( lenStr, sizeof( lenStr ), "Content-Length: %d\r\n", bodyLen );
+   memcpy( te, lenStr, l );
+   memmove( te + l, te + TE_CHUNKED_TEXT_LEN, hdrRest );
+   memmove( te + l + hdrRest, body, bodyLen );
+   priv->sendBuffLen = ( te + l + hdrRest + bodyLen ) - priv->sendBuff;
+
+   priv->chunkHdr = NULL;
+   priv->teHdrPos = 0;
+   priv->flags &= ~HFL_CHUNKED;
+   priv->flags |= HFL_CONTENTLEN;
+}
+
 void ICACHE_FLASH_ATTR httpdCgiIsDone( HttpdInstance *pInstance, HttpdConnData *connData )
 {
    connData->cgi = NULL; // no need to call this anymore
 
-   if( connData->priv->flags & HFL_CHUNKED )
+   // a wait the cgi gave up
+   httpdSuspendCancel( connData->priv );
+
+#ifdef CONFIG_ESPHTTPD_METRICS
+   httpdMetricsDone( pInstance, connData );
+#endif
+
+   // a capture the cgi didn't pick up
+   free( connData->priv->capBuf );
+   connData->priv->capBuf = NULL;
+
+   // the scratch memory of the cgi
+   httpdArenaFree( connData->priv );
+
+   if( connData->priv->flags & HFL_CHUNKED ) httpdUnchunkResponse( connData );
+
+   // The rest of a body the cgi didn't read would be taken as the next request
+   if( ( connData->priv->flags & HFL_KEEPALIVE ) && ( connData->priv->flags & ( HFL_CHUNKED | HFL_CONTENTLEN ) ) &&
+         ( connData->post.len <= 0 || connData->post.received >= connData->post.len ) )
    {
       ESP_LOGD( TAG, "Cleaning up for next request" );
       httpdFlushSendBuffer( pInstance, connData );
       // Note: Do not clean up sendBacklog, it may still contain data at this point.
-      connData->priv->headPos = 0;
+      httpdResetHead( pInstance, connData );
       connData->post.len = -1;
       connData->priv->flags = 0;
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+      // a response which ended without a body
+      httpdDeflateFree( connData->priv->deflate );
+      connData->priv->deflate = NULL;
+#endif
       if( connData->post.buf )
          free( connData->post.buf );
       connData->post.buf = NULL;
       connData->post.buffLen = 0;
       connData->post.received = 0;
-      connData->hostName = NULL;
+      // close the connection if the client doesn't send the next request in time
+      httpdPlatSetIdleTimeout( connData, HTTPD_KEEPALIVE_TIMEOUT );
    }
    else
    {
       // Cannot re-use this connection. Mark to get it killed after all data is sent.
       connData->priv->flags |= HFL_DISCONAFTERSENT;
    }
+
+   // a waiting request may take over
+   httpdResumeParked( pInstance );
 }
 
 // Callback called when the data on a socket has been successfully
@@ -780,6 +1582,8 @@ CallbackStatus ICACHE_FLASH_ATTR httpdSentCb( HttpdInstance *pInstance, HttpdCon
    return httpdContinue( pInstance, connData );
 }
 
+static CallbackStatus ICACHE_FLASH_ATTR httpdPipelineResume( HttpdInstance *pInstance, HttpdConnData *connData );
+
 // Can be called after a CGI function has returned HTTPD_CGI_MORE to
 // resume handling an open connection asynchronously
 
@@ -792,16 +1596,26 @@ CallbackStatus ICACHE_FLASH_ATTR httpdContinue( HttpdInstance *pInstance, HttpdC
 #ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
    if( connData->priv->sendBacklog != NULL )
    {
-      // We have some backlog to send first.
-      HttpSendBacklogItem *next = connData->priv->sendBacklog->next;
-      int bytesWritten = httpdPlatSendData( pInstance, connData, connData->priv->sendBacklog->data, connData->priv->sendBacklog->len );
-      if( bytesWritten != connData->priv->sendBacklog->len )
+      // We have some backlog to send first. What isn't written now stays in the backlog for
+      // the next sent callback.
+      HttpSendBacklogItem *i = connData->priv->sendBacklog;
+      int bytesWritten = httpdPlatSendData( pInstance, connData, i->data, i->len );
+      if( bytesWritten >= i->len )
+      {
+         connData->priv->sendBacklogSize -= i->len;
+         connData->priv->sendBacklog = i->next;
+         free( i );
+      }
+      else if( bytesWritten > 0 )
       {
-         ESP_LOGE( TAG, "tried to write %d bytes, wrote %d", connData->priv->sendBacklog->len, bytesWritten );
+         memmove( i->data, i->data + bytesWritten, i->len - bytesWritten );
+         i->len -= bytesWritten;
+         connData->priv->sendBacklogSize -= bytesWritten;
+      }
+      else if( bytesWritten < 0 )
+      {
+         ESP_LOGE( TAG, "tried to write %d bytes, wrote %d", i->len, bytesWritten );
       }
-      connData->priv->sendBacklogSize -= connData->priv->sendBacklog->len;
-      free( connData->priv->sendBacklog );
-      connData->priv->sendBacklog = next;
       httpdPlatUnlock( pInstance );
       return CallbackSuccess;
    }
@@ -816,8 +1630,10 @@ CallbackStatus ICACHE_FLASH_ATTR httpdContinue( HttpdInstance *pInstance, HttpdC
    }
    else
    {
-      // If we don't have a CGI function, there's nothing to do but wait for something from the client.
-      if( connData->cgi == NULL )
+      // If we don't have a CGI function and no pipelined request is waiting, there's nothing to do
+      // but wait for something from the client. A waiting cgi is called after its event.
+      if( ( connData->cgi == NULL && connData->priv->pipeBuf == NULL ) || connData->priv->parked ||
+            connData->priv->suspendId != 0 )
       {
          status = CallbackSuccess;
       }
@@ -834,34 +1650,448 @@ CallbackStatus ICACHE_FLASH_ATTR httpdContinue( HttpdInstance *pInstance, HttpdC
          {
             connData->priv->sendBuff = sendBuff;
             connData->priv->sendBuffLen = 0;
+            connData->priv->lastActive = ++pInstance->activity;
 
-            ESP_LOGD( TAG, "httpdContinue: Execute cgi fn." );
-            r = connData->cgi( connData ); // Execute cgi fn.
-
-            if( r == HTTPD_CGI_DONE )
+            if( connData->cgi == NULL )
             {
-               // No special action for HTTPD_CGI_DONE
+               // Response to the previous request is sent, process the pipelined ones
+               status = httpdPipelineResume( pInstance, connData );
             }
-            else if( r == HTTPD_CGI_NOTFOUND || r == HTTPD_CGI_AUTHENTICATED )
+            else
             {
-               ESP_LOGW( TAG, "ERROR! CGI fn returns code %d after sending data! Bad CGI!", r );
-            }
+               ESP_LOGD( TAG, "httpdContinue: Execute cgi fn." );
+               r = connData->cgi( connData ); // Execute cgi fn.
 
-            if( ( r == HTTPD_CGI_DONE ) || ( r == HTTPD_CGI_NOTFOUND ) ||
-                  ( r == HTTPD_CGI_AUTHENTICATED ) )
-            {
-               httpdCgiIsDone( pInstance, connData );
+               if( r == HTTPD_CGI_DONE )
+               {
+                  // No special action for HTTPD_CGI_DONE
+               }
+               else if( r == HTTPD_CGI_NOTFOUND || r == HTTPD_CGI_AUTHENTICATED )
+               {
+                  ESP_LOGW( TAG, "ERROR! CGI fn returns code %d after sending data! Bad CGI!", r );
+               }
+
+               if( ( r == HTTPD_CGI_DONE ) || ( r == HTTPD_CGI_NOTFOUND ) ||
+                     ( r == HTTPD_CGI_AUTHENTICATED ) )
+               {
+                  httpdCgiIsDone( pInstance, connData );
+               }
             }
 
             httpdFlushSendBuffer( pInstance, connData );
             free( sendBuff );
             connData->priv->sendBuff = NULL;
+            httpdSuspendCheck( pInstance, connData );
+         }
+      }
+   }
+
+   httpdPlatUnlock( pInstance );
+   return status;
+}
+
+// --------------------------------------------------------------------------
+// cgis waiting for an event
+// --------------------------------------------------------------------------
+
+/*
+The waits of all instances are kept in one table, the id of a wait is its index + 1 in the low
+byte and a sequence number above, so a late httpdResume() for a closed connection doesn't hit
+the next wait in the slot. httpdResume() only marks the wait as ended and asks the platform to
+call httpdRunResumed() from its own context: the event may come from an SDK callback, another
+thread or from the waiting cgi itself. A timer counts down the timeouts while waits have one.
+*/
+
+typedef struct
+{
+   HttpdConnData *connData;   // NULL if the slot is free
+   HttpdInstance *instance;   // kept when the slot is freed, httpdResume() locks it
+   uint32_t id;
+   int ticks;                 // of HTTPD_SUSPEND_TICK_MS until the timeout, 0 for none
+   uint8_t ended;             // resumed or timed out, the cgi is called next
+   uint8_t timedOut;
+} HttpdSuspended;
+
+static HttpdSuspended suspended[HTTPD_MAX_SUSPENDED];
+static uint32_t suspendSeq;
+static HttpdPlatTimerHandle suspendTimer;
+static bool suspendTimerRunning;
+
+static HttpdSuspended* ICACHE_FLASH_ATTR httpdSuspendSlot( HttpdSuspendId id )
+{
+   int i = ( id & 0xff ) - 1;
+   return ( i >= 0 && i < HTTPD_MAX_SUSPENDED ) ? &suspended[i] : NULL;
+}
+
+// Count down the timeouts, stop when no wait has one
+static void ICACHE_FLASH_ATTR httpdSuspendTick( void *arg )
+{
+   bool counting = false;
+   int i;
+
+   for( i = 0; i < HTTPD_MAX_SUSPENDED; i++ )
+   {
+      HttpdSuspended *s = &suspended[i];
+      HttpdInstance *pInstance = s->instance;
+      HttpdConnData *connData = NULL;
+
+      if( pInstance == NULL ) continue;
+
+      httpdPlatLock( pInstance );
+      if( s->connData != NULL && !s->ended && s->ticks > 0 )
+      {
+         if( --s->ticks == 0 )
+         {
+            ESP_LOGD( TAG, "wait %08x timed out", s->id );
+            s->timedOut = true;
+            s->ended = true;
+            connData = s->connData;
+         }
+         else
+         {
+            counting = true;
+         }
+      }
+      httpdPlatUnlock( pInstance );
+
+      if( connData != NULL ) httpdPlatPostResume( pInstance, connData );
+   }
+
+   if( !counting )
+   {
+      suspendTimerRunning = false;
+      httpdPlatTimerStop( suspendTimer );
+
+      // a wait with a timeout may have started meanwhile in another thread
+      for( i = 0; i < HTTPD_MAX_SUSPENDED; i++ )
+      {
+         if( suspended[i].connData != NULL && !suspended[i].ended && suspended[i].ticks > 0 )
+         {
+            suspendTimerRunning = true;
+            httpdPlatTimerStart( suspendTimer );
+            break;
          }
       }
    }
+}
+
+HttpdSuspendId ICACHE_FLASH_ATTR httpdSuspend( HttpdConnData *connData, int timeoutMs )
+{
+   HttpdPriv *priv = connData->priv;
+   HttpdSuspended *s;
+   int i;
+
+   if( priv->suspendId != 0 )
+      return priv->suspendId;
+
+   for( i = 0; i < HTTPD_MAX_SUSPENDED && suspended[i].connData != NULL; i++ )
+      ;
+   if( i == HTTPD_MAX_SUSPENDED )
+   {
+      ESP_LOGW( TAG, "too many waiting cgis" );
+      return 0;
+   }
+
+   s = &suspended[i];
+   s->connData = connData;
+   s->instance = priv->instance;
+   s->id = ( ++suspendSeq << 8 ) | ( i + 1 );
+   s->ticks = ( timeoutMs + HTTPD_SUSPEND_TICK_MS - 1 ) / HTTPD_SUSPEND_TICK_MS;
+   s->ended = false;
+   s->timedOut = false;
+
+   priv->suspendId = s->id;
+   priv->timedOut = false;
+
+   // the wait takes longer than the platform lets a connection idle
+   httpdPlatDisableTimeout( connData );
+
+   if( s->ticks > 0 && !suspendTimerRunning )
+   {
+      if( suspendTimer == NULL )
+         suspendTimer = httpdPlatTimerCreate( "suspend", HTTPD_SUSPEND_TICK_MS, true, httpdSuspendTick, NULL );
+      if( suspendTimer != NULL )
+      {
+         httpdPlatTimerStart( suspendTimer );
+         suspendTimerRunning = true;
+      }
+   }
+
+   ESP_LOGD( TAG, "%s waits, id %08x", S( connData->url ), s->id );
+   return s->id;
+}
+
+bool ICACHE_FLASH_ATTR httpdResume( HttpdSuspendId id )
+{
+   HttpdSuspended *s = httpdSuspendSlot( id );
+   HttpdInstance *pInstance;
+   HttpdConnData *connData = NULL;
+
+   if( s == NULL || ( pInstance = s->instance ) == NULL )
+      return false;
+
+   httpdPlatLock( pInstance );
+   if( s->connData != NULL && s->id == id && !s->ended )
+   {
+      s->ended = true;
+      connData = s->connData;
+   }
+   httpdPlatUnlock( pInstance );
+
+   if( connData != NULL ) httpdPlatPostResume( pInstance, connData );
+   return connData != NULL;
+}
+
+bool ICACHE_FLASH_ATTR httpdSuspendTimedOut( HttpdConnData *connData )
+{
+   return connData->priv->timedOut;
+}
+
+// Free the slot of the wait of the connection
+static void ICACHE_FLASH_ATTR httpdSuspendCancel( HttpdPriv *priv )
+{
+   if( priv->suspendId == 0 ) return;
+
+   httpdSuspendSlot( priv->suspendId )->connData = NULL;
+   priv->suspendId = 0;
+}
+
+// The wait ended while the cgi still ran, it is called when it's done
+static void ICACHE_FLASH_ATTR httpdSuspendCheck( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   if( connData->priv->suspendId != 0 && httpdSuspendSlot( connData->priv->suspendId )->ended )
+      httpdPlatPostResume( pInstance, connData );
+}
+
+// Call the cgis whose wait ended
+void ICACHE_FLASH_ATTR httpdRunResumed( HttpdInstance *pInstance )
+{
+   int i;
+
+   httpdPlatLock( pInstance );
+   for( i = 0; i < HTTPD_MAX_SUSPENDED; i++ )
+   {
+      HttpdSuspended *s = &suspended[i];
+      HttpdConnData *connData = s->connData;
+
+      // a cgi which is running now is called after it returns, see httpdSuspendCheck()
+      if( connData == NULL || s->instance != pInstance || !s->ended || connData->priv->sendBuff != NULL )
+         continue;
+
+      s->connData = NULL;
+      connData->priv->suspendId = 0;
+      connData->priv->timedOut = s->timedOut;
+      if( httpdContinue( pInstance, connData ) != CallbackSuccess )
+      {
+         ESP_LOGE( TAG, "can't resume %s", S( connData->url ) );
+         httpdPlatDisconnect( connData );
+      }
+   }
+   httpdPlatUnlock( pInstance );
+}
+
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+// Does the Accept-Encoding header list gzip, without "gzip;q=0"?
+static bool ICACHE_FLASH_ATTR httpdAcceptsGzip( HttpdConnData *connData )
+{
+   const char *enc = httpdGetHeaderById( connData, HTTPD_HDR_ACCEPT_ENCODING );
+   const char *p;
+
+   if( enc == NULL || ( p = strstr( enc, "gzip" ) ) == NULL ) return false;
+   p += 4;
+   while( *p == ' ' ) p++;
+   if( *p != ';' ) return true;
+   p++;
+   while( *p == ' ' ) p++;
+   if( p[0] != 'q' || p[1] != '=' || p[2] != '0' ) return true;
+   for( p += 3; *p == '.' || *p == '0'; p++ )
+      ;
+   return *p >= '1' && *p <= '9';
+}
+#endif
+
+// Does the route entry match the url? A route ending in '*' matches all urls starting with the
+// part before the '*'.
+static bool ICACHE_FLASH_ATTR httpdRouteMatch( const char *route, const char *url )
+{
+   int len = strlen( route );
+
+   if( strcmp( route, url ) == 0 )
+      return true;
+
+   return len > 0 && route[len - 1] == '*' && strncmp( route, url, len - 1 ) == 0;
+}
+
+// --------------------------------------------------------------------------
+// admission control
+// --------------------------------------------------------------------------
+
+// Reply to requests with a body, which can't wait for a free connection. The body is read and
+// dropped, so a persistent connection stays usable.
+static CgiStatus ICACHE_FLASH_ATTR cgiServiceUnavailable( HttpdConnData *connData )
+{
+   if( connData->isConnectionClosed ) return HTTPD_CGI_DONE;
+
+   if( !( connData->priv->flags & HFL_SENDINGBODY ) )
+   {
+      httpdSetContentLength( connData, 0 );
+      httpdStartResponse( connData, 503 );
+      httpdHeader( connData, "Retry-After", "1" );
+      httpdEndHeaders( connData );
+   }
+
+   return ( connData->post.received < connData->post.len ) ? HTTPD_CGI_MORE : HTTPD_CGI_DONE;
+}
+
+#if HTTPD_RESERVED_CONNECTIONS > 0
+
+// Websocket upgrades and requests for routes with ROUTE_FLAG_PRIORITY may use the reserved
+// connections.
+static bool ICACHE_FLASH_ATTR httpdIsPriorityRequest( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   const HttpdBuiltInUrl *pUrl;
+
+   if( httpdGetHeaderById( connData, HTTPD_HDR_UPGRADE ) != NULL )
+      return true;
+
+   for( pUrl = pInstance->builtInUrls; pUrl->url != NULL; pUrl++ )
+   {
+      if( ( pUrl->flags & ROUTE_FLAG_PRIORITY ) && httpdRouteMatch( pUrl->url, connData->url ) )
+         return true;
+   }
+   return false;
+}
+
+// Count the connections busy with a request which isn't a priority one.
+static int ICACHE_FLASH_ATTR httpdBusyConnections( HttpdInstance *pInstance, HttpdConnData *except )
+{
+   HttpdConnData *conn;
+   int busy = 0;
+
+   for( conn = pInstance->connList; conn != NULL; conn = conn->priv->nextConn )
+   {
+      if( conn != except && conn->cgi != NULL && !conn->priv->priority && !conn->priv->evicted )
+         busy++;
+   }
+   return busy;
+}
+
+// May the request on connData run now?
+static bool ICACHE_FLASH_ATTR httpdAdmitRequest( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   int limit = pInstance->maxConnections - HTTPD_RESERVED_CONNECTIONS;
+   if( limit < 1 ) limit = 1;
+
+   connData->priv->priority = httpdIsPriorityRequest( pInstance, connData );
+   if( connData->priv->priority )
+      return true;
+
+   return httpdBusyConnections( pInstance, connData ) < limit;
+}
+
+// Close the least recently used connection which waits for the next request or, if there is
+// none and all connections are in use, the oldest static file transfer.
+static void ICACHE_FLASH_ATTR httpdEvictConn( HttpdInstance *pInstance, bool poolFull )
+{
+   HttpdConnData *conn;
+   HttpdConnData *idle = NULL;
+   HttpdConnData *transfer = NULL;
+
+   for( conn = pInstance->connList; conn != NULL; conn = conn->priv->nextConn )
+   {
+      HttpdPriv *priv = conn->priv;
+      if( priv->evicted )
+         continue;
+
+      if( priv->requests > 0 && conn->cgi == NULL && !priv->parked && conn->post.len < 0
+          && priv->headPos == 0 && priv->pipeBuf == NULL
+#ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
+          && priv->sendBacklog == NULL
+#endif
+        )
+      {
+         if( idle == NULL || priv->lastActive - idle->priv->lastActive > 0x80000000 )
+            idle = conn;
+      }
+      else if( conn->cgi == cgiEspFsHook )
+      {
+         if( transfer == NULL || priv->lastActive - transfer->priv->lastActive > 0x80000000 )
+            transfer = conn;
+      }
+   }
+
+   conn = idle;
+   if( conn == NULL && poolFull )
+      conn = transfer;
+
+   if( conn != NULL )
+   {
+      ESP_LOGD( TAG, "evict %s connection", ( conn == idle ) ? "idle" : "static file" );
+      conn->priv->evicted = true;
+      HTTPD_METRICS_INC( evicted );
+      httpdPlatDisconnect( conn );
+   }
+}
+
+// A new connection took a slot, make sure the reserved ones stay available.
+static void ICACHE_FLASH_ATTR httpdAdmitConn( HttpdInstance *pInstance )
+{
+   HttpdConnData *conn;
+   int open = 0;
+   int avail;
+
+   for( conn = pInstance->connList; conn != NULL; conn = conn->priv->nextConn )
+   {
+      if( !conn->priv->evicted )
+         open++;
+   }
+
+   avail = pInstance->maxConnections - open;
+   if( avail < HTTPD_RESERVED_CONNECTIONS )
+      httpdEvictConn( pInstance, avail <= 0 );
+}
+
+#endif // HTTPD_RESERVED_CONNECTIONS
+
+static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, HttpdConnData *connData );
+
+// Go on with the oldest request which waits for a free connection. The caller holds the lock.
+static void ICACHE_FLASH_ATTR httpdResumeParked( HttpdInstance *pInstance )
+{
+#if HTTPD_RESERVED_CONNECTIONS > 0
+   HttpdConnData *conn;
+   HttpdConnData *parked = NULL;
+   char *sendBuff;
+
+   for( conn = pInstance->connList; conn != NULL; conn = conn->priv->nextConn )
+   {
+      if( conn->priv->parked && !conn->priv->evicted &&
+          ( parked == NULL || conn->priv->lastActive - parked->priv->lastActive > 0x80000000 ) )
+         parked = conn;
+   }
+
+   if( parked == NULL || !httpdAdmitRequest( pInstance, parked ) )
+      return;
+
+   // the connection gets no callback of its own now, provide the send buffer
+   sendBuff = malloc( HTTPD_MAX_SENDBUFF_LEN );
+   if( sendBuff == NULL )
+   {
+      ESP_LOGE( TAG, "Malloc of sendBuff failed!" );
+      return;  // try again with the next finished request
+   }
 
-   httpdPlatUnlock( pInstance );
-   return status;
+   ESP_LOGD( TAG, "resume %s", parked->url );
+   parked->priv->parked = false;
+   parked->priv->sendBuff = sendBuff;
+   parked->priv->sendBuffLen = 0;
+   // the timeout was disabled while waiting
+   httpdPlatSetIdleTimeout( parked, HTTPD_KEEPALIVE_TIMEOUT );
+   httpdProcessRequest( pInstance, parked );
+   httpdFlushSendBuffer( pInstance, parked );
+   free( sendBuff );
+   parked->priv->sendBuff = NULL;
+#endif
 }
 
 // This is called when the headers have been received and the connection is ready to send
@@ -893,6 +2123,32 @@ static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, Htt
    }
 #endif
 
+#if HTTPD_RESERVED_CONNECTIONS > 0
+   if( !httpdAdmitRequest( pInstance, connData ) )
+   {
+      if( connData->post.len > 0 )
+      {
+         // the body is arriving, don't hold it back
+         ESP_LOGW( TAG, "%s rejected, all connections busy", connData->url );
+         HTTPD_METRICS_INC( rejected );
+         connData->cgiData = NULL;
+         connData->cgi = cgiServiceUnavailable;
+         if( connData->cgi( connData ) == HTTPD_CGI_DONE )
+            httpdCgiIsDone( pInstance, connData );
+      }
+      else
+      {
+         // wait until another request is done, see httpdResumeParked()
+         ESP_LOGD( TAG, "%s waits for a free connection", connData->url );
+         HTTPD_METRICS_INC( parked );
+         connData->priv->parked = true;
+         connData->priv->lastActive = ++pInstance->activity;
+         httpdPlatDisableTimeout( connData );
+      }
+      return;
+   }
+#endif
+
    // See if we can find a CGI that's happy to handle the request.
    while( 1 )
    {
@@ -900,29 +2156,19 @@ static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, Htt
       while( pInstance->builtInUrls[i].url != NULL )
       {
          const HttpdBuiltInUrl *pUrl = &( pInstance->builtInUrls[i] );
-         bool match = false;
-         const char* route = pUrl->url;
-
-         // See if there's a literal match
-         if( strcmp( route, connData->url ) == 0 )
-         {
-            match = true;
-         }
-         else if( route[strlen( route ) - 1] == '*' &&
-                  strncmp( route, connData->url, strlen( route ) - 1 ) == 0 )
-         {
-            // See if there's a wildcard match, if the route entry ends in '*'
-            // and everything up to the '*' is a match
-            match = true;
-         }
 
-         if( match )
+         if( httpdRouteMatch( pUrl->url, connData->url ) )
          {
             ESP_LOGD( TAG, "Is url index %d", i );
             connData->cgiData = NULL;
             connData->cgi = pUrl->cgiCb;
             connData->cgiArg = pUrl->cgiArg;
             connData->cgiArg2 = pUrl->cgiArg2;
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+            connData->priv->flags &= ~HFL_GZIPOK;
+            if( ( pUrl->flags & ROUTE_FLAG_DEFLATE ) && httpdAcceptsGzip( connData ) )
+               connData->priv->flags |= HFL_GZIPOK;
+#endif
             break;
          }
          i++;
@@ -934,6 +2180,7 @@ static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, Htt
          // generate a built-in 404 to handle this.
          ESP_LOGW( TAG, "%s not found. 404", connData->url );
          connData->cgi = cgiNotFound;
+         connData->priv->flags &= ~HFL_GZIPOK;
       }
 
       // Okay, we have a CGI function that matches the URL. See if it wants to handle the
@@ -941,6 +2188,11 @@ static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, Htt
       ESP_LOGD( TAG, "httpdProcessRequest: Execute cgi fn." );
       r = connData->cgi( connData ); // Execute cgi fn.
 
+#ifdef CONFIG_ESPHTTPD_METRICS
+      if( r == HTTPD_CGI_MORE || r == HTTPD_CGI_DONE )
+         connData->priv->route = i;
+#endif
+
       if( r == HTTPD_CGI_MORE )
       {
          // Yep, it's happy to do so and has more data to send.
@@ -949,6 +2201,7 @@ static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, Htt
             // Seems the CGI is planning to do some long-term communications with the socket.
             // Disable the timeout on it, so we won't run into that.
             httpdPlatDisableTimeout( connData );
+            httpdReleaseHead( pInstance, connData );
          }
          httpdFlushSendBuffer( pInstance, connData );
          break;
@@ -968,152 +2221,280 @@ static void ICACHE_FLASH_ATTR httpdProcessRequest( HttpdInstance *pInstance, Htt
    }
 }
 
-// Parse a line of header data and modify the connection data accordingly.
-static CallbackStatus ICACHE_FLASH_ATTR httpdParseHeader( char *h, HttpdConnData *connData )
+// Parse the request line ( "GET /url?args HTTP/1.1" ) and modify the connection data accordingly.
+static CallbackStatus ICACHE_FLASH_ATTR httpdParseRequestLine( char *h, HttpdConnData *connData )
 {
    int i;
-   char firstLine = 0;
-   CallbackStatus status = CallbackSuccess;
+
+   connData->priv->requests++;
+#ifdef CONFIG_ESPHTTPD_METRICS
+   connData->priv->reqStart = httpdMetricsNow();
+   connData->priv->txBytes = 0;
+   connData->priv->status = 0;
+   connData->priv->route = 0xffff;
+#endif
 
    if( strncmp( h, "GET ", 4 ) == 0 )
    {
       connData->requestType = HTTPD_METHOD_GET;
-      firstLine = 1;
-   }
-   else if( strncasecmp( h, "Host:", 5 ) == 0 )
-   {
-      i = 5;
-      while( h[i] == ' ' ) i++;
-      connData->hostName = &h[i];
    }
    else if( strncmp( h, "POST ", 5 ) == 0 )
    {
       connData->requestType = HTTPD_METHOD_POST;
-      firstLine = 1;
    }
    else if( strncmp( h, "PUT ", 4 ) == 0 )
    {
       connData->requestType = HTTPD_METHOD_PUT;
-      firstLine = 1;
    }
    else if( strncmp( h, "PATCH ", 6 ) == 0 )
    {
       connData->requestType = HTTPD_METHOD_PATCH;
-      firstLine = 1;
    }
    else if( strncmp( h, "OPTIONS ", 8 ) == 0 )
    {
       connData->requestType = HTTPD_METHOD_OPTIONS;
-      firstLine = 1;
    }
    else if( strncmp( h, "DELETE ", 7 ) == 0 )
    {
       connData->requestType = HTTPD_METHOD_DELETE;
-      firstLine = 1;
+   }
+   else
+   {
+      ESP_LOGE( TAG, "unknown request: %s", h );
+      return CallbackError;
    }
 
-   if( firstLine )
+   char *e;
+
+   // Skip past the space after POST/GET
+   i = 0;
+   while( h[i] != ' ' ) i++;
+   connData->url = h + i + 1;
+
+   // Figure out end of url.
+   e = ( char* )strstr( connData->url, " " );
+   if( e == NULL ) return CallbackError;
+   *e = 0; // terminate url part
+   e++; // Skip to protocol indicator
+   while( *e == ' ' ) e++; // Skip spaces.
+   // If HTTP/1.1, note that and set chunked encoding
+   if( strcasecmp( e, "HTTP/1.1" ) == 0 )
+      connData->priv->flags |= HFL_HTTP11 | HFL_CHUNKED | HFL_KEEPALIVE;
+
+   ESP_LOGD( TAG, "URL = %s", connData->url );
+   // Parse out the URL part before the GET parameters.
+   connData->getArgs = ( char* )strstr( connData->url, "?" );
+   if( connData->getArgs != 0 )
+   {
+      *connData->getArgs = 0;  // place a '0' to the location of the '?'
+      connData->getArgs++;     // points to the string after the '?'
+      ESP_LOGD( TAG, "GET args: %s", connData->getArgs );
+   }
+   else
    {
-      char *e;
+      connData->getArgs = NULL;
+   }
+
+   return CallbackSuccess;
+}
 
-      // Skip past the space after POST/GET
-      i = 0;
-      while( h[i] != ' ' ) i++;
-      connData->url = h + i + 1;
+// Parse the value of a well known header and modify the connection data accordingly.
+static CallbackStatus ICACHE_FLASH_ATTR httpdParseHeader( HttpdHeaderId id, char *val, HttpdConnData *connData )
+{
+   CallbackStatus status = CallbackSuccess;
 
-      // Figure out end of url.
-      e = ( char* )strstr( connData->url, " " );
-      if( e == NULL ) return CallbackError;
-      *e = 0; // terminate url part
-      e++; // Skip to protocol indicator
-      while( *e == ' ' ) e++; // Skip spaces.
-      // If HTTP/1.1, note that and set chunked encoding
-      if( strcasecmp( e, "HTTP/1.1" ) == 0 )
-         connData->priv->flags |= HFL_HTTP11 | HFL_CHUNKED;
+   switch( id )
+   {
+      case HTTPD_HDR_HOST:
+         connData->hostName = val;
+         break;
 
-      ESP_LOGD( TAG, "URL = %s", connData->url );
-      // Parse out the URL part before the GET parameters.
-      connData->getArgs = ( char* )strstr( connData->url, "?" );
-      if( connData->getArgs != 0 )
-      {
-         *connData->getArgs = 0;  // place a '0' to the location of the '?'
-         connData->getArgs++;     // points to the string after the '?'
-         ESP_LOGD( TAG, "GET args: %s", connData->getArgs );
-      }
-      else
+      case HTTPD_HDR_CONNECTION:
+         if( strncasecmp( val, "close", 5 ) == 0 )
+            connData->priv->flags &= ~( HFL_CHUNKED | HFL_KEEPALIVE ); // Don't use chunked connData
+         else if( strncasecmp( val, "keep-alive", 10 ) == 0 )
+            connData->priv->flags |= HFL_KEEPALIVE; // HTTP/1.0 client asks for a persistent connection
+         break;
+
+      case HTTPD_HDR_CONTENT_LENGTH:
       {
-         connData->getArgs = NULL;
+         // Get POST data length, becomes post.len when the head is complete
+         connData->priv->postLen = atoi( val );
+
+         // Allocate the buffer
+         if( connData->priv->postLen > HTTPD_MAX_POST_LEN )
+         {
+            // we'll stream this in in chunks
+            connData->post.buffSize = HTTPD_MAX_POST_LEN;
+         }
+         else
+         {
+            connData->post.buffSize = connData->priv->postLen;
+         }
+
+         ESP_LOGD( TAG, "Mallocced buffer for %d + 1 bytes of post data", connData->post.buffSize );
+         int bufferSize = connData->post.buffSize + 1;
+         if( connData->post.buf ) free( connData->post.buf );
+         connData->post.buf = ( char* )malloc( bufferSize );
+         if( connData->post.buf == NULL )
+         {
+            ESP_LOGE( TAG, "malloc failed %d bytes", bufferSize );
+            status = CallbackErrorMemory;
+         }
+         else
+         {
+            connData->post.buffLen = 0;
+         }
+         break;
       }
+
+      case HTTPD_HDR_CONTENT_TYPE:
+         if( strstr( val, "multipart/form-data" ) )
+         {
+            // It's multipart form data so let's pull out the boundary for future use
+            char *b;
+            if( ( b = strstr( val, "boundary=" ) ) != NULL )
+            {
+               connData->post.multipartBoundary = b + 7; // move the pointer 2 chars before boundary then fill them with dashes
+               connData->post.multipartBoundary[0] = '-';
+               connData->post.multipartBoundary[1] = '-';
+               ESP_LOGD( TAG, "boundary = %s", connData->post.multipartBoundary );
+            }
+         }
+         break;
+
+#ifdef CONFIG_ESPHTTPD_CORS_SUPPORT
+      case HTTPD_HDR_ACCESS_CONTROL_REQUEST_HEADERS:
+         // CORS token must be repeated in the response, copy it into
+         // the connection token storage
+         ESP_LOGD( TAG, "CORS preflight request." );
+
+         strncpy( connData->priv->corsToken, val, HTTPD_MAX_CORS_TOKEN_LEN );
+
+         // ensure null termination of the token
+         connData->priv->corsToken[ HTTPD_MAX_CORS_TOKEN_LEN - 1 ] = 0;
+         break;
+#endif
+
+      default:
+         break;
    }
-   else if( strncasecmp( h, "Connection:", 11 ) == 0 )
+
+   return status;
+}
+
+// Handle a complete line of the request head. The line is zero terminated in priv->head.
+static CallbackStatus ICACHE_FLASH_ATTR httpdParseLine( HttpdConnData *connData, char *line )
+{
+   HttpdPriv *priv = connData->priv;
+
+   if( priv->parseState == HPS_REQLINE )
    {
-      i = 11;
-      // Skip trailing spaces
-      while( h[i] == ' ' ) i++;
-      if( strncmp( &h[i], "close", 5 ) == 0 ) connData->priv->flags &= ~HFL_CHUNKED; // Don't use chunked connData
+      priv->parseState = HPS_HEADERS;
+      return httpdParseRequestLine( line, connData );
    }
-   else if( strncasecmp( h, "Content-Length:", 15 ) == 0 )
+
+   // Split "name: value", the colon is replaced by the terminator of the name
+   char *val = strchr( line, ':' );
+   if( val == NULL )
    {
-      i = 15;
-      // Skip trailing spaces
-      while( h[i] == ' ' ) i++;
-      // Get POST data length
-      connData->post.len = atoi( h + i );
+      ESP_LOGW( TAG, "malformed header line: %s", line );
+      return CallbackSuccess;
+   }
+   *val++ = 0;
+   while( *val == ' ' || *val == '\t' ) val++;
 
-      // Allocate the buffer
-      if( connData->post.len > HTTPD_MAX_POST_LEN )
-      {
-         // we'll stream this in in chunks
-         connData->post.buffSize = HTTPD_MAX_POST_LEN;
-      }
-      else
-      {
-         connData->post.buffSize = connData->post.len;
-      }
+   // strip trailing white space of the value
+   char *e = val + strlen( val );
+   while( e > val && ( e[-1] == ' ' || e[-1] == '\t' ) ) *--e = 0;
 
-      ESP_LOGD( TAG, "Mallocced buffer for %d + 1 bytes of post data", connData->post.buffSize );
-      int bufferSize = connData->post.buffSize + 1;
-      connData->post.buf = ( char* )malloc( bufferSize );
-      if( connData->post.buf == NULL )
-      {
-         ESP_LOGE( TAG, "malloc failed %d bytes", bufferSize );
-         status = CallbackErrorMemory;
-      }
-      else
-      {
-         connData->post.buffLen = 0;
-      }
+   HttpdHeaderId id = httpdHeaderId( line );
+   if( id != HTTPD_HDR_OTHER )
+   {
+      priv->knownHeaders[id] = val - priv->head;
+      return httpdParseHeader( id, val, connData );
+   }
+
+   if( priv->headerCount < HTTPD_MAX_HEADERS )
+   {
+      priv->headers[priv->headerCount].name  = line - priv->head;
+      priv->headers[priv->headerCount].value = val - priv->head;
+      priv->headerCount++;
+   }
+   else
+   {
+      ESP_LOGW( TAG, "too many headers, %s not indexed", line );
    }
-   else if( strncasecmp( h, "Content-Type: ", 14 ) == 0 )
+
+   return CallbackSuccess;
+}
+
+// Incremental request head parser. Consumes bytes of data until the empty line that ends the
+// head is found or the data is used up, and returns the number of bytes consumed. The parser
+// resumes where it stopped with the next segment, so every received byte is looked at only once.
+// When the head is complete, post.len is set to the Content-Length ( zero if there is no body ).
+
+static int ICACHE_FLASH_ATTR httpdParseHead( HttpdConnData *connData, char *data, int len, CallbackStatus *status )
+{
+   HttpdPriv *priv = connData->priv;
+   int x = 0;
+
+   while( x < len )
    {
-      if( strstr( h, "multipart/form-data" ) )
+      // Copy the run up to the end of the line ( or segment ) in one go
+      char *nl = memchr( data + x, '\n', len - x );
+      int n = ( nl != NULL ) ? ( nl - ( data + x ) ) : ( len - x );
+      int run = n;
+
+      // Drop the \r of the line end. Compatibility with clients that send \n only comes for free.
+      if( run > 0 && data[x + run - 1] == '\r' ) run--;
+
+      if( !priv->lineDropped )
       {
-         // It's multipart form data so let's pull out the boundary for future use
-         char *b;
-         if( ( b = strstr( h, "boundary=" ) ) != NULL )
+         // keep one byte for the zero terminator
+         if( priv->headPos + run < priv->headSize )
+         {
+            memcpy( priv->head + priv->headPos, data + x, run );
+            priv->headPos += run;
+         }
+         else
          {
-            connData->post.multipartBoundary = b + 7; // move the pointer 2 chars before boundary then fill them with dashes
-            connData->post.multipartBoundary[0] = '-';
-            connData->post.multipartBoundary[1] = '-';
-            ESP_LOGD( TAG, "boundary = %s", connData->post.multipartBoundary );
+            // ToDo: return http error code 431 ( request header too long ) if this happens
+            ESP_LOGE( TAG, "request too long!" );
+            priv->lineDropped = 1;
          }
       }
-   }
-#ifdef CONFIG_ESPHTTPD_CORS_SUPPORT
-   else if( strncmp( h, "Access-Control-Request-Headers: ", 32 ) == 0 )
-   {
-      // CORS token must be repeated in the response, copy it into
-      // the connection token storage
-      ESP_LOGD( TAG, "CORS preflight request." );
 
-      strncpy( connData->priv->corsToken, h + strlen( "Access-Control-Request-Headers: " ), HTTPD_MAX_CORS_TOKEN_LEN );
+      x += n;
+      if( nl == NULL ) break; // line continues in the next segment
+      x++;                    // skip the \n
+
+      if( priv->lineDropped )
+      {
+         // forget the partial line, go on with the next one
+         priv->headPos = priv->lineStart;
+         priv->lineDropped = 0;
+         continue;
+      }
+
+      if( priv->headPos == priv->lineStart )
+      {
+         // Empty line: the head is complete. Skip leading empty lines before the request line.
+         if( priv->parseState == HPS_REQLINE ) continue;
+
+         connData->post.len = priv->postLen;
+         break;
+      }
+
+      priv->head[priv->headPos++] = 0;
+      char *line = priv->head + priv->lineStart;
+      priv->lineStart = priv->headPos;
 
-      // ensure null termination of the token
-      connData->priv->corsToken[ HTTPD_MAX_CORS_TOKEN_LEN - 1 ] = 0;
+      CallbackStatus r = httpdParseLine( connData, line );
+      if( r != CallbackSuccess ) *status = r;
    }
-#endif
 
-   return status;
+   return x;
 }
 
 // Make a connection 'live' so we can do all the things a cgi can do to it.
@@ -1148,148 +2529,214 @@ void ICACHE_FLASH_ATTR httpdConnSendFinish( HttpdInstance *pInstance, HttpdConnD
    httpdPlatUnlock( pInstance );
 }
 
-// Callback called when there's data available on a socket.
-CallbackStatus ICACHE_FLASH_ATTR httpdRecvCb( HttpdInstance *pInstance, HttpdConnData *connData, char *data, unsigned short len )
+// Hold back data of pipelined requests until the current request is done.
+static CallbackStatus ICACHE_FLASH_ATTR httpdPipelineStash( HttpdConnData *connData, char *data, int len )
 {
-   int x, r;
-   char *p, *e;
-   CallbackStatus status = CallbackSuccess;
-   httpdPlatLock( pInstance );
+   HttpdPriv *priv = connData->priv;
 
-   char *sendBuff = malloc( HTTPD_MAX_SENDBUFF_LEN );
-   if( sendBuff == NULL )
+   if( priv->pipeLen + len > HTTPD_MAX_PIPELINE_LEN )
    {
-      ESP_LOGE( TAG, "Malloc sendBuff failed!" );
-      HEAP_INFO( "" );
-      status = CallbackErrorMemory;
+      ESP_LOGE( TAG, "pipelined requests exceed %d bytes", HTTPD_MAX_PIPELINE_LEN );
+      return CallbackError;
    }
-   else
+
+   if( priv->pipeBuf == NULL )
    {
-      connData->priv->sendBuff = sendBuff;
-      connData->priv->sendBuffLen = 0;
-#ifdef CONFIG_ESPHTTPD_CORS_SUPPORT
-      connData->priv->corsToken[0] = 0;
-#endif
+      priv->pipeBuf = malloc( HTTPD_MAX_PIPELINE_LEN );
+      if( priv->pipeBuf == NULL )
+      {
+         ESP_LOGE( TAG, "malloc failed %d bytes", HTTPD_MAX_PIPELINE_LEN );
+         return CallbackErrorMemory;
+      }
+      priv->pipeLen = 0;
+   }
+
+   memcpy( priv->pipeBuf + priv->pipeLen, data, len );
+   priv->pipeLen += len;
+   ESP_LOGD( TAG, "%d bytes of pipelined requests waiting", priv->pipeLen );
+   return CallbackSuccess;
+}
+
+// Handle received data. The caller holds the lock and provides the send buffer.
+static CallbackStatus ICACHE_FLASH_ATTR httpdRecvData( HttpdInstance *pInstance, HttpdConnData *connData, char *data, int len )
+{
+   int x, n, r;
+   CallbackStatus status = CallbackSuccess;
 
-      // This is slightly evil/dirty: we abuse connData->post.len as a state variable for where in the http communications we are:
-      // <0 ( -1 ): Post len unknown because we're still receiving headers
-      // ==0: No post data
-      // >0: Need to receive post data
-      // ToDo: See if we can use something more elegant for this.
+   // This is slightly evil/dirty: we abuse connData->post.len as a state variable for where in the http communications we are:
+   // <0 ( -1 ): Post len unknown because we're still receiving headers
+   // ==0: No post data
+   // >0: Need to receive post data
+   // ToDo: See if we can use something more elegant for this.
 
-      for( x = 0; x < len; x++ )
+   x = 0;
+   while( x < len && status == CallbackSuccess )
+   {
+      if( connData->post.len < 0 )
       {
-         if( connData->post.len < 0 ) // This byte is a header byte
+         // These bytes are header bytes.
+         if( connData->priv->headPos == 0 && connData->priv->parseState == HPS_REQLINE )
          {
-            // This byte is a header byte.
-            if( data[x] == '\n' )
-            {
-               if( connData->priv->headPos < HTTPD_MAX_HEAD_LEN - 1 )
-               {
-                  // Compatibility with clients that send \n only: fake a \r in front of this.
-                  if( connData->priv->headPos != 0 && connData->priv->head[connData->priv->headPos - 1] != '\r' )
-                  {
-                     connData->priv->head[connData->priv->headPos++] = '\r';
-                  }
-               }
-               else
-               {
-                  ESP_LOGE( TAG, "adding newline request too long" );
-               }
-            }
+            // Reset url data
+            connData->url = NULL;
+         }
 
-            // ToDo: return http error code 431 ( request header too long ) if this happens
-            if( connData->priv->headPos < HTTPD_MAX_HEAD_LEN - 1 )
-            {
-               connData->priv->head[connData->priv->headPos++] = data[x];
-            }
-            else
+         if( connData->priv->head == NULL )
+         {
+            connData->priv->head = httpdHeadAlloc( pInstance );
+            if( connData->priv->head == NULL )
             {
-               ESP_LOGE( TAG, "request too long!" );
+               ESP_LOGE( TAG, "malloc failed %d bytes", HTTPD_MAX_HEAD_LEN );
+               status = CallbackErrorMemory;
+               break;
             }
+            connData->priv->headSize = HTTPD_MAX_HEAD_LEN;
+         }
 
-            // always null terminate
-            connData->priv->head[connData->priv->headPos] = 0;
-
-            // Scan for /r/n/r/n. Receiving this indicate the headers end.
-            if( data[x] == '\n' && ( char * )strstr( connData->priv->head, "\r\n\r\n" ) != NULL )
-            {
-               // Indicate we're done with the headers.
-               connData->post.len = 0;
-               // Reset url data
-               connData->url = NULL;
-               // Iterate over all received headers and parse them.
-               p = connData->priv->head;
-               while( p < ( &connData->priv->head[connData->priv->headPos - 4] ) )
-               {
-                  e = ( char * )strstr( p, "\r\n" ); // Find end of header line
-                  if( e == NULL ) break;             // Shouldn't happen.
-                  e[0] = 0;                          // Zero-terminate header
-                  httpdParseHeader( p, connData );   // and parse it.
-                  p = e + 2;                         // Skip /r/n ( now /0/n )
-               }
+         x += httpdParseHead( connData, data + x, len - x, &status );
+         if( connData->post.len >= 0 )
+            httpdCompactHead( pInstance, connData );
 
-               // If we don't need to receive post data, we can send the response now.
-               if( connData->post.len == 0 )
-               {
-                  httpdProcessRequest( pInstance, connData );
-               }
-            }
+         // If the head is complete and we don't need to receive post data, we can send the response now.
+         if( connData->post.len == 0 && status == CallbackSuccess )
+         {
+            httpdProcessRequest( pInstance, connData );
          }
-         else if( connData->post.len != 0 )
+      }
+      else if( connData->post.received < connData->post.len && ( connData->priv->flags & HFL_DISCONAFTERSENT ) )
+      {
+         // The cgi is done before the body was read, drop the rest, the connection is closed
+         n = len - x;
+         if( n > connData->post.len - connData->post.received ) n = connData->post.len - connData->post.received;
+         connData->post.received += n;
+         x += n;
+      }
+      else if( connData->post.received < connData->post.len )
+      {
+         // These bytes are POST bytes. Take as much as fits into the post buffer.
+         if( connData->post.buf == NULL )
          {
-            // This byte is a POST byte.
-            connData->post.buf[connData->post.buffLen++] = data[x];
-            connData->post.received++;
-            connData->hostName = NULL;
-            if( connData->post.buffLen >= connData->post.buffSize || connData->post.received == connData->post.len )
-            {
-               // Received a chunk of post data
-               connData->post.buf[connData->post.buffLen] = 0; // zero-terminate, in case the cgi handler knows it can use strings
-               // Process the data
-               if( connData->cgi )
-               {
-                  ESP_LOGD( TAG, "httpdRecvCb: Execute cgi fn." );
-                  r = connData->cgi( connData ); // Execute cgi fn.
-
-                  if( r == HTTPD_CGI_DONE )
-                  {
-                     httpdCgiIsDone( pInstance, connData );
-                  }
-               }
-               else
-               {
-                  // No CGI fn set yet: probably first call. Allow httpdProcessRequest to choose CGI and
-                  // call it the first time.
-                  httpdProcessRequest( pInstance, connData );
-               }
-               connData->post.buffLen = 0;
-            }
+            status = CallbackErrorMemory;
+            break;
          }
-         else
+         n = len - x;
+         if( n > connData->post.buffSize - connData->post.buffLen ) n = connData->post.buffSize - connData->post.buffLen;
+         if( n > connData->post.len - connData->post.received ) n = connData->post.len - connData->post.received;
+         memcpy( connData->post.buf + connData->post.buffLen, data + x, n );
+         connData->post.buffLen += n;
+         connData->post.received += n;
+         x += n;
+         connData->hostName = NULL;
+         if( connData->post.buffLen >= connData->post.buffSize || connData->post.received == connData->post.len )
          {
-            // Let cgi handle data if it registered a recvHdl callback. If not, ignore.
-            if( connData->recvHdl )
+            // Received a chunk of post data
+            connData->post.buf[connData->post.buffLen] = 0; // zero-terminate, in case the cgi handler knows it can use strings
+            // Process the data
+            if( connData->cgi )
             {
-               r = connData->recvHdl( pInstance, connData, data + x, len - x );
+               ESP_LOGD( TAG, "httpdRecvCb: Execute cgi fn." );
+               r = connData->cgi( connData ); // Execute cgi fn.
+
                if( r == HTTPD_CGI_DONE )
                {
-                  ESP_LOGD( TAG, "Recvhdl returned DONE" );
                   httpdCgiIsDone( pInstance, connData );
-                  // We assume the recvhdlr has sent something; we'll kill the sock in the sent callback.
                }
-               break; // ignore rest of data, recvhdl has parsed it.
             }
             else
             {
-               ESP_LOGE( TAG, "Unexpected data from client. %s", data );
-               status = CallbackError;
+               // No CGI fn set yet: probably first call. Allow httpdProcessRequest to choose CGI and
+               // call it the first time.
+               httpdProcessRequest( pInstance, connData );
+            }
+            connData->post.buffLen = 0;
+         }
+      }
+      else
+      {
+         // Let cgi handle data if it registered a recvHdl callback. If not, ignore.
+         if( connData->recvHdl )
+         {
+            r = connData->recvHdl( pInstance, connData, data + x, len - x );
+            if( r == HTTPD_CGI_DONE )
+            {
+               ESP_LOGD( TAG, "Recvhdl returned DONE" );
+               httpdCgiIsDone( pInstance, connData );
+               // We assume the recvhdlr has sent something; we'll kill the sock in the sent callback.
             }
+            break; // ignore rest of data, recvhdl has parsed it.
+         }
+         else if( ( connData->cgi != NULL || connData->priv->parked ) && !( connData->priv->flags & HFL_DISCONAFTERSENT ) )
+         {
+            // The client sent the next request while we are still busy with the current one.
+            status = httpdPipelineStash( connData, data + x, len - x );
+            break;
+         }
+         else
+         {
+            ESP_LOGE( TAG, "Unexpected data from client. %s", data );
+            status = CallbackError;
+         }
+      }
+   }
+
+   return status;
+}
+
+// Go on with the pipelined requests after the previous one is done.
+static CallbackStatus ICACHE_FLASH_ATTR httpdPipelineResume( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   char *buf = connData->priv->pipeBuf;
+   int len = connData->priv->pipeLen;
+
+   // hand over the buffer, the next request may need to stash the rest again
+   connData->priv->pipeBuf = NULL;
+   connData->priv->pipeLen = 0;
+
+   CallbackStatus status = httpdRecvData( pInstance, connData, buf, len );
+   free( buf );
+   return status;
+}
+
+// Callback called when there's data available on a socket.
+CallbackStatus ICACHE_FLASH_ATTR httpdRecvCb( HttpdInstance *pInstance, HttpdConnData *connData, char *data, unsigned short len )
+{
+   CallbackStatus status = CallbackSuccess;
+   httpdPlatLock( pInstance );
+
+   char *sendBuff = malloc( HTTPD_MAX_SENDBUFF_LEN );
+   if( sendBuff == NULL )
+   {
+      ESP_LOGE( TAG, "Malloc sendBuff failed!" );
+      HEAP_INFO( "" );
+      status = CallbackErrorMemory;
+   }
+   else
+   {
+      connData->priv->sendBuff = sendBuff;
+      connData->priv->sendBuffLen = 0;
+      connData->priv->lastActive = ++pInstance->activity;
+#ifdef CONFIG_ESPHTTPD_CORS_SUPPORT
+      connData->priv->corsToken[0] = 0;
+#endif
+
+      if( connData->priv->pipeBuf != NULL )
+      {
+         // Earlier requests are still waiting, keep the order
+         status = httpdPipelineStash( connData, data, len );
+         if( status == CallbackSuccess && connData->cgi == NULL && !connData->priv->parked )
+         {
+            status = httpdPipelineResume( pInstance, connData );
          }
       }
+      else
+      {
+         status = httpdRecvData( pInstance, connData, data, len );
+      }
+
       httpdFlushSendBuffer( pInstance, connData );
       free( sendBuff );
       connData->priv->sendBuff = NULL;
+      httpdSuspendCheck( pInstance, connData );
    }
    httpdPlatUnlock( pInstance );
 
@@ -1324,10 +2771,25 @@ void ICACHE_FLASH_ATTR httpdConnectCb( HttpdInstance *pInstance, HttpdConnData *
 
    memset( connData, 0, sizeof( HttpdConnData ) );
    connData->priv = malloc( sizeof( HttpdPriv ) );
+   if( connData->priv == NULL )
+   {
+      ESP_LOGE( TAG, "Malloc of priv failed!" );
+      HTTPD_METRICS_INC( refused );
+      httpdPlatUnlock( pInstance );
+      return;
+   }
    memset( connData->priv, 0, sizeof( HttpdPriv ) );
+   connData->priv->instance = pInstance;
 
    connData->post.len = -1;
 
+   connData->priv->lastActive = ++pInstance->activity;
+   connData->priv->nextConn = pInstance->connList;
+   pInstance->connList = connData;
+#if HTTPD_RESERVED_CONNECTIONS > 0
+   httpdAdmitConn( pInstance );
+#endif
+
    httpdPlatUnlock( pInstance );
 }
 
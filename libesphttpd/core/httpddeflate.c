@@ -0,0 +1,334 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          httpddeflate.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   the states come from a static pool of HTTPD_DEFLATE_STATES
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Streaming gzip encoder with fixed Huffman codes, see httpddeflate.h and RFC 1951, RFC 1952.
+
+The input is copied into buf, which holds the window of previous data and the new data. When
+it is full, the last HTTPD_DEFLATE_WINDOW bytes are moved to its start. head[] keeps the last
+position of each hash of three bytes, the position found there is the only match candidate.
+*/
+
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+
+// --------------------------------------------------------------------------
+// debug support
+// --------------------------------------------------------------------------
+
+#define LOG_LOCAL_LEVEL    ESP_LOG_WARN
+static const char *TAG = "httpddeflate";
+#include "esp_log.h"
+#define S( str ) ( str == NULL ? "<null>": str )
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#ifdef linux
+   #include <libesphttpd/linux.h>
+#else
+   #include <libesphttpd/esp.h>
+#endif
+
+#include "libesphttpd/httpddeflate.h"
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#if HTTPD_DEFLATE_WINDOW > 16384
+   #error "HTTPD_DEFLATE_WINDOW must not be larger than 16384"
+#endif
+
+#define MIN_MATCH       3
+#define MAX_MATCH       258
+
+// a match of 3 bytes from further away takes more bits than the literals
+#define MAX_DIST_3      4096
+
+struct HttpdDeflate
+{
+   uint32_t crc;
+   uint32_t size;             // of the input, modulo 2^32
+   uint32_t bitBuf;           // bits not yet written, LSB first
+   int      bitCount;
+   int      bufLen;
+   bool     started;          // gzip header and block header are written
+   bool     inUse;
+   int16_t  head[HTTPD_DEFLATE_HASH_SIZE];
+   uint8_t  buf[2 * HTTPD_DEFLATE_WINDOW];
+};
+
+// the tables are in flash and read with aligned 32-bit accesses
+
+// CRC-32 of RFC 1952, four bits at a time
+static const uint32_t crcTable[16] ICACHE_RODATA_ATTR STORE_ATTR =
+{
+   0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+   0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c, 0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c
+};
+
+// base lengths and extra bits of the length codes 257 .. 285
+static const int lengthBase[29] ICACHE_RODATA_ATTR STORE_ATTR =
+{
+   3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const int lengthExtra[29] ICACHE_RODATA_ATTR STORE_ATTR =
+{
+   0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+   3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+// base distances of the distance codes 0 .. 29, code n has ( n / 2 - 1 ) extra bits
+static const int distBase[30] ICACHE_RODATA_ATTR STORE_ATTR =
+{
+   1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+   257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577
+};
+
+// the states of the compressed responses, a heap block per response would fragment the heap
+static HttpdDeflate deflateStates[HTTPD_DEFLATE_STATES];
+
+static const uint8_t gzipHeader[10] =
+{
+   0x1f, 0x8b,                // magic
+   8,                         // deflate
+   0,                         // flags
+   0, 0, 0, 0,                // no modification time
+   0,                         // extra flags
+   0xff                       // unknown OS
+};
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+static uint32_t ICACHE_FLASH_ATTR deflateCrc( uint32_t crc, const uint8_t *data, int len )
+{
+   crc = ~crc;
+   while( len-- > 0 )
+   {
+      crc ^= *data++;
+      crc = ( crc >> 4 ) ^ crcTable[crc & 0xf];
+      crc = ( crc >> 4 ) ^ crcTable[crc & 0xf];
+   }
+   return ~crc;
+}
+
+// write n bits, LSB first
+static inline uint8_t* ICACHE_FLASH_ATTR putBits( HttpdDeflate *d, uint8_t *out, uint32_t bits, int n )
+{
+   d->bitBuf |= bits << d->bitCount;
+   d->bitCount += n;
+   while( d->bitCount >= 8 )
+   {
+      *out++ = d->bitBuf;
+      d->bitBuf >>= 8;
+      d->bitCount -= 8;
+   }
+   return out;
+}
+
+// Huffman codes are written MSB first
+static inline uint8_t* ICACHE_FLASH_ATTR putCode( HttpdDeflate *d, uint8_t *out, uint32_t code, int n )
+{
+   uint32_t rev = 0;
+   int i;
+
+   for( i = 0; i < n; i++ )
+   {
+      rev = ( rev << 1 ) | ( code & 1 );
+      code >>= 1;
+   }
+   return putBits( d, out, rev, n );
+}
+
+// fixed Huffman code of a literal/length symbol
+static inline uint8_t* ICACHE_FLASH_ATTR putSymbol( HttpdDeflate *d, uint8_t *out, int sym )
+{
+   if( sym < 144 )
+      return putCode( d, out, 0x30 + sym, 8 );
+   if( sym < 256 )
+      return putCode( d, out, 0x190 + sym - 144, 9 );
+   if( sym < 280 )
+      return putCode( d, out, sym - 256, 7 );
+   return putCode( d, out, 0xc0 + sym - 280, 8 );
+}
+
+static uint8_t* ICACHE_FLASH_ATTR putMatch( HttpdDeflate *d, uint8_t *out, int len, int dist )
+{
+   int i;
+
+   for( i = 28; lengthBase[i] > len; i-- )
+      ;
+   out = putSymbol( d, out, 257 + i );
+   if( lengthExtra[i] )
+      out = putBits( d, out, len - lengthBase[i], lengthExtra[i] );
+
+   for( i = 29; distBase[i] > dist; i-- )
+      ;
+   out = putCode( d, out, i, 5 );
+   if( i >= 4 )
+      out = putBits( d, out, dist - distBase[i], i / 2 - 1 );
+   return out;
+}
+
+static inline int ICACHE_FLASH_ATTR deflateHash( const uint8_t *p )
+{
+   return ( ( p[0] << 8 ) ^ ( p[1] << 4 ) ^ p[2] ) * 2654435761u >> 16 & ( HTTPD_DEFLATE_HASH_SIZE - 1 );
+}
+
+// encode buf[pos .. d->bufLen)
+static uint8_t* ICACHE_FLASH_ATTR deflateBlock( HttpdDeflate *d, uint8_t *out, int pos )
+{
+   const uint8_t *buf = d->buf;
+   int end = d->bufLen;
+
+   while( pos < end )
+   {
+      if( pos + MIN_MATCH <= end )
+      {
+         int h = deflateHash( buf + pos );
+         int cand = d->head[h];
+         d->head[h] = pos;
+
+         if( cand >= 0 && buf[cand] == buf[pos] && buf[cand + 1] == buf[pos + 1] && buf[cand + 2] == buf[pos + 2] )
+         {
+            int max = end - pos < MAX_MATCH ? end - pos : MAX_MATCH;
+            int len = MIN_MATCH;
+            while( len < max && buf[cand + len] == buf[pos + len] )
+               len++;
+
+            if( len > MIN_MATCH || pos - cand <= MAX_DIST_3 )
+            {
+               out = putMatch( d, out, len, pos - cand );
+
+               // the positions inside the match are candidates for later matches
+               int last = pos + len;
+               for( pos++; pos < last; pos++ )
+                  if( pos + MIN_MATCH <= end )
+                     d->head[deflateHash( buf + pos )] = pos;
+               continue;
+            }
+         }
+      }
+      out = putSymbol( d, out, buf[pos] );
+      pos++;
+   }
+   return out;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+HttpdDeflate* ICACHE_FLASH_ATTR httpdDeflateNew( void )
+{
+   HttpdDeflate *d = NULL;
+   int i;
+
+   for( i = 0; i < HTTPD_DEFLATE_STATES; i++ )
+   {
+      if( !deflateStates[i].inUse )
+      {
+         d = &deflateStates[i];
+         break;
+      }
+   }
+   if( d == NULL )
+   {
+      ESP_LOGD( TAG, "All %d deflate states in use", HTTPD_DEFLATE_STATES );
+      return NULL;
+   }
+   d->inUse = true;
+   d->crc = 0;
+   d->size = 0;
+   d->bitBuf = 0;
+   d->bitCount = 0;
+   d->bufLen = 0;
+   d->started = false;
+   memset( d->head, 0xff, sizeof( d->head ) );
+   return d;
+}
+
+void ICACHE_FLASH_ATTR httpdDeflateFree( HttpdDeflate *d )
+{
+   if( d != NULL ) d->inUse = false;
+}
+
+int ICACHE_FLASH_ATTR httpdDeflate( HttpdDeflate *d, const char *data, int len, char *out )
+{
+   uint8_t *o = ( uint8_t * )out;
+   int i;
+
+   if( !d->started )
+   {
+      memcpy( o, gzipHeader, sizeof( gzipHeader ) );
+      o += sizeof( gzipHeader );
+      o = putBits( d, o, 1 | ( 1 << 1 ), 3 );     // last block, fixed Huffman codes
+      d->started = true;
+   }
+
+   d->crc = deflateCrc( d->crc, ( const uint8_t * )data, len );
+   d->size += len;
+
+   while( len > 0 )
+   {
+      if( d->bufLen == sizeof( d->buf ) )
+      {
+         // keep the last window for the matches of the next data
+         int shift = d->bufLen - HTTPD_DEFLATE_WINDOW;
+         memmove( d->buf, d->buf + shift, HTTPD_DEFLATE_WINDOW );
+         d->bufLen = HTTPD_DEFLATE_WINDOW;
+         for( i = 0; i < HTTPD_DEFLATE_HASH_SIZE; i++ )
+            d->head[i] = d->head[i] >= shift ? d->head[i] - shift : -1;
+      }
+
+      int n = sizeof( d->buf ) - d->bufLen;
+      if( n > len ) n = len;
+      memcpy( d->buf + d->bufLen, data, n );
+      int pos = d->bufLen;
+      d->bufLen += n;
+      data += n;
+      len -= n;
+
+      o = deflateBlock( d, o, pos );
+   }
+   return ( char * )o - out;
+}
+
+int ICACHE_FLASH_ATTR httpdDeflateFinish( HttpdDeflate *d, char *out )
+{
+   uint8_t *o = ( uint8_t * )out;
+   int i;
+
+   if( !d->started )
+      o += httpdDeflate( d, NULL, 0, out );
+
+   o = putSymbol( d, o, 256 );                     // end of block
+   if( d->bitCount > 0 )
+      o = putBits( d, o, 0, 8 - d->bitCount );
+
+   for( i = 0; i < 4; i++ )
+      *o++ = d->crc >> ( 8 * i );
+   for( i = 0; i < 4; i++ )
+      *o++ = d->size >> ( 8 * i );
+   return ( char * )o - out;
+}
+
+#endif // CONFIG_ESPHTTPD_DEFLATE
@@ -9,6 +9,21 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   serveStaticFile(): a span which is not accepted is copied into the send
+//                        buffer, the body is only advanced by what was sent
+//    2026-10-19  AWe   tplSend() returns the number of bytes sent, the rest of an escaped value
+//                        is sent by the callback in its next call
+//    2026-10-19  AWe   answer 503 with Retry-After when espfs has no free file handle or decoder
+//    2026-10-19  AWe   the state of templates is in the request arena
+//    2026-10-19  AWe   add cgiEspFsTemplateCached(), replays the body from the render cache
+//    2026-10-19  AWe   render templates precompiled by mkespfsimage without scanning them
+//    2026-10-19  AWe   serveStaticFile(): send uncompressed files in place or read them straight
+//                        into the send buffer
+//    2026-10-19  AWe   serveStaticFile(): answer Range requests with 206 Partial Content
+//    2026-10-19  AWe   serveStaticFile(): send ETag from the content hash of the espfs image,
+//                        answer If-None-Match with 304 without opening the file
+//    2026-10-19  AWe   serveStaticFile(): send Content-Length, keeps the connection open
+//    2026-10-19  AWe   serveStaticFile(): check Accept-Encoding with httpdGetHeaderById()
 //    2018-02-04  AWe   take over changes from MightyPork/libesphttpd
 //                        https://github.com/MightyPork/libesphttpd/commit/8f4db520bce2ecdc147dd6625e05d8dda45c813a
 //                        make it possible to set server name
@@ -65,6 +80,10 @@ static const char *TAG = "httpdespfs";
 static EspFsFile* ICACHE_FLASH_ATTR tryOpenIndex_do( const char *path, const char *indexname );
 static EspFsFile* ICACHE_FLASH_ATTR tryOpenIndex( const char *path );
 static CgiStatus ICACHE_FLASH_ATTR cgiTemplateSendContent( HttpdConnData *connData );
+static CgiStatus ICACHE_FLASH_ATTR cgiTemplateSendCompiled( HttpdConnData *connData );
+static bool ICACHE_FLASH_ATTR tplLoadTokens( HttpdConnData *connData, TplData *tpd );
+static void ICACHE_FLASH_ATTR tplFree( TplData *tpd );
+static CgiStatus ICACHE_FLASH_ATTR tplFinish( HttpdConnData *connData, TplData *tpd );
 
 // --------------------------------------------------------------------------
 //
@@ -145,14 +164,15 @@ static EspFsFile* ICACHE_FLASH_ATTR tryOpenIndex( const char *path )
    // no point in trying to look for index.
    if( strchr( path, '.' ) != NULL ) return NULL;
 
+   // stop when espfs is busy, espFsOpenResult() tells the caller
    file = tryOpenIndex_do( path, "index.tpl.html" );
-   if( file != NULL ) return file;
+   if( file != NULL || espFsOpenResult() == ESPFS_OPEN_BUSY ) return file;
 
    file = tryOpenIndex_do( path, "index.html" );
-   if( file != NULL ) return file;
+   if( file != NULL || espFsOpenResult() == ESPFS_OPEN_BUSY ) return file;
 
    file = tryOpenIndex_do( path, "index.tpl" );
-   if( file != NULL ) return file;
+   if( file != NULL || espFsOpenResult() == ESPFS_OPEN_BUSY ) return file;
 
    file = tryOpenIndex_do( path, "index.htm" );
    if( file != NULL ) return file;
@@ -160,18 +180,99 @@ static EspFsFile* ICACHE_FLASH_ATTR tryOpenIndex( const char *path )
    return NULL; // failed to guess the right name
 }
 
+// All file handles or heatshrink decoders of espfs are in use, the client should try again soon
+static CgiStatus ICACHE_FLASH_ATTR espFsBusy( HttpdConnData *connData, const char *filepath )
+{
+   ESP_LOGW( TAG, "%s: no free espfs file, try later", filepath );
+   httpdSetContentLength( connData, 0 );
+   httpdStartResponse( connData, 503 );
+   httpdHeader( connData, "Retry-After", "1" );
+   httpdEndHeaders( connData );
+   return HTTPD_CGI_DONE;
+}
+
+// The ETag of a file is its content hash from the espfs image
+static void ICACHE_FLASH_ATTR espFsETag( char *etag, int len, uint32_t hash )
+{
+   snprintf( etag, len, "\"%08x\"", ( unsigned int )hash );
+}
+
+// Check the If-None-Match header of the request, returns true if the client has the
+// current version of the file.
+static bool ICACHE_FLASH_ATTR espFsNotModified( HttpdConnData *connData, const char *etag )
+{
+   const char *ifNoneMatch = httpdGetHeaderById( connData, HTTPD_HDR_IF_NONE_MATCH );
+
+   if( ifNoneMatch == NULL ) return false;
+   // a list of ETags, also weak ones ( W/"..." ), or "*"
+   return strcmp( ifNoneMatch, "*" ) == 0 || strstr( ifNoneMatch, etag ) != NULL;
+}
+
+// Parse the Range header of the request for a file of size bytes. Only a single range
+// "bytes=first-last", "bytes=first-" or "bytes=-suffix" is supported.
+// Returns 1 and the range in first and last if the range is satisfiable, -1 if not and 0 if
+// there is no usable range and the whole file should be sent.
+static int ICACHE_FLASH_ATTR espFsGetRange( HttpdConnData *connData, int size, const char *etag, int *first, int *last )
+{
+   const char *range = httpdGetHeaderById( connData, HTTPD_HDR_RANGE );
+   char ifRange[16];
+   char *e;
+
+   if( range == NULL || strncmp( range, "bytes=", 6 ) != 0 ) return 0;
+   if( strchr( range, ',' ) != NULL ) return 0;       // multiple ranges, send it all
+
+   // the client resumes a download only if the file was not changed in the meantime
+   if( httpdGetHeader( connData, "If-Range", ifRange, sizeof( ifRange ) )
+         && ( etag[0] == 0 || strcmp( ifRange, etag ) != 0 ) ) return 0;
+
+   range += 6;
+   if( *range == '-' )
+   {
+      // the last n bytes
+      long suffix = strtol( range + 1, &e, 10 );
+      if( e == range + 1 || *e != 0 ) return 0;
+      if( suffix <= 0 || size == 0 ) return -1;
+      *first = ( suffix < size ) ? size - suffix : 0;
+      *last = size - 1;
+      return 1;
+   }
+
+   *first = strtol( range, &e, 10 );
+   if( e == range || *e != '-' ) return 0;
+   range = e + 1;
+   if( *range == 0 )
+   {
+      *last = size - 1;
+   }
+   else
+   {
+      *last = strtol( range, &e, 10 );
+      if( *e != 0 || *last < *first ) return 0;
+      if( *last >= size ) *last = size - 1;
+   }
+   if( *first >= size ) return -1;
+   return 1;
+}
+
 CgiStatus ICACHE_FLASH_ATTR serveStaticFile( HttpdConnData *connData, const char* filepath, int responseCode )
 {
-   EspFsFile *file = connData->cgiData;
+   StaticFileData *sfd = connData->cgiData;
+   EspFsFile *file;
    int len;
    char buf[FILE_CHUNK_LEN + 1];
-   char acceptEncodingBuffer[64];
    int isGzip;
+   char etag[12];
+   uint32_t hash;
+   int size, first, last, range;
 
    if( connData->isConnectionClosed )
    {
       // Connection closed. Clean up.
-      espFsClose( file );
+      if( sfd != NULL )
+      {
+         espFsClose( sfd->file );
+         free( sfd );
+      }
       return HTTPD_CGI_DONE;
    }
 
@@ -183,18 +284,44 @@ CgiStatus ICACHE_FLASH_ATTR serveStaticFile( HttpdConnData *connData, const char
    }
 
    // First call to this cgi.
-   if( file == NULL )
+   if( sfd == NULL )
    {
+      // Conditional request: if the client already has this version of the file, the
+      // header of the file is enough to answer it
+      if( responseCode == 200 && httpdGetHeaderById( connData, HTTPD_HDR_IF_NONE_MATCH ) != NULL )
+      {
+         EspFsStat st;
+         if( espFsStat( filepath, &st ) && st.hash != 0 )
+         {
+            espFsETag( etag, sizeof( etag ), st.hash );
+            if( espFsNotModified( connData, etag ) )
+            {
+               ESP_LOGD( TAG, "%s not modified", filepath );
+               // no body follows, the length is the one of the full response
+               httpdSetContentLength( connData, st.size );
+               httpdStartResponse( connData, 304 );
+               httpdHeader( connData, "ETag", etag );
+               httpdAddCacheHeaders( connData, httpdGetMimetype( filepath ) );
+               httpdEndHeaders( connData );
+               return HTTPD_CGI_DONE;
+            }
+         }
+      }
+
       // First call to this cgi. Open the file so we can read it.
       file = espFsOpen( filepath );
 
-      if( file == NULL )
+      if( file == NULL && espFsOpenResult() != ESPFS_OPEN_BUSY )
       {
          // file not found
          ESP_LOGE( TAG, "serveStaticFile file %s not found", filepath );
          // If this is a folder, look for index file
          file = tryOpenIndex( filepath );
-         if( file == NULL ) return HTTPD_CGI_NOTFOUND;
+      }
+      if( file == NULL )
+      {
+         if( espFsOpenResult() == ESPFS_OPEN_BUSY ) return espFsBusy( connData, filepath );
+         return HTTPD_CGI_NOTFOUND;
       }
 
       // The gzip checking code is intentionally without #ifdefs because checking
@@ -202,14 +329,21 @@ CgiStatus ICACHE_FLASH_ATTR serveStaticFile( HttpdConnData *connData, const char
       // mean additional overhead and is actually safer to be on at all times.
       // If there are no gzipped files in the image, the code bellow will not cause any harm.
 
+      if( espFsFlags( file ) & FLAG_TEMPLATE )
+      {
+         ESP_LOGE( TAG, "serveStaticFile: %s is a precompiled template, use cgiEspFsTemplate", filepath );
+         espFsClose( file );
+         return HTTPD_CGI_NOTFOUND;
+      }
+
       // Check if requested file was GZIP compressed
       isGzip = espFsFlags( file ) & FLAG_GZIP;
       if( isGzip )
       {
          // Check the browser's "Accept-Encoding" header. If the client does not
          // advertise that he accepts GZIP send a warning message ( telnet users for e.g. )
-         bool found = httpdGetHeader( connData, "Accept-Encoding", acceptEncodingBuffer, sizeof( acceptEncodingBuffer ) );
-         if( !found || ( strstr( acceptEncodingBuffer, "gzip" ) == NULL ) )
+         const char *acceptEncoding = httpdGetHeaderById( connData, HTTPD_HDR_ACCEPT_ENCODING );
+         if( acceptEncoding == NULL || ( strstr( acceptEncoding, "gzip" ) == NULL ) )
          {
             // No Accept-Encoding: gzip header present
             httpdSend( connData, gzipNonSupportedMessage, -1 );
@@ -218,25 +352,106 @@ CgiStatus ICACHE_FLASH_ATTR serveStaticFile( HttpdConnData *connData, const char
          }
       }
 
-      connData->cgiData = file;
-      httpdStartResponse( connData, responseCode );
+      size = espFsFileSize( file );
+      hash = ( responseCode == 200 ) ? espFsFileHash( file ) : 0;
+      etag[0] = 0;
+      if( hash != 0 ) espFsETag( etag, sizeof( etag ), hash );
+
+      // A byte range of the file, e.g. to resume an interrupted download. Ranges of gzip'ed
+      // files refer to the compressed data, which is the representation we send.
+      range = ( responseCode == 200 ) ? espFsGetRange( connData, size, etag, &first, &last ) : 0;
+      if( range > 0 && espFsSeek( file, first ) != first ) range = 0;
+      if( range < 0 )
+      {
+         ESP_LOGD( TAG, "%s range not satisfiable", filepath );
+         snprintf( buf, sizeof( buf ), "bytes */%d", size );
+         espFsClose( file );
+         httpdSetContentLength( connData, 0 );
+         httpdStartResponse( connData, 416 );
+         httpdHeader( connData, "Content-Range", buf );
+         httpdEndHeaders( connData );
+         return HTTPD_CGI_DONE;
+      }
+      if( range == 0 )
+      {
+         first = 0;
+         last = size - 1;
+      }
+
+      sfd = ( StaticFileData * )malloc( sizeof( StaticFileData ) );
+      if( sfd == NULL )
+      {
+         ESP_LOGE( TAG, "Out of memory" );
+         espFsClose( file );
+         return HTTPD_CGI_DONE;
+      }
+      sfd->file = file;
+      sfd->remaining = last - first + 1;
+      sfd->end = last + 1;
+      connData->cgiData = sfd;
+
+      httpdSetContentLength( connData, sfd->remaining );
+      httpdStartResponse( connData, ( range > 0 ) ? 206 : responseCode );
       const char *mime = httpdGetMimetype( filepath );
       httpdHeader( connData, "Content-Type", mime );
       if( isGzip )
       {
          httpdHeader( connData, "Content-Encoding", "gzip" );
       }
+      if( responseCode == 200 )
+      {
+         httpdHeader( connData, "Accept-Ranges", "bytes" );
+      }
+      if( range > 0 )
+      {
+         snprintf( buf, sizeof( buf ), "bytes %d-%d/%d", first, last, size );
+         httpdHeader( connData, "Content-Range", buf );
+      }
+      if( etag[0] != 0 )
+      {
+         httpdHeader( connData, "ETag", etag );
+      }
       httpdAddCacheHeaders( connData, mime );
       httpdEndHeaders( connData );
       return HTTPD_CGI_MORE;
    }
 
-   len = espFsRead( file, buf, FILE_CHUNK_LEN );
-   if( len > 0 ) httpdSend( connData, buf, len );
-   if( len != FILE_CHUNK_LEN )
+   // Uncompressed files of a memory mapped image are handed to the network stack in place,
+   // otherwise the file is read straight into the send buffer
+   const char *data;
+   len = ( sfd->remaining < HTTPD_MAX_SENDBUFF_LEN ) ? sfd->remaining : HTTPD_MAX_SENDBUFF_LEN;
+   len = espFsReadPtr( sfd->file, &data, len );
+   if( len > 0 )
+   {
+      if( !httpdSendSpan( connData, data, len ) )
+      {
+         // the span is not accepted, copy what fits into the send buffer and read the rest again
+         int n;
+         char *dst = httpdSendReserve( connData, &n );
+         if( n > len ) n = len;
+         memcpy( dst, data, n );
+         httpdSendCommit( connData, n );
+         if( n < len ) espFsSeek( sfd->file, sfd->end - sfd->remaining + n );
+         len = n;
+      }
+   }
+   else
+   {
+      char *dst = httpdSendReserve( connData, &len );
+      if( len > sfd->remaining ) len = sfd->remaining;
+      if( len > 0 )
+      {
+         len = espFsRead( sfd->file, dst, len );
+         if( len == 0 ) len = -1;   // file is shorter than announced
+      }
+      if( len > 0 ) httpdSendCommit( connData, len );
+   }
+   if( len > 0 ) sfd->remaining -= len;
+   if( len < 0 || sfd->remaining == 0 )
    {
       // We're done.
-      espFsClose( file );
+      espFsClose( sfd->file );
+      free( sfd );
       return HTTPD_CGI_DONE;
    }
    else
@@ -280,8 +495,9 @@ CgiStatus ICACHE_FLASH_ATTR cgiEspFsHook( HttpdConnData *connData )
 
 // cgiEspFsTemplate can be used as a template.
 
-// return value < 0 something goes wrong: -1 sendbuffer will overflow, discard data
-// otherwise return value gives the number of remaining free bytes in the send buffer
+// Send the value of a token with the encoding of the token. Returns the number of bytes of str
+// sent, < 0 on errors. If not all of it fits in the send buffer, the callback returns
+// HTTPD_CGI_MORE and sends the rest in the next call, see httpdSend_html().
 
 int ICACHE_FLASH_ATTR tplSend( HttpdConnData *connData, const char *str, int len )
 {
@@ -289,12 +505,19 @@ int ICACHE_FLASH_ATTR tplSend( HttpdConnData *connData, const char *str, int len
       return -2;
    TplData *tpd = connData->cgiData;
 
-   if( tpd == NULL || tpd->tokEncode == ENCODE_PLAIN ) return httpdSend( connData, str, len );
+   if( len < 0 ) len = strlen( str );
+   if( tpd == NULL || tpd->tokEncode == ENCODE_PLAIN ) return ( httpdSend( connData, str, len ) < 0 ) ? 0 : len;
    if( tpd->tokEncode == ENCODE_HTML ) return httpdSend_html( connData, str, len );
    if( tpd->tokEncode == ENCODE_JS ) return httpdSend_js( connData, str, len );
    return -3;
 }
 
+void ICACHE_FLASH_ATTR tplNoCache( HttpdConnData *connData )
+{
+   TplData *tpd = connData->cgiData;
+   if( tpd != NULL ) tpd->noCache = true;
+}
+
 CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplate( HttpdConnData *connData )
 {
    TplData *tpd = connData->cgiData;
@@ -302,23 +525,30 @@ CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplate( HttpdConnData *connData )
    if( connData->isConnectionClosed )
    {
       // Connection aborted. Clean up.
-      ( ( TplCallback )( connData->cgiArg ) )( connData, NULL, &tpd->tplArg );  // do some clean up
-      espFsClose( tpd->file );
-      free( tpd );
+      if( tpd != NULL )
+      {
+         ( ( TplCallback )( connData->cgiArg ) )( connData, NULL, &tpd->tplArg );  // do some clean up
+         tplFree( tpd );
+      }
       return HTTPD_CGI_DONE;
    }
 
    if( tpd == NULL )
    {
       // First call to this cgi. Open the file so we can read it.
-      tpd = ( TplData * ) malloc( sizeof( TplData ) );
+      tpd = ( TplData * )httpdArenaAlloc( connData, sizeof( TplData ) );
       if( tpd == NULL )
       {
-         ESP_LOGE( TAG, "Failed to malloc tpl struct" );
+         ESP_LOGE( TAG, "Failed to allocate tpl struct" );
          return HTTPD_CGI_NOTFOUND;
       }
 
       tpd->chunk_resume = false;
+      tpd->tokOffs = NULL;
+      tpd->tokEncode = ENCODE_PLAIN;
+      tpd->cache = false;
+      tpd->noCache = false;
+      tpd->replay = NULL;
 
       const char *filepath = connData->url;
       // check for custom template URL
@@ -330,16 +560,15 @@ CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplate( HttpdConnData *connData )
 
       tpd->file = espFsOpen( filepath );
 
-      if( tpd->file == NULL )
+      if( tpd->file == NULL && espFsOpenResult() != ESPFS_OPEN_BUSY )
       {
          // maybe a folder, look for index file
          tpd->file = tryOpenIndex( filepath );
-         if( tpd->file == NULL )
-         {
-            espFsClose( tpd->file );
-            free( tpd );
-            return HTTPD_CGI_NOTFOUND;
-         }
+      }
+      if( tpd->file == NULL )
+      {
+         if( espFsOpenResult() == ESPFS_OPEN_BUSY ) return espFsBusy( connData, filepath );
+         return HTTPD_CGI_NOTFOUND;
       }
 
       tpd->tplArg = NULL;
@@ -349,7 +578,13 @@ CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplate( HttpdConnData *connData )
       {
          ESP_LOGE( TAG, "cgiEspFsTemplate: Trying to use gzip-compressed file %s as template.", connData->url );
          espFsClose( tpd->file );
-         free( tpd );
+         return HTTPD_CGI_NOTFOUND;
+      }
+
+      if( ( espFsFlags( tpd->file ) & FLAG_TEMPLATE ) && !tplLoadTokens( connData, tpd ) )
+      {
+         ESP_LOGE( TAG, "cgiEspFsTemplate: broken precompiled template %s", connData->url );
+         tplFree( tpd );
          return HTTPD_CGI_NOTFOUND;
       }
 
@@ -362,9 +597,129 @@ CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplate( HttpdConnData *connData )
       return HTTPD_CGI_MORE;
    }
 
+   if( tpd->tokOffs != NULL )
+      return cgiTemplateSendCompiled( connData );
    return cgiTemplateSendContent( connData );
 }
 
+// --------------------------------------------------------------------------
+// precompiled templates
+// --------------------------------------------------------------------------
+
+// tpd itself and the token table are in the request arena
+static void ICACHE_FLASH_ATTR tplFree( TplData *tpd )
+{
+   espFsClose( tpd->file );
+   renderCacheRelease( tpd->replay );
+}
+
+// The template is sent completely, clean up and keep the body if it was recorded
+static CgiStatus ICACHE_FLASH_ATTR tplFinish( HttpdConnData *connData, TplData *tpd )
+{
+   ( ( TplCallback )( connData->cgiArg ) )( connData, NULL, &tpd->tplArg );  // do some clean up
+   ESP_LOGD( TAG, "Template sent" );
+
+   if( tpd->cache )
+   {
+      int len;
+      char *body = httpdCaptureEnd( connData, &len );
+      if( body != NULL && !tpd->noCache )
+         renderCachePut( connData->url, tpd->cacheGen, body, len );
+      else
+         free( body );
+   }
+   tplFree( tpd );
+   return HTTPD_CGI_DONE;
+}
+
+// Read the token table at the start of a precompiled template
+static bool ICACHE_FLASH_ATTR tplLoadTokens( HttpdConnData *connData, TplData *tpd )
+{
+   uint16_t hdr[2];     // token count, table size
+   int i, pos;
+
+   if( espFsRead( tpd->file, ( char * )hdr, sizeof( hdr ) ) != sizeof( hdr ) ) return false;
+
+   // offsets first, they need the alignment
+   tpd->tokOffs = ( uint16_t * )httpdArenaAlloc( connData, hdr[0] * sizeof( uint16_t ) + hdr[1] );
+   if( tpd->tokOffs == NULL ) return false;
+   tpd->tokTable = ( char * )( tpd->tokOffs + hdr[0] );
+   tpd->tokCount = hdr[0];
+   tpd->litLen = 0;
+   if( espFsRead( tpd->file, tpd->tokTable, hdr[1] ) != hdr[1] ) return false;
+
+   // each entry is the encoding followed by the zero terminated name
+   pos = 0;
+   for( i = 0; i < tpd->tokCount; i++ )
+   {
+      char *end;
+      if( pos + 1 >= hdr[1] ) return false;
+      end = memchr( tpd->tokTable + pos + 1, 0, hdr[1] - pos - 1 );
+      if( end == NULL ) return false;
+      tpd->tokOffs[i] = pos;
+      pos = end + 1 - tpd->tokTable;
+   }
+   return true;
+}
+
+// The template is a sequence of literal text and token ids. Literals are read straight into
+// the send buffer, tokens are handed to the callback by the name from the token table.
+static CgiStatus ICACHE_FLASH_ATTR cgiTemplateSendCompiled( HttpdConnData *connData )
+{
+   TplData *tpd = connData->cgiData;
+   uint16_t rec;
+   char *dst;
+   int len;
+
+   while( 1 )
+   {
+      if( tpd->chunk_resume )
+      {
+         // leave the callback at least half of the send buffer
+         httpdSendReserve( connData, &len );
+         if( len < HTTPD_MAX_SENDBUFF_LEN / 2 ) return HTTPD_CGI_MORE;
+
+         char *token = tpd->tokTable + tpd->tokOffs[tpd->tokId];
+         tpd->tokEncode = ( TplEncode )token[0];
+         CgiStatus status = ( ( TplCallback )( connData->cgiArg ) )( connData, token + 1, &tpd->tplArg );
+         tpd->tokEncode = ENCODE_PLAIN;
+         if( status == HTTPD_CGI_MORE )
+         {
+            // wants to send more in this token's place
+            return HTTPD_CGI_MORE;
+         }
+         tpd->chunk_resume = false;
+      }
+      else if( tpd->litLen > 0 )
+      {
+         dst = httpdSendReserve( connData, &len );
+         if( len == 0 ) return HTTPD_CGI_MORE;
+         if( len > tpd->litLen ) len = tpd->litLen;
+         len = espFsRead( tpd->file, dst, len );
+         if( len <= 0 ) break;   // truncated template
+         httpdSendCommit( connData, len );
+         tpd->litLen -= len;
+      }
+      else
+      {
+         if( espFsRead( tpd->file, ( char * )&rec, sizeof( rec ) ) != sizeof( rec ) ) break;  // end of template
+         if( rec & TPL_REC_TOKEN )
+         {
+            tpd->tokId = rec & ~TPL_REC_TOKEN;
+            if( tpd->tokId >= tpd->tokCount ) break;
+            tpd->chunk_resume = true;
+         }
+         else
+         {
+            tpd->litLen = rec;
+         }
+      }
+   }
+
+   // We're done.
+   return tplFinish( connData, tpd );
+}
+
 // --------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------
@@ -493,7 +848,7 @@ static CgiStatus ICACHE_FLASH_ATTR cgiTemplateSendContent( HttpdConnData* connDa
             {
                // Add char to the token buf
                char c = buf[x];
-               bool outOfSpace = tpd->tokenPos >= ( sizeof( tpd->token ) - 1 );
+               bool outOfSpace = tpd->tokenPos >= ( int )sizeof( tpd->token ) - 1;
                if( outOfSpace ||
                      ( !( c >= 'a' && c <= 'z' ) &&
                        !( c >= 'A' && c <= 'Z' ) &&
@@ -534,11 +889,7 @@ static CgiStatus ICACHE_FLASH_ATTR cgiTemplateSendContent( HttpdConnData* connDa
    if( len != FILE_CHUNK_LEN )
    {
       // We're done.
-      ( ( TplCallback )( connData->cgiArg ) )( connData, NULL, &tpd->tplArg );  // do some clean up
-      ESP_LOGD( TAG, "Template sent" );
-      espFsClose( tpd->file );
-      free( tpd );
-      return HTTPD_CGI_DONE;
+      return tplFinish( connData, tpd );
    }
    else
    {
@@ -546,3 +897,79 @@ static CgiStatus ICACHE_FLASH_ATTR cgiTemplateSendContent( HttpdConnData* connDa
       return HTTPD_CGI_MORE;
    }
 }
+
+// --------------------------------------------------------------------------
+// render cache
+// --------------------------------------------------------------------------
+
+CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplateCached( HttpdConnData *connData )
+{
+   TplData *tpd = connData->cgiData;
+   RenderCacheEntry *entry;
+   char *dst;
+   int len;
+
+   if( tpd == NULL && !connData->isConnectionClosed )
+   {
+      entry = renderCacheGet( connData->url );
+      if( entry == NULL )
+      {
+         // render the page and record the body for the next request
+         CgiStatus status = cgiEspFsTemplate( connData );
+         tpd = connData->cgiData;
+         if( status == HTTPD_CGI_MORE && tpd != NULL )
+         {
+            tpd->cacheGen = renderCacheGeneration();
+            tpd->cache = httpdCaptureStart( connData, RENDER_CACHE_SIZE );
+         }
+         return status;
+      }
+
+      tpd = ( TplData * )httpdArenaAlloc( connData, sizeof( TplData ) );
+      if( tpd == NULL )
+      {
+         ESP_LOGE( TAG, "Failed to allocate tpl struct" );
+         renderCacheRelease( entry );
+         return HTTPD_CGI_NOTFOUND;
+      }
+      tpd->file = NULL;
+      tpd->tokOffs = NULL;
+      tpd->replay = entry;
+      tpd->replayPos = 0;
+
+      connData->cgiData = tpd;
+      httpdSetContentLength( connData, entry->len );
+      httpdStartResponse( connData, 200 );
+      const char *mime = httpdGetMimetype( connData->url );
+      httpdHeader( connData, "Content-Type", mime );
+      httpdAddCacheHeaders( connData, mime );
+      httpdEndHeaders( connData );
+      return HTTPD_CGI_MORE;
+   }
+
+   if( tpd == NULL || tpd->replay == NULL )
+   {
+      return cgiEspFsTemplate( connData );
+   }
+
+   // send the cached body
+   if( connData->isConnectionClosed )
+   {
+      tplFree( tpd );
+      return HTTPD_CGI_DONE;
+   }
+
+   entry = tpd->replay;
+   dst = httpdSendReserve( connData, &len );
+   if( len > entry->len - tpd->replayPos ) len = entry->len - tpd->replayPos;
+   memcpy( dst, entry->data + tpd->replayPos, len );
+   httpdSendCommit( connData, len );
+   tpd->replayPos += len;
+   if( tpd->replayPos < entry->len )
+   {
+      return HTTPD_CGI_MORE;
+   }
+
+   tplFree( tpd );
+   return HTTPD_CGI_DONE;
+}
@@ -0,0 +1,281 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          httpdmetrics.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Request metrics of the web server, see httpdmetrics.h
+*/
+
+#ifdef CONFIG_ESPHTTPD_METRICS
+
+// --------------------------------------------------------------------------
+// debug support
+// --------------------------------------------------------------------------
+
+#define LOG_LOCAL_LEVEL    ESP_LOG_WARN
+static const char *TAG = "httpdmetrics";
+#include "esp_log.h"
+#define S( str ) ( str == NULL ? "<null>": str )
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#ifdef linux
+   #include <libesphttpd/linux.h>
+   #include <time.h>
+#else
+   #include <libesphttpd/esp.h>
+#endif
+
+#include <stddef.h>  // offsetof()
+
+#include "libesphttpd/httpd.h"
+#include "libesphttpd/httpdmetrics.h"
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+HttpdMetrics httpdMetrics;
+
+static const uint32_t latencyBounds[HTTPD_METRICS_NBUCKETS] = HTTPD_METRICS_BUCKETS;
+
+uint32_t ICACHE_FLASH_ATTR httpdMetricsNow( void )
+{
+#ifdef linux
+   struct timespec ts;
+   clock_gettime( CLOCK_MONOTONIC, &ts );
+   return ( uint32_t )ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#else
+   return system_get_time();
+#endif
+}
+
+// the per route counters, allocated when the first request is done
+static HttpdRouteMetrics* ICACHE_FLASH_ATTR httpdMetricsRoutes( HttpdInstance *pInstance )
+{
+   int n;
+
+   if( httpdMetrics.route != NULL || httpdMetrics.routes != NULL )
+      return httpdMetrics.route;
+
+   for( n = 0; pInstance->builtInUrls[n].url != NULL; n++ )
+      ;
+
+   httpdMetrics.routes = pInstance->builtInUrls;
+   httpdMetrics.route = calloc( n + 1, sizeof( HttpdRouteMetrics ) );
+   if( httpdMetrics.route == NULL )
+   {
+      ESP_LOGE( TAG, "no memory for the counters of %d routes", n );
+      return NULL;
+   }
+   httpdMetrics.numRoutes = n;
+   return httpdMetrics.route;
+}
+
+void ICACHE_FLASH_ATTR httpdMetricsDone( HttpdInstance *pInstance, HttpdConnData *connData )
+{
+   HttpdPriv *priv = connData->priv;
+   HttpdRouteMetrics *route = httpdMetricsRoutes( pInstance );
+   uint32_t time = httpdMetricsNow() - priv->reqStart;
+   int i;
+
+   if( priv->requests == 0 )
+      return;  // not a request, e.g. a websocket closing
+
+   httpdMetrics.requests++;
+   httpdMetrics.time += time;
+   if( priv->status >= 100 && priv->status < 600 )
+      httpdMetrics.status[priv->status / 100 - 1]++;
+
+   for( i = 0; i < HTTPD_METRICS_NBUCKETS && time > latencyBounds[i]; i++ )
+      ;
+   httpdMetrics.latency[i]++;
+
+   if( route != NULL && priv->route <= httpdMetrics.numRoutes )
+   {
+      route += priv->route;
+      route->requests++;
+      // the last part of the response is still in the send buffer
+      route->bytes += priv->txBytes + priv->sendBuffLen + priv->sendSpanLen;
+      route->time += time;
+   }
+}
+
+// --------------------------------------------------------------------------
+// Prometheus text format
+// --------------------------------------------------------------------------
+
+static const char * const routeFamily[][3] =
+{
+   { "httpd_requests_total", "counter", "Requests by route." },
+   { "httpd_request_seconds_total", "counter", "Time spent in requests by route." },
+   { "httpd_sent_bytes_total", "counter", "Bytes sent by route, including headers." },
+};
+
+#define ROUTE_FAMILIES  ( sizeof( routeFamily ) / sizeof( routeFamily[0] ) )
+
+static const struct
+{
+   const char *name;
+   const char *help;
+   int offset;
+} eventCounter[] =
+{
+   { "httpd_send_overflows_total", "Data discarded, the send buffer was full.", offsetof( HttpdMetrics, sendOverflows ) },
+   { "httpd_backlog_overflows_total", "Data dropped, the send backlog was full.", offsetof( HttpdMetrics, backlogOverflows ) },
+   { "httpd_connections_refused_total", "Connections refused, no free connection.", offsetof( HttpdMetrics, refused ) },
+   { "httpd_connections_evicted_total", "Connections closed to make room.", offsetof( HttpdMetrics, evicted ) },
+   { "httpd_requests_parked_total", "Requests which waited for a free connection.", offsetof( HttpdMetrics, parked ) },
+   { "httpd_requests_rejected_total", "Requests answered with 503.", offsetof( HttpdMetrics, rejected ) },
+};
+
+#define EVENT_COUNTERS  ( sizeof( eventCounter ) / sizeof( eventCounter[0] ) )
+
+static void ICACHE_FLASH_ATTR metricsFamily( HttpdConnData *connData, const char *name, const char *type, const char *help )
+{
+   char buf[192];
+   snprintf( buf, sizeof( buf ), "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type );
+   httpdSend( connData, buf, -1 );
+}
+
+// seconds with microsecond resolution
+static void ICACHE_FLASH_ATTR metricsSeconds( char *buf, int len, uint64_t usec )
+{
+   snprintf( buf, len, "%u.%06u", ( unsigned int )( usec / 1000000 ), ( unsigned int )( usec % 1000000 ) );
+}
+
+// one line of a route family, i is the route index
+static void ICACHE_FLASH_ATTR metricsRouteLine( HttpdConnData *connData, int family, int i )
+{
+   HttpdRouteMetrics *route = &httpdMetrics.route[i];
+   const char *url = ( i < httpdMetrics.numRoutes ) ? httpdMetrics.routes[i].url : "404";
+   char val[24];
+   char buf[128];
+
+   if( family == 0 )
+      snprintf( val, sizeof( val ), "%u", ( unsigned int )route->requests );
+   else if( family == 1 )
+      metricsSeconds( val, sizeof( val ), route->time );
+   else
+      snprintf( val, sizeof( val ), "%u", ( unsigned int )route->bytes );
+
+   snprintf( buf, sizeof( buf ), "%s{index=\"%d\",route=\"%s\"} %s\n", routeFamily[family][0], i, url, val );
+   httpdSend( connData, buf, -1 );
+}
+
+static void ICACHE_FLASH_ATTR metricsLatency( HttpdConnData *connData )
+{
+   char buf[96];
+   char val[24];
+   uint32_t count = 0;
+   int i;
+
+   metricsFamily( connData, "httpd_request_duration_seconds", "histogram", "Time from the request line to the end of the response." );
+   for( i = 0; i <= HTTPD_METRICS_NBUCKETS; i++ )
+   {
+      count += httpdMetrics.latency[i];
+      if( i < HTTPD_METRICS_NBUCKETS )
+         metricsSeconds( val, sizeof( val ), latencyBounds[i] );
+      else
+         strcpy( val, "+Inf" );
+      snprintf( buf, sizeof( buf ), "httpd_request_duration_seconds_bucket{le=\"%s\"} %u\n", val, ( unsigned int )count );
+      httpdSend( connData, buf, -1 );
+   }
+   metricsSeconds( val, sizeof( val ), httpdMetrics.time );
+   snprintf( buf, sizeof( buf ), "httpd_request_duration_seconds_sum %s\n", val );
+   httpdSend( connData, buf, -1 );
+   snprintf( buf, sizeof( buf ), "httpd_request_duration_seconds_count %u\n", ( unsigned int )httpdMetrics.requests );
+   httpdSend( connData, buf, -1 );
+}
+
+static void ICACHE_FLASH_ATTR metricsStatus( HttpdConnData *connData )
+{
+   char buf[64];
+   int i;
+
+   metricsFamily( connData, "httpd_responses_total", "counter", "Responses by status class." );
+   for( i = 0; i < 5; i++ )
+   {
+      snprintf( buf, sizeof( buf ), "httpd_responses_total{code=\"%dxx\"} %u\n", i + 1, ( unsigned int )httpdMetrics.status[i] );
+      httpdSend( connData, buf, -1 );
+   }
+}
+
+static void ICACHE_FLASH_ATTR metricsEvents( HttpdConnData *connData )
+{
+   char buf[64];
+   unsigned int i;
+
+   for( i = 0; i < EVENT_COUNTERS; i++ )
+   {
+      metricsFamily( connData, eventCounter[i].name, "counter", eventCounter[i].help );
+      snprintf( buf, sizeof( buf ), "%s %u\n", eventCounter[i].name,
+                ( unsigned int )*( uint32_t * )( ( char * )&httpdMetrics + eventCounter[i].offset ) );
+      httpdSend( connData, buf, -1 );
+   }
+}
+
+// Send the counters. The output is produced in steps, as many as fit into the send buffer per
+// call: for each route family the header and one line per route, then the histogram, the
+// status classes and the event counters. cgiData keeps the step and, in the upper half, the
+// number of route lines at the start.
+CgiStatus ICACHE_FLASH_ATTR cgiMetrics( HttpdConnData *connData )
+{
+   int step = ( int )( intptr_t )connData->cgiData & 0xffff;
+   int lines = ( int )( intptr_t )connData->cgiData >> 16;
+
+   if( connData->isConnectionClosed ) return HTTPD_CGI_DONE;
+
+   if( connData->cgiData == NULL )
+   {
+      lines = ( httpdMetrics.route != NULL ) ? httpdMetrics.numRoutes + 1 : 0;
+
+      httpdStartResponse( connData, 200 );
+      httpdHeader( connData, "Content-Type", "text/plain; version=0.0.4" );
+      httpdHeader( connData, "Cache-Control", "no-cache" );
+      httpdEndHeaders( connData );
+   }
+
+   int routeSteps = ROUTE_FAMILIES * ( lines + 1 );
+   while( step < routeSteps + 3 )
+   {
+      int need = ( step < routeSteps ) ? 160 : 1280;
+      if( httpdSend( connData, NULL, 0 ) < need )
+         break;
+
+      if( step < routeSteps )
+      {
+         int family = step / ( lines + 1 );
+         int line = step % ( lines + 1 );
+         if( line == 0 )
+            metricsFamily( connData, routeFamily[family][0], routeFamily[family][1], routeFamily[family][2] );
+         else
+            metricsRouteLine( connData, family, line - 1 );
+      }
+      else if( step == routeSteps )
+         metricsLatency( connData );
+      else if( step == routeSteps + 1 )
+         metricsStatus( connData );
+      else
+         metricsEvents( connData );
+      step++;
+   }
+
+   connData->cgiData = ( void * )( intptr_t )( step | lines << 16 );
+   return ( step < routeSteps + 3 ) ? HTTPD_CGI_MORE : HTTPD_CGI_DONE;
+}
+
+#endif // CONFIG_ESPHTTPD_METRICS
@@ -0,0 +1,657 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          postparser.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Incremental parsers for urlencoded, multipart and JSON POST bodies, see postparser.h
+*/
+
+// --------------------------------------------------------------------------
+// debug support
+// --------------------------------------------------------------------------
+
+#define LOG_LOCAL_LEVEL    ESP_LOG_WARN
+static const char *TAG = "postparser";
+#include "esp_log.h"
+#define S( str ) ( str == NULL ? "<null>": str )
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#ifdef linux
+   #include <libesphttpd/linux.h>
+#else
+   #include <libesphttpd/esp.h>
+#endif
+
+#include "libesphttpd/postparser.h"
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+enum
+{
+   // application/x-www-form-urlencoded
+   UE_NAME,
+   UE_VALUE,
+
+   // multipart/form-data
+   MP_PREAMBLE,         // skip everything up to the first delimiter
+   MP_DELIM_END,        // after a delimiter, "--" ends the body, CR LF starts a part
+   MP_HEADERS,          // header lines of a part
+   MP_DATA,             // content of a part
+   MP_END,              // skip the epilogue
+
+   // application/json
+   JS_VALUE,
+   JS_VALUE_OR_END,     // first value of an array or ']'
+   JS_KEY_OR_END,       // first key of an object or '}'
+   JS_KEY_START,
+   JS_KEY,
+   JS_COLON,
+   JS_STRING,
+   JS_LITERAL,          // number, true, false, null
+   JS_AFTER_VALUE       // ',' or the end of the container, at depth 0 the end of the body
+};
+
+// --------------------------------------------------------------------------
+// common helpers
+// --------------------------------------------------------------------------
+
+static int ICACHE_FLASH_ATTR postHexVal( char c )
+{
+   if( c >= '0' && c <= '9' ) return c - '0';
+   if( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+   if( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+   return 0;
+}
+
+// pass a piece of the current value to the callback
+static int ICACHE_FLASH_ATTR postEmit( HttpdPostParser *pp, const char *data, int len, bool last )
+{
+   if( len == 0 && !last ) return 0;
+
+   int flags = ( pp->first ? HTTPD_POST_FIRST : 0 ) | ( last ? HTTPD_POST_LAST : 0 );
+   pp->first = last;
+   if( pp->cb( pp, data, len, flags ) < 0 )
+   {
+      ESP_LOGD( TAG, "stopped by callback at field %s", pp->name );
+      pp->error = HTTPD_POST_ERR_ABORT;
+   }
+   return pp->error;
+}
+
+static void ICACHE_FLASH_ATTR postValPut( HttpdPostParser *pp, char c )
+{
+   pp->val[pp->valLen++] = c;
+   if( pp->valLen == HTTPD_POST_VALUE_LEN )
+   {
+      pp->valLen = 0;
+      postEmit( pp, pp->val, HTTPD_POST_VALUE_LEN, false );
+   }
+}
+
+static void ICACHE_FLASH_ATTR postValEnd( HttpdPostParser *pp )
+{
+   int len = pp->valLen;
+   pp->valLen = 0;
+   postEmit( pp, pp->val, len, true );
+}
+
+static void ICACHE_FLASH_ATTR postNamePut( HttpdPostParser *pp, char c )
+{
+   if( pp->nameLen < HTTPD_POST_NAME_LEN - 1 )
+   {
+      pp->name[pp->nameLen++] = c;
+      pp->name[pp->nameLen] = 0;
+   }
+}
+
+static void ICACHE_FLASH_ATTR postNameReset( HttpdPostParser *pp, int len )
+{
+   pp->nameLen = len;
+   pp->name[len] = 0;
+}
+
+// --------------------------------------------------------------------------
+// application/x-www-form-urlencoded
+// --------------------------------------------------------------------------
+
+static void ICACHE_FLASH_ATTR postUrlChar( HttpdPostParser *pp, char c )
+{
+   if( pp->state == UE_NAME )
+      postNamePut( pp, c );
+   else
+      postValPut( pp, c );
+}
+
+// end of a field at '&' or at the end of the body, empty fields are skipped
+static void ICACHE_FLASH_ATTR postUrlField( HttpdPostParser *pp )
+{
+   if( pp->state == UE_VALUE || pp->nameLen > 0 ) postValEnd( pp );
+   pp->state = UE_NAME;
+   pp->esc = 0;
+   postNameReset( pp, 0 );
+}
+
+static void ICACHE_FLASH_ATTR postUrlencoded( HttpdPostParser *pp, const char *data, int len )
+{
+   for( int i = 0; i < len && pp->error == 0; i++ )
+   {
+      char c = data[i];
+
+      if( pp->esc == 1 )
+      {
+         pp->escVal = postHexVal( c ) << 4;
+         pp->esc = 2;
+      }
+      else if( pp->esc == 2 )
+      {
+         postUrlChar( pp, pp->escVal + postHexVal( c ) );
+         pp->esc = 0;
+      }
+      else if( c == '%' )
+         pp->esc = 1;
+      else if( c == '+' )
+         postUrlChar( pp, ' ' );
+      else if( c == '&' )
+         postUrlField( pp );
+      else if( c == '=' && pp->state == UE_NAME )
+         pp->state = UE_VALUE;
+      else
+         postUrlChar( pp, c );
+   }
+}
+
+// --------------------------------------------------------------------------
+// multipart/form-data
+// --------------------------------------------------------------------------
+
+// copy the value of a parameter like name="value" from a Content-Disposition header line
+static void ICACHE_FLASH_ATTR postMultipartParam( const char *line, const char *param, char *out )
+{
+   int plen = strlen( param );
+
+   out[0] = 0;
+   for( const char *p = line; *p != 0; p++ )
+   {
+      if( ( p[-1] == ' ' || p[-1] == ';' ) && strncasecmp( p, param, plen ) == 0 && p[plen] == '=' )
+      {
+         char end = ';';
+         int n = 0;
+
+         p += plen + 1;
+         if( *p == '"' )
+         {
+            end = '"';
+            p++;
+         }
+         while( *p != 0 && *p != end && n < HTTPD_POST_NAME_LEN - 1 ) out[n++] = *p++;
+         out[n] = 0;
+         return;
+      }
+   }
+}
+
+// a header line of a part is complete, an empty line starts the content
+static void ICACHE_FLASH_ATTR postMultipartHeader( HttpdPostParser *pp )
+{
+   if( pp->valLen == 0 )
+   {
+      ESP_LOGD( TAG, "part %s, file %s", pp->name, pp->filename );
+      pp->state = MP_DATA;
+      pp->first = true;
+      return;
+   }
+
+   pp->val[pp->valLen] = 0;
+   if( strncasecmp( pp->val, "Content-Disposition:", 20 ) == 0 )
+   {
+      postMultipartParam( pp->val + 20, "name", pp->name );
+      postMultipartParam( pp->val + 20, "filename", pp->filename );
+      pp->nameLen = strlen( pp->name );
+   }
+   pp->valLen = 0;
+}
+
+// The content of a part is passed to the callback directly from data. Bytes which might be the
+// start of the delimiter are held back, if they turn out to be content they are passed from
+// pp->delim. The delimiter starts with CR LF and the boundary contains no CR, so after a
+// mismatch the search can simply start again.
+
+static void ICACHE_FLASH_ATTR postMultipart( HttpdPostParser *pp, const char *data, int len )
+{
+   int start = -1;      // start of content in data, which is not yet passed to the callback
+
+   for( int i = 0; i < len && pp->error == 0; i++ )
+   {
+      char c = data[i];
+
+      switch( pp->state )
+      {
+         case MP_PREAMBLE:
+         case MP_DATA:
+            if( c == pp->delim[pp->match] )
+            {
+               if( pp->match == 0 && start >= 0 && pp->state == MP_DATA )
+                  postEmit( pp, data + start, i - start, false );
+               start = -1;
+
+               if( ++pp->match == pp->delimLen )
+               {
+                  if( pp->state == MP_DATA ) postEmit( pp, NULL, 0, true );
+                  pp->state = MP_DELIM_END;
+                  pp->match = 0;
+                  pp->esc = 0;
+               }
+               break;
+            }
+
+            if( pp->match > 0 )
+            {
+               // the bytes held back are content
+               if( pp->state == MP_DATA ) postEmit( pp, pp->delim, pp->match, false );
+               pp->match = 0;
+               if( c == pp->delim[0] )
+               {
+                  pp->match = 1;
+                  break;
+               }
+            }
+            if( start < 0 ) start = i;
+            break;
+
+         case MP_DELIM_END:
+            if( c == '-' )
+            {
+               if( ++pp->esc == 2 ) pp->state = MP_END;
+            }
+            else if( c == '\n' )
+            {
+               pp->state = MP_HEADERS;
+               pp->valLen = 0;
+               pp->filename[0] = 0;
+               postNameReset( pp, 0 );
+            }
+            else if( c != '\r' && c != ' ' && c != '\t' )
+            {
+               pp->error = HTTPD_POST_ERR_SYNTAX;
+            }
+            break;
+
+         case MP_HEADERS:
+            if( c == '\n' )
+               postMultipartHeader( pp );
+            else if( c != '\r' && pp->valLen < HTTPD_POST_VALUE_LEN - 1 )
+               pp->val[pp->valLen++] = c;    // longer lines are truncated
+            break;
+
+         default:
+            i = len;    // the epilogue is ignored
+            break;
+      }
+   }
+
+   if( start >= 0 && pp->state == MP_DATA && pp->error == 0 )
+      postEmit( pp, data + start, len - start, false );
+}
+
+// --------------------------------------------------------------------------
+// application/json
+// --------------------------------------------------------------------------
+
+// name of the current array element: "<array name>[<index>]"
+static void ICACHE_FLASH_ATTR postJsonIndex( HttpdPostParser *pp )
+{
+   int base = pp->pathLen[pp->depth - 1];
+   int n = base + snprintf( pp->name + base, HTTPD_POST_NAME_LEN - base, "[%d]", pp->index[pp->depth - 1] );
+   postNameReset( pp, n < HTTPD_POST_NAME_LEN ? n : HTTPD_POST_NAME_LEN - 1 );
+}
+
+static void ICACHE_FLASH_ATTR postJsonPush( HttpdPostParser *pp, bool array )
+{
+   if( pp->depth == HTTPD_POST_JSON_DEPTH )
+   {
+      ESP_LOGW( TAG, "json nested too deep" );
+      pp->error = HTTPD_POST_ERR_SYNTAX;
+      return;
+   }
+
+   pp->pathLen[pp->depth] = pp->nameLen;
+   pp->index[pp->depth] = array ? 0 : 0xffff;
+   pp->depth++;
+   if( array ) postJsonIndex( pp );
+}
+
+static void ICACHE_FLASH_ATTR postJsonPop( HttpdPostParser *pp, char c )
+{
+   if( pp->depth == 0 || ( c == ']' ) != ( pp->index[pp->depth - 1] != 0xffff ) )
+   {
+      pp->error = HTTPD_POST_ERR_SYNTAX;
+      return;
+   }
+
+   pp->depth--;
+   postNameReset( pp, pp->pathLen[pp->depth] );
+   pp->state = JS_AFTER_VALUE;
+}
+
+// add a character of a key or string value
+static void ICACHE_FLASH_ATTR postJsonPut( HttpdPostParser *pp, char c )
+{
+   if( pp->state == JS_KEY )
+      postNamePut( pp, c );
+   else
+      postValPut( pp, c );
+}
+
+static void ICACHE_FLASH_ATTR postJsonString( HttpdPostParser *pp, char c )
+{
+   if( pp->esc >= 2 )
+   {
+      // \uxxxx, encoded as UTF-8. Surrogate pairs are not combined.
+      pp->escVal = ( pp->escVal << 4 ) | postHexVal( c );
+      if( ++pp->esc == 6 )
+      {
+         uint16_t u = pp->escVal;
+         if( u < 0x80 )
+         {
+            postJsonPut( pp, u );
+         }
+         else if( u < 0x800 )
+         {
+            postJsonPut( pp, 0xc0 | ( u >> 6 ) );
+            postJsonPut( pp, 0x80 | ( u & 0x3f ) );
+         }
+         else
+         {
+            postJsonPut( pp, 0xe0 | ( u >> 12 ) );
+            postJsonPut( pp, 0x80 | ( ( u >> 6 ) & 0x3f ) );
+            postJsonPut( pp, 0x80 | ( u & 0x3f ) );
+         }
+         pp->esc = 0;
+      }
+   }
+   else if( pp->esc == 1 )
+   {
+      pp->esc = 0;
+      switch( c )
+      {
+         case 'b':   postJsonPut( pp, '\b' ); break;
+         case 'f':   postJsonPut( pp, '\f' ); break;
+         case 'n':   postJsonPut( pp, '\n' ); break;
+         case 'r':   postJsonPut( pp, '\r' ); break;
+         case 't':   postJsonPut( pp, '\t' ); break;
+         case 'u':   pp->esc = 2; pp->escVal = 0; break;
+         default:    postJsonPut( pp, c );    break;   // \" \\ \/
+      }
+   }
+   else if( c == '\\' )
+   {
+      pp->esc = 1;
+   }
+   else if( c == '"' )
+   {
+      if( pp->state == JS_KEY )
+      {
+         pp->state = JS_COLON;
+      }
+      else
+      {
+         postValEnd( pp );
+         pp->state = JS_AFTER_VALUE;
+      }
+   }
+   else
+   {
+      postJsonPut( pp, c );
+   }
+}
+
+static bool ICACHE_FLASH_ATTR postJsonIsLiteral( char c )
+{
+   return ( c >= '0' && c <= '9' ) || ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' )
+          || c == '-' || c == '+' || c == '.';
+}
+
+static void ICACHE_FLASH_ATTR postJson( HttpdPostParser *pp, const char *data, int len )
+{
+   for( int i = 0; i < len && pp->error == 0; i++ )
+   {
+      char c = data[i];
+      bool ws = ( c == ' ' || c == '\t' || c == '\r' || c == '\n' );
+
+      switch( pp->state )
+      {
+         case JS_VALUE_OR_END:
+            if( ws ) break;
+            if( c == ']' )
+            {
+               postJsonPop( pp, c );
+               break;
+            }
+            pp->state = JS_VALUE;
+            // fall through
+
+         case JS_VALUE:
+            if( ws ) break;
+            if( c == '{' )
+            {
+               postJsonPush( pp, false );
+               pp->state = JS_KEY_OR_END;
+            }
+            else if( c == '[' )
+            {
+               postJsonPush( pp, true );
+               pp->state = JS_VALUE_OR_END;
+            }
+            else if( c == '"' )
+            {
+               pp->first = true;
+               pp->state = JS_STRING;
+            }
+            else if( postJsonIsLiteral( c ) )
+            {
+               pp->first = true;
+               pp->state = JS_LITERAL;
+               postValPut( pp, c );
+            }
+            else
+            {
+               pp->error = HTTPD_POST_ERR_SYNTAX;
+            }
+            break;
+
+         case JS_KEY_OR_END:
+            if( ws ) break;
+            if( c == '}' )
+            {
+               postJsonPop( pp, c );
+               break;
+            }
+            pp->state = JS_KEY_START;
+            // fall through
+
+         case JS_KEY_START:
+            if( ws ) break;
+            if( c != '"' )
+            {
+               pp->error = HTTPD_POST_ERR_SYNTAX;
+               break;
+            }
+            // name of the member: "<object name>.<key>"
+            postNameReset( pp, pp->pathLen[pp->depth - 1] );
+            if( pp->nameLen > 0 ) postNamePut( pp, '.' );
+            pp->state = JS_KEY;
+            break;
+
+         case JS_KEY:
+         case JS_STRING:
+            postJsonString( pp, c );
+            break;
+
+         case JS_COLON:
+            if( ws ) break;
+            if( c == ':' )
+               pp->state = JS_VALUE;
+            else
+               pp->error = HTTPD_POST_ERR_SYNTAX;
+            break;
+
+         case JS_LITERAL:
+            if( postJsonIsLiteral( c ) )
+            {
+               postValPut( pp, c );
+               break;
+            }
+            postValEnd( pp );
+            pp->state = JS_AFTER_VALUE;
+            // fall through
+
+         case JS_AFTER_VALUE:
+            if( ws ) break;
+            if( pp->depth == 0 )
+            {
+               // trailing garbage after the top level value
+               pp->error = HTTPD_POST_ERR_SYNTAX;
+            }
+            else if( c == ',' )
+            {
+               if( pp->index[pp->depth - 1] != 0xffff )
+               {
+                  pp->index[pp->depth - 1]++;
+                  postJsonIndex( pp );
+                  pp->state = JS_VALUE;
+               }
+               else
+               {
+                  pp->state = JS_KEY_START;
+               }
+            }
+            else if( c == '}' || c == ']' )
+            {
+               postJsonPop( pp, c );
+            }
+            else
+            {
+               pp->error = HTTPD_POST_ERR_SYNTAX;
+            }
+            break;
+      }
+   }
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+int ICACHE_FLASH_ATTR httpdPostParserInit( HttpdPostParser *pp, HttpdConnData *connData, HttpdPostFieldCb cb, void *arg )
+{
+   const char *type = httpdGetHeaderById( connData, HTTPD_HDR_CONTENT_TYPE );
+
+   memset( pp, 0, sizeof( HttpdPostParser ) );
+   pp->cb = cb;
+   pp->arg = arg;
+   pp->first = true;
+
+   if( type != NULL && strstr( type, "multipart/form-data" ) != NULL )
+   {
+      // httpd.c points multipartBoundary to "--boundary" in the Content-Type header
+      const char *b = connData->post.multipartBoundary;
+      int n = 4;
+
+      if( b == NULL || b < type || b >= type + strlen( type ) )
+      {
+         ESP_LOGE( TAG, "multipart body without boundary" );
+         return pp->error = HTTPD_POST_ERR_SYNTAX;
+      }
+
+      b += 2;
+      if( *b == '"' ) b++;
+      strcpy( pp->delim, "\r\n--" );
+      while( *b != 0 && *b != '"' && *b != ';' && *b != ' ' && n < ( int )sizeof( pp->delim ) - 1 )
+         pp->delim[n++] = *b++;
+      pp->delim[n] = 0;
+      pp->delimLen = n;
+
+      pp->type = HTTPD_POST_MULTIPART;
+      pp->state = MP_PREAMBLE;
+      pp->match = 2;    // the body starts with "--boundary" without CR LF
+   }
+   else if( type != NULL && strstr( type, "json" ) != NULL )
+   {
+      pp->type = HTTPD_POST_JSON;
+      pp->state = JS_VALUE;
+   }
+   else
+   {
+      pp->type = HTTPD_POST_URLENCODED;
+      pp->state = UE_NAME;
+   }
+
+   return 0;
+}
+
+int ICACHE_FLASH_ATTR httpdPostParse( HttpdPostParser *pp, const char *data, int len )
+{
+   if( pp->error == 0 )
+   {
+      switch( pp->type )
+      {
+         case HTTPD_POST_URLENCODED:   postUrlencoded( pp, data, len ); break;
+         case HTTPD_POST_MULTIPART:    postMultipart( pp, data, len );  break;
+         case HTTPD_POST_JSON:         postJson( pp, data, len );       break;
+      }
+   }
+   return pp->error;
+}
+
+int ICACHE_FLASH_ATTR httpdPostParseFinish( HttpdPostParser *pp )
+{
+   if( pp->error != 0 ) return pp->error;
+
+   switch( pp->type )
+   {
+      case HTTPD_POST_URLENCODED:
+         postUrlField( pp );
+         break;
+
+      case HTTPD_POST_MULTIPART:
+         if( pp->state != MP_END ) pp->error = HTTPD_POST_ERR_SYNTAX;
+         break;
+
+      case HTTPD_POST_JSON:
+         if( pp->state == JS_LITERAL )
+         {
+            postValEnd( pp );
+            pp->state = JS_AFTER_VALUE;
+         }
+         if( pp->error == 0 && ( pp->state != JS_AFTER_VALUE || pp->depth != 0 ) )
+            pp->error = HTTPD_POST_ERR_SYNTAX;
+         break;
+   }
+
+   if( pp->error != 0 ) ESP_LOGW( TAG, "post body error %d", pp->error );
+   return pp->error;
+}
+
+int ICACHE_FLASH_ATTR httpdPostParseChunk( HttpdPostParser *pp, HttpdConnData *connData )
+{
+   if( httpdPostParse( pp, connData->post.buf, connData->post.buffLen ) < 0 ) return pp->error;
+   if( connData->post.received < connData->post.len ) return 0;
+   if( httpdPostParseFinish( pp ) < 0 ) return pp->error;
+   return 1;
+}
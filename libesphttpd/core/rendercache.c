@@ -0,0 +1,156 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          rendercache.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Generation stamped cache for rendered pages and template tokens, see rendercache.h
+*/
+
+// --------------------------------------------------------------------------
+// debug support
+// --------------------------------------------------------------------------
+
+#define LOG_LOCAL_LEVEL    ESP_LOG_WARN
+static const char *TAG = "rendercache";
+#include "esp_log.h"
+#define S( str ) ( str == NULL ? "<null>": str )
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#ifdef linux
+   #include <libesphttpd/linux.h>
+#else
+   #include <libesphttpd/esp.h>
+#endif
+
+#include "libesphttpd/rendercache.h"
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+static RenderCacheEntry renderCache[RENDER_CACHE_ENTRIES];
+static volatile uint32_t renderGeneration = 1;
+static uint32_t renderUseCount = 0;
+static int renderCacheUsed = 0;        // bytes of all entries
+
+static void ICACHE_FLASH_ATTR renderCacheFree( RenderCacheEntry *e )
+{
+   renderCacheUsed -= e->len;
+   free( e->data );
+   e->data = NULL;
+   e->len = 0;
+   e->key[0] = 0;
+}
+
+uint32_t ICACHE_FLASH_ATTR renderCacheGeneration( void )
+{
+   return renderGeneration;
+}
+
+// Something shown on the pages has changed. Only the counter is touched here, so mutators may
+// call it from any context. Stale entries are freed by the next lookup.
+void ICACHE_FLASH_ATTR renderCacheBump( void )
+{
+   renderGeneration++;
+}
+
+RenderCacheEntry * ICACHE_FLASH_ATTR renderCacheGet( const char *key )
+{
+   RenderCacheEntry *r = NULL;
+   int i;
+
+   for( i = 0; i < RENDER_CACHE_ENTRIES; i++ )
+   {
+      RenderCacheEntry *e = &renderCache[i];
+      if( e->key[0] == 0 ) continue;
+      if( e->generation != renderGeneration )
+      {
+         if( e->users == 0 ) renderCacheFree( e );
+      }
+      else if( r == NULL && strcmp( e->key, key ) == 0 )
+      {
+         r = e;
+      }
+   }
+   if( r != NULL )
+   {
+      r->users++;
+      r->lastUse = ++renderUseCount;
+      ESP_LOGD( TAG, "hit %s", key );
+   }
+   return r;
+}
+
+void ICACHE_FLASH_ATTR renderCacheRelease( RenderCacheEntry *e )
+{
+   if( e == NULL ) return;
+   e->users--;
+   if( e->users == 0 && e->generation != renderGeneration ) renderCacheFree( e );
+}
+
+bool ICACHE_FLASH_ATTR renderCachePut( const char *key, uint32_t generation, char *data, int len )
+{
+   RenderCacheEntry *e;
+   int i;
+
+   if( generation != renderGeneration || len > RENDER_CACHE_SIZE || strlen( key ) >= RENDER_CACHE_KEY_LEN )
+   {
+      free( data );
+      return false;
+   }
+
+   // drop an older copy and, if needed, the least recently used entries to make room
+   while( 1 )
+   {
+      RenderCacheEntry *lru = NULL;
+      for( i = 0; i < RENDER_CACHE_ENTRIES; i++ )
+      {
+         e = &renderCache[i];
+         if( e->key[0] != 0 && e->users == 0 && strcmp( e->key, key ) == 0 ) renderCacheFree( e );
+      }
+      e = NULL;
+      for( i = 0; i < RENDER_CACHE_ENTRIES; i++ )
+      {
+         if( renderCache[i].key[0] == 0 )
+         {
+            if( e == NULL ) e = &renderCache[i];
+         }
+         else if( renderCache[i].users == 0 && ( lru == NULL || renderCache[i].lastUse < lru->lastUse ) )
+         {
+            lru = &renderCache[i];
+         }
+      }
+      if( e != NULL && renderCacheUsed + len <= RENDER_CACHE_SIZE ) break;
+      if( lru == NULL )
+      {
+         ESP_LOGD( TAG, "no room for %s", key );
+         free( data );
+         return false;
+      }
+      renderCacheFree( lru );
+   }
+
+   strcpy( e->key, key );
+   e->generation = generation;
+   e->lastUse = ++renderUseCount;
+   e->users = 0;
+   e->data = data;
+   e->len = len;
+   renderCacheUsed += len;
+   ESP_LOGD( TAG, "stored %s, %d bytes", key, len );
+   return true;
+}
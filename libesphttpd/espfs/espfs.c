@@ -9,6 +9,16 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   espFsRead(): heatshrink files are read ahead in aligned blocks and sunk into
+//                        the decoder in large slices, readFlashUnaligned() reads equally
+//                        misaligned data straight into dst
+//    2026-10-19  AWe   file handles and heatshrink decoders from fixed pools instead of malloc(),
+//                        add espFsOpenResult()
+//    2026-10-19  AWe   espFsOpen(), espFsStat() look the name up in the hash index of the image
+//    2026-10-19  AWe   add espFsReadPtr(), readFlashUnaligned() reads aligned data straight into dst
+//    2026-10-19  AWe   add espFsSeek(), heatshrink files are entered at the blocks of the seek table
+//    2026-10-19  AWe   read version 2 images with content hash, add espFsStat()
+//    2026-10-19  AWe   add espFsFileSize()
 //    2018-02-03  AWe   replace uintptr_t --> uint32_t
 //    2018-01-19  AWe   replace httpd_printf() with ESP_LOG*()
 // --------------------------------------------------------------------------
@@ -75,6 +85,14 @@ static const char *TAG = "espfs";
 // ESP8266 stores flash offsets here. ESP32, for now, stores memory locations here.
 static const char* espFsData = NULL;
 
+// Magic and header size of the image, version 1 images have no content hash
+static int32_t espFsMagic = ESPFS_MAGIC;
+static int espFsHeaderLen = sizeof( EspFsHeader );
+
+// Hash table of the file names, NULL if the image has no index, see espfsformat.h
+static const char *espFsIndex = NULL;
+static uint32_t espFsIndexMask;
+
 
 struct EspFsFile
 {
@@ -84,8 +102,38 @@ struct EspFsFile
    const char *posStart;
    const char *posComp;
    void *decompData;
+#ifdef ESPFS_HEATSHRINK
+   const char *posBlockEnd;      // end of the compressed data of the current block
+   int32_t blockEndDecomp;       // uncompressed position where the current block ends
+   uint8_t blockShift;           // log2 of the block size, 0 if the file has no seek table
+#endif
 };
 
+// The open files and the heatshrink decoders come from fixed pools instead of the heap. A file
+// handle is free when its header is NULL.
+static EspFsFile espFsFiles[ESPFS_MAX_OPEN_FILES];
+static EspFsOpenResult espFsLastOpen = ESPFS_OPEN_OK;
+
+#ifdef ESPFS_HEATSHRINK
+// Input buffer of the decoder, the most espFsRead() can sink at once
+#define ESPFS_DECODER_INPUT_SIZE    64
+#define ESPFS_DECODER_SIZE          ( sizeof( heatshrink_decoder ) + ESPFS_DECODER_INPUT_SIZE + \
+                                      ( 1 << ESPFS_HEATSHRINK_WINDOW_BITS ) )
+
+// A decoder of the pool with the read-ahead buffer of the compressed data. The buffer is filled
+// with aligned reads of whole words, readAhead[raPos..raLen[ is not yet sunk into the decoder.
+typedef struct
+{
+   EspFsFile *owner;             // NULL if free
+   uint16_t raPos;
+   uint16_t raLen;
+   uint32_t readAhead[ESPFS_READ_AHEAD / 4];
+   uint32_t decoder[( ESPFS_DECODER_SIZE + 3 ) / 4];
+} EspFsDecoder;
+
+static EspFsDecoder espFsDecoders[ESPFS_HEATSHRINK_DECODERS];
+#endif
+
 /*
 Available locations, at least in my flash, with boundaries partially guessed. This
 is using 0.9.1/0.9.2 SDK on a not-too-new module.
@@ -110,12 +158,44 @@ a memory exception, crashing the program.
 #if defined( __ets__ ) && !defined( ESP32 )
 void ICACHE_FLASH_ATTR readFlashUnaligned( char *dst, const char *src, int len )
 {
-   uint8_t src_offset = ( ( uint32_t )src ) & 3;
-   uint32_t src_address = ( ( uint32_t )src ) - src_offset;
+   uint32_t tmp_buf[64];
+
+   // src and dst equally misaligned: the first bytes through the buffer, then the aligned words
+   if( ( ( ( uint32_t )src ^ ( uint32_t )dst ) & 3 ) == 0 && ( ( uint32_t )src & 3 ) != 0 && len >= 8 )
+   {
+      uint8_t src_offset = ( ( uint32_t )src ) & 3;
+      int n = 4 - src_offset;
+
+      spi_flash_read( ( uint32_t )src - src_offset, tmp_buf, 4 );
+      memcpy( dst, ( ( uint8_t* )tmp_buf ) + src_offset, n );
+      src += n;
+      dst += n;
+      len -= n;
+   }
 
-   uint32_t tmp_buf[len / 4 + 2];
-   spi_flash_read( ( uint32_t )src_address, ( uint32_t* )tmp_buf, len + src_offset );
-   memcpy( dst, ( ( uint8_t* )tmp_buf ) + src_offset, len );
+   // aligned words go straight to the destination
+   if( ( ( ( uint32_t )src | ( uint32_t )dst ) & 3 ) == 0 && len >= 4 )
+   {
+      int n = len & ~3;
+      spi_flash_read( ( uint32_t )src, ( uint32_t* )dst, n );
+      src += n;
+      dst += n;
+      len -= n;
+   }
+
+   // the rest through a small buffer on the stack
+   while( len > 0 )
+   {
+      uint8_t src_offset = ( ( uint32_t )src ) & 3;
+      uint32_t src_address = ( ( uint32_t )src ) - src_offset;
+      int n = ( len < ( int )sizeof( tmp_buf ) - 4 ) ? len : ( int )sizeof( tmp_buf ) - 4;
+
+      spi_flash_read( src_address, tmp_buf, ( n + src_offset + 3 ) & ~3 );
+      memcpy( dst, ( ( uint8_t* )tmp_buf ) + src_offset, n );
+      src += n;
+      dst += n;
+      len -= n;
+   }
 }
 #else
    #define readFlashUnaligned memcpy
@@ -127,7 +207,7 @@ void ICACHE_FLASH_ATTR readFlashAligned( uint32_t *dst, uint32_t pos, int len )
    spi_flash_read( pos, dst, len );
 }
 #else
-   #define readFlashAligned( a,b,c ) memcpy( a, ( uint32_t* )b, c )
+   #define readFlashAligned( a,b,c ) memcpy( a, ( uint32_t* )( b ), c )
 #endif
 
 EspFsInitResult ICACHE_FLASH_ATTR espFsInit( void *flashAddress )
@@ -149,11 +229,31 @@ EspFsInitResult ICACHE_FLASH_ATTR espFsInit( void *flashAddress )
    // check if there is valid header at address
    EspFsHeader testHeader;
    readFlashUnaligned( ( char* )&testHeader, ( char* )flashAddress, sizeof( EspFsHeader ) );
-   if( testHeader.magic != ESPFS_MAGIC )
+   if( testHeader.magic == ESPFS_MAGIC )
+   {
+      espFsHeaderLen = sizeof( EspFsHeader );
+   }
+   else if( testHeader.magic == ESPFS_MAGIC_V1 )
+   {
+      espFsHeaderLen = ESPFS_HEADER_V1_LEN;
+   }
+   else
    {
       ESP_LOGE( TAG, "Esp magic: %x ( should be %x )", testHeader.magic, ESPFS_MAGIC );
       return ESPFS_INIT_RESULT_NO_IMAGE;
    }
+   espFsMagic = testHeader.magic;
+
+   espFsIndex = NULL;
+   if( testHeader.flags & FLAG_INDEX )
+   {
+      uint16_t buckets[2];    // bucketCount, fileCount
+      const char *p = ( const char * )flashAddress + espFsHeaderLen + testHeader.nameLen;
+      readFlashUnaligned( ( char* )buckets, p, 4 );
+      ESP_LOGD( TAG, "index of %d files in %d buckets", buckets[1], buckets[0] );
+      espFsIndex = p + 4;
+      espFsIndexMask = buckets[0] - 1;
+   }
 
    espFsData = ( const char * )flashAddress;
    return ESPFS_INIT_RESULT_OK;
@@ -176,8 +276,124 @@ int ICACHE_FLASH_ATTR espFsFlags( EspFsFile *fh )
    return ( int )flags;
 }
 
-// Open a file and return a pointer to the file desc struct.
-EspFsFile* ICACHE_FLASH_ATTR espFsOpen( const char *fileName )
+// Returns the number of bytes espFsRead() delivers for the opened file. This is the stored size
+// for uncompressed and gzip files and the decompressed size for heatshrink files.
+int ICACHE_FLASH_ATTR espFsFileSize( EspFsFile *fh )
+{
+   if( fh == NULL )
+   {
+      ESP_LOGE( TAG, "File handle not ready" );
+      return -1;
+   }
+
+   int32_t len;
+   if( fh->decompressor == COMPRESS_NONE )
+      readFlashUnaligned( ( char* )&len, ( char* )&fh->header->fileLenComp, 4 );
+   else
+      readFlashUnaligned( ( char* )&len, ( char* )&fh->header->fileLenDecomp, 4 );
+   return ( int )len;
+}
+
+// Returns the content hash of opened file, 0 if the image has none.
+uint32_t ICACHE_FLASH_ATTR espFsFileHash( EspFsFile *fh )
+{
+   if( fh == NULL || espFsHeaderLen < ( int )sizeof( EspFsHeader ) ) return 0;
+
+   uint32_t hash;
+   readFlashUnaligned( ( char* )&hash, ( char* )&fh->header->hash, 4 );
+   return hash;
+}
+
+#ifdef ESPFS_HEATSHRINK
+// Restart the decoder at the beginning of a block of a heatshrink file. Without seek table the
+// whole file is one block.
+static void ICACHE_FLASH_ATTR espFsEnterBlock( EspFsFile *fh, int block )
+{
+   EspFsDecoder *d = ( EspFsDecoder * )fh->decompData;
+   int32_t flen, fdlen;
+   uint32_t offs[2];
+   uint16_t blockCount;
+
+   readFlashUnaligned( ( char* )&flen, ( char* )&fh->header->fileLenComp, 4 );
+   readFlashUnaligned( ( char* )&fdlen, ( char* )&fh->header->fileLenDecomp, 4 );
+   heatshrink_decoder_reset( ( heatshrink_decoder * )d->decoder );
+   d->raPos = d->raLen = 0;
+
+   if( fh->blockShift == 0 )
+   {
+      fh->posComp = fh->posStart + 1;   // skip decoder parms
+      fh->posBlockEnd = fh->posStart + flen;
+      fh->posDecomp = 0;
+      fh->blockEndDecomp = fdlen;
+      return;
+   }
+
+   readFlashUnaligned( ( char* )&blockCount, fh->posStart + 2, 2 );
+   readFlashAligned( offs, ( uint32_t )( fh->posStart + 4 + 4 * block ), ( block + 1 < blockCount ) ? 8 : 4 );
+   fh->posComp = fh->posStart + offs[0];
+   fh->posBlockEnd = fh->posStart + ( ( block + 1 < blockCount ) ? offs[1] : ( uint32_t )flen );
+   fh->posDecomp = block << fh->blockShift;
+   fh->blockEndDecomp = ( block + 1 ) << fh->blockShift;
+   if( fh->blockEndDecomp > fdlen ) fh->blockEndDecomp = fdlen;
+}
+
+// Fill the read-ahead buffer with the next compressed data of the block. The read starts at the
+// word before posComp and covers whole words, posComp moves to the first byte not in the buffer.
+static void ICACHE_FLASH_ATTR espFsReadAhead( EspFsFile *fh, EspFsDecoder *d )
+{
+   int offs = ( uint32_t )fh->posComp & 3;
+   int n = fh->posBlockEnd - fh->posComp;
+
+   if( n > ESPFS_READ_AHEAD - offs ) n = ESPFS_READ_AHEAD - offs;
+   readFlashAligned( d->readAhead, ( uint32_t )fh->posComp - offs, ( offs + n + 3 ) & ~3 );
+   d->raPos = offs;
+   d->raLen = offs + n;
+   fh->posComp += n;
+}
+#endif
+
+// Look a file up in the index of the image: the buckets from the one of the name hash on are
+// probed until an empty one, for a matching hash the header and the name are read.
+static const char * ICACHE_FLASH_ATTR espFsFindIndexed( const char *fileName, EspFsHeader *h )
+{
+   char namebuf[256];
+   uint32_t bucket[2];     // nameHash, headerOffs
+   uint32_t hash = 2166136261u;
+   int len;
+   uint32_t i, n;
+
+   for( len = 0; fileName[len]; len++ )
+   {
+      hash ^= ( uint8_t )fileName[len];
+      hash *= 16777619u;
+   }
+   if( hash == 0 ) hash = 1;
+   len++;   // with the terminating zero
+   if( len > ( int )sizeof( namebuf ) ) return NULL;
+
+   for( i = hash & espFsIndexMask, n = 0; n <= espFsIndexMask; i = ( i + 1 ) & espFsIndexMask, n++ )
+   {
+      readFlashAligned( bucket, ( uint32_t )( espFsIndex + 8 * i ), sizeof( bucket ) );
+      if( bucket[0] == 0 ) break;
+      if( bucket[0] != hash ) continue;
+
+      const char *hpos = espFsData + bucket[1];
+      readFlashAligned( ( uint32_t* )h, ( uint32_t )hpos, sizeof( EspFsHeader ) );
+      if( h->magic != espFsMagic )
+      {
+         ESP_LOGE( TAG, "Magic mismatch. EspFS image broken." );
+         return NULL;
+      }
+      if( h->nameLen < len ) continue;
+      readFlashAligned( ( uint32_t* )&namebuf, ( uint32_t )( hpos + espFsHeaderLen ), ( len + 3 ) & ~3 );
+      if( memcmp( namebuf, fileName, len ) == 0 ) return hpos;
+   }
+   return NULL;
+}
+
+// Find a file in the image. Returns the position of its header and copies the header to h,
+// NULL if the file isn't there.
+static const char * ICACHE_FLASH_ATTR espFsFind( const char *fileName, EspFsHeader *h )
 {
    if( espFsData == NULL )
    {
@@ -187,79 +403,174 @@ EspFsFile* ICACHE_FLASH_ATTR espFsOpen( const char *fileName )
    const char *p = espFsData;
    const char *hpos;
    char namebuf[256];
-   EspFsHeader h;
-   EspFsFile *r;
    // Strip first initial slash
    // We should not strip any next slashes otherwise there is potential security risk when mapped authentication handler will not invoke ( ex. // /security.html )
    if( fileName[0] == '/' ) fileName++;
+
+   if( espFsIndex != NULL ) return espFsFindIndexed( fileName, h );
+
    // Go find that file!
    while( 1 )
    {
       hpos = p;
       // Grab the next file header.
-      readFlashAligned( ( uint32_t* )&h, ( uint32_t )p, sizeof( EspFsHeader ) );
+      readFlashAligned( ( uint32_t* )h, ( uint32_t )p, sizeof( EspFsHeader ) );
 
-      if( h.magic != ESPFS_MAGIC )
+      if( h->magic != espFsMagic )
       {
          ESP_LOGE( TAG, "Magic mismatch. EspFS image broken." );
          return NULL;
       }
-      if( h.flags & FLAG_LASTFILE )
+      if( h->flags & FLAG_LASTFILE )
       {
          ESP_LOGD( TAG, "End of image." );
          return NULL;
       }
       // Grab the name of the file.
-      p += sizeof( EspFsHeader );
+      p += espFsHeaderLen;
       readFlashAligned( ( uint32_t* )&namebuf, ( uint32_t )p, sizeof( namebuf ) );
 #ifdef VERBOSE_OUTPUT
       ESP_LOGD( TAG, "Found file '%s'. Namelen=%x fileLenComp=%x, compr=%d flags=%d",
-                namebuf, ( unsigned int )h.nameLen, ( unsigned int )h.fileLenComp, h.compression, h.flags );
+                namebuf, ( unsigned int )h->nameLen, ( unsigned int )h->fileLenComp, h->compression, h->flags );
 #endif
-      if( strcmp( namebuf, fileName ) == 0 )
+      if( strcmp( namebuf, fileName ) == 0 && !( h->flags & FLAG_INDEX ) )
       {
          // Yay, this is the file we need!
-         p += h.nameLen; // Skip to content.
-         r = ( EspFsFile * )malloc( sizeof( EspFsFile ) ); // Alloc file desc mem
+         if( espFsHeaderLen < ( int )sizeof( EspFsHeader ) ) h->hash = 0;
+         return hpos;
+      }
+      // We don't need this file. Skip name and file
+      p += h->nameLen + h->fileLenComp;
+      if( ( uint32_t )p & 3 ) p += 4 - ( ( uint32_t )p & 3 ); // align to next 32bit val
+   }
+}
+
+// Get information about a file without opening it. Returns 1 if the file exists, otherwise 0.
+int ICACHE_FLASH_ATTR espFsStat( const char *fileName, EspFsStat *st )
+{
+   EspFsHeader h;
+
+   if( espFsFind( fileName, &h ) == NULL ) return 0;
+
+   st->flags = h.flags;
+   st->size = ( h.compression == COMPRESS_NONE ) ? h.fileLenComp : h.fileLenDecomp;
+   st->hash = h.hash;
+   return 1;
+}
+
+#ifdef ESPFS_HEATSHRINK
+// Take a decoder from the pool and set it up for the window and lookahead of the file. Returns
+// NULL if all decoders are in use or the window is larger than the one of the pool.
+static EspFsDecoder* ICACHE_FLASH_ATTR espFsDecoderGet( EspFsFile *fh, int windowBits, int lookaheadBits )
+{
+   int i;
+
+   if( windowBits > ESPFS_HEATSHRINK_WINDOW_BITS || lookaheadBits >= windowBits )
+   {
+      ESP_LOGE( TAG, "Heatshrink window %d bits not supported, at most %d", windowBits, ESPFS_HEATSHRINK_WINDOW_BITS );
+      espFsLastOpen = ESPFS_OPEN_FAILED;
+      return NULL;
+   }
+
+   for( i = 0; i < ESPFS_HEATSHRINK_DECODERS; i++ )
+   {
+      if( espFsDecoders[i].owner == NULL )
+      {
+         heatshrink_decoder *dec = ( heatshrink_decoder * )espFsDecoders[i].decoder;
+         dec->input_buffer_size = ESPFS_DECODER_INPUT_SIZE;
+         dec->window_sz2 = windowBits;
+         dec->lookahead_sz2 = lookaheadBits;
+         espFsDecoders[i].owner = fh;
+         return &espFsDecoders[i];
+      }
+   }
+
+   ESP_LOGW( TAG, "All %d heatshrink decoders in use", ESPFS_HEATSHRINK_DECODERS );
+   espFsLastOpen = ESPFS_OPEN_BUSY;
+   return NULL;
+}
+#endif
+
+// Open a file and return a pointer to the file desc struct. Returns NULL if the file can't be
+// opened, espFsOpenResult() tells why.
+EspFsFile* ICACHE_FLASH_ATTR espFsOpen( const char *fileName )
+{
+   const char *hpos;
+   const char *p;
+   EspFsHeader h;
+   EspFsFile *r = NULL;
+   int i;
+
+   hpos = espFsFind( fileName, &h );
+   if( hpos == NULL )
+   {
+      espFsLastOpen = ESPFS_OPEN_NOT_FOUND;
+      return NULL;
+   }
+
+   p = hpos + espFsHeaderLen + h.nameLen; // Skip to content.
+   for( i = 0; i < ESPFS_MAX_OPEN_FILES; i++ )
+   {
+      if( espFsFiles[i].header == NULL )
+      {
+         r = &espFsFiles[i];
+         break;
+      }
+   }
+   if( r == NULL )
+   {
+      ESP_LOGW( TAG, "All %d file handles in use", ESPFS_MAX_OPEN_FILES );
+      espFsLastOpen = ESPFS_OPEN_BUSY;
+      return NULL;
+   }
 #ifdef VERBOSE_OUTPUT
-         ESP_LOGD( TAG, "Alloc %p", r );
+   ESP_LOGD( TAG, "Open %p", r );
 #endif
-         if( r == NULL ) return NULL;
-         r->header = ( EspFsHeader * )hpos;
-         r->decompressor = h.compression;
-         r->posComp = p;
-         r->posStart = p;
-         r->posDecomp = 0;
-         if( h.compression == COMPRESS_NONE )
-         {
-            r->decompData = NULL;
+   r->header = ( EspFsHeader * )hpos;
+   r->decompressor = h.compression;
+   r->posComp = p;
+   r->posStart = p;
+   r->posDecomp = 0;
+   if( h.compression == COMPRESS_NONE )
+   {
+      r->decompData = NULL;
 #ifdef ESPFS_HEATSHRINK
-         }
-         else if( h.compression == COMPRESS_HEATSHRINK )
-         {
-            // File is compressed with Heatshrink.
-            char parm;
-            heatshrink_decoder *dec;
-            // Decoder params are stored in 1st byte.
-            readFlashUnaligned( &parm, r->posComp, 1 );
-            r->posComp++;
-            ESP_LOGD( TAG, "Heatshrink compressed file; decode parms = %x", parm );
-            dec = heatshrink_decoder_alloc( 16, ( parm >> 4 ) & 0xf, parm & 0xf );
-            r->decompData = dec;
-#endif
-         }
-         else
-         {
-            ESP_LOGE( TAG, "Invalid compression: %d", h.compression );
-            free( r );
-            return NULL;
-         }
-         return r;
+   }
+   else if( h.compression == COMPRESS_HEATSHRINK )
+   {
+      // File is compressed with Heatshrink.
+      char parm[2];
+      EspFsDecoder *dec;
+      // Decoder params are stored in 1st byte, followed by the block size of the seek table.
+      readFlashUnaligned( parm, r->posComp, 2 );
+      ESP_LOGD( TAG, "Heatshrink compressed file; decode parms = %x", parm[0] );
+      dec = espFsDecoderGet( r, ( parm[0] >> 4 ) & 0xf, parm[0] & 0xf );
+      if( dec == NULL )
+      {
+         r->header = NULL;
+         return NULL;
       }
-      // We don't need this file. Skip name and file
-      p += h.nameLen + h.fileLenComp;
-      if( ( uint32_t )p & 3 ) p += 4 - ( ( uint32_t )p & 3 ); // align to next 32bit val
+      r->decompData = dec;
+      r->blockShift = ( h.flags & FLAG_SEEKTABLE ) ? parm[1] : 0;
+      espFsEnterBlock( r, 0 );
+#endif
    }
+   else
+   {
+      ESP_LOGE( TAG, "Invalid compression: %d", h.compression );
+      espFsLastOpen = ESPFS_OPEN_FAILED;
+      r->header = NULL;
+      return NULL;
+   }
+   espFsLastOpen = ESPFS_OPEN_OK;
+   return r;
+}
+
+// Why the last espFsOpen() returned NULL, ESPFS_OPEN_BUSY if the file can be opened later when
+// other files are closed.
+EspFsOpenResult ICACHE_FLASH_ATTR espFsOpenResult( void )
+{
+   return espFsLastOpen;
 }
 
 // Read len bytes from the given file into buf. Returns the actual amount of bytes read.
@@ -295,9 +606,9 @@ int ICACHE_FLASH_ATTR espFsRead( EspFsFile *fh, char *buf, int len )
    {
       readFlashUnaligned( ( char* )&fdlen, ( char* )&fh->header->fileLenDecomp, 4 );
       int decoded = 0;
-      size_t elen, rlen;
-      char ebuff[16];
-      heatshrink_decoder *dec = ( heatshrink_decoder * )fh->decompData;
+      size_t elen, rlen, plen;
+      EspFsDecoder *d = ( EspFsDecoder * )fh->decompData;
+      heatshrink_decoder *dec = ( heatshrink_decoder * )d->decoder;
 #ifdef VERBOSE_OUTPUT
       ESP_LOGD( TAG, "Alloc %p", dec );
 #endif
@@ -312,17 +623,27 @@ int ICACHE_FLASH_ATTR espFsRead( EspFsFile *fh, char *buf, int len )
 
       while( decoded < len )
       {
-         // Feed data into the decompressor
+         // Blocks of files with seek table are compressed independently, restart the decoder
+         if( fh->posDecomp == fh->blockEndDecomp )
+         {
+            if( fh->posDecomp == fdlen ) break;
+            espFsEnterBlock( fh, fh->posDecomp >> fh->blockShift );
+         }
+
+         // Feed data into the decompressor, as much as its input buffer takes
          // ToDo: Check ret val of heatshrink fns for errors
-         elen = flen - ( fh->posComp - fh->posStart );
+         if( d->raPos == d->raLen && fh->posComp < fh->posBlockEnd )
+            espFsReadAhead( fh, d );
+         elen = d->raLen - d->raPos;
          if( elen > 0 )
          {
-            readFlashUnaligned( ebuff, fh->posComp, 16 );
-            heatshrink_decoder_sink( dec, ( uint8_t * )ebuff, ( elen > 16 ) ? 16 : elen, &rlen );
-            fh->posComp += rlen;
+            heatshrink_decoder_sink( dec, ( uint8_t * )d->readAhead + d->raPos, elen, &rlen );
+            d->raPos += rlen;
          }
-         // Grab decompressed data and put into buf
-         heatshrink_decoder_poll( dec, ( uint8_t * )buf, len - decoded, &rlen );
+         // Grab decompressed data and put into buf, but not beyond the end of the block
+         plen = len - decoded;
+         if( plen > ( size_t )( fh->blockEndDecomp - fh->posDecomp ) ) plen = fh->blockEndDecomp - fh->posDecomp;
+         heatshrink_decoder_poll( dec, ( uint8_t * )buf, plen, &rlen );
          fh->posDecomp += rlen;
          buf += rlen;
          decoded += rlen;
@@ -331,42 +652,112 @@ int ICACHE_FLASH_ATTR espFsRead( EspFsFile *fh, char *buf, int len )
          ESP_LOGD( TAG, "Elen %d rlen %d d %d pd %d fdl %d", elen, rlen, decoded, ( uint32_t ) fh->posDecomp, fdlen );
 #endif
 
-         if( elen == 0 )
+         if( elen == 0 && rlen == 0 )
          {
-            if( fh->posDecomp == fdlen )
-            {
+            // no input left and the decoder has nothing more to give
+            break;
+         }
+      }
+      if( fh->posDecomp == fdlen )
+      {
 #ifdef VERBOSE_OUTPUT
-               ESP_LOGD( TAG, "Decoder finish" );
+         ESP_LOGD( TAG, "Decoder finish" );
 #endif
-               heatshrink_decoder_finish( dec );
-            }
-            return decoded;
-         }
+         heatshrink_decoder_finish( dec );
       }
-      return len;
+      return decoded;
 #endif
    }
    return 0;
 }
 
-// Close the file.
+// Get a pointer to the next len bytes of the file instead of copying them, and advance the read
+// position. Only possible for uncompressed files of an image the CPU can address directly,
+// returns 0 otherwise and espFsRead() must be used. The ESP8266 reads the flash with
+// spi_flash_read(), its espfs image is never addressed directly.
+int ICACHE_FLASH_ATTR espFsReadPtr( EspFsFile *fh, const char **ptr, int len )
+{
+#if defined( __ets__ ) && !defined( ESP32 )
+   return 0;
+#else
+   int flen;
+   int toRead;
+
+   if( fh == NULL || fh->decompressor != COMPRESS_NONE ) return 0;
+
+   readFlashUnaligned( ( char* )&flen, ( char* )&fh->header->fileLenComp, 4 );
+   toRead = flen - ( fh->posComp - fh->posStart );
+   if( len > toRead ) len = toRead;
+   *ptr = fh->posComp;
+   fh->posDecomp += len;
+   fh->posComp += len;
+   return len;
+#endif
+}
+
+// Set the read position of the file, returns the new position or -1 on error. Uncompressed files
+// are positioned directly, heatshrink files restart at the nearest block of their seek table and
+// decode up to the position.
+int ICACHE_FLASH_ATTR espFsSeek( EspFsFile *fh, int pos )
+{
+   if( fh == NULL ) return -1;
+
+   int size = espFsFileSize( fh );
+   if( pos < 0 || pos > size ) return -1;
+
+   if( fh->decompressor == COMPRESS_NONE )
+   {
+      fh->posComp = fh->posStart + pos;
+      fh->posDecomp = pos;
+      return pos;
+#ifdef ESPFS_HEATSHRINK
+   }
+   else if( fh->decompressor == COMPRESS_HEATSHRINK )
+   {
+      char skip[32];
+      int block = 0;
+
+      // the end of the file belongs to the last block
+      if( fh->blockShift != 0 && pos > 0 ) block = ( pos == size ? pos - 1 : pos ) >> fh->blockShift;
+
+      // decode forward within the current block, otherwise start at the block which holds pos
+      if( pos < fh->posDecomp
+            || ( fh->blockShift != 0 && block != ( fh->blockEndDecomp - 1 ) >> fh->blockShift ) )
+      {
+         espFsEnterBlock( fh, block );
+      }
+      while( fh->posDecomp < pos )
+      {
+         int n = pos - fh->posDecomp;
+         if( n > ( int )sizeof( skip ) ) n = sizeof( skip );
+         if( espFsRead( fh, skip, n ) <= 0 ) return -1;
+      }
+      return pos;
+#endif
+   }
+   return -1;
+}
+
+
+// Close the file, its handle and decoder go back to the pools.
 void ICACHE_FLASH_ATTR espFsClose( EspFsFile *fh )
 {
    if( fh == NULL ) return;
 #ifdef ESPFS_HEATSHRINK
    if( fh->decompressor == COMPRESS_HEATSHRINK )
    {
-      heatshrink_decoder *dec = ( heatshrink_decoder * )fh->decompData;
-      heatshrink_decoder_free( dec );
-#ifdef VERBOSE_OUTPUT
-      ESP_LOGD( TAG, "Freed %p", dec );
-#endif
+      int i;
+      for( i = 0; i < ESPFS_HEATSHRINK_DECODERS; i++ )
+      {
+         if( espFsDecoders[i].owner == fh ) espFsDecoders[i].owner = NULL;
+      }
    }
 #endif
 
 #ifdef VERBOSE_OUTPUT
-   ESP_LOGD( TAG, "Freed %p", fh );
+   ESP_LOGD( TAG, "Close %p", fh );
 #endif
 
-   free( fh );
+   fh->header = NULL;
+   fh->decompData = NULL;
 }
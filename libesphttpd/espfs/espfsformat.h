@@ -12,14 +12,61 @@ when trying to do a <4byte or unaligned read.
 The idea 'borrows' from cpio: it's basically a concatenation of {header, filename, file} data.
 Header, filename and file data is 32-bit aligned. The last file is indicated by data-less header
 with the FLAG_LASTFILE flag set.
+
+Version 2 images ( magic "ESf2" ) have a hash of the file content at the end of the header, which
+is used as ETag by the webserver. Version 1 images ( magic "ESfs" ) have the shorter header
+without hash and can still be read.
+
+Heatshrink compressed files bigger than one block have FLAG_SEEKTABLE set. The encoder is restarted
+at every ( 1 << blockShift ) bytes of the uncompressed file, so the decoder can start at any block
+boundary. The compressed data then begins with
+   uint8_t  parm             decoder parameters, window size << 4 | lookahead size
+   uint8_t  blockShift       log2 of the uncompressed block size
+   uint16_t blockCount       number of blocks
+   uint32_t blockOffs[n]     offset of the compressed data of each block from the start of the file data
+followed by the compressed blocks. Without the flag, only the parm byte preceeds the compressed data.
+
+Templates with FLAG_TEMPLATE are precompiled by mkespfsimage, the ( uncompressed ) content is
+   uint16_t tokenCount
+   uint16_t tableLen         size of the token table
+   token table               per token: uint8_t encoding ( TPL_ENC_* ), zero terminated name
+followed by the records of the template, each starting with an uint16_t:
+   0x0000 .. 0x7fff          literal text of that length follows
+   0x8000 | id               token id, index into the token table
+All uint16_t are little endian. %% is stored as literal %.
+
+Images made with mkespfsimage -i 1 begin with an index, an entry with FLAG_INDEX and the name
+ESPFS_INDEX_NAME in front of the files. Its content is a hash table of the file names:
+   uint16_t bucketCount      power of two, at least twice the number of files
+   uint16_t fileCount
+   per bucket: uint32_t nameHash, uint32_t headerOffs
+nameHash is the FNV-1a hash of the name as stored ( without leading slash ), 0 marks an empty
+bucket and a name hashing to 0 is stored as 1. headerOffs is the position of the file header from
+the start of the image. A name is looked up at bucket ( nameHash & ( bucketCount - 1 ) ) and the
+following ones until an empty bucket. Readers which don't know the index see it as a file.
 */
 
 
 #define FLAG_LASTFILE ( 1<<0 )
 #define FLAG_GZIP ( 1<<1 )
+#define FLAG_SEEKTABLE ( 1<<2 )
+#define FLAG_TEMPLATE ( 1<<3 )
+#define FLAG_INDEX ( 1<<4 )          // hash table of the file names, see above
 #define COMPRESS_NONE 0
 #define COMPRESS_HEATSHRINK 1
-#define ESPFS_MAGIC 0x73665345   // "ESfs"
+#define ESPFS_MAGIC 0x32665345      // "ESf2", version 2
+#define ESPFS_MAGIC_V1 0x73665345   // "ESfs", version 1, header without hash
+#define ESPFS_HEADER_V1_LEN 16      // header size of version 1 images
+#define ESPFS_SEEK_BLOCK_SHIFT 12   // default heatshrink block size for the seek table, 4 kByte
+#define ESPFS_INDEX_NAME ".espfs-index"
+
+// precompiled templates
+#define TPL_REC_TOKEN 0x8000        // record is a token id, otherwise the length of a literal
+#define TPL_REC_MAX_LITERAL 0x7fff
+#define TPL_ENC_PLAIN 0             // same values as TplEncode of httpdespfs.h
+#define TPL_ENC_HTML 1
+#define TPL_ENC_JS 2
+#define TPL_MAX_TOKEN_LEN 63        // longer tokens are sent as text
 
 typedef struct
 {
@@ -29,6 +76,7 @@ typedef struct
    int16_t nameLen;
    int32_t fileLenComp;
    int32_t fileLenDecomp;
+   uint32_t hash;                   // FNV-1a hash of the file content and flags, since version 2
 } __attribute__( ( packed ) ) EspFsHeader;
 
 #endif
\ No newline at end of file
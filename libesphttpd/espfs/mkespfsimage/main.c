@@ -54,31 +54,208 @@ int htoxl( int in )
    return *( ( int * )r );
 }
 
+// FNV-1a hash of the file content, stored in the header and used as ETag by the webserver
+uint32_t hashContent( const uint8_t *data, int len, int8_t flags )
+{
+   uint32_t hash = 2166136261u;
+   int i;
+
+   for( i = 0; i < len; i++ )
+   {
+      hash ^= data[i];
+      hash *= 16777619u;
+   }
+   // gzip'ed and plain delivery of the same content are different representations
+   hash ^= ( uint8_t )flags;
+   hash *= 16777619u;
+
+   // zero is reserved for "no hash"
+   return hash ? hash : 1;
+}
+
+// Templates ( *.tpl* ) are precompiled into literal spans and token records, see espfsformat.h
+
+typedef struct
+{
+   uint8_t *data;
+   int len;
+   int size;
+} OutBuf;
+
+void outAppend( OutBuf *o, const void *data, int len )
+{
+   if( o->len + len > o->size )
+   {
+      o->size = ( o->len + len ) * 2 + 64;
+      o->data = realloc( o->data, o->size );
+      if( o->data == NULL )
+      {
+         perror( "allocating mem for template" );
+         exit( 1 );
+      }
+   }
+   memcpy( o->data + o->len, data, len );
+   o->len += len;
+}
+
+void outU16( OutBuf *o, int val )
+{
+   uint8_t r[2];
+   r[0] = val;
+   r[1] = val >> 8;
+   outAppend( o, r, 2 );
+}
+
+// Write the collected text as literal records
+void tplFlushLiteral( OutBuf *recs, OutBuf *lit )
+{
+   int pos = 0;
+   while( pos < lit->len )
+   {
+      int n = lit->len - pos;
+      if( n > TPL_REC_MAX_LITERAL ) n = TPL_REC_MAX_LITERAL;
+      outU16( recs, n );
+      outAppend( recs, lit->data + pos, n );
+      pos += n;
+   }
+   lit->len = 0;
+}
+
+int isTemplate( char *name )
+{
+   return strstr( name, ".tpl" ) != NULL;
+}
+
+int isTokenChar( uint8_t c )
+{
+   return ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || ( c >= '0' && c <= '9' )
+          || c == '.' || c == '_' || c == '-' || c == ':';
+}
+
+// Parse the template like cgiEspFsTemplate() does at runtime. Returns the length of the
+// compiled template in *out, 0 if there are no tokens and the file is stored as it is.
+int compileTemplate( uint8_t *in, int insize, uint8_t **out )
+{
+   static const struct { const char *prefix; int enc; } prefixes[] =
+   {
+      { "html:", TPL_ENC_HTML }, { "h:", TPL_ENC_HTML }, { "js:", TPL_ENC_JS }, { "j:", TPL_ENC_JS }
+   };
+   OutBuf table = { NULL, 0, 0 };
+   OutBuf recs = { NULL, 0, 0 };
+   OutBuf lit = { NULL, 0, 0 };
+   OutBuf res = { NULL, 0, 0 };
+   int tokOfs[TPL_REC_TOKEN];
+   int count = 0;
+   int tokStart = -1;
+   int tokLen = 0;
+   int i, j;
+
+   for( i = 0; i < insize; i++ )
+   {
+      uint8_t c = in[i];
+      if( tokStart < 0 )
+      {
+         if( c == '%' )
+         {
+            tokStart = i + 1;
+            tokLen = 0;
+         }
+         else
+         {
+            outAppend( &lit, &c, 1 );
+         }
+      }
+      else if( c == '%' )
+      {
+         if( tokLen == 0 )
+         {
+            // %% escape
+            outAppend( &lit, "%", 1 );
+         }
+         else
+         {
+            char name[TPL_MAX_TOKEN_LEN + 1];
+            char *n = name;
+            int enc = TPL_ENC_PLAIN;
+
+            memcpy( name, in + tokStart, tokLen );
+            name[tokLen] = 0;
+            for( j = 0; j < sizeof( prefixes ) / sizeof( prefixes[0] ); j++ )
+            {
+               if( strncmp( name, prefixes[j].prefix, strlen( prefixes[j].prefix ) ) == 0 )
+               {
+                  n += strlen( prefixes[j].prefix );
+                  enc = prefixes[j].enc;
+                  break;
+               }
+            }
+
+            // same name and encoding share the id
+            for( j = 0; j < count; j++ )
+            {
+               if( table.data[tokOfs[j]] == enc && strcmp( ( char * )table.data + tokOfs[j] + 1, n ) == 0 ) break;
+            }
+            if( j == count )
+            {
+               if( count == TPL_REC_TOKEN )
+               {
+                  fprintf( stderr, "Template: too many tokens\n" );
+                  exit( 1 );
+               }
+               tokOfs[count++] = table.len;
+               outAppend( &table, ( uint8_t[] ) { enc }, 1 );
+               outAppend( &table, n, strlen( n ) + 1 );
+            }
+            tplFlushLiteral( &recs, &lit );
+            outU16( &recs, TPL_REC_TOKEN | j );
+         }
+         tokStart = -1;
+      }
+      else if( tokLen < TPL_MAX_TOKEN_LEN && isTokenChar( c ) )
+      {
+         tokLen++;
+      }
+      else
+      {
+         // not a token, keep the text
+         outAppend( &lit, "%", 1 );
+         outAppend( &lit, in + tokStart, tokLen );
+         outAppend( &lit, &c, 1 );
+         tokStart = -1;
+      }
+   }
+   // an unterminated token at the end of the file is dropped, like the runtime parser does
+   tplFlushLiteral( &recs, &lit );
+
+   if( count != 0 )
+   {
+      outU16( &res, count );
+      outU16( &res, table.len );
+      outAppend( &res, table.data, table.len );
+      outAppend( &res, recs.data, recs.len );
+   }
+   free( table.data );
+   free( recs.data );
+   free( lit.data );
+   *out = res.data;
+   return res.len;
+}
+
 #ifdef ESPFS_HEATSHRINK
-size_t compressHeatshrink( uint8_t *in, int insize, uint8_t *out, int outsize, int level )
+// Compress insize bytes with a fresh encoder state, returns the length of the compressed data
+size_t encodeHeatshrink( heatshrink_encoder *enc, uint8_t *in, int insize, uint8_t *out, int outsize )
 {
    uint8_t *inp = in;
    uint8_t *outp = out;
    size_t len;
-   int ws[] = {5, 6, 8, 11, 13};
-   int ls[] = {3, 3, 4, 4, 4};
    HSE_poll_res pres;
    HSE_sink_res sres;
    size_t r;
-   if( level == -1 ) level = 8;
-   level = ( level - 1 ) / 2; // level is now 0, 1, 2, 3, 4
-   heatshrink_encoder *enc = heatshrink_encoder_alloc( ws[level], ls[level] );
-   if( enc == NULL )
-   {
-      perror( "allocating mem for heatshrink" );
-      exit( 1 );
-   }
-   // Save encoder parms as first byte
-   *outp = ( ws[level] << 4 ) | ls[level];
-   outp++;
-   outsize--;
 
-   r = 1;
+   heatshrink_encoder_reset( enc );
+   if( insize == 0 ) heatshrink_encoder_finish( enc );
+
+   r = 0;
    do
    {
       if( insize > 0 )
@@ -106,6 +283,49 @@ size_t compressHeatshrink( uint8_t *in, int insize, uint8_t *out, int outsize, i
       fprintf( stderr, "Heatshrink: Bug? insize is still %d. sres=%d pres=%d\n", insize, sres, pres );
       exit( 1 );
    }
+   return r;
+}
+
+// With blockShift > 0 the file is compressed in independent blocks and a seek table is written
+// in front of them, see espfsformat.h
+size_t compressHeatshrink( uint8_t *in, int insize, uint8_t *out, int outsize, int level, int blockShift )
+{
+   uint8_t *outp = out;
+   int ws[] = {5, 6, 8, 11, 13};
+   int ls[] = {3, 3, 4, 4, 4};
+   size_t r;
+   if( level == -1 ) level = 8;
+   level = ( level - 1 ) / 2; // level is now 0, 1, 2, 3, 4
+   heatshrink_encoder *enc = heatshrink_encoder_alloc( ws[level], ls[level] );
+   if( enc == NULL )
+   {
+      perror( "allocating mem for heatshrink" );
+      exit( 1 );
+   }
+   // Save encoder parms as first byte
+   *outp = ( ws[level] << 4 ) | ls[level];
+
+   if( blockShift == 0 )
+   {
+      r = 1 + encodeHeatshrink( enc, in, insize, outp + 1, outsize - 1 );
+   }
+   else
+   {
+      int blockSize = 1 << blockShift;
+      int blockCount = ( insize + blockSize - 1 ) / blockSize;
+      int i;
+
+      outp[1] = blockShift;
+      outp[2] = blockCount;
+      outp[3] = blockCount >> 8;
+      r = 4 + 4 * blockCount;
+      for( i = 0; i < blockCount; i++ )
+      {
+         int len = ( insize - i * blockSize > blockSize ) ? blockSize : insize - i * blockSize;
+         *( ( int * )( outp + 4 + 4 * i ) ) = htoxl( r );
+         r += encodeHeatshrink( enc, in + i * blockSize, len, outp + r, outsize - r );
+      }
+   }
 
    heatshrink_encoder_free( enc );
    return r;
@@ -209,21 +429,122 @@ int parseGzipExtensions( char *input )
 }
 #endif
 
-int handleFile( int f, char *name, int compression, int level, char **compName )
+// The files are collected in memory, the index in front of them needs their positions
+OutBuf image = { NULL, 0, 0 };
+
+typedef struct
+{
+   uint32_t nameHash;
+   uint32_t offs;             // position of the header in image
+} IndexEntry;
+
+IndexEntry *indexEntries = NULL;
+int indexCount = 0;
+
+// FNV-1a hash of a file name for the index, see espfsformat.h
+uint32_t hashName( const char *name )
+{
+   uint32_t hash = 2166136261u;
+
+   while( *name )
+   {
+      hash ^= ( uint8_t )*name++;
+      hash *= 16777619u;
+   }
+   return hash ? hash : 1;
+}
+
+void indexAdd( const char *name, int offs )
+{
+   indexEntries = realloc( indexEntries, ( indexCount + 1 ) * sizeof( IndexEntry ) );
+   if( indexEntries == NULL )
+   {
+      perror( "allocating mem for index" );
+      exit( 1 );
+   }
+   indexEntries[indexCount].nameHash = hashName( name );
+   indexEntries[indexCount].offs = offs;
+   indexCount++;
+}
+
+// Write the index entry, the files follow it
+void writeIndex()
 {
-   uint8_t *fdat, *cdat;
+   EspFsHeader h;
+   OutBuf table = { NULL, 0, 0 };
+   int buckets = 2;
+   int nameLen = strlen( ESPFS_INDEX_NAME ) + 1;
+   int alignedNameLen = ( nameLen + 3 ) & ~3;
+   int size, i;
+
+   while( buckets < 2 * indexCount ) buckets *= 2;
+   if( buckets > 0x8000 )
+   {
+      fprintf( stderr, "Index: too many files\n" );
+      exit( 1 );
+   }
+
+   uint32_t *slots = calloc( buckets, 2 * sizeof( uint32_t ) );
+   if( slots == NULL )
+   {
+      perror( "allocating mem for index table" );
+      exit( 1 );
+   }
+   size =4 + buckets * 2 * sizeof( uint32_t );
+   int base = sizeof( EspFsHeader ) + alignedNameLen + size;
+   for( i = 0; i < indexCount; i++ )
+   {
+      int b = indexEntries[i].nameHash & ( buckets - 1 );
+      while( slots[2 * b] != 0 ) b = ( b + 1 ) & ( buckets - 1 );
+      slots[2 * b] = htoxl( indexEntries[i].nameHash );
+      slots[2 * b + 1] = htoxl( base + indexEntries[i].offs );
+   }
+   outU16( &table, buckets );
+   outU16( &table, indexCount );
+   outAppend( &table, slots, buckets * 2 * sizeof( uint32_t ) );
+   free( slots );
+
+   h.magic = ( 'E' << 0 ) + ( 'S' << 8 ) + ( 'f' << 16 ) + ( '2' << 24 );
+   h.flags = FLAG_INDEX;
+   h.compression = COMPRESS_NONE;
+   h.nameLen = htoxs( alignedNameLen );
+   h.fileLenComp = htoxl( size );
+   h.fileLenDecomp = htoxl( size );
+   h.hash = htoxl( hashContent( table.data, size, FLAG_INDEX ) );
+
+   write( 1, &h, sizeof( EspFsHeader ) );
+   write( 1, ESPFS_INDEX_NAME "\000\000\000", alignedNameLen );
+   write( 1, table.data, size );
+   free( table.data );
+}
+
+int handleFile( int f, char *name, int compression, int level, int blockShift, int precompile, char **compName )
+{
+   uint8_t *fdat, *cdat, *tdat;
    off_t size, csize;
    EspFsHeader h;
    int nameLen;
    int8_t flags = 0;
+   uint32_t hash;
+   int tsize;
    size = lseek( f, 0, SEEK_END );
    fdat = malloc( size );
    lseek( f, 0, SEEK_SET );
    read( f, fdat, size );
 
+   // the hash is over the original content, the client never sees the precompiled form
+   hash = hashContent( fdat, size, flags );
+   if( precompile && isTemplate( name ) && ( tsize = compileTemplate( fdat, size, &tdat ) ) != 0 )
+   {
+      free( fdat );
+      fdat = tdat;
+      size = tsize;
+      flags = FLAG_TEMPLATE;
+   }
 
 #ifdef ESPFS_GZIP
-   if( shouldCompressGzip( name ) )
+   // templates are rendered by the webserver and never sent gzip'ed
+   if( !( flags & FLAG_TEMPLATE ) && shouldCompressGzip( name ) )
    {
       csize = size * 3;
       if( csize < 100 ) // gzip has some headers that do not fit when trying to compress small files
@@ -232,6 +553,7 @@ int handleFile( int f, char *name, int compression, int level, char **compName )
       csize = compressGzip( fdat, size, cdat, csize, level );
       compression = COMPRESS_NONE;
       flags = FLAG_GZIP;
+      hash = hashContent( fdat, size, flags );
    }
    else
 #endif
@@ -243,8 +565,11 @@ int handleFile( int f, char *name, int compression, int level, char **compName )
       }
       else if( compression == COMPRESS_HEATSHRINK )
       {
-         cdat = malloc( size * 2 );
-         csize = compressHeatshrink( fdat, size, cdat, size * 2, level );
+         // a seek table is only worth it for files with more than one block
+         if( size <= ( 1 << blockShift ) ) blockShift = 0;
+         cdat = malloc( size * 2 + 64 );
+         csize = compressHeatshrink( fdat, size, cdat, size * 2 + 64, level, blockShift );
+         if( blockShift != 0 ) flags |= FLAG_SEEKTABLE;
 #endif
       }
       else
@@ -256,14 +581,16 @@ int handleFile( int f, char *name, int compression, int level, char **compName )
    if( csize > size )
    {
       // Compressing enbiggened this file. Revert to uncompressed store.
+      free( cdat );
       compression = COMPRESS_NONE;
       csize = size;
       cdat = fdat;
-      flags = 0;
+      flags &= FLAG_TEMPLATE;
+      if( flags == 0 ) hash = hashContent( fdat, size, flags );
    }
 
    // Fill header data
-   h.magic = ( 'E' << 0 ) + ( 'S' << 8 ) + ( 'f' << 16 ) + ( 's' << 24 );
+   h.magic = ( 'E' << 0 ) + ( 'S' << 8 ) + ( 'f' << 16 ) + ( '2' << 24 );
    h.flags = flags;
    h.compression = compression;
    h.nameLen = nameLen = strlen( name ) + 1;
@@ -271,21 +598,24 @@ int handleFile( int f, char *name, int compression, int level, char **compName )
    h.nameLen = htoxs( h.nameLen );
    h.fileLenComp = htoxl( csize );
    h.fileLenDecomp = htoxl( size );
+   h.hash = htoxl( hash );
 
-   write( 1, &h, sizeof( EspFsHeader ) );
-   write( 1, name, nameLen );
+   indexAdd( name, image.len );
+   outAppend( &image, &h, sizeof( EspFsHeader ) );
+   outAppend( &image, name, nameLen );
    while( nameLen & 3 )
    {
-      write( 1, "\000", 1 );
+      outAppend( &image, "\000", 1 );
       nameLen++;
    }
-   write( 1, cdat, csize );
+   outAppend( &image, cdat, csize );
    // Pad out to 32bit boundary
    while( csize & 3 )
    {
-      write( 1, "\000", 1 );
+      outAppend( &image, "\000", 1 );
       csize++;
    }
+   if( cdat != fdat ) free( cdat );
    free( fdat );
 
    if( compName != NULL )
@@ -317,13 +647,14 @@ int handleFile( int f, char *name, int compression, int level, char **compName )
 void finishArchive()
 {
    EspFsHeader h;
-   h.magic = ( 'E' << 0 ) + ( 'S' << 8 ) + ( 'f' << 16 ) + ( 's' << 24 );
+   h.magic = ( 'E' << 0 ) + ( 'S' << 8 ) + ( 'f' << 16 ) + ( '2' << 24 );
    h.flags = FLAG_LASTFILE;
    h.compression = COMPRESS_NONE;
    h.nameLen = htoxs( 0 );
    h.fileLenComp = htoxl( 0 );
    h.fileLenDecomp = htoxl( 0 );
-   write( 1, &h, sizeof( EspFsHeader ) );
+   h.hash = htoxl( 0 );
+   outAppend( &image, &h, sizeof( EspFsHeader ) );
 }
 
 int main( int argc, char **argv )
@@ -337,6 +668,9 @@ int main( int argc, char **argv )
    int err = 0;
    int compType;  // default compression type - heatshrink
    int compLvl = -1;
+   int blockShift = ESPFS_SEEK_BLOCK_SHIFT;
+   int precompile = 1;
+   int makeIndex = 0;
 
 #ifdef __MINGW32__
    setmode( fileno( stdout ), O_BINARY );
@@ -359,6 +693,22 @@ int main( int argc, char **argv )
          compLvl = atoi( argv[x + 1] );
          if( compLvl < 1 || compLvl > 9 ) err = 1;
          x++;
+      }
+      else if( strcmp( argv[x], "-t" ) == 0 && argc >= x - 2 )
+      {
+         precompile = atoi( argv[x + 1] );
+         x++;
+      }
+      else if( strcmp( argv[x], "-i" ) == 0 && argc >= x - 2 )
+      {
+         makeIndex = atoi( argv[x + 1] );
+         x++;
+      }
+      else if( strcmp( argv[x], "-s" ) == 0 && argc >= x - 2 )
+      {
+         blockShift = atoi( argv[x + 1] );
+         if( blockShift != 0 && ( blockShift < 8 || blockShift > 15 ) ) err = 1;
+         x++;
 #ifdef ESPFS_GZIP
       }
       else if( strcmp( argv[x], "-g" ) == 0 && argc >= x - 2 )
@@ -383,7 +733,7 @@ int main( int argc, char **argv )
    if( err )
    {
       fprintf( stderr, "%s - Program to create espfs images\n", argv[0] );
-      fprintf( stderr, "Usage: \nfind | %s [-c compressor] [-l compression_level] ", argv[0] );
+      fprintf( stderr, "Usage: \nfind | %s [-c compressor] [-l compression_level] [-s seek_block_shift] [-t 0|1] [-i 0|1] ", argv[0] );
 #ifdef ESPFS_GZIP
       fprintf( stderr, "[-g gzipped_extensions] " );
 #endif
@@ -395,6 +745,11 @@ int main( int argc, char **argv )
       fprintf( stderr, "0 - None( default )\n" );
 #endif
       fprintf( stderr, "\nCompression level: 1 is worst but low RAM usage, higher is better compression \nbut uses more ram on decompression. -1 = compressors default.\n" );
+      fprintf( stderr, "\nTemplates: 1 precompiles files with .tpl in the name for the webserver ( default ), 0 stores them as they are.\n" );
+      fprintf( stderr, "\nIndex: 1 puts a hash table of the file names in front of the files, which lets the \nwebserver open a file without walking the image. 0 = no index ( default ).\n" );
+#ifdef ESPFS_HEATSHRINK
+      fprintf( stderr, "\nSeek block shift: heatshrink compresses files in blocks of 2^n bytes, which allows \nto start reading at a block boundary. 8..15, 0 = no seek table. Defaults to %d\n", ESPFS_SEEK_BLOCK_SHIFT );
+#endif
 #ifdef ESPFS_GZIP
       fprintf( stderr, "\nGzipped extensions: list of comma separated, case sensitive file extensions \nthat will be gzipped. Defaults to 'html,css,js'\n" );
 #endif
@@ -417,7 +772,7 @@ int main( int argc, char **argv )
          if( f > 0 )
          {
             char *compName = "unknown";
-            rate = handleFile( f, realName, compType, compLvl, &compName );
+            rate = handleFile( f, realName, compType, compLvl, blockShift, precompile, &compName );
             fprintf( stderr, "%s ( %d%%, %s )\n", realName, rate, compName );
             close( f );
          }
@@ -435,6 +790,8 @@ int main( int argc, char **argv )
       }
    }
    finishArchive();
+   if( makeIndex ) writeIndex();
+   write( 1, image.data, image.len );
    return 0;
 }
 
@@ -0,0 +1,68 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things
+//
+// File          cgieventsource.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+#ifndef __CGIEVENTSOURCE_H__
+#define __CGIEVENTSOURCE_H__
+
+#include "httpd.h"
+
+/*
+Server-Sent Events ( text/event-stream ), a one way alternative to websockets for pages which
+only listen. The route gets an EventSource as argument:
+
+   static EventSource statusEvents;
+   ROUTE_EVENTSOURCE( "/events", &statusEvents ),
+
+eventSourcePublish() sends an event to all clients of the EventSource. The last events are
+kept, a client which reconnects with Last-Event-ID gets the ones it missed. A new client gets the
+current state events. Each client holds a connection as long as the page is open.
+*/
+
+// Number of events kept for clients which reconnect
+#ifndef EVENTSOURCE_BACKLOG
+   #define EVENTSOURCE_BACKLOG      8
+#endif
+
+// The event describes a state: only the latest one of its type is kept, a new client gets it
+// on connect and data equal to the kept one is not sent again.
+#define EVENTSOURCE_FLAG_STATE      ( 1 << 0 )
+
+typedef struct EventSourceClient EventSourceClient;
+
+typedef struct
+{
+   const char *type;          // event name, a constant string
+   char *data;
+   int len;
+   uint32_t id;
+   int flags;
+} EventSourceEvent;
+
+typedef struct
+{
+   uint32_t lastId;
+   int count;
+   EventSourceEvent events[EVENTSOURCE_BACKLOG];   // oldest first
+   EventSourceClient *clients;
+} EventSource;
+
+CgiStatus ICACHE_FLASH_ATTR cgiEventSource( HttpdConnData *connData );
+
+// Send an event to the clients, each line of data is a data field. Returns the number of clients sent to,
+// 0 for an unchanged state and -1 if the event can't be kept.
+int ICACHE_FLASH_ATTR eventSourcePublish( HttpdInstance *pInstance, EventSource *es, const char *type,
+                                          const char *data, int len, int flags );
+
+#endif // __CGIEVENTSOURCE_H__
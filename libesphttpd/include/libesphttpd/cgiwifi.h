@@ -14,6 +14,7 @@ CgiStatus ICACHE_FLASH_ATTR cgiWiFiConnect( HttpdConnData *connData );
 CgiStatus ICACHE_FLASH_ATTR cgiWiFiSetMode( HttpdConnData *connData );
 CgiStatus ICACHE_FLASH_ATTR cgiWiFiSetChannel( HttpdConnData *connData );
 CgiStatus ICACHE_FLASH_ATTR cgiWiFiConnStatus( HttpdConnData *connData );
+int ICACHE_FLASH_ATTR cgiWiFiConnStatusJson( char *buf, int bufsize );
 CgiStatus ICACHE_FLASH_ATTR cgiWiFiSetSSID( HttpdConnData *connData );
 
 #endif
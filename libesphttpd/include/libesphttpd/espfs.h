@@ -1,10 +1,34 @@
 #ifndef ESPFS_H
 #define ESPFS_H
 
+#include <stdint.h>
+
 // This define is done in Makefile. If you do not use default Makefile, uncomment
 // to be able to use Heatshrink-compressed espfs images.
 // #define ESPFS_HEATSHRINK
 
+// Number of files which can be open at the same time, one per connection is enough for httpd
+#ifndef ESPFS_MAX_OPEN_FILES
+   #define ESPFS_MAX_OPEN_FILES        8
+#endif
+
+// Number of heatshrink compressed files which can be open at the same time. Each decoder is
+// a static buffer with a window of ESPFS_HEATSHRINK_WINDOW_BITS, 11 is the window of the default
+// compression level of mkespfsimage. With the read-ahead buffer a decoder takes about 2.4 kB of
+// DRAM. Requests for compressed files beyond the decoders are answered with 503 and Retry-After.
+#ifndef ESPFS_HEATSHRINK_DECODERS
+   #define ESPFS_HEATSHRINK_DECODERS   2
+#endif
+
+#ifndef ESPFS_HEATSHRINK_WINDOW_BITS
+   #define ESPFS_HEATSHRINK_WINDOW_BITS 11
+#endif
+
+// Bytes of compressed data each decoder reads from the flash at once, a multiple of 4
+#ifndef ESPFS_READ_AHEAD
+   #define ESPFS_READ_AHEAD            256
+#endif
+
 typedef enum
 {
    ESPFS_INIT_RESULT_OK,
@@ -12,14 +36,37 @@ typedef enum
    ESPFS_INIT_RESULT_BAD_ALIGN,
 } EspFsInitResult;
 
+// Why espFsOpen() returned NULL
+typedef enum
+{
+   ESPFS_OPEN_OK,
+   ESPFS_OPEN_NOT_FOUND,
+   ESPFS_OPEN_BUSY,           // all file handles or decoders in use, try again later
+   ESPFS_OPEN_FAILED,         // unknown compression or a heatshrink window too large
+} EspFsOpenResult;
+
 typedef struct EspFsFile EspFsFile;
 
+// File information, see espFsStat()
+typedef struct
+{
+   int flags;        // FLAG_* of the file
+   int size;         // number of bytes espFsRead() delivers
+   uint32_t hash;    // hash of the content, 0 if the image has none
+} EspFsStat;
+
 // here we cannot use ICACHE_FLASH_ATTR, it's in conflict with the mkespfsimage build
 
 EspFsInitResult espFsInit( void *flashAddress );
 EspFsFile *espFsOpen( const char *fileName );
+EspFsOpenResult espFsOpenResult( void );
+int espFsStat( const char *fileName, EspFsStat *st );
 int espFsFlags( EspFsFile *fh );
+int espFsFileSize( EspFsFile *fh );
+uint32_t espFsFileHash( EspFsFile *fh );
 int espFsRead( EspFsFile *fh, char *buf, int len );
+int espFsSeek( EspFsFile *fh, int pos );
+int espFsReadPtr( EspFsFile *fh, const char **ptr, int len );
 void espFsClose( EspFsFile *fh );
 
 
@@ -21,16 +21,38 @@
    #include <netinet/in.h>
 #endif
 
+// Linux only: serve the connections with edge triggered epoll instead of select(). The
+// connections are split between HTTPD_EPOLL_WORKERS threads, each thread owns its share of the
+// connection list and accepts its connections on an own SO_REUSEPORT socket. Calls into the
+// httpd core are still serialized by the global httpd lock.
+#ifdef CONFIG_ESPHTTPD_EPOLL
+   #ifndef linux
+      #error "CONFIG_ESPHTTPD_EPOLL needs linux"
+   #endif
+   #ifdef CONFIG_ESPHTTPD_SSL_SUPPORT
+      #error "CONFIG_ESPHTTPD_EPOLL doesn't support ssl"
+   #endif
+   #ifndef HTTPD_EPOLL_WORKERS
+      #define HTTPD_EPOLL_WORKERS   1
+   #endif
+#endif
+
 struct RtosConnType
 {
    int fd;
    int needWriteDoneNotif;
    int needsClose;
+   int idleTimeout;        // seconds without activity until the connection is closed, 0 = never
+   uint32_t idleSince;     // time of the last activity in seconds
    int port;
    char ip[4];
 #ifdef CONFIG_ESPHTTPD_SSL_SUPPORT
    SSL *ssl;
 #endif
+#ifdef CONFIG_ESPHTTPD_EPOLL
+   struct HttpdEpollWorker *pWorker;   // thread serving the connection
+   int armedOut;           // the fd is registered for EPOLLOUT
+#endif
 
    // server connection data structure
    HttpdConnData connData;
@@ -38,7 +60,20 @@ struct RtosConnType
 
 #define RECV_BUF_SIZE 2048
 
-typedef struct
+#ifdef CONFIG_ESPHTTPD_EPOLL
+typedef struct HttpdEpollWorker
+{
+   struct HttpdFreertosInstance *pInstance;
+   int index;
+   int first, last;        // the connections [first, last) of rConnList belong to this thread
+   int epfd;
+   int listenfd;
+   int wakefd;             // eventfd, other threads ask for a look at the connections
+   bool listening;         // listenfd is registered, there are free connections
+} HttpdEpollWorker;
+#endif
+
+typedef struct HttpdFreertosInstance
 {
    RtosConnType *rConnList;
 
@@ -61,10 +96,20 @@ typedef struct
    xQueueHandle httpdMux;
 #endif
 
+#if defined( linux ) && !defined( CONFIG_ESPHTTPD_EPOLL )
+   int resumefd;           // eventfd, wakes the select loop for httpdRunResumed()
+#endif
+
 #ifdef CONFIG_ESPHTTPD_SSL_SUPPORT
    SSL_CTX *ctx;
 #endif
 
+#ifdef CONFIG_ESPHTTPD_EPOLL
+   HttpdEpollWorker worker[HTTPD_EPOLL_WORKERS];
+   int runningWorkers;
+   volatile bool shutdown;
+#endif
+
    HttpdInstance httpdInstance;
 } HttpdFreertosInstance;
 
@@ -9,6 +9,19 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   httpdSuspend(), httpdResume(): a cgi waits for an event without blocking
+//    2026-10-19  AWe   httpdArenaAlloc(): scratch memory of a request, freed all at once
+//    2026-10-19  AWe   the request head is kept in a pooled buffer while it is received, then compacted
+//    2026-10-19  AWe   ROUTE_FLAG_DEFLATE, gzip compression of dynamic responses, see httpddeflate.h
+//    2026-10-19  AWe   request metrics, see httpdmetrics.h
+//    2026-10-19  AWe   admission control: reserved connections for priority routes, route flags
+//    2026-10-19  AWe   httpdParseArgs(): decode get/post arguments once into an indexed table
+//    2026-10-19  AWe   httpdCaptureStart(), httpdCaptureEnd() to record a response body
+//    2026-10-19  AWe   httpdSendReserve(), httpdSendSpan() to send without extra copies
+//    2026-10-19  AWe   configurable Cache-Control header, HTTPD_CACHE_CONTROL
+//    2026-10-19  AWe   persistent connections: Content-Length responses, pipelining, idle timeout
+//    2026-10-19  AWe   index of the well known request headers, httpdGetHeaderById()
+//    2026-10-19  AWe   incremental request head parser, keep offsets of the header lines
 //    2018-04-19  AWe   for priv buffer and sendData buffer allocate memory from
 //                        heap when needed. Give up to have buffers in the memory space.
 //    2018-01-19  AWe   update to chmorgan/libesphttpd
@@ -48,11 +61,24 @@
    #define HTTPD_SERVERNAME "esp-httpd ( awe ) " HTTPDVER
 #endif
 
-// Max length of request head. This is statically allocated for each connection.
+// Max length of request head. A buffer of this size is taken from the pool of the instance while
+// the head is received, afterwards the head is moved into a block of its actual size.
 #ifndef HTTPD_MAX_HEAD_LEN
    #define HTTPD_MAX_HEAD_LEN    1024
 #endif
 
+// Number of free head buffers kept by the instance for the next requests, instead of
+// giving them back to the heap.
+#ifndef HTTPD_HEAD_POOL_SIZE
+   #define HTTPD_HEAD_POOL_SIZE  2
+#endif
+
+// Max number of request header lines, which are not in HttpdHeaderId, whose name/value offsets
+// are kept for httpdGetHeader(). Additional header lines are still parsed, but can't be looked up later.
+#ifndef HTTPD_MAX_HEADERS
+   #define HTTPD_MAX_HEADERS     8
+#endif
+
 // Max post buffer len. This is dynamically malloc'ed if needed.
 #ifndef HTTPD_MAX_POST_LEN
    #define HTTPD_MAX_POST_LEN    2048
@@ -70,6 +96,57 @@
    #define HTTPD_MAX_BACKLOG_SIZE   ( 4*1024 )
 #endif
 
+// Idle time in seconds after which a persistent ( keep-alive ) connection without a pending
+// request is closed.
+#ifndef HTTPD_KEEPALIVE_TIMEOUT
+   #define HTTPD_KEEPALIVE_TIMEOUT  5
+#endif
+
+// Max amount of pipelined request data, which is held back while the response to the
+// previous request on the same connection is still being sent.
+#ifndef HTTPD_MAX_PIPELINE_LEN
+   #define HTTPD_MAX_PIPELINE_LEN   HTTPD_MAX_HEAD_LEN
+#endif
+
+// Cache-Control header of static files, except html, text and json, see httpdAddCacheHeaders().
+// The files have an ETag, so the browser can revalidate them cheaply when they are expired.
+#ifndef HTTPD_CACHE_CONTROL
+   #define HTTPD_CACHE_CONTROL      "max-age=7200, public, must-revalidate"
+#endif
+
+// Max number of arguments httpdParseArgs() keeps, further arguments are ignored. At most 255.
+#ifndef HTTPD_MAX_ARGS
+   #define HTTPD_MAX_ARGS           24
+#endif
+
+// Number of hash buckets of the argument table, a power of 2
+#define HTTPD_ARGS_HASH_SIZE        32
+
+// Size of the chunks of the request arena, see httpdArenaAlloc(). All chunks have this size,
+// except those for larger allocations, so the freed chunks fit the next ones.
+#ifndef HTTPD_ARENA_CHUNK_SIZE
+   #define HTTPD_ARENA_CHUNK_SIZE   256
+#endif
+
+// Max number of cgis waiting for an event at the same time, see httpdSuspend(). At most 255.
+#ifndef HTTPD_MAX_SUSPENDED
+   #define HTTPD_MAX_SUSPENDED      4
+#endif
+
+// Resolution of the timeouts of waiting cgis in ms
+#ifndef HTTPD_SUSPEND_TICK_MS
+   #define HTTPD_SUSPEND_TICK_MS    100
+#endif
+
+// Number of connections kept for requests to priority routes ( ROUTE_FLAG_PRIORITY ) and
+// websockets. Other requests wait while all remaining connections are busy, requests with a body
+// are answered with 503. Idle persistent connections are closed when a new client takes one of
+// the reserved connections, static file transfers when all connections are in use. 0 disables
+// the admission control.
+#ifndef HTTPD_RESERVED_CONNECTIONS
+   #define HTTPD_RESERVED_CONNECTIONS  1
+#endif
+
 // Max length of CORS token. This amount is allocated per connection.
 #define HTTPD_MAX_CORS_TOKEN_LEN 256
 
@@ -105,6 +182,28 @@ typedef enum
    HTTPD_TRANSFER_NONE
 } TransferModes;
 
+// Request headers known to the server. The parser keeps their position in a table indexed
+// by this id, so looking them up doesn't need a string compare.
+
+typedef enum
+{
+   HTTPD_HDR_HOST,
+   HTTPD_HDR_CONNECTION,
+   HTTPD_HDR_CONTENT_LENGTH,
+   HTTPD_HDR_CONTENT_TYPE,
+   HTTPD_HDR_ACCEPT_ENCODING,
+   HTTPD_HDR_AUTHORIZATION,
+   HTTPD_HDR_UPGRADE,
+   HTTPD_HDR_SEC_WEBSOCKET_KEY,
+   HTTPD_HDR_IF_NONE_MATCH,
+   HTTPD_HDR_RANGE,
+   HTTPD_HDR_ORIGIN,
+   HTTPD_HDR_ACCESS_CONTROL_REQUEST_HEADERS,
+   HTTPD_HDR_LAST_EVENT_ID,
+   HTTPD_HDR_COUNT,              // number of known headers
+   HTTPD_HDR_OTHER = HTTPD_HDR_COUNT
+} HttpdHeaderId;
+
 typedef struct HttpdPriv HttpdPriv;
 typedef struct HttpdConnData HttpdConnData;
 typedef struct HttpdPostData HttpdPostData;
@@ -125,25 +224,85 @@ struct HttpSendBacklogItem
 };
 #endif
 
+// Position of a parsed header line in HttpdPriv.head, both strings are zero terminated
+typedef struct
+{
+   uint16_t name;
+   uint16_t value;
+} HttpdHeaderRef;
+
 // Private data for http connection
 struct HttpdPriv
 {
-   char  head[HTTPD_MAX_HEAD_LEN];
+   char  *head;           // request head, NULL if none, see httpdCompactHead()
+   int   headSize;        // allocated size of head
 #ifdef CONFIG_ESPHTTPD_CORS_SUPPORT
    char  corsToken[HTTPD_MAX_CORS_TOKEN_LEN];
 #endif
    int   headPos;
+
+   // state of the incremental head parser, see httpdParseHead()
+   int   lineStart;       // offset of the line currently received
+   int   postLen;         // Content-Length, becomes post.len when the head is complete
+   uint8_t parseState;
+   uint8_t lineDropped;   // current line didn't fit into head and is skipped
+   uint8_t headerCount;
+   uint16_t knownHeaders[HTTPD_HDR_COUNT];   // offset of the value in head, 0 if not received
+   HttpdHeaderRef headers[HTTPD_MAX_HEADERS]; // all other headers
+
    char  *sendBuff;
    int   sendBuffLen;
 
    /** NOTE: chunkHdr, if valid, points at memory assigned to sendBuff
       so it doesn't have to be freed */
    char *chunkHdr;
+   int   teHdrPos;        // offset of "Transfer-Encoding: chunked" in sendBuff, 0 if not there
+   int   contentLen;      // response length set by httpdSetContentLength()
+
+   // data sent in place after sendBuff, see httpdSendSpan()
+   const char *sendSpan;
+   int   sendSpanLen;
+
+   // copy of the response body, see httpdCaptureStart()
+   char  *capBuf;
+   int   capLen;
+   int   capSize;
+   int   capMax;
+
+   // data of pipelined requests received while the current one is still processed
+   char  *pipeBuf;
+   int   pipeLen;
+
+   // admission control, see HTTPD_RESERVED_CONNECTIONS
+   HttpdConnData *nextConn;   // list of the connections of the instance
+   uint32_t lastActive;       // value of HttpdInstance.activity at the last receive or send
+   uint16_t requests;         // number of requests on this connection
+   uint8_t priority;          // the current request is for a priority route
+   uint8_t parked;            // the request waits for a free connection
+   uint8_t evicted;           // closed to make room
+
+#ifdef CONFIG_ESPHTTPD_DEFLATE
+   struct HttpdDeflate *deflate;    // compressor of the response body, see httpdFlushDeflate()
+   int   bodyPos;         // offset of the body in sendBuff, headers are in front
+#endif
+
+#ifdef CONFIG_ESPHTTPD_METRICS
+   uint32_t reqStart;         // httpdMetricsNow() at the request line
+   uint32_t txBytes;          // bytes sent for the request
+   uint16_t status;           // status code of the response
+   uint16_t route;            // index of the route, 0xffff if none
+#endif
 
 #ifdef CONFIG_ESPHTTPD_BACKLOG_SUPPORT
    HttpSendBacklogItem *sendBacklog;
    int   sendBacklogSize;
 #endif
+   struct HttpdArenaChunk *arena;   // scratch memory of the request, see httpdArenaAlloc()
+
+   // the cgi waits for an event, see httpdSuspend()
+   HttpdInstance *instance;   // the instance the connection belongs to
+   uint32_t suspendId;        // id of the wait, 0 if the cgi isn't waiting
+   uint8_t timedOut;          // the last wait ended with its timeout
    int   flags;
 };
 
@@ -184,8 +343,15 @@ typedef struct
    cgiSendCallback cgiCb;
    const void *cgiArg;
    const void *cgiArg2;
+   int flags;              // ROUTE_FLAG_*, a word because the table may be stored in flash
 } HttpdBuiltInUrl;
 
+// requests for this route are admitted to the reserved connections, see HTTPD_RESERVED_CONNECTIONS
+#define ROUTE_FLAG_PRIORITY   ( 1 << 0 )
+// responses of this route are sent gzip compressed when the client accepts it and
+// CONFIG_ESPHTTPD_DEFLATE is set, meant for templates and other dynamic content
+#define ROUTE_FLAG_DEFLATE    ( 1 << 1 )
+
 const char* ICACHE_FLASH_ATTR httpdGetVersion( void );
 void ICACHE_FLASH_ATTR httpdRedirect( HttpdConnData *connData, const char *newUrl );
 
@@ -197,6 +363,38 @@ void ICACHE_FLASH_ATTR httpdRedirect( HttpdConnData *connData, const char *newUr
 bool ICACHE_FLASH_ATTR httpdUrlDecode( const char *val, int valLen, char *ret, int retLen, int* bytesWritten );
 int  ICACHE_FLASH_ATTR httpdFindArg( const char *line, const char *arg, char *buf, int buffLen );
 
+// An url-decoded argument of get- or post-data, see httpdParseArgs()
+typedef struct
+{
+   const char *name;
+   const char *value;      // "" if the argument has no '='
+   int valueLen;
+   uint16_t hash;
+   uint8_t next;           // next argument in the same hash bucket, 0xff: none
+} HttpdArg;
+
+typedef struct
+{
+   char *buf;              // decoded names and values, NULL if they are in the request arena
+   int count;
+   HttpdArg arg[ HTTPD_MAX_ARGS ];        // in the order of the argument string
+   uint8_t bucket[ HTTPD_ARGS_HASH_SIZE ];
+} HttpdArgs;
+
+// Decode all arguments of a string of get- or post-data in one pass. Afterwards
+// args->arg[ 0 .. args->count-1 ] can be iterated, or an argument is looked up by name with
+// httpdGetArg(). Repeated names are returned in order by httpdGetNextArg().
+// @return Number of arguments, -1 if out of memory. Call httpdFreeArgs() in any case.
+
+int  ICACHE_FLASH_ATTR httpdParseArgs( HttpdArgs *args, const char *line );
+void ICACHE_FLASH_ATTR httpdFreeArgs( HttpdArgs *args );
+
+// The same as httpdParseArgs(), the decoded arguments are kept in the request arena and
+// don't need httpdFreeArgs().
+int  ICACHE_FLASH_ATTR httpdParseArgsArena( HttpdConnData *connData, HttpdArgs *args, const char *line );
+const HttpdArg* ICACHE_FLASH_ATTR httpdGetArg( const HttpdArgs *args, const char *name );
+const HttpdArg* ICACHE_FLASH_ATTR httpdGetNextArg( const HttpdArgs *args, const HttpdArg *arg );
+
 typedef enum
 {
    HTTPD_FLAG_NONE = ( 1 << 0 ),
@@ -214,6 +412,10 @@ typedef struct HttpdInstance
 {
    const HttpdBuiltInUrl *builtInUrls;
    int maxConnections;
+   HttpdConnData *connList;   // open connections, linked by HttpdPriv.nextConn
+   uint32_t activity;         // counts receive and send events of all connections
+   char *headPool[HTTPD_HEAD_POOL_SIZE];  // free buffers of HTTPD_MAX_HEAD_LEN bytes
+   int headPoolCount;
 } HttpdInstance;
 
 typedef enum
@@ -228,6 +430,15 @@ typedef enum
 const char* ICACHE_FLASH_ATTR httpdGetMimetype( const char *url );
 const char* ICACHE_FLASH_ATTR httpdMethodName( RequestTypes m );
 void ICACHE_FLASH_ATTR httpdSetTransferMode( HttpdConnData *connData, TransferModes mode );
+
+/**
+ * Send the response with a Content-Length header instead of chunked, the connection stays open
+ * for the next request if the client allows it.
+ *
+ * NOTE: must be called before httpdStartResponse(), exactly len bytes of body have to follow
+ */
+void ICACHE_FLASH_ATTR httpdSetContentLength( HttpdConnData *connData, int len );
+
 void ICACHE_FLASH_ATTR httpdStartResponse( HttpdConnData *connData, int code );
 void ICACHE_FLASH_ATTR httpdHeader( HttpdConnData *connData, const char *field, const char *val );
 void ICACHE_FLASH_ATTR httpdEndHeaders( HttpdConnData *connData );
@@ -242,9 +453,80 @@ void ICACHE_FLASH_ATTR httpdEndHeaders( HttpdConnData *connData );
  */
 bool ICACHE_FLASH_ATTR httpdGetHeader( HttpdConnData *connData, const char *header, char *ret, int retLen );
 
+/**
+ * Get the value of a well known header in the HTTP client head without copying it.
+ * Returns a pointer into the head buffer, or NULL when the header wasn't sent.
+ *
+ * NOTE: the pointer is valid until the request is finished. When the cgi installs a receive
+ *       handler ( websocket ), the headers are released after its first call, only the url stays.
+ */
+const char * ICACHE_FLASH_ATTR httpdGetHeaderById( HttpdConnData *connData, HttpdHeaderId id );
+
+/**
+ * Allocate scratch memory for the current request. There is no free of single allocations,
+ * the whole arena is released when the cgi is done or the connection is closed. For a cgi
+ * which takes the connection over ( websocket ) that is at the end of the connection.
+ * The memory is aligned to 8 bytes and not cleared.
+ * Returns NULL when out of memory.
+ *
+ * NOTE: pointers into the arena must not be kept beyond the request
+ */
+void* ICACHE_FLASH_ATTR httpdArenaAlloc( HttpdConnData *connData, int size );
+
+typedef uint32_t HttpdSuspendId;
+
+/**
+ * Let the cgi wait for an event without blocking the server, e.g. the end of a wifi scan or of
+ * a flash job. The cgi returns HTTPD_CGI_MORE and gives the id to the code which reports the
+ * event, that calls httpdResume() with it. The cgi is called again after the event or after
+ * timeoutMs, httpdSuspendTimedOut() tells which one. 0 waits without a timeout.
+ * Until then the cgi isn't called, except with isConnectionClosed when the client goes away.
+ * Returns 0 if too many cgis wait, see HTTPD_MAX_SUSPENDED.
+ *
+ * NOTE: the request body must be received before, the cgi is called for each part of it
+ */
+HttpdSuspendId ICACHE_FLASH_ATTR httpdSuspend( HttpdConnData *connData, int timeoutMs );
+
+/**
+ * End the wait of a cgi. It is called again in the context of the server, not in the one of
+ * the caller, so this can be called from callbacks of the SDK or other threads.
+ * Returns false if the cgi doesn't wait anymore, e.g. its connection was closed.
+ */
+bool ICACHE_FLASH_ATTR httpdResume( HttpdSuspendId id );
+
+// Did the last wait of the cgi end with its timeout?
+bool ICACHE_FLASH_ATTR httpdSuspendTimedOut( HttpdConnData *connData );
+
 int  ICACHE_FLASH_ATTR httpdSend( HttpdConnData *connData, const char *data, int len );
+// Send escaped data, as much as fits in the send buffer. Return the number of bytes of data
+// sent, the rest is sent in the next call of the cgi.
 int  ICACHE_FLASH_ATTR httpdSend_js( HttpdConnData *connData, const char *data, int len );
 int  ICACHE_FLASH_ATTR httpdSend_html( HttpdConnData *connData, const char *data, int len );
+
+/**
+ * Get the free space of the send buffer to fill it directly, e.g. by reading a file into it.
+ * Returns the write position and the free space in len, which may be 0.
+ * Call httpdSendCommit() with the number of bytes written.
+ */
+char* ICACHE_FLASH_ATTR httpdSendReserve( HttpdConnData *connData, int *len );
+void ICACHE_FLASH_ATTR httpdSendCommit( HttpdConnData *connData, int len );
+
+/**
+ * Send data in place, without copying it into the send buffer. It is sent after the content
+ * of the send buffer when the cgi returns, so it must stay valid until then, e.g. memory
+ * mapped flash. At most HTTPD_MAX_SENDBUFF_LEN bytes, one span per cgi call and not for
+ * chunked responses. Returns false if the span can't be taken.
+ */
+bool ICACHE_FLASH_ATTR httpdSendSpan( HttpdConnData *connData, const char *data, int len );
+
+/**
+ * Record a copy of the response body sent from now on, e.g. to cache a rendered page.
+ * Recording stops when the body exceeds maxLen bytes.
+ * httpdCaptureEnd() returns the recorded body, allocated with malloc(), or NULL if it was
+ * too long. The caller owns the buffer.
+ */
+bool ICACHE_FLASH_ATTR httpdCaptureStart( HttpdConnData *connData, int maxLen );
+char* ICACHE_FLASH_ATTR httpdCaptureEnd( HttpdConnData *connData, int *len );
 bool ICACHE_FLASH_ATTR httpdFlushSendBuffer( HttpdInstance *pInstance, HttpdConnData *connData );
 CallbackStatus ICACHE_FLASH_ATTR httpdContinue( HttpdInstance *pInstance, HttpdConnData *connData );
 CallbackStatus ICACHE_FLASH_ATTR httpdConnSendStart( HttpdInstance *pInstance, HttpdConnData *connData );
@@ -253,6 +535,7 @@ void ICACHE_FLASH_ATTR httpdAddCacheHeaders( HttpdConnData *connData, const char
 void ICACHE_FLASH_ATTR httdResponseOptions( HttpdConnData *connData, int cors );
 
 // Platform dependent code should call these.
+void ICACHE_FLASH_ATTR httpdRunResumed( HttpdInstance *pInstance );   // after httpdPlatPostResume()
 CallbackStatus ICACHE_FLASH_ATTR httpdSentCb( HttpdInstance *pInstance, HttpdConnData *connData );
 CallbackStatus ICACHE_FLASH_ATTR httpdRecvCb( HttpdInstance *pInstance, HttpdConnData *connData, char *data, unsigned short len );
 CallbackStatus ICACHE_FLASH_ATTR httpdDisconCb( HttpdInstance *pInstance, HttpdConnData *connData );
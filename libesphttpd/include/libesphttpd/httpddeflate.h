@@ -0,0 +1,73 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          httpddeflate.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   HTTPD_DEFLATE_STATES, HTTPD_DEFLATE_OUT_LEN
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+#ifndef __HTTPDDEFLATE_H__
+#define __HTTPDDEFLATE_H__
+
+#include <stdint.h>
+
+/*
+Streaming gzip encoder for dynamic responses, enabled with CONFIG_ESPHTTPD_DEFLATE. Routes with
+ROUTE_FLAG_DEFLATE are sent with Content-Encoding: gzip when the client accepts it, the body is
+compressed when the send buffer is flushed.
+
+The encoder finds matches with a single hash lookup in a small window and writes one deflate
+block with the fixed Huffman codes, so it needs no code tables in RAM. Its state is about
+2 * HTTPD_DEFLATE_WINDOW + 2 * HTTPD_DEFLATE_HASH_SIZE bytes per compressed response.
+
+The states come from a static pool, a response is sent uncompressed when all are in use. The
+output is assembled in one static buffer of HTTPD_DEFLATE_OUT_LEN bytes, which the flushes
+share under the httpd lock.
+*/
+
+// Size of the window in which matches are searched, at most 16384. Matches don't reach back
+// further than this into previous output, a larger window compresses a bit better.
+#ifndef HTTPD_DEFLATE_WINDOW
+   #define HTTPD_DEFLATE_WINDOW     512
+#endif
+
+// Number of entries of the hash table, a power of 2
+#ifndef HTTPD_DEFLATE_HASH_SIZE
+   #define HTTPD_DEFLATE_HASH_SIZE  256
+#endif
+
+// Max size of the output for len bytes of input, including the gzip header and trailer.
+// Literals take up to 9 bits.
+#define HTTPD_DEFLATE_BOUND( len )  ( ( len ) + ( len ) / 8 + 32 )
+
+// Number of responses which can be compressed at the same time
+#ifndef HTTPD_DEFLATE_STATES
+   #define HTTPD_DEFLATE_STATES     2
+#endif
+
+// Output of a flush: the headers and the compressed send buffer, the compressed span of at most
+// HTTPD_MAX_SENDBUFF_LEN bytes, the end of the stream and the chunk framing
+#define HTTPD_DEFLATE_OUT_LEN       ( 2 * HTTPD_DEFLATE_BOUND( HTTPD_MAX_SENDBUFF_LEN ) + \
+                                      HTTPD_DEFLATE_BOUND( 0 ) + 16 )
+
+typedef struct HttpdDeflate HttpdDeflate;
+
+HttpdDeflate* ICACHE_FLASH_ATTR httpdDeflateNew( void );
+void ICACHE_FLASH_ATTR httpdDeflateFree( HttpdDeflate *d );
+
+// Compress len bytes, the output is written to out. Returns the number of bytes written, at
+// most HTTPD_DEFLATE_BOUND( len ). Some bits may be held back until the next call.
+int ICACHE_FLASH_ATTR httpdDeflate( HttpdDeflate *d, const char *data, int len, char *out );
+
+// End the stream, writes at most HTTPD_DEFLATE_BOUND( 0 ) bytes. Returns the number of bytes written.
+int ICACHE_FLASH_ATTR httpdDeflateFinish( HttpdDeflate *d, char *out );
+
+#endif // __HTTPDDEFLATE_H__
@@ -9,6 +9,11 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   StaticFileData.end
+//    2026-10-19  AWe   tplSend() returns the number of bytes sent
+//    2026-10-19  AWe   add cgiEspFsTemplateCached(), tplNoCache()
+//    2026-10-19  AWe   TplData: state of precompiled templates
+//    2026-10-19  AWe   add StaticFileData for serving a byte range of a file
 //    2018-01-18  AWe   update to chmorgan/libesphttpd
 //                         https://github.com/chmorgan/libesphttpd/commits/cmo_minify
 //                         Latest commit d15cc2e  from 5. Januar 2018
@@ -24,6 +29,7 @@
 
 #include "httpd.h"
 #include "espfs.h"
+#include "rendercache.h"
 
 #define FILE_CHUNK_LEN 1024
 
@@ -41,6 +47,14 @@ typedef enum
 }
 TplEncode;
 
+typedef struct
+{
+   EspFsFile *file;
+   int remaining;             // number of bytes still to send, the range end for 206 responses
+   int end;                   // end of the range in the file, the read position is end - remaining
+}
+StaticFileData;
+
 typedef struct
 {
    EspFsFile *file;
@@ -57,15 +71,38 @@ typedef struct
    char *buff_e;
 
    TplEncode tokEncode;
+
+   // precompiled templates, see espfsformat.h
+   uint16_t *tokOffs;         // offset of each token name in tokTable, NULL if parsed at runtime
+   char *tokTable;            // token table, allocated together with tokOffs
+   int tokCount;
+   int tokId;                 // token to process, with chunk_resume
+   int litLen;                // bytes of the current literal still to send
+
+   // render cache, see cgiEspFsTemplateCached()
+   bool cache;                // the body is recorded for the cache
+   bool noCache;              // set by tplNoCache()
+   uint32_t cacheGen;         // generation when the rendering started
+   RenderCacheEntry *replay;  // cached body to send, NULL while rendering
+   int replayPos;
 }
 TplData;
 
 CgiStatus ICACHE_FLASH_ATTR cgiEspFsHook( HttpdConnData *connData );
 CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplate( HttpdConnData *connData );
+
+// Like cgiEspFsTemplate, but the rendered body is kept in the render cache and sent from there
+// until renderCacheBump() is called. Only for pages whose tokens don't change by themselves,
+// a token like the current time must call tplNoCache().
+CgiStatus ICACHE_FLASH_ATTR cgiEspFsTemplateCached( HttpdConnData *connData );
 CgiStatus ICACHE_FLASH_ATTR serveStaticFile( HttpdConnData *connData, const char* filepath, int responseCode );
 
-// return value < 0 something goes wrong: -1 sendbuffer will overflow, discard data
-// otherwise return value gives the number of remaining free bytes in the send buffer
+// Send the value of a token with its encoding. Returns the number of bytes of str sent, the
+// callback sends the rest in its next call after returning HTTPD_CGI_MORE
 int ICACHE_FLASH_ATTR tplSend( HttpdConnData *connData, const char *str, int len );
 
+// Called by a template callback whose output changes without renderCacheBump(), the page
+// rendered now is not cached.
+void ICACHE_FLASH_ATTR tplNoCache( HttpdConnData *connData );
+
 #endif // __HTTPDESPFS_H__
\ No newline at end of file
@@ -0,0 +1,81 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          httpdmetrics.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+#ifndef __HTTPDMETRICS_H__
+#define __HTTPDMETRICS_H__
+
+#include "httpd.h"
+
+/*
+Request metrics of the web server, enabled with CONFIG_ESPHTTPD_METRICS. Per route the number of
+requests, the time spent and the bytes sent are counted, over all requests the status classes
+and a latency histogram. The latency is measured from the request line to the end of the
+response. cgiMetrics() shows the counters in the Prometheus text format.
+
+Recording costs a timer read when the request arrives and some counter increments when it is
+done, the per route counters are allocated with the first finished request.
+*/
+
+// upper bounds of the latency histogram in microseconds, the last bucket is +Inf
+#define HTTPD_METRICS_BUCKETS    { 1000, 5000, 20000, 100000, 500000, 2000000 }
+#define HTTPD_METRICS_NBUCKETS   6
+
+typedef struct
+{
+   uint32_t requests;
+   uint32_t bytes;
+   uint64_t time;                // microseconds
+} HttpdRouteMetrics;
+
+typedef struct
+{
+   const HttpdBuiltInUrl *routes;
+   int numRoutes;                // routes[numRoutes] counts the requests no route took
+   HttpdRouteMetrics *route;
+
+   uint32_t status[5];           // 1xx .. 5xx
+   uint32_t latency[HTTPD_METRICS_NBUCKETS + 1];
+   uint64_t time;
+   uint32_t requests;
+
+   uint32_t sendOverflows;       // httpdSend() discarded data, the send buffer was full
+   uint32_t backlogOverflows;    // data dropped, the send backlog was full
+   uint32_t refused;             // connections refused, no free connection
+   uint32_t evicted;             // connections closed to make room
+   uint32_t parked;              // requests which had to wait for a free connection
+   uint32_t rejected;            // requests answered with 503
+} HttpdMetrics;
+
+#ifdef CONFIG_ESPHTTPD_METRICS
+
+extern HttpdMetrics httpdMetrics;
+
+   #define HTTPD_METRICS_INC( counter )   httpdMetrics.counter++
+
+// time base of the latency, in microseconds
+uint32_t ICACHE_FLASH_ATTR httpdMetricsNow( void );
+
+// count the finished request of connData
+void ICACHE_FLASH_ATTR httpdMetricsDone( HttpdInstance *pInstance, HttpdConnData *connData );
+
+CgiStatus ICACHE_FLASH_ATTR cgiMetrics( HttpdConnData *connData );
+
+#else
+
+   #define HTTPD_METRICS_INC( counter )
+
+#endif // CONFIG_ESPHTTPD_METRICS
+
+#endif // __HTTPDMETRICS_H__
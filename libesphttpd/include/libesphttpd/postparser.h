@@ -0,0 +1,118 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          postparser.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+#ifndef __POSTPARSER_H__
+#define __POSTPARSER_H__
+
+#include "httpd.h"
+
+/*
+Incremental parsers for POST bodies of type application/x-www-form-urlencoded,
+multipart/form-data and application/json. The body is fed in pieces as it arrives, e.g. the
+content of connData->post.buf on every call of the cgi, and the field callback gets the decoded
+values in pieces. Nothing is buffered beyond a small value buffer, so the size of the body is
+not limited by HTTPD_MAX_POST_LEN.
+
+For JSON the name of a value is its path, e.g. "mqtt.host" or "timers[2].time". Objects and
+arrays are not reported themselves, only their scalar members. Strings are passed without
+quotes and unescaped, numbers, true, false and null as they are written.
+*/
+
+// Max length of a field name including the terminating zero. Longer names are truncated.
+#ifndef HTTPD_POST_NAME_LEN
+   #define HTTPD_POST_NAME_LEN      48
+#endif
+
+// Size of the buffer for decoded values and multipart header lines. Values are passed to the
+// callback in pieces of at most this size, multipart data is passed without copying.
+#ifndef HTTPD_POST_VALUE_LEN
+   #define HTTPD_POST_VALUE_LEN     128
+#endif
+
+// Max nesting of JSON objects and arrays
+#ifndef HTTPD_POST_JSON_DEPTH
+   #define HTTPD_POST_JSON_DEPTH    8
+#endif
+
+// Max length of a multipart boundary, see RFC 2046
+#define HTTPD_POST_BOUNDARY_LEN     70
+
+typedef enum
+{
+   HTTPD_POST_URLENCODED,
+   HTTPD_POST_MULTIPART,
+   HTTPD_POST_JSON
+} HttpdPostType;
+
+// flags passed to the field callback
+#define HTTPD_POST_FIRST         ( 1 << 0 )  // first piece of the value of a field
+#define HTTPD_POST_LAST          ( 1 << 1 )  // the value is complete
+
+// error codes
+#define HTTPD_POST_ERR_SYNTAX    -1          // malformed or truncated body
+#define HTTPD_POST_ERR_ABORT     -2          // the callback stopped parsing
+
+typedef struct HttpdPostParser HttpdPostParser;
+
+// Called for every piece of the value of a field, pp->name holds its name. A field with an
+// empty value is reported once with len 0 and both flags set. Return a negative value to stop
+// parsing.
+typedef int ( * HttpdPostFieldCb )( HttpdPostParser *pp, const char *data, int len, int flags );
+
+struct HttpdPostParser
+{
+   HttpdPostType type;
+   HttpdPostFieldCb cb;
+   void *arg;                          // for the use of the callback
+   char name[HTTPD_POST_NAME_LEN];     // name of the current field
+   char filename[HTTPD_POST_NAME_LEN]; // multipart: file name of the current part, "" if none
+   int error;                          // < 0 after an error, see HTTPD_POST_ERR_*
+
+   // private
+   uint8_t state;
+   uint8_t esc;                        // state of a %xx or \uxxxx escape sequence
+   bool first;                         // the next piece is the first of the field
+   uint16_t escVal;
+   int nameLen;
+   int valLen;
+   char val[HTTPD_POST_VALUE_LEN];
+
+   // multipart
+   char delim[4 + HTTPD_POST_BOUNDARY_LEN + 1];  // "\r\n--boundary"
+   uint8_t delimLen;
+   uint8_t match;                      // bytes of delim matched so far
+
+   // json
+   uint8_t depth;
+   uint8_t pathLen[HTTPD_POST_JSON_DEPTH];       // length of the container's name
+   uint16_t index[HTTPD_POST_JSON_DEPTH];        // array index, 0xffff for objects
+};
+
+// Set up a parser for the body of the request in connData, the type is taken from the
+// Content-Type header, urlencoded if there is none. Returns HTTPD_POST_ERR_SYNTAX for a
+// multipart body without boundary.
+int ICACHE_FLASH_ATTR httpdPostParserInit( HttpdPostParser *pp, HttpdConnData *connData, HttpdPostFieldCb cb, void *arg );
+
+// Parse the next len bytes of the body. Returns 0 or an error code.
+int ICACHE_FLASH_ATTR httpdPostParse( HttpdPostParser *pp, const char *data, int len );
+
+// The body is complete, reports a pending field. Returns 0 or an error code.
+int ICACHE_FLASH_ATTR httpdPostParseFinish( HttpdPostParser *pp );
+
+// Parse the post data of the current cgi call and finish the parser with the last piece.
+// Returns 1 when the body is complete, 0 if more data follows, or an error code.
+int ICACHE_FLASH_ATTR httpdPostParseChunk( HttpdPostParser *pp, HttpdConnData *connData );
+
+#endif // __POSTPARSER_H__
@@ -0,0 +1,62 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things - WebServer
+//
+// File          rendercache.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+#ifndef __RENDERCACHE_H__
+#define __RENDERCACHE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+Small cache for rendered output, e.g. the body of a template page or the value of an expensive
+template token. Every entry is stamped with the generation counter at the time the rendering
+started. Code which changes something shown on the web pages ( config, relay state, ... ) calls
+renderCacheBump(), which makes all entries stale.
+*/
+
+#ifndef RENDER_CACHE_ENTRIES
+   #define RENDER_CACHE_ENTRIES     3
+#endif
+
+#ifndef RENDER_CACHE_SIZE
+   #define RENDER_CACHE_SIZE        ( 12*1024 )    // max. heap used by all entries together
+#endif
+
+#ifndef RENDER_CACHE_KEY_LEN
+   #define RENDER_CACHE_KEY_LEN     32
+#endif
+
+typedef struct
+{
+   char key[RENDER_CACHE_KEY_LEN];  // url or token name, empty if the entry is unused
+   uint32_t generation;
+   uint32_t lastUse;
+   int users;                       // renderCacheGet() without renderCacheRelease()
+   int len;
+   char *data;
+} RenderCacheEntry;
+
+uint32_t renderCacheGeneration( void );
+void renderCacheBump( void );
+
+// Returns the entry of key if it is current, NULL otherwise. Call renderCacheRelease() when done.
+RenderCacheEntry *renderCacheGet( const char *key );
+void renderCacheRelease( RenderCacheEntry *entry );
+
+// Store data, allocated with malloc(), for key. The cache takes over the buffer, also if the
+// data is not stored because generation is outdated or there is no room.
+bool renderCachePut( const char *key, uint32_t generation, char *data, int len );
+
+#endif // __RENDERCACHE_H__
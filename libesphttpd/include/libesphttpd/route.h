@@ -7,12 +7,18 @@
 /** Route with a CGI handler and two arguments */
 #define ROUTE_CGI_ARG2( path, handler, arg1, arg2 )  {( path ), ( handler ), ( void * )( arg1 ), ( void * )( arg2 )}
 
+/** Route with a CGI handler, two arguments and ROUTE_FLAG_* flags */
+#define ROUTE_CGI_ARG2_FLAGS( path, handler, arg1, arg2, flags )  {( path ), ( handler ), ( void * )( arg1 ), ( void * )( arg2 ), ( flags )}
+
 /** Route with a CGI handler and one arguments */
 #define ROUTE_CGI_ARG( path, handler, arg1 )         ROUTE_CGI_ARG2( (path ), ( handler ), ( arg1 ), NULL )
 
 /** Route with an argument-less CGI handler */
 #define ROUTE_CGI( path, handler )                   ROUTE_CGI_ARG2( (path ), ( handler ), NULL, NULL )
 
+/** Route for a control or api CGI, which may use the reserved connections */
+#define ROUTE_API( path, handler )                   ROUTE_CGI_ARG2_FLAGS( (path ), ( handler ), NULL, NULL, ROUTE_FLAG_PRIORITY )
+
 /** Static file route ( file loaded from espfs ) */
 #define ROUTE_FILE( path, filepath )                 ROUTE_CGI_ARG( (path ), cgiEspFsHook, ( const char* )( filepath ) )
 
@@ -29,7 +35,10 @@
 #define ROUTE_AUTH( path, passwordFunc )             ROUTE_CGI_ARG( (path ), authBasic, ( AuthGetUserPw )( passwordFunc ) )
 
 /** Websocket endpoint */
-#define ROUTE_WS( path, callback )                   ROUTE_CGI_ARG( (path ), cgiWebsocket, ( WsConnectedCb )( callback ) )
+#define ROUTE_WS( path, callback )                   ROUTE_CGI_ARG2_FLAGS( (path ), cgiWebsocket, ( WsConnectedCb )( callback ), NULL, ROUTE_FLAG_PRIORITY )
+
+/** Server-Sent Events endpoint, events is an EventSource */
+#define ROUTE_EVENTSOURCE( path, events )            ROUTE_CGI_ARG2_FLAGS( (path ), cgiEventSource, ( EventSource * )( events ), NULL, ROUTE_FLAG_PRIORITY )
 
 /** Catch-all filesystem route */
 #define ROUTE_FILESYSTEM()                           ROUTE_CGI( "*", cgiEspFsHook )
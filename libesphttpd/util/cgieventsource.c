@@ -0,0 +1,299 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things
+//
+// File          cgieventsource.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   a full backlog of states drops the oldest state, not the newest
+//    2026-10-19  AWe   the client is allocated in the request arena
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+Server-Sent Events for esphttpd, see cgieventsource.h and
+https://html.spec.whatwg.org/multipage/server-sent-events.html
+
+The response is a chunked body which never ends, each event is flushed as one chunk. Every client
+remembers the id of the last event it got. A client which is behind, because it reconnected with
+Last-Event-ID or its send buffer was full, catches up from the kept events in the cgi calls after
+its data was sent; eventSourcePublish() only sends to clients which are up to date.
+*/
+
+// --------------------------------------------------------------------------
+// debug support
+// --------------------------------------------------------------------------
+
+#define LOG_LOCAL_LEVEL    ESP_LOG_INFO
+static const char *TAG = "cgieventsource";
+#include "esp_log.h"
+#define S( str ) ( str == NULL ? "<null>": str )
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#ifdef linux
+   #include <libesphttpd/linux.h>
+#else
+   #include <libesphttpd/esp.h>
+#endif
+
+#include <stdlib.h>  // strtoul()
+
+#include "libesphttpd/httpd.h"
+#include "libesphttpd/cgieventsource.h"
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+struct EventSourceClient
+{
+   HttpdConnData *connData;
+   EventSource *es;
+   uint32_t lastId;           // id of the last event sent to the client
+   EventSourceClient *next;
+};
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// Size of an event without the id line:
+// "event: " type "\n" ( "data: " line "\n" )* "\n"
+static int ICACHE_FLASH_ATTR eventSourceSize( const char *type, const char *data, int len )
+{
+   int lines = 1;
+   int i;
+
+   for( i = 0; i < len; i++ )
+      if( data[i] == '\n' ) lines++;
+   return 7 + strlen( type ) + 1 + lines * 7 + len + 1;
+}
+
+// Put one event into the send buffer, nothing if it doesn't fit. Each line of the data is sent
+// as a data field.
+static bool ICACHE_FLASH_ATTR eventSourceSend( HttpdConnData *connData, const EventSourceEvent *ev )
+{
+   char buf[24];
+   int l = snprintf( buf, sizeof( buf ), "id: %u\n", ( unsigned )ev->id );
+   int i, start;
+
+   if( httpdSend( connData, NULL, 0 ) < l + eventSourceSize( ev->type, ev->data, ev->len ) )
+      return false;
+
+   httpdSend( connData, buf, l );
+   httpdSend( connData, "event: ", 7 );
+   httpdSend( connData, ev->type, -1 );
+   httpdSend( connData, "\n", 1 );
+   for( start = 0, i = 0; i <= ev->len; i++ )
+   {
+      if( i == ev->len || ev->data[i] == '\n' )
+      {
+         httpdSend( connData, "data: ", 6 );
+         httpdSend( connData, ev->data + start, i - start );
+         httpdSend( connData, "\n", 1 );
+         start = i + 1;
+      }
+   }
+   httpdSend( connData, "\n", 1 );
+   return true;
+}
+
+// Send the kept events newer than the last one the client got, as many as fit
+static void ICACHE_FLASH_ATTR eventSourceCatchUp( EventSourceClient *client )
+{
+   EventSource *es = client->es;
+   int i;
+
+   for( i = 0; i < es->count; i++ )
+   {
+      if( es->events[i].id <= client->lastId )
+         continue;
+      if( !eventSourceSend( client->connData, &es->events[i] ) )
+         return;
+      client->lastId = es->events[i].id;
+   }
+   // events which are not kept anymore are lost for the client
+   client->lastId = es->lastId;
+}
+
+// Remove the kept event i
+static void ICACHE_FLASH_ATTR eventSourceDrop( EventSource *es, int i )
+{
+   free( es->events[i].data );
+   es->count--;
+   memmove( &es->events[i], &es->events[i + 1], ( es->count - i ) * sizeof( EventSourceEvent ) );
+}
+
+// The client sends nothing, but with a receive handler the connection has no timeout
+static CgiStatus ICACHE_FLASH_ATTR eventSourceRecv( HttpdInstance *pInstance, HttpdConnData *connData, char *data, int len )
+{
+   return HTTPD_CGI_MORE;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+int ICACHE_FLASH_ATTR eventSourcePublish( HttpdInstance *pInstance, EventSource *es, const char *type,
+                                          const char *data, int len, int flags )
+{
+   EventSourceClient *client;
+   uint32_t prevId = es->lastId;
+   int i, ret = 0;
+
+   if( len < 0 )
+      len = strlen( data );
+
+   // an event has to fit into an empty send buffer, with the id and the chunk framing
+   if( eventSourceSize( type, data, len ) + 32 > HTTPD_MAX_SENDBUFF_LEN )
+   {
+      ESP_LOGE( TAG, "Event %s too long: %d", type, len );
+      return -1;
+   }
+
+   if( flags & EVENTSOURCE_FLAG_STATE )
+   {
+      for( i = 0; i < es->count; i++ )
+      {
+         if( es->events[i].type == type || strcmp( es->events[i].type, type ) == 0 )
+         {
+            if( es->events[i].len == len && memcmp( es->events[i].data, data, len ) == 0 )
+               return 0;
+            eventSourceDrop( es, i );
+            break;
+         }
+      }
+   }
+
+   char *copy = malloc( len + 1 );
+   if( copy == NULL )
+   {
+      ESP_LOGE( TAG, "Can't allocate mem for event %s", type );
+      return -1;
+   }
+   memcpy( copy, data, len );
+   copy[len] = 0;
+
+   if( es->count == EVENTSOURCE_BACKLOG )
+   {
+      // make room, states are dropped last, the oldest one if all events are states
+      for( i = 0; i < es->count && ( es->events[i].flags & EVENTSOURCE_FLAG_STATE ); i++ )
+         ;
+      eventSourceDrop( es, ( i < es->count ) ? i : 0 );
+   }
+
+   EventSourceEvent *ev = &es->events[es->count++];
+   ev->type = type;
+   ev->data = copy;
+   ev->len = len;
+   ev->id = ++es->lastId;
+   ev->flags = flags;
+
+   for( client = es->clients; client != NULL; client = client->next )
+   {
+      if( client->lastId != prevId )
+         continue;            // is catching up and gets it then
+
+      if( httpdConnSendStart( pInstance, client->connData ) == CallbackSuccess &&
+            eventSourceSend( client->connData, ev ) )
+      {
+         client->lastId = ev->id;
+         ret++;
+      }
+      httpdConnSendFinish( pInstance, client->connData );
+   }
+   return ret;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// EventSource 'cgi' implementation, cgiArg is the EventSource
+CgiStatus ICACHE_FLASH_ATTR cgiEventSource( HttpdConnData *connData )
+{
+   EventSourceClient *client = ( EventSourceClient * )connData->cgiData;
+   EventSourceClient **pp;
+
+   if( connData->isConnectionClosed )
+   {
+      // Connection aborted. Clean up.
+      if( client != NULL )
+      {
+         for( pp = &client->es->clients; *pp != NULL; pp = &( *pp )->next )
+         {
+            if( *pp == client )
+            {
+               *pp = client->next;
+               break;
+            }
+         }
+         connData->cgiData = NULL;
+      }
+      return HTTPD_CGI_DONE;
+   }
+
+   if( client == NULL )
+   {
+      EventSource *es = ( EventSource * )connData->cgiArg;
+
+      if( connData->requestType != HTTPD_METHOD_GET )
+         return HTTPD_CGI_NOTFOUND;
+
+      // lives in the request arena as long as the connection
+      client = ( EventSourceClient * )httpdArenaAlloc( connData, sizeof( EventSourceClient ) );
+      if( client == NULL )
+      {
+         ESP_LOGE( TAG, "Can't allocate mem for event source client" );
+         httpdStartResponse( connData, 503 );
+         httpdEndHeaders( connData );
+         return HTTPD_CGI_DONE;
+      }
+      client->connData = connData;
+      client->es = es;
+      client->next = es->clients;
+      es->clients = client;
+      connData->cgiData = client;
+      connData->recvHdl = eventSourceRecv;
+
+      httpdStartResponse( connData, 200 );
+      httpdHeader( connData, "Content-Type", "text/event-stream" );
+      httpdHeader( connData, "Cache-Control", "no-cache" );
+      httpdEndHeaders( connData );
+
+      // a client which reconnects gets what it missed, unless the ids are from before a restart
+      const char *lastEventId = httpdGetHeaderById( connData, HTTPD_HDR_LAST_EVENT_ID );
+      uint32_t id = ( lastEventId != NULL ) ? strtoul( lastEventId, NULL, 10 ) : 0;
+      if( lastEventId != NULL && id <= es->lastId )
+      {
+         ESP_LOGD( TAG, "resume after event %u", ( unsigned )id );
+         client->lastId = id;
+         eventSourceCatchUp( client );
+      }
+      else
+      {
+         // the current states
+         int i;
+         for( i = 0; i < es->count; i++ )
+         {
+            if( es->events[i].flags & EVENTSOURCE_FLAG_STATE )
+               eventSourceSend( connData, &es->events[i] );
+         }
+         client->lastId = es->lastId;
+      }
+      return HTTPD_CGI_MORE;
+   }
+
+   // the data is sent, go on if the client is behind
+   if( client->lastId != client->es->lastId )
+      eventSourceCatchUp( client );
+   return HTTPD_CGI_MORE;
+}
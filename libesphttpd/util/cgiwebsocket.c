@@ -9,6 +9,8 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   Websock and WebsockPriv are allocated in the request arena
+//    2026-10-19  AWe   cgiWebsocket(): look up Upgrade and Sec-WebSocket-Key with httpdGetHeaderById()
 //    2018-01-18  AWe   update to chmorgan/libesphttpd
 //                         https://github.com/chmorgan/libesphttpd/commits/cmo_minify
 //                         Latest commit d15cc2e  from 5. Januar 2018
@@ -239,7 +241,7 @@ static void ICACHE_FLASH_ATTR websockFree( Websock *ws )
       while( lws != NULL && lws->priv->next != ws ) lws = lws->priv->next;
       if( lws != NULL ) lws->priv->next = ws->priv->next;
    }
-   if( ws->priv ) free( ws->priv );
+   // the memory is released with the request arena
 }
 
 CgiStatus ICACHE_FLASH_ATTR cgiWebSocketRecv( HttpdInstance *pInstance, HttpdConnData *connData, char *data, int len )
@@ -312,7 +314,7 @@ CgiStatus ICACHE_FLASH_ATTR cgiWebSocketRecv( HttpdInstance *pInstance, HttpdCon
          // First, unmask the data
          sl = len - i;
          ESP_LOGD( TAG, "Frame payload. wasHeaderByte %d fr.len %d sl %d cmd 0x%x", wasHeaderByte, ( int )ws->priv->fr.len, ( int )sl, ws->priv->fr.flags );
-         if( sl > ws->priv->fr.len ) sl = ws->priv->fr.len;
+         if( ( uint64_t )sl > ws->priv->fr.len ) sl = ( int )ws->priv->fr.len;
          for( j = 0; j < sl; j++ ) data[i + j] ^= ( ws->priv->fr.mask[( ws->priv->maskCtr++ ) & 3] );
 
          // Inspect the header to see what we need to do.
@@ -334,7 +336,7 @@ CgiStatus ICACHE_FLASH_ATTR cgiWebSocketRecv( HttpdInstance *pInstance, HttpdCon
                   ( ws->priv->fr.flags & OPCODE_MASK ) == OPCODE_BINARY ||
                   ( ws->priv->fr.flags & OPCODE_MASK ) == OPCODE_CONTINUE )
          {
-            if( sl > ws->priv->fr.len ) sl = ws->priv->fr.len;
+            if( ( uint64_t )sl > ws->priv->fr.len ) sl = ( int )ws->priv->fr.len;
             if( !( ws->priv->fr.len8 & IS_MASKED ) )
             {
                // We're a server; client should send us masked packets.
@@ -383,7 +385,6 @@ CgiStatus ICACHE_FLASH_ATTR cgiWebSocketRecv( HttpdInstance *pInstance, HttpdCon
       // We're going to tell the main webserver we're done. The webserver expects us to clean up by ourselves
       // we're chosing to be done. Do so.
       websockFree( ws );
-      free( connData->cgiData );
       connData->cgiData = NULL;
    }
    return r;
@@ -394,7 +395,6 @@ CgiStatus ICACHE_FLASH_ATTR cgiWebsocket( HttpdConnData *connData )
 {
    ESP_LOGD( TAG, "cgiWebsocket" );
    char buf[256];
-   int i;
    sha1nfo s;
    if( connData->isConnectionClosed )
    {
@@ -404,7 +404,6 @@ CgiStatus ICACHE_FLASH_ATTR cgiWebsocket( HttpdConnData *connData )
       {
          Websock *ws = ( Websock* )connData->cgiData;
          websockFree( ws );
-         free( connData->cgiData );
          connData->cgiData = NULL;
       }
       return HTTPD_CGI_DONE;
@@ -414,33 +413,29 @@ CgiStatus ICACHE_FLASH_ATTR cgiWebsocket( HttpdConnData *connData )
    {
       ESP_LOGD( TAG, "WS: First call" );
       // First call here. Check if client headers are OK, send server header.
-      i = httpdGetHeader( connData, "Upgrade", buf, sizeof( buf ) - 1 );
-      ESP_LOGD( TAG, "Upgrade: %s", buf );
-      if( i && strcasecmp( buf, "websocket" ) == 0 )
+      const char *upgrade = httpdGetHeaderById( connData, HTTPD_HDR_UPGRADE );
+      ESP_LOGD( TAG, "Upgrade: %s", S( upgrade ) );
+      if( upgrade && strcasecmp( upgrade, "websocket" ) == 0 )
       {
-         i = httpdGetHeader( connData, "Sec-WebSocket-Key", buf, sizeof( buf ) - 1 );
-         if( i )
+         // the key is extended by the GUID below, keep room for it
+         const char *key = httpdGetHeaderById( connData, HTTPD_HDR_SEC_WEBSOCKET_KEY );
+         if( key && strlen( key ) < sizeof( buf ) - strlen( WS_GUID ) )
          {
+            strcpy( buf, key );
             ESP_LOGD( TAG, "Key: %s", buf );
             // Seems like a WebSocket connection.
-            // Alloc structs
-            connData->cgiData = malloc( sizeof( Websock ) );
-            if( connData->cgiData == NULL )
+            // Alloc structs, they live in the request arena as long as the connection
+            Websock *ws = ( Websock* )httpdArenaAlloc( connData, sizeof( Websock ) );
+            WebsockPriv *priv = ( WebsockPriv* )httpdArenaAlloc( connData, sizeof( WebsockPriv ) );
+            if( ws == NULL || priv == NULL )
             {
                ESP_LOGE( TAG, "Can't allocate mem for websocket" );
                return HTTPD_CGI_DONE;
             }
-            memset( connData->cgiData, 0, sizeof( Websock ) );
-            Websock *ws = ( Websock* )connData->cgiData;
-            ws->priv = malloc( sizeof( WebsockPriv ) );
-            if( ws->priv == NULL )
-            {
-               ESP_LOGE( TAG, "Can't allocate mem for websocket priv" );
-               free( connData->cgiData );
-               connData->cgiData = NULL;
-               return HTTPD_CGI_DONE;
-            }
-            memset( ws->priv, 0, sizeof( WebsockPriv ) );
+            memset( ws, 0, sizeof( Websock ) );
+            memset( priv, 0, sizeof( WebsockPriv ) );
+            ws->priv = priv;
+            connData->cgiData = ws;
             ws->connData = connData;
             // Reply with the right headers.
             strcat( buf, WS_GUID );
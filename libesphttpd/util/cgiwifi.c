@@ -9,6 +9,10 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   cgiWiFiScan() waits for a running scan with httpdSuspend() instead of
+//                        answering inProgress, and scans when there is no result yet
+//    2026-10-19  AWe   wifiScanDoneCb(): keep the scan result in one block instead of one per AP
+//    2026-10-19  AWe   cgiWiFiConnStatusJson(), the status of cgiWiFiConnStatus() for the event source
 //    2018-01-18  AWe   update to chmorgan/libesphttpd
 //                         https://github.com/chmorgan/libesphttpd/commits/cmo_minify
 //                         Latest commit d15cc2e  from 5. Januar 2018
@@ -85,6 +89,14 @@ typedef struct
 // Static scan status storage.
 static ScanResultData cgiWifiAps;
 
+// Max time a request of cgiWiFiScan() waits for the result of a scan
+#ifndef WIFI_SCAN_WAIT_MS
+   #define WIFI_SCAN_WAIT_MS  6000
+#endif
+
+// requests waiting for the end of the scan, see httpdSuspend()
+static HttpdSuspendId scanWaiters[HTTPD_MAX_SUSPENDED];
+
 #define CONNTRY_IDLE       0
 #define CONNTRY_WORKING    1
 #define CONNTRY_SUCCESS    2
@@ -98,6 +110,35 @@ static os_timer_t connectTimer;
 //
 // --------------------------------------------------------------------------
 
+// Answer the requests which wait for the scan
+static void ICACHE_FLASH_ATTR wifiScanResume( void )
+{
+   int i;
+
+   for( i = 0; i < HTTPD_MAX_SUSPENDED; i++ )
+   {
+      if( scanWaiters[i] != 0 )
+         httpdResume( scanWaiters[i] );
+      scanWaiters[i] = 0;
+   }
+}
+
+// Let the request wait for the end of the scan, false if it can't
+static bool ICACHE_FLASH_ATTR wifiScanWait( HttpdConnData *connData )
+{
+   int i;
+
+   for( i = 0; i < HTTPD_MAX_SUSPENDED; i++ )
+   {
+      if( scanWaiters[i] == 0 )
+      {
+         scanWaiters[i] = httpdSuspend( connData, WIFI_SCAN_WAIT_MS );
+         return scanWaiters[i] != 0;
+      }
+   }
+   return false;
+}
+
 // Callback the code calls when a wlan ap scan is done. Basically stores the result in
 // the cgiWifiAps struct.
 
@@ -111,15 +152,16 @@ void ICACHE_FLASH_ATTR wifiScanDoneCb( void *arg, STATUS status )
    if( status != OK )
    {
       cgiWifiAps.scanInProgress = 0;
+      wifiScanResume();
       return;
    }
 
    // Clear prev ap data if needed.
    if( cgiWifiAps.apData != NULL )
    {
-      for( n = 0; n < cgiWifiAps.noAps; n++ )
-         free( cgiWifiAps.apData[n] );
       free( cgiWifiAps.apData );
+      cgiWifiAps.apData = NULL;
+      cgiWifiAps.noAps = 0;
    }
 
    // Count amount of access points found.
@@ -129,17 +171,20 @@ void ICACHE_FLASH_ATTR wifiScanDoneCb( void *arg, STATUS status )
       bss_link = bss_link->next.stqe_next;
       n++;
    }
-   // Allocate memory for access point data
-   cgiWifiAps.apData = ( ApData ** )malloc( sizeof( ApData * )*n );
+   // Allocate memory for access point data, the pointers and the entries in one block
+   cgiWifiAps.apData = ( ApData ** )malloc( ( sizeof( ApData * ) + sizeof( ApData ) ) * n );
    if( cgiWifiAps.apData == NULL )
    {
       ESP_LOGE( TAG, "Out of memory allocating apData" );
+      cgiWifiAps.scanInProgress = 0;
+      wifiScanResume();
       return;
    }
    cgiWifiAps.noAps = n;
    ESP_LOGD( TAG, "Scan done: found %d APs", n );
 
    // Copy access point data to the static struct
+   ApData *ap = ( ApData * )( cgiWifiAps.apData + cgiWifiAps.noAps );
    n = 0;
    bss_link = ( struct bss_info * )arg;
    while( bss_link != NULL )
@@ -152,13 +197,7 @@ void ICACHE_FLASH_ATTR wifiScanDoneCb( void *arg, STATUS status )
          break;
       }
       // Save the ap data.
-      cgiWifiAps.apData[n] = ( ApData * )malloc( sizeof( ApData ) );
-      if( cgiWifiAps.apData[n] == NULL )
-      {
-         ESP_LOGE( TAG, "Can't allocate mem for ap buf." );
-         cgiWifiAps.scanInProgress = 0;
-         return;
-      }
+      cgiWifiAps.apData[n] = &ap[n];
       cgiWifiAps.apData[n]->rssi = bss_link->rssi;
       cgiWifiAps.apData[n]->channel = bss_link->channel;
       cgiWifiAps.apData[n]->enc = bss_link->authmode;
@@ -170,6 +209,7 @@ void ICACHE_FLASH_ATTR wifiScanDoneCb( void *arg, STATUS status )
    }
    // We're done.
    cgiWifiAps.scanInProgress = 0;
+   wifiScanResume();
 
    ESP_LOGD( TAG, "wifiScanDoneCb finished. We had %d APs", n );
 }
@@ -182,11 +222,14 @@ static void ICACHE_FLASH_ATTR wifiStartScan()
 
    if( cgiWifiAps.scanInProgress ) return;
    cgiWifiAps.scanInProgress = 1;
-   wifi_station_scan( NULL, wifiScanDoneCb );
+   // fails in softAP mode, the callback doesn't come then
+   if( !wifi_station_scan( NULL, wifiScanDoneCb ) )
+      cgiWifiAps.scanInProgress = 0;
 }
 
 // This CGI is called from the bit of AJAX-code in wifi.tpl. It will initiate a
 // scan for access points and if available will return the result of an earlier scan.
+// While a scan runs the request waits for its end, up to WIFI_SCAN_WAIT_MS.
 // The result is embedded in a bit of JSON parsed by the javascript in wifi.tpl.
 
 /* json parameter
@@ -215,7 +258,7 @@ CgiStatus ICACHE_FLASH_ATTR cgiWiFiScan( HttpdConnData *connData )
    int len;
    char buf[256];
 
-   if( !cgiWifiAps.scanInProgress && pos != 0 )
+   if( !cgiWifiAps.scanInProgress && pos > 0 )
    {
       // Fill in json code for an access point
       if( pos - 1 < cgiWifiAps.noAps )
@@ -246,13 +289,27 @@ CgiStatus ICACHE_FLASH_ATTR cgiWiFiScan( HttpdConnData *connData )
       }
    }
 
+   if( pos == 0 )
+   {
+      // No result yet, scan now
+      if( cgiWifiAps.apData == NULL )
+         wifiStartScan();
+
+      // Answer when the scan is done, pos -1 until then
+      if( cgiWifiAps.scanInProgress && wifiScanWait( connData ) )
+      {
+         connData->cgiData = ( void * )-1;
+         return HTTPD_CGI_MORE;
+      }
+   }
+
    httpdStartResponse( connData, 200 );
    httpdHeader( connData, "Content-Type", "application/json" );
    httpdEndHeaders( connData );
 
    if( cgiWifiAps.scanInProgress == 1 )
    {
-      // We're still scanning. Tell Javascript code that.
+      // We're still scanning, the wait timed out or there was no room for it. Tell Javascript code that.
       len = sprintf( buf, "{\r\n \"result\": { \r\n\"inProgress\": \"1\"\r\n }\r\n}\r\n" );
       httpdSend( connData, buf, len );
       return HTTPD_CGI_DONE;
@@ -449,6 +506,31 @@ CgiStatus ICACHE_FLASH_ATTR cgiWiFiSetChannel( HttpdConnData *connData )
 //    "status"  : "idle" | "success" | "working" | "fail"
 //    "ip"
 
+// The connection state as json, returns its length. Used by cgiWiFiConnStatus() and for the
+// wifi event of the event source.
+int ICACHE_FLASH_ATTR cgiWiFiConnStatusJson( char *buf, int bufsize )
+{
+   struct ip_info info;
+   int st = wifi_station_get_connect_status();
+
+   if( connTryStatus == CONNTRY_IDLE )
+   {
+      return snprintf( buf, bufsize, "{\n \"status\": \"idle\"\n }\n" );
+   }
+   else if( connTryStatus == CONNTRY_WORKING || connTryStatus == CONNTRY_SUCCESS )
+   {
+      if( st == STATION_GOT_IP )
+      {
+         wifi_get_ip_info( 0, &info );
+         return snprintf( buf, bufsize, "{\n \"status\": \"success\",\n \"ip\": \"%d.%d.%d.%d\" }\n",
+                          ( info.ip.addr >> 0 ) & 0xff, ( info.ip.addr >> 8 ) & 0xff,
+                          ( info.ip.addr >> 16 ) & 0xff, ( info.ip.addr >> 24 ) & 0xff );
+      }
+      return snprintf( buf, bufsize, "{\n \"status\": \"working\"\n }\n" );
+   }
+   return snprintf( buf, bufsize, "{\n \"status\": \"fail\"\n }\n" );
+}
+
 CgiStatus ICACHE_FLASH_ATTR cgiWiFiConnStatus( HttpdConnData *connData )
 {
    ESP_LOGD( TAG, "cgiWiFiConnStatus" );
@@ -461,38 +543,19 @@ CgiStatus ICACHE_FLASH_ATTR cgiWiFiConnStatus( HttpdConnData *connData )
 
    char buf[128];
    int len;
-   struct ip_info info;
-   int st = wifi_station_get_connect_status();
 
    httpdStartResponse( connData, 200 );
    httpdHeader( connData, "Content-Type", "text/json" );
    httpdEndHeaders( connData );
 
-   if( connTryStatus == CONNTRY_IDLE )
-   {
-      len = sprintf( buf, "{\n \"status\": \"idle\"\n }\n" );
-   }
-   else if( connTryStatus == CONNTRY_WORKING || connTryStatus == CONNTRY_SUCCESS )
-   {
-      if( st == STATION_GOT_IP )
-      {
-         wifi_get_ip_info( 0, &info );
-         len = sprintf( buf, "{\n \"status\": \"success\",\n \"ip\": \"%d.%d.%d.%d\" }\n",
-                        ( info.ip.addr >> 0 ) & 0xff, ( info.ip.addr >> 8 ) & 0xff,
-                        ( info.ip.addr >> 16 ) & 0xff, ( info.ip.addr >> 24 ) & 0xff );
-         // Reset into AP-only mode sooner.
-         os_timer_disarm( &connectTimer );
-         os_timer_setfn( &connectTimer, staCheckConnStatusCb, NULL );
-         os_timer_arm( &connectTimer, 1000, 0 );
-      }
-      else
-      {
-         len = sprintf( buf, "{\n \"status\": \"working\"\n }\n" );
-      }
-   }
-   else
+   len = cgiWiFiConnStatusJson( buf, sizeof( buf ) );
+   if( ( connTryStatus == CONNTRY_WORKING || connTryStatus == CONNTRY_SUCCESS ) &&
+         wifi_station_get_connect_status() == STATION_GOT_IP )
    {
-      len = sprintf( buf, "{\n \"status\": \"fail\"\n }\n" );
+      // Reset into AP-only mode sooner.
+      os_timer_disarm( &connectTimer );
+      os_timer_setfn( &connectTimer, staCheckConnStatusCb, NULL );
+      os_timer_arm( &connectTimer, 1000, 0 );
    }
 
    httpdSend( connData, buf, len );
@@ -9,6 +9,9 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   cgiConfig(): post data and arguments in the request arena
+//    2026-10-19  AWe   cgiConfig(): import settings from a POST body, urlencoded, multipart or json
+//    2026-10-19  AWe   cgiConfig(): parse the arguments once with httpdParseArgs()
 //    2018-04-20  AWe   takeover from WebServer project and adept it
 //    2018-04-09  AWe   replace httpd_printf() with ESP_LOG*()
 //    2018-01-19  AWe   update to chmorgan/libesphttpd
@@ -41,6 +44,7 @@ static const char *TAG = "cgiConfig";
 #endif
 #include "configs.h"         // enums, config_save_str()
 #include "cgiConfig.h"
+#include "libesphttpd/postparser.h"
 
 // --------------------------------------------------------------------------
 //
@@ -234,6 +238,99 @@ static int ICACHE_FLASH_ATTR send_json_reponse( HttpdConnData *connData, Config_
    return len;
 }
 
+// --------------------------------------------------------------------------
+// store a new value of a keyword
+// --------------------------------------------------------------------------
+
+// buf holds the value as string, len counts the terminating zero, buf is changed
+
+static void ICACHE_FLASH_ATTR set_config_value( const Config_Keyword_t *keyword, char *buf, int len )
+{
+   int id = keyword->id;
+   int type = keyword->type;
+
+   // ESP_LOGD( TAG, "cgiConfig id 0x%02x len %d \"%s\"", id, len, S( buf ) );
+
+   // remove leading blanks from str, there are no trailing blanks, so at least one character
+   char *buf_p = buf;
+   while( *buf_p == ' ' || *buf_p == '\t' )
+   {
+      buf_p++;
+      len--;
+   }
+   // move to begin of buf
+   if( buf != buf_p )
+   {
+      strcpy( buf, buf_p );
+      ESP_LOGD( TAG, "remove blanks '%s'", S( buf ) );
+   }
+
+   // buf holds the new value for configlist[ id ]
+   // check if the value has changed
+   // if so, save the new value to the flash and update the config_list
+
+   if( type == Text )
+   {
+      // compare with string stored in flash
+      if( 0 == compare_config( id, buf, 0 ) )
+      {
+         // ESP_LOGD( TAG, "update config %d, %s", id, S( buf ) );
+         if( update_config( id, buf, 0 ) == 1 )
+            config_save_str( id, buf, 0, Text );
+
+         // apply the changes to the device, module, ...
+         apply_config( id, buf, 0 );
+      }
+   }
+   else if( type == NumArray )
+   {
+      // determine the number of integers in buf
+      int cnt = str2int_array( buf, NULL, 0 );
+      // ESP_LOGD( TAG, "NumArray has %d elements", cnt );
+      int num_array[ NUMARRAY_SIZE ] __attribute__( ( aligned( 4 ) ) );
+      if( cnt > NUMARRAY_SIZE )
+         cnt = NUMARRAY_SIZE;
+
+      str2int_array( buf, num_array, cnt );
+
+      for( int i = cnt; i < NUMARRAY_SIZE; i++ )
+         num_array [ i ] = 0;
+
+      if( 0 == compare_config( id, ( char* )num_array, 0 ) )
+      {
+         if( update_config( id, ( char* )num_array, 0 ) == 1 )
+            config_save_str( id, ( char* )num_array, cnt * sizeof( int ), NumArray );
+
+         // apply the changes to the device, module, ...
+         apply_config( id, ( char* )num_array, 0 );
+      }
+   }
+   else
+   {
+      // compare with value stored in config_list
+      // first convert value string in buf to an integer
+
+      int val = 0;
+      if( type == Number )
+         val = str2int( buf );
+      else if( type == Flag )
+          val = strcmp( "0", buf ) == 0 ? 0 : 1;
+      else if( type == Ip_Addr )
+         str2ip( buf, &val );
+
+      if( 0 == compare_config( id, NULL, val ) )
+      {
+         // ESP_LOGD( TAG, "update config %d, %d", id, val );
+         if( update_config( id, NULL, val ) == 1 )
+            config_save_int( id, val, type );
+
+         // apply the changes to the device, module, ...
+         apply_config( id, NULL, val );
+      }
+   }
+
+}
+
 // --------------------------------------------------------------------------
 // get the configuration from the web page
 // --------------------------------------------------------------------------
@@ -243,123 +340,144 @@ static int ICACHE_FLASH_ATTR send_json_reponse( HttpdConnData *connData, Config_
 // if not equal update the configuration and store the new value in
 // the user configuration section of the flash
 
+// A POST body is parsed while it arrives, so a whole set of settings can be imported
+// independent of HTTPD_MAX_POST_LEN. The names of the fields are the keywords.
+
+typedef struct
+{
+   HttpdPostParser pp;
+   char buf[128];
+   int len;
+   int count;                 // number of settings found in the body
+} ConfigPostData;
+
+static const Config_Keyword_t* ICACHE_FLASH_ATTR find_config_keyword( const char *token )
+{
+   for( int i = 0; i < get_num_keywords(); i++ )
+   {
+      Config_Keyword_t keyword;
+      memcpy ( &keyword, get_config_keyword( i ), sizeof( Config_Keyword_t ) );
+
+      if( strcmp( token, keyword.token ) == 0 )
+         return get_config_keyword( i );
+   }
+   return NULL;
+}
+
+static int ICACHE_FLASH_ATTR config_post_field( HttpdPostParser *pp, const char *data, int len, int flags )
+{
+   ConfigPostData *cpd = ( ConfigPostData * )pp->arg;
+
+   if( flags & HTTPD_POST_FIRST ) cpd->len = 0;
+
+   // longer values are truncated like in the GET request
+   if( len > ( int )sizeof( cpd->buf ) - 1 - cpd->len ) len = sizeof( cpd->buf ) - 1 - cpd->len;
+   if( len > 0 )
+   {
+      memcpy( cpd->buf + cpd->len, data, len );
+      cpd->len += len;
+   }
+
+   if( flags & HTTPD_POST_LAST )
+   {
+      const Config_Keyword_t *kw = find_config_keyword( pp->name );
+      if( kw != NULL )
+      {
+         Config_Keyword_t keyword;
+         memcpy ( &keyword, kw, sizeof( Config_Keyword_t ) );
+
+         cpd->buf[ cpd->len ] = 0;
+         set_config_value( &keyword, cpd->buf, cpd->len + 1 );
+         cpd->count++;
+      }
+      else
+      {
+         ESP_LOGW( TAG, "unknown setting %s", S( pp->name ) );
+      }
+   }
+   return 0;
+}
+
+static CgiStatus ICACHE_FLASH_ATTR cgiConfigPost( HttpdConnData *connData )
+{
+   ConfigPostData *cpd = ( ConfigPostData * )connData->cgiData;
+   char buf[48];
+   int rc;
+
+   if( cpd == NULL )
+   {
+      cpd = ( ConfigPostData * )httpdArenaAlloc( connData, sizeof( ConfigPostData ) );
+      if( cpd == NULL )
+      {
+         ESP_LOGE( TAG, "Failed to allocate post data" );
+         return HTTPD_CGI_NOTFOUND;
+      }
+      cpd->count = 0;
+      cpd->len = 0;
+      httpdPostParserInit( &cpd->pp, connData, config_post_field, cpd );
+      connData->cgiData = cpd;
+   }
+
+   rc = httpdPostParseChunk( &cpd->pp, connData );
+
+   // after an error just eat up the rest of the body
+   if( connData->post.received < connData->post.len )
+      return HTTPD_CGI_MORE;
+
+   ESP_LOGI( TAG, "imported %d settings, rc %d", cpd->count, rc );
+   int len = sprintf( buf, "{ \"settings\" : %d }", cpd->count );
+   httpdStartResponse( connData, rc < 0 ? 400 : 200 );
+   httpdHeader( connData, "Content-Type", "text/json" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, buf, len );
+
+   connData->cgiData = NULL;
+   return HTTPD_CGI_DONE;
+}
+
 CgiStatus ICACHE_FLASH_ATTR cgiConfig( HttpdConnData *connData )
 {
    char buf[128];
 
    if( connData->isConnectionClosed )
    {
-      // Connection aborted. Clean up.
+      // Connection aborted. The post data is released with the request arena.
+      connData->cgiData = NULL;
       return HTTPD_CGI_DONE;
    }
 
-#if 0 // use post or get method
-   // ESP_LOGD( TAG, "%s", S( connData->post.buf ) );
-#else
+   if( connData->requestType == HTTPD_METHOD_POST )
+   {
+      return cgiConfigPost( connData );
+   }
+
    if( connData->requestType != HTTPD_METHOD_GET )
    {
-      // Sorry, we only accept GET requests.
+      // Sorry, we only accept GET and POST requests.
       httpdStartResponse( connData, 406 ); // http error code 'unacceptable'
       httpdEndHeaders( connData );
       return HTTPD_CGI_DONE;
    }
-#endif
+
+   // decode the arguments once, then look up each keyword
+   HttpdArgs args;
+   httpdParseArgsArena( connData, &args, connData->getArgs );
 
    int i;
-   for( i = 0; i < get_num_keywords(); i++ )
+   for( i = 0; i < get_num_keywords() && args.count > 0; i++ )
    {
       Config_Keyword_t keyword;
       memcpy ( &keyword, get_config_keyword( i ), sizeof( Config_Keyword_t ) );
 
-#if 0  // use post or get method
-      int len = httpdFindArg( connData->post.buf, keyword.token, ( char * )buf, sizeof( buf ) );
-#else
-      int len = httpdFindArg( connData->getArgs,  keyword.token, ( char * )buf, sizeof( buf ) );
-#endif
-      if( len > 0 )
+      const HttpdArg *arg = httpdGetArg( &args, keyword.token );
+      if( arg != NULL )
       {
-         int id = keyword.id;
-         int type = keyword.type;
+         // copy the value, it is changed below; len counts the terminating zero
+         int len = arg->valueLen < ( int )sizeof( buf ) - 1 ? arg->valueLen : ( int )sizeof( buf ) - 1;
+         memcpy( buf, arg->value, len );
+         buf[ len++ ] = 0;
 
-         // ESP_LOGD( TAG, "cgiConfig id 0x%02x len %d \"%s\"", id, len, S( buf ) );
-
-         // remove leading blanks from str, there are no trailing blanks, so at least one character
-         char *buf_p = buf;
-         while( *buf_p == ' ' || *buf_p == '\t' )
-         {
-            buf_p++;
-            len--;
-         }
-         // move to begin of buf
-         if( buf != buf_p )
-         {
-            strcpy( buf, buf_p );
-            ESP_LOGD( TAG, "remove blanks '%s'", S( buf ) );
-         }
-
-         // buf holds the new value for configlist[ id ]
-         // check if the value has changed
-         // if so, save the new value to the flash and update the config_list
-
-         if( type == Text )
-         {
-            // compare with string stored in flash
-            if( 0 == compare_config( id, buf, 0 ) )
-            {
-               // ESP_LOGD( TAG, "update config %d, %s", id, S( buf ) );
-               if( update_config( id, buf, 0 ) == 1 )
-                  config_save_str( id, buf, 0, Text );
-
-               // apply the changes to the device, module, ...
-               apply_config( id, buf, 0 );
-            }
-         }
-         else if( type == NumArray )
-         {
-            // determine the number of integers in buf
-            int cnt = str2int_array( buf, NULL, 0 );
-            // ESP_LOGD( TAG, "NumArray has %d elements", cnt );
-            int num_array[ NUMARRAY_SIZE ] __attribute__( ( aligned( 4 ) ) );
-            if( cnt > NUMARRAY_SIZE )
-               cnt = NUMARRAY_SIZE;
-
-            str2int_array( buf, num_array, cnt );
-
-            for( int i = cnt; i < NUMARRAY_SIZE; i++ )
-               num_array [ i ] = 0;
-
-            if( 0 == compare_config( id, ( char* )num_array, 0 ) )
-            {
-               if( update_config( id, ( char* )num_array, 0 ) == 1 )
-                  config_save_str( id, ( char* )num_array, cnt * sizeof( int ), NumArray );
-
-               // apply the changes to the device, module, ...
-               apply_config( id, ( char* )num_array, 0 );
-            }
-         }
-         else
-         {
-            // compare with value stored in config_list
-            // first convert value string in buf to an integer
-
-            int val = 0;
-            if( type == Number )
-               val = str2int( buf );
-            else if( type == Flag )
-                val = strcmp( "0", buf ) == 0 ? 0 : 1;
-            else if( type == Ip_Addr )
-               str2ip( buf, &val );
-
-            if( 0 == compare_config( id, NULL, val ) )
-            {
-               // ESP_LOGD( TAG, "update config %d, %d", id, val );
-               if( update_config( id, NULL, val ) == 1 )
-                  config_save_int( id, val, type );
-
-               // apply the changes to the device, module, ...
-               apply_config( id, NULL, val );
-            }
-         }
+         set_config_value( &keyword, buf, len );
 
          send_json_reponse( connData, &keyword );
       }
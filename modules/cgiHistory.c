@@ -9,6 +9,8 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   tplHistory(): ring buffer in the request arena
+//    2026-10-19  AWe   call the event handler for each new message
 //    2018-06-08  AWe   initial implementation
 //
 // --------------------------------------------------------------------------
@@ -62,6 +64,7 @@ ringbuf_t;
 // --------------------------------------------------------------------------
 
 static ringbuf_t* ringbuf = NULL;
+static appl_event_handler_t history_eventHandler = NULL;
 
 // --------------------------------------------------------------------------
 //
@@ -141,9 +144,7 @@ CgiStatus ICACHE_FLASH_ATTR tplHistory( HttpdConnData *connData, char *token, vo
    if( token == NULL )
    {
       ESP_LOGD( TAG, "tplHistory clean up" );
-      // clean up
-      if( ringbuf )
-         free( ringbuf );
+      // the ring buffer is released with the request arena
       *arg = NULL;            // ringbuf
       return HTTPD_CGI_DONE;
    }
@@ -160,7 +161,7 @@ CgiStatus ICACHE_FLASH_ATTR tplHistory( HttpdConnData *connData, char *token, vo
       if( ringbuf == NULL )
       {
          // create a ring buffer and fill it
-         ringbuf = ( ringbuf_t* )malloc( sizeof( ringbuf_t ) );
+         ringbuf = ( ringbuf_t* )httpdArenaAlloc( connData, sizeof( ringbuf_t ) );
          if( ringbuf == NULL )
          {
             ESP_LOGE( TAG, "tplHistory cannot allocate memory" );
@@ -336,9 +337,21 @@ int ICACHE_FLASH_ATTR history( const char *format, ... )
    ESP_LOG( TAG, "'%s'", S( pBuf ) );
    saveHistory( buf, len );
 
+   if( history_eventHandler )
+      history_eventHandler( history_newEntry, pBuf );
+
    return len;
 }
 
 // --------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------
+
+void ICACHE_FLASH_ATTR history_setEventHandler( appl_event_handler_t handler )
+{
+   history_eventHandler = handler;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
@@ -0,0 +1,285 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things
+//
+// File          cgiState.c
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   take the names of the timer types from cgiTimer.c
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+/*
+/api/state: the state of the device in one JSON document, for dashboards and the polling of
+many devices.
+
+GET parameter
+   "fields"    comma separated list of the parts to send, all if missing:
+               relay, timers, wifi, time, health, mqtt
+   "timers"    number of upcoming switching times, default 4, at most API_STATE_MAX_TIMERS
+
+{"relay":{"state":1,"power":1,"info_led":0,"sysled":1},
+ "timers":[{"type":"daily","val":0,"id":1,"time":1792400400}],
+ "wifi":{"mode":1,"status":5,"ssid":"home","rssi":-61,"ip":"192.168.1.20"},
+ "time":{"now":1792393200,"date_time":"2026-10-19 20:00:00","synced":true,"first_sync":...,"last_sync":...},
+ "health":{"uptime":86400,"heap":21344,"reset":0,"build":42},
+ "mqtt":{"connected":true,"state":18}}
+
+The parts are sent one per cgi call, each is read when it is sent.
+*/
+
+// --------------------------------------------------------------------------
+// debug support
+// --------------------------------------------------------------------------
+
+#ifndef ESP_PLATFORM
+   #define _PRINT_CHATTY
+   #define V_HEAP_INFO
+#else
+   #define HEAP_INFO( x )
+#endif
+
+#define LOG_LOCAL_LEVEL    ESP_LOG_INFO
+static const char* TAG = "cgiState";
+#include "esp_log.h"
+#define S( str ) ( str == NULL ? "<null>": str )
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+#include <stdlib.h>  // atoi()
+
+#include <osapi.h>
+#include <user_interface.h>
+
+#include "libesphttpd/httpd.h"
+#include "sntp_client.h"
+#include "device.h"                 // devGet()
+#include "cgiTimer.h"               // switchingTimeNext(), switchingTimeTypeName()
+#include "user_mqtt.h"              // mqttWifiIsConnected()
+#include "cgiState.h"
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+typedef struct rst_info *rst_info_t;
+extern rst_info_t sys_rst_info;
+
+extern const uint32_t build_number;    // user_main.c
+
+enum
+{
+   STATE_RELAY,
+   STATE_TIMERS,
+   STATE_WIFI,
+   STATE_TIME,
+   STATE_HEALTH,
+   STATE_MQTT,
+   STATE_COUNT
+};
+
+// names of the parts in the "fields" parameter and in the document
+static const char * const stateNames[ STATE_COUNT ] =
+{
+   "relay", "timers", "wifi", "time", "health", "mqtt"
+};
+
+typedef struct
+{
+   uint8_t fields;      // bit mask of the parts to send
+   uint8_t next;        // the part sent in the next call
+   uint8_t timers;      // number of switching times
+   uint8_t sent;        // a part was sent, the next one needs a comma
+} StateData;
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// bit mask of the parts in a comma separated list
+static int ICACHE_FLASH_ATTR stateParseFields( const char *list, int len )
+{
+   int fields = 0;
+   int start = 0;
+
+   for( int i = 0; i <= len; i++ )
+   {
+      if( i == len || list[ i ] == ',' )
+      {
+         for( int f = 0; f < STATE_COUNT; f++ )
+         {
+            if( strlen( stateNames[ f ] ) == i - start && strncmp( stateNames[ f ], list + start, i - start ) == 0 )
+               fields |= 1 << f;
+         }
+         start = i + 1;
+      }
+   }
+   return fields;
+}
+
+static int ICACHE_FLASH_ATTR stateRelay( char *buf, int bufsize )
+{
+   return snprintf( buf, bufsize, "{\"state\":%d,\"power\":%d,\"info_led\":%d,\"sysled\":%d}",
+                    devGet( Relay ), devGet( PowerSense ), devGet( InfoLed ), devGet( SysLed ) );
+}
+
+static void ICACHE_FLASH_ATTR stateTimers( HttpdConnData *connData, int max )
+{
+   switching_time_t next[ API_STATE_MAX_TIMERS ];
+   char buf[80];
+   int n = switchingTimeNext( next, max );
+
+   httpdSend( connData, "[", 1 );
+   for( int i = 0; i < n; i++ )
+   {
+      int buflen = snprintf( buf, sizeof( buf ), "%s{\"type\":\"%s\",\"val\":%d,\"id\":%d,\"time\":%ld}",
+                             i > 0 ? "," : "", switchingTimeTypeName( next[ i ].type ), next[ i ].val, next[ i ].id,
+                             ( long )next[ i ].time );
+      httpdSend( connData, buf, buflen );
+   }
+   httpdSend( connData, "]", 1 );
+}
+
+static void ICACHE_FLASH_ATTR stateWifi( HttpdConnData *connData )
+{
+   struct station_config sta_config;
+   struct ip_info ipconfig;
+   char buf[64];
+   int buflen;
+   int mode = wifi_get_opmode();
+
+   buflen = snprintf( buf, sizeof( buf ), "{\"mode\":%d,\"status\":%d,\"ssid\":\"",
+                      mode, wifi_station_get_connect_status() );
+   httpdSend( connData, buf, buflen );
+   if( ( mode & STATION_MODE ) && wifi_station_get_config( &sta_config ) )
+      httpdSend_js( connData, ( char * )sta_config.ssid, strnlen( ( char * )sta_config.ssid, sizeof( sta_config.ssid ) ) );
+
+   if( ( mode & STATION_MODE ) && wifi_get_ip_info( STATION_IF, &ipconfig ) )
+      buflen = snprintf( buf, sizeof( buf ), "\",\"rssi\":%d,\"ip\":\"" IPSTR "\"}",
+                         wifi_station_get_rssi(), IP2STR( &ipconfig.ip.addr ) );
+   else
+      buflen = snprintf( buf, sizeof( buf ), "\",\"rssi\":0,\"ip\":\"\"}" );
+   httpdSend( connData, buf, buflen );
+}
+
+static int ICACHE_FLASH_ATTR stateTime( char *buf, int bufsize )
+{
+   time_t timestamp = sntp_gettime();
+   struct tm *dt = gmtime( &timestamp );
+
+   return snprintf( buf, bufsize,
+                    "{\"now\":%ld,\"date_time\":\"%d-%02d-%02d %02d:%02d:%02d\","
+                    "\"synced\":%s,\"first_sync\":%ld,\"last_sync\":%ld}",
+                    ( long )timestamp,
+                    dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday,
+                    dt->tm_hour, dt->tm_min, dt->tm_sec,
+                    sntp_getLastSync() != 0 ? "true" : "false",
+                    ( long )sntp_getFirstSync(), ( long )sntp_getLastSync() );
+}
+
+static int ICACHE_FLASH_ATTR stateHealth( char *buf, int bufsize )
+{
+   return snprintf( buf, bufsize, "{\"uptime\":%ld,\"heap\":%d,\"reset\":%d,\"build\":%d}",
+                    ( long )sntp_getUptime(), system_get_free_heap_size(),
+                    sys_rst_info->reason, build_number );
+}
+
+static int ICACHE_FLASH_ATTR stateMqtt( char *buf, int bufsize )
+{
+   return snprintf( buf, bufsize, "{\"connected\":%s,\"state\":%d}",
+                    mqttWifiIsConnected() ? "true" : "false", mqttClient.connState );
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+CgiStatus ICACHE_FLASH_ATTR cgiApiState( HttpdConnData *connData )
+{
+   StateData *sd = ( StateData * )connData->cgiData;
+   char buf[160];
+   int buflen = 0;
+
+   if( connData->isConnectionClosed )
+   {
+      // Connection aborted. The state lives in the request arena.
+      return HTTPD_CGI_DONE;
+   }
+
+   if( sd == NULL )
+   {
+      if( connData->requestType != HTTPD_METHOD_GET )
+      {
+         httpdStartResponse( connData, 405 );
+         httpdEndHeaders( connData );
+         return HTTPD_CGI_DONE;
+      }
+
+      sd = ( StateData * )httpdArenaAlloc( connData, sizeof( StateData ) );
+      if( sd == NULL )
+      {
+         ESP_LOGE( TAG, "Can't allocate mem for the state" );
+         httpdStartResponse( connData, 503 );
+         httpdEndHeaders( connData );
+         return HTTPD_CGI_DONE;
+      }
+      sd->fields = ( 1 << STATE_COUNT ) - 1;
+      sd->next = 0;
+      sd->timers = 4;
+      sd->sent = false;
+
+      HttpdArgs args;
+      const HttpdArg *arg;
+      httpdParseArgsArena( connData, &args, connData->getArgs );
+      if( ( arg = httpdGetArg( &args, "fields" ) ) != NULL )
+         sd->fields = stateParseFields( arg->value, arg->valueLen );
+      if( ( arg = httpdGetArg( &args, "timers" ) ) != NULL )
+      {
+         int n = atoi( arg->value );
+         sd->timers = n < 0 ? 0 : n > API_STATE_MAX_TIMERS ? API_STATE_MAX_TIMERS : n;
+      }
+      connData->cgiData = sd;
+
+      httpdStartResponse( connData, 200 );
+      httpdHeader( connData, "Content-Type", "application/json" );
+      httpdHeader( connData, "Cache-Control", "no-cache" );
+      httpdEndHeaders( connData );
+      httpdSend( connData, "{", 1 );
+   }
+
+   // the next part which was asked for
+   while( sd->next < STATE_COUNT && !( sd->fields & ( 1 << sd->next ) ) )
+      sd->next++;
+
+   if( sd->next == STATE_COUNT )
+   {
+      httpdSend( connData, "}", 1 );
+      return HTTPD_CGI_DONE;
+   }
+
+   buflen = snprintf( buf, sizeof( buf ), "%s\"%s\":", sd->sent ? "," : "", stateNames[ sd->next ] );
+   httpdSend( connData, buf, buflen );
+
+   switch( sd->next )
+   {
+      case STATE_RELAY:    buflen = stateRelay( buf, sizeof( buf ) );   break;
+      case STATE_TIMERS:   stateTimers( connData, sd->timers ); buflen = 0; break;
+      case STATE_WIFI:     stateWifi( connData ); buflen = 0;           break;
+      case STATE_TIME:     buflen = stateTime( buf, sizeof( buf ) );    break;
+      case STATE_HEALTH:   buflen = stateHealth( buf, sizeof( buf ) );  break;
+      case STATE_MQTT:     buflen = stateMqtt( buf, sizeof( buf ) );    break;
+   }
+   if( buflen > 0 )
+      httpdSend( connData, buf, buflen );
+
+   sd->sent = true;
+   sd->next++;
+   return HTTPD_CGI_MORE;
+}
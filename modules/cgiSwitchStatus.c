@@ -9,6 +9,7 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   mark time, uptime, heap and power state as not cacheable
 //    2017-09-18  AWe   replace streq() with strcmp()
 //    2017-09-13  AWe   initial implementation
 //
@@ -38,6 +39,7 @@ static const char* TAG = "cgiswitchStatus";
 #include <user_interface.h>
 
 #include "libesphttpd/httpd.h"      // CgiStatus
+#include "libesphttpd/httpdespfs.h" // tplNoCache()
 
 #include "sntp_client.h"
 #include "device.h"     // devGet()
@@ -78,10 +80,12 @@ CgiStatus ICACHE_FLASH_ATTR tplSwitchStatus( HttpdConnData *connData, char *toke
    }
    else if( strcmp( token, "power_state" ) == 0 )
    {
+      tplNoCache( connData );
       buflen = snprintf( buf, bufsize, "%d", devGet( PowerSense ) );
    }
    else if( strcmp( token, "date_time" ) == 0 )
    {
+      tplNoCache( connData );
       buflen = snprintf( buf, bufsize,
                             "%d-%02d-%02d %02d:%02d:%02d",
                             dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday,
@@ -89,22 +93,26 @@ CgiStatus ICACHE_FLASH_ATTR tplSwitchStatus( HttpdConnData *connData, char *toke
    }
    else if( strcmp( token, "date" ) == 0 )
    {
+      tplNoCache( connData );
       buflen = snprintf( buf, bufsize,
                             "%d-%02d-%02d",
                             dt->tm_year + 1900, dt->tm_mon + 1, dt->tm_mday );
    }
    else if( strcmp( token, "time" ) == 0 )
    {
+      tplNoCache( connData );
       buflen = snprintf( buf, bufsize,
                             "%02d:%02d:%02d",
                             dt->tm_hour, dt->tm_min, dt->tm_sec );
    }
    else if( strcmp( token, "uptime" ) == 0 )
    {
+      tplNoCache( connData );
       buflen = snprintf( buf, bufsize, "%d", sntp_getUptime() );
    }
    else if( strcmp( token, "heap" ) == 0 )
    {
+      tplNoCache( connData );
       buflen = snprintf( buf, bufsize, "%d", system_get_free_heap_size() );
    }
    else if( strcmp( token, "sys_rst_info" ) == 0 )
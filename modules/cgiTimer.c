@@ -9,6 +9,16 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   a schedule read with SCHEDULE_REPLACE set was interrupted by a power loss,
+//                        invalidate the records before and clear the flag
+//    2026-10-19  AWe   PUT and POST of /api/timers skip the hourglass of the GET output
+//    2026-10-19  AWe   clear SCHEDULE_REPLACE of a stored schedule after the records before are
+//                        invalidated, follow the records moved by config_save()
+//    2026-10-19  AWe   add /api/timers, a schedule is written as one record and replaces the
+//                        switching times written before
+//    2026-10-19  AWe   add switchingTimeNext() for /api/state
+//    2026-10-19  AWe   cgiSetTimer(): decode the arguments into the request arena
+//    2026-10-19  AWe   cgiSetTimer(): parse the arguments once with httpdParseArgs()
 //    2018-06-24  AWe   add support for WORKDAY and WEEKEND
 //    2018-06-08  AWe   initial implementation
 //
@@ -40,6 +50,7 @@ static const char* TAG = "modules/cgiTimer.c";
 #include <user_interface.h>
 
 #include "libesphttpd/httpd.h"
+#include "libesphttpd/postparser.h"
 #include "configs.h"
 #include "device.h"                 // devGet(), devSet();
 #include "sntp_client.h"            // struct tm, sntp_settime
@@ -60,7 +71,11 @@ static int  ICACHE_FLASH_ATTR switchingTimeAdd( switching_time_ext_t *switching_
 static int  ICACHE_FLASH_ATTR switchingTimeUpdate( int index );
 static void ICACHE_FLASH_ATTR switchingTimeRemove( int index );
 static void ICACHE_FLASH_ATTR switchingTimeDelete( int index );
+static int  ICACHE_FLASH_ATTR switchingTimeLoad( switching_time_ext_t *switching_time );
 static int  ICACHE_FLASH_ATTR switchingTimeGet( uint32_t *cfg_data, int len, uint32_t rd_addr, switching_time_ext_t *switching_time );
+static int  ICACHE_FLASH_ATTR switchingTimeGetSchedule( switching_time_t *record, int len, uint32_t rd_addr );
+static uint32_t ICACHE_FLASH_ATTR switchingTimeSaveSchedule( switching_time_t *record, int count, int flags );
+static int  ICACHE_FLASH_ATTR switchingTimeStore( switching_time_ext_t *list, int count, int flags );
 static void ICACHE_FLASH_ATTR switchingTimerCb( void *arg );
 static void ICACHE_FLASH_ATTR switchingTimeUpdateCb( uint32_t event, void *arg, void *arg2 );
 static int  ICACHE_FLASH_ATTR switchingTimeAdjust( switching_time_ext_t *switching_time, time_t time );
@@ -69,6 +84,9 @@ static void ICACHE_FLASH_ATTR switchingTimeSortList( switching_time_ext_t *switc
 CgiStatus ICACHE_FLASH_ATTR tplTimer( HttpdConnData *connData, char *token, void **arg );
 CgiStatus ICACHE_FLASH_ATTR cgiSetTimer( HttpdConnData *connData );
 int  ICACHE_FLASH_ATTR switchingTimeInit( void );
+int  ICACHE_FLASH_ATTR switchingTimeNext( switching_time_t *next, int max );
+const char* ICACHE_FLASH_ATTR switchingTimeTypeName( int type );
+CgiStatus ICACHE_FLASH_ATTR cgiApiTimers( HttpdConnData *connData );
 
 // --------------------------------------------------------------------------
 //
@@ -76,6 +94,9 @@ int  ICACHE_FLASH_ATTR switchingTimeInit( void );
 
 #define MAX_SWITCHING_TIMERS 32
 
+// flags of a schedule record, in the .val field of its header
+#define SCHEDULE_REPLACE     0x01    // replaces the switching times written before
+
 static switching_time_ext_t switchingTime[ MAX_SWITCHING_TIMERS ];
 static int num_switchingTimes = 0;
 static os_timer_t switchingTimer;
@@ -447,12 +468,134 @@ static void ICACHE_FLASH_ATTR switchingTimeDelete( int index )
 {
    // ESP_LOGD( TAG, "switchingTimeDelete %d", index );
 
+   uint32_t addr = switchingTime[ index ].addr;
    switchingTime[ index ].type = 0;
-   if( switchingTime[ index ].addr )
-      user_config_invalidate( switchingTime[ index ].addr );
 
    // remove from list
    switchingTimeRemove( index );
+
+   if( addr )
+   {
+      // the other switching times of a schedule record are written again without this one
+      switching_time_t record[ MAX_SCHEDULE_TIMERS + 1 ];
+      int count = 0;
+
+      for( int i = 0; i < num_switchingTimes; i++ )
+      {
+         if( switchingTime[ i ].addr == addr )
+            memcpy( &record[ ++count ], &switchingTime[ i ], sizeof( switching_time_t ) );
+      }
+
+      if( count > 0 )
+      {
+         // the record may be moved when the flash is cleaned up for the write, the
+         // switching times of the record know where it is then
+         int first = 0;
+         while( switchingTime[ first ].addr != addr )
+            first++;
+
+         uint32_t wr_addr = switchingTimeSaveSchedule( record, count, 0 );
+         addr = switchingTime[ first ].addr;
+         for( int i = 0; i < num_switchingTimes; i++ )
+         {
+            if( switchingTime[ i ].addr == addr )
+               switchingTime[ i ].addr = wr_addr;
+         }
+      }
+      user_config_invalidate( addr );
+   }
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// write switching times as one record to the flash, record[ 0 ] is the header and
+// record[ 1 .. count ] are the switching times
+
+static uint32_t ICACHE_FLASH_ATTR switchingTimeSaveSchedule( switching_time_t *record, int count, int flags )
+{
+   // ESP_LOGD( TAG, "switchingTimeSaveSchedule %d flags %d", count, flags );
+
+   record[ 0 ].type = 0;
+   record[ 0 ].val  = flags;
+   record[ 0 ].dmy  = count;
+   record[ 0 ].id   = ID_SCHEDULE;
+   record[ 0 ].time = 0;
+
+   return ( uint32_t )config_save_str( ID_EXTRA_DATA, ( char * )record, ( count + 1 ) * sizeof( switching_time_t ), Structure );
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// Add the switching times of the list with one flash write. With SCHEDULE_REPLACE they
+// replace the current switching times: the new record is valid on its own, also when the
+// records of the old ones are not yet invalidated. The hourglass is kept.
+
+static int ICACHE_FLASH_ATTR switchingTimeStore( switching_time_ext_t *list, int count, int flags )
+{
+   // ESP_LOGD( TAG, "switchingTimeStore %d flags %d", count, flags );
+
+   switching_time_t record[ MAX_SCHEDULE_TIMERS + 1 ];
+
+   for( int i = 0; i < count; i++ )
+   {
+      list[ i ].id = ID_SWITCHTIME;
+      memcpy( &record[ i + 1 ], &list[ i ], sizeof( switching_time_t ) );
+   }
+   uint32_t addr = switchingTimeSaveSchedule( record, count, flags );
+
+   if( flags & SCHEDULE_REPLACE )
+   {
+      for( int i = num_switchingTimes - 1; i >= 0; i-- )
+      {
+         if( switchingTime[ i ].id == ID_SWITCHTIME )
+         {
+            // records of a schedule are shared, invalidating them twice does no harm
+            if( switchingTime[ i ].addr )
+               user_config_invalidate( switchingTime[ i ].addr );
+            switchingTimeRemove( i );
+         }
+      }
+
+      // The records before are invalidated now. The flag is cleared in the flash, clearing a bit
+      // needs no erase, otherwise the record would drop the switching times added after it
+      // when the flash is cleaned up and they are copied in front of it.
+      record[ 0 ].val &= ~SCHEDULE_REPLACE;
+      user_config_write( addr, ( char * )&record[ 0 ], sizeof( uint32_t ) );
+   }
+
+   for( int i = 0; i < count; i++ )
+   {
+      list[ i ].addr = addr;
+      switchingTimeInsert( &list[ i ] );
+   }
+
+   // the hourglass may have moved
+   hourglass_index = 0;
+   for( int i = 0; i < num_switchingTimes; i++ )
+   {
+      if( switchingTime[ i ].id == ID_HOURGLASS )
+         hourglass_index = i + 1;
+   }
+   return count;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// a record with switching times was copied to new_addr when the flash was cleaned up
+
+void ICACHE_FLASH_ATTR switchingTimeMoved( uint32_t old_addr, uint32_t new_addr )
+{
+   for( int i = 0; i < num_switchingTimes; i++ )
+   {
+      if( switchingTime[ i ].addr == old_addr )
+         switchingTime[ i ].addr = new_addr;
+   }
 }
 
 // --------------------------------------------------------------------------
@@ -474,6 +617,9 @@ static int ICACHE_FLASH_ATTR switchingTimeGet( uint32_t *cfg_data, int len, uint
 
    memcpy( switching_time, cfg_data, sizeof( switching_time_ext_t ) );
 
+   if( switching_time->id == ID_SCHEDULE )
+      return switchingTimeGetSchedule( ( switching_time_t * )cfg_data, len, rd_addr );
+
    if( switching_time->id != ID_SWITCHTIME )
       return false;
 
@@ -482,18 +628,76 @@ static int ICACHE_FLASH_ATTR switchingTimeGet( uint32_t *cfg_data, int len, uint
                   switching_time->val ? "ON" : "OFF" );
    switching_time->addr = rd_addr;
 
-   // adjust time for the future
+   if( !switchingTimeLoad( switching_time ) )
+   {
+      // don't add to list, invalidate it in the flash
+      user_config_invalidate( rd_addr );
+   }
+   return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// a schedule record: a header with the number of switching times and the flags,
+// followed by the switching times
+
+static int ICACHE_FLASH_ATTR switchingTimeGetSchedule( switching_time_t *record, int len, uint32_t rd_addr )
+{
+   int count = record[ 0 ].dmy;
+
+   ESP_LOGD( TAG, "read schedule of %d switching times, flags %d", count, record[ 0 ].val );
+
+   if( count > MAX_SCHEDULE_TIMERS || ( count + 1 ) * sizeof( switching_time_t ) > len )
+      return false;
+
+   if( record[ 0 ].val & SCHEDULE_REPLACE )
+   {
+      // Forget the switching times read so far. The flag is only still set if the power was
+      // lost in switchingTimeStore(), finish it: invalidate the records before and clear the
+      // flag. Otherwise switchingTimeDelete() would write the record again without the flag
+      // and the records before would be valid again.
+      for( int i = num_switchingTimes - 1; i >= 0; i-- )
+      {
+         if( switchingTime[ i ].id == ID_SWITCHTIME )
+         {
+            if( switchingTime[ i ].addr )
+               user_config_invalidate( switchingTime[ i ].addr );
+            switchingTimeRemove( i );
+         }
+      }
+      record[ 0 ].val &= ~SCHEDULE_REPLACE;
+      user_config_write( rd_addr, ( char * )&record[ 0 ], sizeof( uint32_t ) );
+   }
+
+   for( int i = 1; i <= count; i++ )
+   {
+      switching_time_ext_t switching_time;
+      memcpy( &switching_time, &record[ i ], sizeof( switching_time_t ) );
+      switching_time.addr = rd_addr;
+
+      // a ONCE switching time in the past is dropped when the record is written again
+      switchingTimeLoad( &switching_time );
+   }
+   return true;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// adjust a switching time read from the flash to the future and insert it into the list,
+// false for a ONCE switching time in the past
+
+static int ICACHE_FLASH_ATTR switchingTimeLoad( switching_time_ext_t *switching_time )
+{
    time_t current_time = sntp_gettime();
    if( switching_time->time < current_time )
    {
       // time stored in the flash is in the past
-
       if( switching_time->type == ONCE )
-      {
-         // don't add to list, invalidate it in the flash
-         user_config_invalidate( rd_addr );
-         return true;
-      }
+         return false;
 
       // adjust to current date
       switchingTimeAdjust( switching_time, current_time );
@@ -571,6 +775,64 @@ static void ICACHE_FLASH_ATTR switchingTimerCb( void *arg )
 //
 // --------------------------------------------------------------------------
 
+// The next max switching times, in the order they are due. Returns their number.
+
+int ICACHE_FLASH_ATTR switchingTimeNext( switching_time_t *next, int max )
+{
+   time_t current_time = sntp_gettime();
+   int n = 0;
+
+   // the list is sorted by time
+   for( int i = 0; i < num_switchingTimes && n < max; i++ )
+   {
+      if( switchingTime[ i ].type && switchingTime[ i ].time > current_time )
+      {
+         memcpy( &next[ n ], &switchingTime[ i ], sizeof( switching_time_t ) );
+         n++;
+      }
+   }
+   return n;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
+// names of the types of switching times, used by the JSON API
+
+static const char * const switchingTimeTypes[ ONCE + 1 ] =
+{
+   "unknown", "mon", "tue", "wed", "thu", "fri", "sat", "sun",
+   "daily", "workday", "weekend", "once"
+};
+
+const char* ICACHE_FLASH_ATTR switchingTimeTypeName( int type )
+{
+   return type > 0 && type <= ONCE ? switchingTimeTypes[ type ] : switchingTimeTypes[ 0 ];
+}
+
+// the type of a name or number, 0 if unknown
+
+static int ICACHE_FLASH_ATTR switchingTimeTypeParse( const char *str )
+{
+   if( *str >= '0' && *str <= '9' )
+   {
+      int type = atoi( str );
+      return type <= ONCE ? type : 0;
+   }
+
+   for( int type = 1; type <= ONCE; type++ )
+   {
+      if( strcmp( str, switchingTimeTypes[ type ] ) == 0 )
+         return type;
+   }
+   return 0;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
 // Template code for the "Switching Timer" page.
 
 // TimerList
@@ -750,8 +1012,7 @@ CgiStatus ICACHE_FLASH_ATTR cgiSetTimer( HttpdConnData *connData )
       return HTTPD_CGI_DONE;
    }
 
-   int len;
-   char buf[64];
+   HttpdArgs args;
 
    time_t clock_date = 0;
    time_t clock_time = 0;
@@ -760,9 +1021,20 @@ CgiStatus ICACHE_FLASH_ATTR cgiSetTimer( HttpdConnData *connData )
    switching_time_ext_t newSwitchingTime;
    memset( &newSwitchingTime, 0, sizeof( switching_time_ext_t ) );
 
-   for( int i = 0; i < NUM_TOKEN; i++ )
+   httpdParseArgsArena( connData, &args, connData->getArgs );
+
+   // handle the arguments present in the request
+   for( int a = 0; a < args.count; a++ )
    {
-      len = httpdFindArg( connData->getArgs, token[ i ], buf, sizeof( buf ) );
+      char *buf = ( char * )args.arg[ a ].value;
+      int len = args.arg[ a ].valueLen;
+      int i;
+
+      for( i = 0; i < NUM_TOKEN; i++ )
+      {
+         if( strcmp( args.arg[ a ].name, token[ i ] ) == 0 ) break;
+      }
+
       if( len > 0 )
       {
          if( i == TOKEN_DELETE )
@@ -888,6 +1160,242 @@ CgiStatus ICACHE_FLASH_ATTR cgiSetTimer( HttpdConnData *connData )
 //
 // --------------------------------------------------------------------------
 
+// JSON API of the switching times
+//
+// GET    /api/timers             {"timers":[{"index":0,"id":1,"type":"workday","date":"20.10.2026","time":"06:30:00","val":1},...]}
+// PUT    /api/timers             replace all switching times with the ones of the body, written to
+//                                the flash as one record, at most MAX_SCHEDULE_TIMERS
+//                                [{"type":"workday","time":"6:30","val":1},{"type":"daily","time":"22:00","val":0}]
+//                                or {"timers":[...]}, the output of GET is accepted
+// POST   /api/timers             add switching times, one object or a list like PUT
+//                                {"type":"once","date":"24.12.2026","time":"18:00","val":1}
+// DELETE /api/timers?index=n     delete the switching time with the index of GET
+//
+// "type" is mon .. sun, daily, workday, weekend, once or its number, "date" and "time" take the
+// forms of dateToTime() and clockToTime(), "val" is 0, 1, false or true. A ONCE switching time
+// in the past is ignored, as well as an entry with an "id" other than 1, like the hourglass ( 2 ). The response is {"timers":n}, the number of switching times stored, or
+// {"error":"..."} with status 400 and nothing is changed.
+
+typedef struct
+{
+   HttpdPostParser pp;
+   switching_time_ext_t timer[ MAX_SCHEDULE_TIMERS ];
+   int count;                 // number of switching times in the body
+   const char *error;
+   char buf[ 24 ];
+   int len;
+} TimersPostData;
+
+static int ICACHE_FLASH_ATTR timersPostField( HttpdPostParser *pp, const char *data, int len, int flags )
+{
+   TimersPostData *tpd = ( TimersPostData * )pp->arg;
+
+   if( flags & HTTPD_POST_FIRST ) tpd->len = 0;
+
+   if( len > ( int )sizeof( tpd->buf ) - 1 - tpd->len ) len = sizeof( tpd->buf ) - 1 - tpd->len;
+   if( len > 0 )
+   {
+      memcpy( tpd->buf + tpd->len, data, len );
+      tpd->len += len;
+   }
+
+   if( !( flags & HTTPD_POST_LAST ) )
+      return 0;
+   tpd->buf[ tpd->len ] = 0;
+
+   // "[2].time", "timers[2].time" or "time" of a single object
+   const char *field = strrchr( pp->name, '.' );
+   const char *bracket = strrchr( pp->name, '[' );
+   int index = bracket != NULL ? atoi( bracket + 1 ) : 0;
+   field = field != NULL ? field + 1 : pp->name;
+
+   if( index >= MAX_SCHEDULE_TIMERS )
+   {
+      tpd->error = "too many switching times";
+      return HTTPD_POST_ERR_ABORT;
+   }
+   if( index >= tpd->count )
+      tpd->count = index + 1;
+
+   switching_time_ext_t *st = &tpd->timer[ index ];
+   if( strcmp( field, "type" ) == 0 )
+   {
+      st->type = switchingTimeTypeParse( tpd->buf );
+      if( st->type == 0 )
+      {
+         tpd->error = "invalid type";
+         return HTTPD_POST_ERR_ABORT;
+      }
+   }
+   else if( strcmp( field, "date" ) == 0 )
+      st->time += dateToTime( tpd->buf );
+   else if( strcmp( field, "time" ) == 0 )
+      st->time += clockToTime( tpd->buf );
+   else if( strcmp( field, "val" ) == 0 )
+      st->val = strcmp( tpd->buf, "true" ) == 0 || atoi( tpd->buf ) != 0;
+   else if( strcmp( field, "id" ) == 0 )
+      st->id = atoi( tpd->buf );
+   // other fields, like "index" of GET, are ignored
+
+   return 0;
+}
+
+static CgiStatus ICACHE_FLASH_ATTR apiTimersReply( HttpdConnData *connData, int status, const char *error, int count )
+{
+   char buf[ 64 ];
+   int buflen;
+
+   if( error != NULL )
+      buflen = snprintf( buf, sizeof( buf ), "{\"error\":\"%s\"}", error );
+   else
+      buflen = snprintf( buf, sizeof( buf ), "{\"timers\":%d}", count );
+
+   httpdStartResponse( connData, status );
+   httpdHeader( connData, "Content-Type", "application/json" );
+   httpdEndHeaders( connData );
+   httpdSend( connData, buf, buflen );
+   return HTTPD_CGI_DONE;
+}
+
+// PUT and POST
+static CgiStatus ICACHE_FLASH_ATTR apiTimersPost( HttpdConnData *connData )
+{
+   TimersPostData *tpd = ( TimersPostData * )connData->cgiData;
+   int rc;
+
+   if( tpd == NULL )
+   {
+      tpd = ( TimersPostData * )httpdArenaAlloc( connData, sizeof( TimersPostData ) );
+      if( tpd == NULL )
+      {
+         ESP_LOGE( TAG, "Failed to allocate post data" );
+         return HTTPD_CGI_NOTFOUND;
+      }
+      memset( tpd, 0, sizeof( TimersPostData ) );
+      httpdPostParserInit( &tpd->pp, connData, timersPostField, tpd );
+      connData->cgiData = tpd;
+   }
+
+   rc = httpdPostParseChunk( &tpd->pp, connData );
+
+   // after an error just eat up the rest of the body
+   if( connData->post.received < connData->post.len )
+      return HTTPD_CGI_MORE;
+
+   if( rc < 0 )
+      return apiTimersReply( connData, 400, tpd->error != NULL ? tpd->error : "invalid JSON", 0 );
+
+   // adjust to the next switching day, keep the ones in the future
+   time_t current_time = sntp_gettime();
+   int count = 0;
+   for( int i = 0; i < tpd->count; i++ )
+   {
+      switching_time_ext_t *st = &tpd->timer[ i ];
+
+      // the hourglass in the output of GET stays as it is, it's set on the timer page
+      if( st->id != 0 && st->id != ID_SWITCHTIME )
+         continue;
+
+      if( st->type == 0 )
+         return apiTimersReply( connData, 400, "missing type", 0 );
+
+      if( st->type != ONCE )
+         switchingTimeAdjust( st, current_time );
+      if( st->time > current_time )
+         memmove( &tpd->timer[ count++ ], st, sizeof( switching_time_ext_t ) );
+   }
+
+   if( connData->requestType == HTTPD_METHOD_PUT )
+   {
+      ESP_LOGI( TAG, "replace the switching times with %d", count );
+      switchingTimeStore( tpd->timer, count, SCHEDULE_REPLACE );
+   }
+   else if( count > 0 )
+   {
+      if( num_switchingTimes + count > MAX_SWITCHING_TIMERS )
+         return apiTimersReply( connData, 400, "switching timer list is full", 0 );
+
+      ESP_LOGI( TAG, "add %d switching times", count );
+      switchingTimeStore( tpd->timer, count, 0 );
+   }
+   return apiTimersReply( connData, 200, NULL, count );
+}
+
+CgiStatus ICACHE_FLASH_ATTR cgiApiTimers( HttpdConnData *connData )
+{
+   if( connData->isConnectionClosed )
+   {
+      // Connection aborted. The data is released with the request arena.
+      connData->cgiData = NULL;
+      return HTTPD_CGI_DONE;
+   }
+
+   if( connData->requestType == HTTPD_METHOD_PUT || connData->requestType == HTTPD_METHOD_POST )
+   {
+      return apiTimersPost( connData );
+   }
+
+   if( connData->requestType == HTTPD_METHOD_DELETE )
+   {
+      HttpdArgs args;
+      const HttpdArg *arg;
+
+      httpdParseArgsArena( connData, &args, connData->getArgs );
+      arg = httpdGetArg( &args, "index" );
+      int index = arg != NULL && arg->valueLen > 0 ? atoi( arg->value ) : -1;
+      if( index < 0 || index >= num_switchingTimes || switchingTime[ index ].id != ID_SWITCHTIME )
+         return apiTimersReply( connData, 404, "no such switching time", 0 );
+
+      ESP_LOGI( TAG, "delete: %d", index );
+      switchingTimeDelete( index );
+      return apiTimersReply( connData, 200, NULL, 1 );
+   }
+
+   if( connData->requestType != HTTPD_METHOD_GET )
+   {
+      httpdStartResponse( connData, 405 );
+      httpdEndHeaders( connData );
+      return HTTPD_CGI_DONE;
+   }
+
+   // GET, the list is sent in as many calls as needed
+   int *next = ( int * )connData->cgiData;
+   if( next == NULL )
+   {
+      next = ( int * )httpdArenaAlloc( connData, sizeof( int ) );
+      if( next == NULL )
+         return HTTPD_CGI_NOTFOUND;
+      *next = 0;
+      connData->cgiData = next;
+
+      httpdStartResponse( connData, 200 );
+      httpdHeader( connData, "Content-Type", "application/json" );
+      httpdHeader( connData, "Cache-Control", "no-cache" );
+      httpdEndHeaders( connData );
+      httpdSend( connData, "{\"timers\":[", -1 );
+   }
+
+   char buf[ 128 ];
+   for( ; *next < num_switchingTimes; ( *next )++ )
+   {
+      switching_time_ext_t *st = &switchingTime[ *next ];
+      int buflen = snprintf( buf, sizeof( buf ),
+                             "%s{\"index\":%d,\"id\":%d,\"type\":\"%s\",\"date\":\"%s\",\"time\":\"%s\",\"val\":%d}",
+                             *next > 0 ? "," : "", *next, st->id, switchingTimeTypeName( st->type ),
+                             timeToDate( st->time ), timeToClock( st->time ), st->val );
+
+      if( httpdSend( connData, NULL, 0 ) < buflen + 16 )
+         return HTTPD_CGI_MORE;
+      httpdSend( connData, buf, buflen );
+   }
+   httpdSend( connData, "]}", 2 );
+   return HTTPD_CGI_DONE;
+}
+
+// --------------------------------------------------------------------------
+//
+// --------------------------------------------------------------------------
+
 // first map switching time to the current day
 // then adjust to the day of type references
 // ONCE switching time in the future should not pass this function,
@@ -9,6 +9,10 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   the extra data copied from the oldest block are read at their addresses in
+//                        the user configuration section, switchingTimeMoved() is told the new address
+//    2026-10-19  AWe   user_config_scan() reads whole records near the end of a block
+//    2026-10-19  AWe   saving a setting invalidates the render cache
 //    2018-06-24  AWe   add FillData near the end of a block, when a new write has no place there
 //    2017-12-13  AWe   implement new ringbuffer concept
 //    2017-11-29  AWe   initial implementation
@@ -58,6 +62,8 @@ static const char *TAG = "modules/configs.c";
 
 
 #include "configs.h"
+#include "libesphttpd/rendercache.h"   // renderCacheBump()
+#include "cgiTimer.h"                  // switchingTimeMoved()
 
 // --------------------------------------------------------------------------
 //
@@ -1117,6 +1123,7 @@ int ICACHE_FLASH_ATTR config_save( cfg_mode_t cfg_mode, char *str, int value )
 {
    ASSERT( "str isn't 32bit aligned", ( ( uint32_t ) str & 3 ) == 0 );
    ESP_LOGD( TAG, "config_save 0x%08x %s %d", cfg_mode.mode, S( str ), value );
+   renderCacheBump();      // pages showing the settings must be rendered again
 
    // get the address to save the configuration record
    uint32_t addr = user_settings.write;   // 8 .. 0x2FFF; address for the next record to write
@@ -1214,7 +1221,8 @@ int ICACHE_FLASH_ATTR config_save( cfg_mode_t cfg_mode, char *str, int value )
          while( num_words > 0)
          {
             cfg_mode_t cfg_mode;
-            spi_flash_read( rd_addr, ( uint32_t *)&cfg_mode, sizeof(cfg_mode ) );
+            user_config_read( rd_addr, ( char * )&cfg_mode, sizeof( cfg_mode ) );
+            rd_addr += sizeof( cfg_mode_t );
             num_words--;
 
             if( cfg_mode.mode == 0xFFFFFFFF ) // end of list
@@ -1230,14 +1238,15 @@ int ICACHE_FLASH_ATTR config_save( cfg_mode_t cfg_mode, char *str, int value )
 
                if( cfg_mode.id == ID_EXTRA_DATA && cfg_mode.valid != RECORD_ERASED )
                {
-                  uint8_t buf[ len4 ];
-                  spi_flash_read( rd_addr, ( uint32_t *)buf, len4 );
+                  uint32_t buf[ len4 / sizeof( uint32_t ) ];
+                  user_config_read( rd_addr, ( char * )buf, len4 );
 
                   int wr_len = user_config_write( addr, ( char * )&cfg_mode, sizeof( cfg_mode_t ) );
                   addr += wr_len;
+                  // the switching times keep the address of their record
+                  switchingTimeMoved( rd_addr, addr );
                   wr_len = user_config_write( addr, ( char * )buf, len4 );
                   addr += wr_len;
-                  num_words -= len4 / sizeof( uint32_t );
                }
 
                rd_addr += len4;
@@ -1533,10 +1542,10 @@ int ICACHE_FLASH_ATTR user_config_scan( int id, int (call_back)(), void *arg )
          while( num_words > 0)
          {
             uint32_t buf32[ 1 + 64 ];     // cfg_mode + 256 bytes
-            int rd_words = sizeof( buf32 );
-            if( rd_words > num_words )
-               rd_words = num_words;
-            user_config_read( rd_addr, ( char * )buf32, rd_words );
+            int rd_bytes = sizeof( buf32 );
+            if( rd_bytes > num_words * sizeof( uint32_t ) )
+               rd_bytes = num_words * sizeof( uint32_t );
+            user_config_read( rd_addr, ( char * )buf32, rd_bytes );
             cfg_mode_t *cfg_mode = ( cfg_mode_t * )buf32;
 
             if( cfg_mode->mode == 0xFFFFFFFF ) // end of list
@@ -9,6 +9,7 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   switching the relay invalidates the render cache
 //    2018-04-13  AWe   send the new state of the device to the mqtt server
 //    2017-11-20  AWe   add here parts from io.c
 //
@@ -41,6 +42,7 @@ static const char* TAG = "device";
 #include "io.h"
 #include "leds.h"
 #include "device.h"        // switchRelay()
+#include "libesphttpd/rendercache.h"   // renderCacheBump()
 
 // --------------------------------------------------------------------------
 //
@@ -60,6 +62,7 @@ int ICACHE_FLASH_ATTR devSet( enum _devices dev, int val )
    {
       case Relay:
          switchRelay( val );
+         renderCacheBump();
          break;
 
       case InfoLed:
@@ -9,6 +9,7 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   history_setEventHandler(), history_newEntry for new messages
 //    2018-06-18  AWe   initial implementation
 //
 // --------------------------------------------------------------------------
@@ -17,11 +18,17 @@
 #define __CGIHISTORY_H__
 
 #include "libesphttpd/httpd.h"      // CgiStatus
+#include "events.h"                 // appl_event_handler_t
 
 // --------------------------------------------------------------------------
 //
 // --------------------------------------------------------------------------
 
+enum
+{
+   history_newEntry = 0x1100,       // a message was saved, arg is the message
+};
+
 typedef struct
 {
    uint8_t type;
@@ -37,6 +44,7 @@ typedef struct
 
 CgiStatus ICACHE_FLASH_ATTR tplHistory( HttpdConnData *connData, char *token, void **arg );
 int ICACHE_FLASH_ATTR history( const char *format, ... );
+void ICACHE_FLASH_ATTR history_setEventHandler( appl_event_handler_t handler );
 
 // --------------------------------------------------------------------------
 //
@@ -0,0 +1,28 @@
+// --------------------------------------------------------------------------
+//
+// Project       IoT - Internet of Things
+//
+// File          cgiState.h
+//
+// Author        Axel Werner
+//
+// --------------------------------------------------------------------------
+// Changelog
+//
+//    2026-10-19  AWe   initial implementation
+//
+// --------------------------------------------------------------------------
+
+#ifndef __CGISTATE_H__
+#define __CGISTATE_H__
+
+#include "libesphttpd/httpd.h"      // CgiStatus
+
+// Max number of switching times in the "timers" field, see cgiApiState()
+#ifndef API_STATE_MAX_TIMERS
+   #define API_STATE_MAX_TIMERS     8
+#endif
+
+CgiStatus ICACHE_FLASH_ATTR cgiApiState( HttpdConnData *connData );
+
+#endif // __CGISTATE_H__
@@ -9,6 +9,9 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   add switchingTimeMoved()
+//    2026-10-19  AWe   add cgiApiTimers(), switchingTimeTypeName(), schedule records
+//    2026-10-19  AWe   add switchingTimeNext()
 //    2018-06-24  AWe   add support for WORKDAY and WEEKEND
 //    2018-06-08  AWe   initial implementation
 //
@@ -35,6 +38,10 @@
 #define ID_HISTORY         0
 #define ID_SWITCHTIME      1
 #define ID_HOURGLASS       2
+#define ID_SCHEDULE        3        // header of a record with several switching times
+
+// Max number of switching times written as one record, its length is a byte
+#define MAX_SCHEDULE_TIMERS   30
 
 // --------------------------------------------------------------------------
 //
@@ -71,6 +78,10 @@ time_t ICACHE_FLASH_ATTR dateToTime( char * str );
 CgiStatus ICACHE_FLASH_ATTR tplTimer( HttpdConnData *connData, char *token, void **arg );
 CgiStatus ICACHE_FLASH_ATTR cgiSetTimer( HttpdConnData *connData );
 int ICACHE_FLASH_ATTR switchingTimeInit( void );
+int ICACHE_FLASH_ATTR switchingTimeNext( switching_time_t *next, int max );
+const char* ICACHE_FLASH_ATTR switchingTimeTypeName( int type );
+void ICACHE_FLASH_ATTR switchingTimeMoved( uint32_t old_addr, uint32_t new_addr );
+CgiStatus ICACHE_FLASH_ATTR cgiApiTimers( HttpdConnData *connData );
 
 // --------------------------------------------------------------------------
 //
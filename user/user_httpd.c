@@ -9,6 +9,15 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   /api/timers without CONFIG_ESPHTTPD_METRICS
+//    2026-10-19  AWe   add /api/timers
+//    2026-10-19  AWe   /api/state without CONFIG_ESPHTTPD_METRICS, only /metrics needs it
+//    2026-10-19  AWe   add /api/state
+//    2026-10-19  AWe   /events: status, wifi and history events for pages which don't need a websocket
+//    2026-10-19  AWe   compress the templates, the scan result and the metrics, ROUTE_FLAG_DEFLATE
+//    2026-10-19  AWe   add /metrics
+//    2026-10-19  AWe   control cgis and the websocket may use the reserved connections
+//    2026-10-19  AWe   serve the status page from the render cache
 //    2018-05-08  AWe   remove support for 2nd websocket
 //    2017-11-12  AWe   adapt for use with current HW: only one relay
 //    2017-08-19  AWe   change debug message printing
@@ -65,14 +74,17 @@ some pictures of cats.
 #include "libesphttpd/captdns.h"
 #include "libesphttpd/webpages-espfs.h"
 #include "libesphttpd/cgiwebsocket.h"
+#include "libesphttpd/cgieventsource.h"
 #include "libesphttpd/httpd-nonos.h"
 #include "libesphttpd/cgiredirect.h"
 #include "libesphttpd/route.h"
+#include "libesphttpd/httpdmetrics.h"
 
 #include "cgiSwitchStatus.h"
 #include "cgiTimer.h"
 #include "cgiHistory.h"
 #include "cgiConfig.h"
+#include "cgiState.h"
 #include "mqtt_config.h"
 #include "wifi_config.h"
 
@@ -86,10 +98,13 @@ some pictures of cats.
 // --------------------------------------------------------------------------
 
 static int  ICACHE_FLASH_ATTR prepareSystemStatusMsg( char *buf, int bufsize );
+static int  ICACHE_FLASH_ATTR prepareSwitchStateMsg( char *buf, int bufsize );
 static int  ICACHE_FLASH_ATTR httpdPassFn( HttpdConnData *connData, int no, char *user, int userLen, char *pass, int passLen );
 static void ICACHE_FLASH_ATTR httpdWebsockTimerCb( void *arg );
 static void ICACHE_FLASH_ATTR httpdWebsocketRecv( Websock *ws, char *data, int len, int flags );
 static void ICACHE_FLASH_ATTR httpdWebsocketConnect( Websock *ws );
+static void ICACHE_FLASH_ATTR httpdEventsTimerCb( void *arg );
+static void ICACHE_FLASH_ATTR httpdHistoryEventCb( uint32_t event, void *arg );
 
 void ICACHE_FLASH_ATTR httpdInit( void );
 int  ICACHE_FLASH_ATTR httpdBroadcastStart( void );
@@ -100,6 +115,7 @@ int  ICACHE_FLASH_ATTR httpdBroadcastStop( void );
 // --------------------------------------------------------------------------
 
 static HttpdNonosInstance httpdNonosInstance;
+static EventSource statusEvents;    // events of /events
 
 // --------------------------------------------------------------------------
 //
@@ -122,15 +138,16 @@ const HttpdBuiltInUrl builtInUrls[] ICACHE_RODATA_ATTR STORE_ATTR =
 // ----------------------------+--------------------------------+----------------------
    {"*",                        cgiRedirectApClientToHostname,   "esp8266.nonet", NULL },
    {"/",                        cgiRedirect,                     "/index.tpl.html", NULL },
-   {"/index.tpl.html",          cgiEspFsTemplate,                tplSwitchStatus, NULL },
-   {"/Timer.tpl.html",          cgiEspFsTemplate,                tplTimer, NULL },
-   {"/settimer.cgi",            cgiSetTimer,                     NULL, NULL },
-   {"/WifiConfig.tpl.html",     cgiEspFsTemplate,                tplConfig, NULL },
-   {"/MqttConfig.tpl.html",     cgiEspFsTemplate,                tplConfig, NULL },
-   {"/Config.cgi",              cgiConfig,                       NULL, NULL },
-   {"/History.tpl.html",        cgiEspFsTemplate,                tplHistory, NULL },
+   {"/index.tpl.html",          cgiEspFsTemplateCached,          tplSwitchStatus, NULL, ROUTE_FLAG_DEFLATE },
+   {"/Timer.tpl.html",          cgiEspFsTemplate,                tplTimer, NULL, ROUTE_FLAG_DEFLATE },
+   {"/settimer.cgi",            cgiSetTimer,                     NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/WifiConfig.tpl.html",     cgiEspFsTemplate,                tplConfig, NULL, ROUTE_FLAG_DEFLATE },
+   {"/MqttConfig.tpl.html",     cgiEspFsTemplate,                tplConfig, NULL, ROUTE_FLAG_DEFLATE },
+   {"/Config.cgi",              cgiConfig,                       NULL, NULL, ROUTE_FLAG_PRIORITY },
+   {"/History.tpl.html",        cgiEspFsTemplate,                tplHistory, NULL, ROUTE_FLAG_DEFLATE },
 
-   {"/status",                  cgiWebsocket,                    httpdWebsocketConnect, NULL },
+   {"/status",                  cgiWebsocket,                    httpdWebsocketConnect, NULL, ROUTE_FLAG_PRIORITY },
+   {"/events",                  cgiEventSource,                  &statusEvents, NULL, ROUTE_FLAG_PRIORITY },
 
    // Routines to make the /wifi URL and everything beneath it work.
    // Enable the line below to protect the WiFi configuration with an username/password combo.
@@ -138,8 +155,8 @@ const HttpdBuiltInUrl builtInUrls[] ICACHE_RODATA_ATTR STORE_ATTR =
 
    {"/wifi",                    cgiRedirect,                     "/WifiSetup.tpl.html", NULL },
    {"/wifi/",                   cgiRedirect,                     "/WifiSetup.tpl.html", NULL },
-   {"/WifiSetup.tpl.html",      cgiEspFsTemplate,                tplWlan, NULL },
-   {"/wifi/wifiscan.cgi",       cgiWiFiScan,                     NULL, NULL },     // called from WifiSetup.tpl.html
+   {"/WifiSetup.tpl.html",      cgiEspFsTemplate,                tplWlan, NULL, ROUTE_FLAG_DEFLATE },
+   {"/wifi/wifiscan.cgi",       cgiWiFiScan,                     NULL, NULL, ROUTE_FLAG_DEFLATE },     // called from WifiSetup.tpl.html
    {"/wifi/connect.cgi",        cgiWiFiConnect,                  NULL, NULL },     // called from WifiSetup.tpl.html
    {"/wifi/connstatus.cgi",     cgiWiFiConnStatus,               NULL, NULL },     // called from wifi/connecting.html
    {"/wifi/setmode.cgi",        cgiWiFiSetMode,                  NULL, NULL },     // not used
@@ -150,6 +167,12 @@ const HttpdBuiltInUrl builtInUrls[] ICACHE_RODATA_ATTR STORE_ATTR =
 #endif
    {"/flash/reboot",            cgiRebootFirmware,               NULL, NULL },
 
+#ifdef CONFIG_ESPHTTPD_METRICS
+   {"/metrics",                 cgiMetrics,                      NULL, NULL, ROUTE_FLAG_PRIORITY | ROUTE_FLAG_DEFLATE },
+#endif
+   {"/api/state",               cgiApiState,                     NULL, NULL, ROUTE_FLAG_PRIORITY | ROUTE_FLAG_DEFLATE },
+   {"/api/timers",              cgiApiTimers,                    NULL, NULL, ROUTE_FLAG_PRIORITY },
+
    {"*",                        cgiEspFsHook,                    NULL, NULL },     // Catch-all cgi function for the filesystem
    {NULL, NULL, NULL, NULL}
 };
@@ -183,6 +206,7 @@ static int ICACHE_FLASH_ATTR httpdPassFn( HttpdConnData *connData, int no, char
 // --------------------------------------------------------------------------
 
 static os_timer_t websockTimer;
+static os_timer_t eventsTimer;
 
 // --------------------------------------------------------------------------
 //
@@ -247,6 +271,49 @@ static void ICACHE_FLASH_ATTR httpdWebsockTimerCb( void *arg )
       cgiWebsockBroadcast( &httpdNonosInstance.httpdInstance, "/status", buf, strlen( buf ), WEBSOCK_FLAG_NONE );
 }
 
+// --------------------------------------------------------------------------
+// Event source
+// --------------------------------------------------------------------------
+
+// the part of the status which doesn't change by itself
+static int ICACHE_FLASH_ATTR prepareSwitchStateMsg( char *buf, int bufsize )
+{
+   return snprintf( buf, bufsize,
+                    "{\"sysled\" : \"%d\","
+                    " \"relay\" : \"%d\","
+                    " \"info_led\" : \"%d\","
+                    " \"power\" : \"%d\"}",
+                    devGet( SysLed ), devGet( Relay ),
+                    devGet( InfoLed ), devGet( PowerSense ) );
+}
+
+// Check the states every second, only changes are sent to the clients of /events
+static void ICACHE_FLASH_ATTR httpdEventsTimerCb( void *arg )
+{
+   char buf[128];
+   int buflen;
+
+   buflen = prepareSwitchStateMsg( buf, sizeof( buf ) );
+   if( buflen < sizeof( buf ) )
+      eventSourcePublish( &httpdNonosInstance.httpdInstance, &statusEvents, "status", buf, buflen, EVENTSOURCE_FLAG_STATE );
+
+   buflen = cgiWiFiConnStatusJson( buf, sizeof( buf ) );
+   if( buflen < sizeof( buf ) )
+      eventSourcePublish( &httpdNonosInstance.httpdInstance, &statusEvents, "wifi", buf, buflen, EVENTSOURCE_FLAG_STATE );
+}
+
+// A new history message, sent as the columns of the history table: date, time, source, action
+static void ICACHE_FLASH_ATTR httpdHistoryEventCb( uint32_t event, void *arg )
+{
+   char buf[256];
+   time_t now = sntp_gettime();
+   int buflen = snprintf( buf, sizeof( buf ), "%s\t", timeToDate( now ) );
+
+   buflen += snprintf( buf + buflen, sizeof( buf ) - buflen, "%s\t%s", timeToClock( now ), ( const char * )arg );
+   if( buflen < sizeof( buf ) )
+      eventSourcePublish( &httpdNonosInstance.httpdInstance, &statusEvents, "history", buf, buflen, 0 );
+}
+
 // --------------------------------------------------------------------------
 // Websocket
 // --------------------------------------------------------------------------
@@ -330,6 +397,12 @@ void ICACHE_FLASH_ATTR httpdInit( void )
                     HTTPD_MAX_CONNECTIONS, HTTPD_FLAG_SSL );
 #endif
 
+   // the event source runs also without a station connection, e.g. for wifi/connecting.html
+   history_setEventHandler( httpdHistoryEventCb );
+   os_timer_disarm( &eventsTimer );
+   os_timer_setfn( &eventsTimer, httpdEventsTimerCb, NULL );
+   os_timer_arm( &eventsTimer, 1000, 1 );
+
    HEAP_INFO( "" );
 }
 
@@ -9,6 +9,7 @@
 // --------------------------------------------------------------------------
 // Changelog
 //
+//    2026-10-19  AWe   wifi events invalidate the render cache
 //    2018-05-03  AWe   remove wait_for_connection(), add its stuff to wifiIsConnected()
 //                      remove the wait_for_connection timer
 //                      connect to the external clients/servers in the event handler
@@ -51,6 +52,7 @@ static const char* TAG = "user/user_wifi.c";
 #include "user_mqtt.h"        // mqttWifiConnect()
 #include "user_httpd.h"       // httpdBroadcastStart(), httpdBroadcastStop()
 #include "user_wifi.h"
+#include "libesphttpd/rendercache.h"   // renderCacheBump()
 
 #include "cgiHistory.h"
 
@@ -632,6 +634,9 @@ static void ICACHE_FLASH_ATTR wifiEventHandlerCb( System_Event_t *event )
       return;
    }
 
+   // the status pages show the network state
+   renderCacheBump();
+
    switch( event->event )
    {
       case EVENT_STAMODE_CONNECTED: